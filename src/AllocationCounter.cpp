@@ -0,0 +1,38 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "AllocationCounter.hpp"
+
+static std::atomic < uint64_t > f_allocations ( 0 );
+static std::atomic < uint64_t > f_bytes ( 0 );
+
+void * operator new ( size_t size )
+{
+	f_allocations.fetch_add ( 1, std::memory_order_relaxed );
+	f_bytes.fetch_add ( size, std::memory_order_relaxed );
+	void * p ( malloc ( size ? size : 1 ) );
+	if ( !p )
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete ( void * p ) noexcept
+{
+	free ( p );
+}
+
+namespace JumpInterview {
+	namespace OrderBook {
+
+		uint64_t AllocationCounter::allocations()
+		{
+			return f_allocations.load();
+		}
+
+		uint64_t AllocationCounter::bytes()
+		{
+			return f_bytes.load();
+		}
+	}
+}
@@ -0,0 +1,24 @@
+#ifndef __ALLOCATION_COUNTER_HPP__
+#define __ALLOCATION_COUNTER_HPP__
+
+#include <stdint.h>
+
+namespace JumpInterview {
+	namespace OrderBook {
+
+		/*
+		 * Every allocation that goes to the heap, for the benchmarks' allocs/msg and allocs/op. Linking this in replaces
+		 * operator new for the whole program, so only the benchmarks do. Pooled objects only show up here when their
+		 * pool has nothing left to hand out.
+		 */
+		class AllocationCounter
+		{
+		public:
+			static uint64_t allocations();
+			/* And how many bytes they asked for */
+			static uint64_t bytes();
+		};
+	}
+}
+
+#endif
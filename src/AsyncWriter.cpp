@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <assert.h>
+#include <chrono>
+#include <unistd.h>
+
+#include "AsyncWriter.hpp"
+
+namespace JumpInterview {
+	namespace OrderBook {
+
+		/*
+		 * Neither side ever waits on the other for longer than this. The ring doesn't need the mutex, so a wakeup
+		 * can slip through the cracks - this way that costs us a millisecond rather than a deadlock.
+		 */
+		static const std::chrono::milliseconds f_max_wait ( 1 );
+
+		AsyncWriterStats::AsyncWriterStats() :
+			blocks ( 0 ),
+			producer_stalls ( 0 ),
+			stalled_ns ( 0 ),
+			dropped_blocks ( 0 ),
+			dropped_bytes ( 0 ),
+			occupancy_sum ( 0 ),
+			max_occupancy ( 0 ),
+			capacity ( 0 ),
+			bytes_written ( 0 ),
+			writes ( 0 ),
+			failed_writes ( 0 ),
+			syncs ( 0 ),
+			failed_syncs ( 0 ),
+			sync_ns ( 0 ),
+			max_sync_ns ( 0 )
+		{
+		}
+
+		std::ostream& operator<< ( std::ostream& os, const AsyncWriterStats& stats )
+		{
+			os << "[ OUTPUT] Blocks handed to the writer: " << stats.blocks << std::endl;
+			os << "[ OUTPUT] Bytes written: " << stats.bytes_written << " in " << stats.writes << " writes, " << stats.failed_writes << " failed" << std::endl;
+			os << "[ OUTPUT] Ring occupancy: " << ( stats.blocks ? stats.occupancy_sum / stats.blocks : 0 ) << " bytes on average, " <<
+			   stats.max_occupancy << " at most, out of " << stats.capacity << std::endl;
+			os << "[ OUTPUT] Producer stalls: " << stats.producer_stalls << ", " << stats.stalled_ns / 1000 << " us in total" << std::endl;
+			os << "[ OUTPUT] Dropped: " << stats.dropped_blocks << " blocks, " << stats.dropped_bytes << " bytes" << std::endl;
+			if ( stats.syncs )
+				os << "[ OUTPUT] Syncs: " << stats.syncs << ", " << stats.failed_syncs << " failed, " << stats.sync_ns / stats.syncs / 1000 <<
+				   " us on average, " << stats.max_sync_ns / 1000 << " us at most" << std::endl;
+			return os;
+		}
+
+		AsyncWriter::AsyncWriter ( int fd, RingFullPolicy::Policy policy, size_t capacity, GroupCommit commit ) :
+			m_fd ( fd ),
+			m_policy ( policy ),
+			m_ring ( capacity ),
+			m_closing ( false ),
+			m_writer_waiting ( false ),
+			m_producer_waiting ( false ),
+			m_commit ( commit ),
+			m_wake_at ( commit.enabled() ? std::min ( m_ring.capacity() / 4, commit.bytes ? commit.bytes : m_ring.capacity() ) : 0 ),
+			m_uncommitted ( 0 ),
+			m_committed ( 0 ),
+			// last, everything it uses has to be there already
+			m_thread ( &AsyncWriter::run, this )
+		{
+			m_stats.capacity = m_ring.capacity();
+		}
+
+		AsyncWriter::~AsyncWriter()
+		{
+			close();
+		}
+
+		void AsyncWriter::write ( const char * data, size_t size )
+		{
+			assert ( !m_closing );
+			size_t occupancy ( m_ring.capacity() - m_ring.freeSpace() );
+			m_stats.blocks++;
+			m_stats.occupancy_sum += occupancy;
+			m_stats.max_occupancy = std::max ( m_stats.max_occupancy, occupancy );
+			if ( m_policy == RingFullPolicy::DROP )
+			{
+				// all or nothing, half a block is worse than none
+				if ( m_ring.freeSpace() < size )
+				{
+					m_stats.producer_stalls++;
+					m_stats.dropped_blocks++;
+					m_stats.dropped_bytes += size;
+					return;
+				}
+				m_ring.push ( data, size );
+				wakeWriter();
+				return;
+			}
+			bool stalled ( false );
+			std::chrono::steady_clock::time_point stalled_since;
+			while ( true )
+			{
+				size_t pushed ( m_ring.push ( data, size ) );
+				data += pushed;
+				size -= pushed;
+				if ( pushed )
+					wakeWriter();
+				if ( !size )
+					break;
+				if ( !stalled )
+				{
+					stalled = true;
+					stalled_since = std::chrono::steady_clock::now();
+					m_stats.producer_stalls++;
+				}
+				if ( m_policy == RingFullPolicy::SPIN )
+					std::this_thread::yield();
+				else
+					waitForSpace();
+			}
+			if ( stalled )
+				m_stats.stalled_ns += std::chrono::duration_cast < std::chrono::nanoseconds > ( std::chrono::steady_clock::now() - stalled_since ).count();
+		}
+
+		void AsyncWriter::close()
+		{
+			if ( !m_thread.joinable() )
+				return;
+			{
+				std::lock_guard < std::mutex > lock ( m_mutex );
+				m_closing.store ( true );
+				m_has_data.notify_one();
+			}
+			m_thread.join();
+		}
+
+		AsyncWriterStats const & AsyncWriter::stats() const
+		{
+			return m_stats;
+		}
+
+		uint64_t AsyncWriter::committed() const
+		{
+			return m_committed.load();
+		}
+
+		void AsyncWriter::commit()
+		{
+			std::chrono::steady_clock::time_point start ( std::chrono::steady_clock::now() );
+			if ( fdatasync ( m_fd ) )
+				m_stats.failed_syncs++;
+			else
+				m_committed.fetch_add ( m_uncommitted );
+			uint64_t took ( std::chrono::duration_cast < std::chrono::nanoseconds > ( std::chrono::steady_clock::now() - start ).count() );
+			m_stats.syncs++;
+			m_stats.sync_ns += took;
+			m_stats.max_sync_ns = std::max ( m_stats.max_sync_ns, took );
+			m_uncommitted = 0;
+		}
+
+		void AsyncWriter::waitForSpace()
+		{
+			std::unique_lock < std::mutex > lock ( m_mutex );
+			m_producer_waiting.store ( true );
+			if ( !m_ring.freeSpace() )
+				m_has_space.wait_for ( lock, f_max_wait );
+			m_producer_waiting.store ( false );
+		}
+
+		/*
+		 * With group commit, nothing we write is any good to anyone before the next commit anyway. So rather than wake
+		 * the writer thread for every little block ( a journal record is a couple of dozen bytes ), we let it wake up on
+		 * its own every f_max_wait - unless the ring is filling up faster than that.
+		 */
+		void AsyncWriter::wakeWriter()
+		{
+			if ( m_writer_waiting.load() && ( !m_wake_at || m_ring.size() >= m_wake_at ) )
+			{
+				std::lock_guard < std::mutex > lock ( m_mutex );
+				m_has_data.notify_one();
+			}
+		}
+
+		/*
+		 * The writer thread. Whatever sits in the ring in one piece goes out in one write - we don't wait for more
+		 * to come in, if the fd is slow the ring fills up behind us and the next write is bigger anyway. With group
+		 * commit we sync in between writes when it's time, and otherwise when we wake up with nothing to write - a
+		 * millisecond at most ( see f_max_wait ), so that's how much later than asked for a commit can be.
+		 */
+		void AsyncWriter::run()
+		{
+			const char * data;
+			while ( true )
+			{
+				size_t available ( m_ring.front ( data ) );
+				if ( available )
+				{
+					if ( FdSink::writeAll ( m_fd, data, available ) )
+					{
+						m_stats.bytes_written += available;
+						if ( m_commit.enabled() && !m_uncommitted )
+							m_uncommitted_since = std::chrono::steady_clock::now();
+						m_uncommitted += m_commit.enabled() ? available : 0;
+					}
+					else
+						m_stats.failed_writes++;
+					m_stats.writes++;
+					m_ring.pop ( available );
+					if ( m_producer_waiting.load() )
+					{
+						std::lock_guard < std::mutex > lock ( m_mutex );
+						m_has_space.notify_one();
+					}
+				}
+				if ( m_uncommitted && ( ( m_commit.bytes && m_uncommitted >= m_commit.bytes ) ||
+										( m_commit.interval_us && std::chrono::steady_clock::now() - m_uncommitted_since >= std::chrono::microseconds ( m_commit.interval_us ) ) ) )
+					commit();
+				if ( available )
+					continue;
+				// once we're closing nothing new comes in, but something may have just before
+				if ( m_closing.load() )
+				{
+					if ( m_ring.front ( data ) )
+						continue;
+					if ( m_uncommitted )
+						commit();
+					break;
+				}
+				std::unique_lock < std::mutex > lock ( m_mutex );
+				m_writer_waiting.store ( true );
+				if ( m_ring.empty() && !m_closing.load() )
+					m_has_data.wait_for ( lock, f_max_wait );
+				m_writer_waiting.store ( false );
+			}
+		}
+	}
+}
@@ -0,0 +1,135 @@
+#ifndef __ASYNC_WRITER_HPP__
+#define __ASYNC_WRITER_HPP__
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <ostream>
+#include <thread>
+
+#include "OutputBuffer.hpp"
+#include "SpscRing.hpp"
+
+namespace JumpInterview {
+	namespace OrderBook {
+
+		/* What the producer does when the writer thread can't keep up and the ring is full */
+		namespace RingFullPolicy
+		{
+			enum Policy
+			{
+				// wait until the writer thread made room, without burning the core
+				BLOCK,
+				// keep trying until there's room. Only makes sense if the writer thread has a core of its own
+				SPIN,
+				// throw the block away and count it. Lossy, but we never wait
+				DROP
+			};
+		}
+
+		/*
+		 * Makes the writer thread fdatasync() what it has written, once this many bytes are waiting for it or the
+		 * oldest of them has waited this long - whichever comes first. One sync covers every write before it, so a
+		 * whole group of them is committed at once. 0 for both, the default, and we never sync.
+		 */
+		struct GroupCommit
+		{
+			GroupCommit ( size_t commit_bytes = 0, uint32_t commit_us = 0 ) : bytes ( commit_bytes ), interval_us ( commit_us ) {}
+
+			bool enabled() const
+			{
+				return bytes || interval_us;
+			}
+
+			size_t bytes;
+			uint32_t interval_us;
+		};
+
+		struct AsyncWriterStats
+		{
+			AsyncWriterStats();
+
+			// producer side
+			uint64_t blocks;
+			uint64_t producer_stalls;
+			uint64_t stalled_ns;
+			uint64_t dropped_blocks;
+			uint64_t dropped_bytes;
+			// how full the ring was every time we handed it a block
+			uint64_t occupancy_sum;
+			size_t max_occupancy;
+			size_t capacity;
+
+			// writer side
+			uint64_t bytes_written;
+			uint64_t writes;
+			uint64_t failed_writes;
+			// group commit
+			uint64_t syncs;
+			uint64_t failed_syncs;
+			uint64_t sync_ns;
+			uint64_t max_sync_ns;
+		};
+
+		std::ostream& operator<< ( std::ostream& os, const AsyncWriterStats& stats );
+
+		/*
+		 * An OutputSink that doesn't write anything itself. The processing thread copies what it gets into a lock-free
+		 * ring, and a writer thread of our own drains that into the file descriptor, as much as it can get in one go.
+		 * A slow reader on the other end of a pipe now stalls that thread instead of the book.
+		 *
+		 * Only one thread may write into this, and close() has to be called before anything else writes to the same fd.
+		 */
+		class AsyncWriter : public OutputSink
+		{
+		public:
+			static const size_t default_capacity = 4 * 1024 * 1024;
+
+			AsyncWriter ( int fd, RingFullPolicy::Policy policy = RingFullPolicy::BLOCK, size_t capacity = default_capacity, GroupCommit commit = GroupCommit() );
+			/* Closes if we haven't yet */
+			~AsyncWriter();
+
+			virtual void write ( const char * data, size_t size );
+
+			/* Waits until everything has been written out ( and committed, if we do that ), and stops the writer thread */
+			void close();
+
+			/* How many bytes we've committed so far. Any thread may ask */
+			uint64_t committed() const;
+
+			/* Only complete once we're closed */
+			AsyncWriterStats const & stats() const;
+		private:
+			AsyncWriter ( AsyncWriter const & rhs ) : m_ring ( 0 ) {}
+
+			void run();
+			void commit();
+			void waitForSpace();
+			void wakeWriter();
+
+			int m_fd;
+			RingFullPolicy::Policy m_policy;
+			SpscRing < char > m_ring;
+			AsyncWriterStats m_stats;
+			std::atomic < bool > m_closing;
+			// only used to sleep on, the ring itself doesn't need them
+			std::mutex m_mutex;
+			std::condition_variable m_has_data;
+			std::condition_variable m_has_space;
+			std::atomic < bool > m_writer_waiting;
+			std::atomic < bool > m_producer_waiting;
+			GroupCommit m_commit;
+			// with group commit the writer thread is only woken up once the ring holds this much, 0 and it always is
+			size_t m_wake_at;
+			// only the writer thread touches these: what it has written, but not committed yet, and since when
+			uint64_t m_uncommitted;
+			std::chrono::steady_clock::time_point m_uncommitted_since;
+			std::atomic < uint64_t > m_committed;
+			std::thread m_thread;
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,1334 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "AllocationCounter.hpp"
+#include "FeedHandler.hpp"
+#include "Fill.hpp"
+#include "MappedFile.hpp"
+#include "BinaryFeed.hpp"
+#include "FlatIndex.hpp"
+#include "Journal.hpp"
+#include "LevelDelta.hpp"
+#include "PriceLevelMap.hpp"
+#include "PriceTraits.hpp"
+#include "StdIndex.hpp"
+#include "AsyncWriter.hpp"
+#include "ParsePipeline.hpp"
+#include "Replay.hpp"
+#include "ShardedFeed.hpp"
+#include "Snapshot.hpp"
+#include "StreamReader.hpp"
+
+using namespace JumpInterview::OrderBook;
+
+/*
+ * Throughput numbers for the different ways of getting messages into the FeedHandler. Every benchmark
+ * runs a couple of times and we keep the fastest run, the first one tends to be paying for a cold page cache.
+ *
+ * benchmarks [input file, defaults to bigger.txt] [repetitions, defaults to 5]
+ */
+typedef std::chrono::steady_clock Clock;
+
+// results we compute but don't need end up here, so they can't be optimised away
+static volatile uint64_t sink;
+
+static void report ( const char * name, size_t messages, size_t bytes, Clock::duration elapsed, uint64_t allocated )
+{
+	double seconds ( std::chrono::duration < double > ( elapsed ).count() );
+	std::cout << std::left << std::setw ( 32 ) << name << std::right << std::fixed << std::setprecision ( 1 ) <<
+			  std::setw ( 10 ) << seconds * 1e9 / messages << " ns/msg " <<
+			  std::setw ( 10 ) << bytes / seconds / ( 1024 * 1024 ) << " MB/s" <<
+			  std::setprecision ( 2 ) << std::setw ( 10 ) << static_cast < double > ( allocated ) / messages << " allocs/msg" << std::endl;
+}
+
+enum Mode
+{
+	// just read the lines
+	INGEST,
+	// read and parse them, but don't touch the book
+	PARSE,
+	// parse them and apply them to the book, but don't print the book
+	APPLY,
+	// everything Main does
+	FEED
+};
+
+/*
+ * FEED is the same loop Main runs, including the book we print every 10 messages, formatted into an OutputBuffer
+ * whose sink throws everything away.
+ */
+template <class T>
+static void processLine ( FeedHandler & feed, T const & line, uint32_t & counter, OutputBuffer & out, Mode mode )
+{
+	Message message;
+	switch ( mode )
+	{
+	case PARSE:
+		FeedHandler::parse ( line, message );
+		sink = message.price;
+		break;
+	case APPLY:
+		feed.processMessage ( line, out );
+		break;
+	case FEED:
+		feed.processMessage ( line, out );
+		if ( ++counter % 10 == 0 )
+			feed.printCurrentOrderBook ( out );
+		break;
+	default:
+		break;
+	}
+}
+
+static Clock::duration readGetline ( std::string const & filename, size_t & messages, size_t & bytes, Mode mode )
+{
+	NullSink null_sink;
+	OutputBuffer out ( null_sink );
+	FeedHandler feed;
+	std::ifstream infile ( filename.c_str(), std::ios::in );
+	std::string line;
+	uint32_t counter ( 0 );
+	messages = bytes = 0;
+	Clock::time_point start ( Clock::now() );
+	while ( std::getline ( infile, line ) )
+	{
+		processLine ( feed, line, counter, out, mode );
+		messages++;
+		bytes += line.size() + 1;
+	}
+	return Clock::now() - start;
+}
+
+static Clock::duration readMappedFile ( std::string const & filename, size_t & messages, size_t & bytes, Mode mode )
+{
+	NullSink null_sink;
+	OutputBuffer out ( null_sink );
+	FeedHandler feed;
+	uint32_t counter ( 0 );
+	messages = bytes = 0;
+	Clock::time_point start ( Clock::now() );
+	// mapping the file is part of the cost, so that's inside the timed section
+	MappedFile infile ( filename );
+	MessageView line;
+	while ( infile.nextLine ( line ) )
+	{
+		processLine ( feed, line, counter, out, mode );
+		messages++;
+		bytes += line.size() + 1;
+	}
+	return Clock::now() - start;
+}
+
+/*
+ * The same file through a StreamReader, either straight from the file or through a pipe that another thread writes
+ * it into ( like 'zcat capture.gz | main -' would ). Setting up the pipe and writing into it is part of the time.
+ */
+template < bool through_pipe, bool use_io_uring >
+static Clock::duration readStream ( std::string const & filename, size_t & messages, size_t & bytes, Mode mode )
+{
+	NullSink null_sink;
+	OutputBuffer out ( null_sink );
+	FeedHandler feed;
+	uint32_t counter ( 0 );
+	messages = bytes = 0;
+	MappedFile mapped_file ( filename );
+	Clock::time_point start ( Clock::now() );
+	int fds[2] = { -1, -1 };
+	std::thread writer;
+	if ( through_pipe )
+	{
+		if ( pipe ( fds ) != 0 )
+			return Clock::duration::zero();
+		writer = std::thread ( [&]()
+		{
+			FdSink::writeAll ( fds[1], mapped_file.data(), mapped_file.size() );
+			close ( fds[1] );
+		} );
+	}
+	else
+		fds[0] = open ( filename.c_str(), O_RDONLY );
+	{
+		StreamReader infile ( fds[0], use_io_uring );
+		MessageView line;
+		while ( infile.nextLine ( line ) )
+		{
+			processLine ( feed, line, counter, out, mode );
+			messages++;
+			bytes += line.size() + 1;
+		}
+	}
+	if ( writer.joinable() )
+		writer.join();
+	close ( fds[0] );
+	return Clock::now() - start;
+}
+
+/*
+ * Parse cost per message on its own: the lines are already split up front, so all we time is the parser.
+ */
+static Clock::duration parseOnly ( std::string const & filename, size_t & messages, size_t & bytes, Mode mode )
+{
+	MappedFile infile ( filename );
+	std::vector < MessageView > lines;
+	MessageView line;
+	while ( infile.nextLine ( line ) )
+		lines.push_back ( line );
+	messages = lines.size();
+	bytes = infile.size();
+	Message message;
+	uint64_t checksum ( 0 );
+	Clock::time_point start ( Clock::now() );
+	for ( size_t i = 0; i < lines.size(); i++ )
+	{
+		FeedHandler::parse ( lines[i], message );
+		checksum += message.price + message.type;
+	}
+	Clock::duration elapsed ( Clock::now() - start );
+	// so the parser can't be optimised away
+	sink = checksum;
+	return elapsed;
+}
+
+/*
+ * The same feed, converted to binary records up front ( see BinaryFeed.hpp ). Decoding a record
+ * is what parsing a line is for text.
+ */
+static Clock::duration readBinary ( std::string const & filename, size_t & messages, size_t & bytes, Mode mode )
+{
+	std::vector < char > records;
+	{
+		MappedFile infile ( filename );
+		MessageView line;
+		Message message;
+		char record[ BinaryFeed::record_size ];
+		while ( infile.nextLine ( line ) )
+		{
+			FeedHandler::parse ( line, message );
+			BinaryFeed::encode ( message, record );
+			records.insert ( records.end(), record, record + sizeof ( record ) );
+		}
+	}
+	NullSink null_sink;
+	OutputBuffer out ( null_sink );
+	FeedHandler feed;
+	Message message;
+	uint32_t counter ( 0 );
+	messages = records.size() / BinaryFeed::record_size;
+	bytes = records.size();
+	Clock::time_point start ( Clock::now() );
+	for ( size_t i = 0; i < records.size(); i += BinaryFeed::record_size )
+	{
+		const char * record ( &records[i] );
+		switch ( mode )
+		{
+		case PARSE:
+			BinaryFeed::decode ( record, message );
+			sink = message.price;
+			break;
+		case APPLY:
+			feed.processRecord ( record, out );
+			break;
+		case FEED:
+			feed.processRecord ( record, out );
+			if ( ++counter % 10 == 0 )
+				feed.printCurrentOrderBook ( out );
+			break;
+		default:
+			sink = record[0];
+			break;
+		}
+	}
+	return Clock::now() - start;
+}
+
+/*
+ * Already parsed messages, applied batch_size at a time ( see FeedHandler::processBatch ). Compare with "apply binary",
+ * which applies them one by one.
+ */
+template < size_t batch_size, bool netting >
+static Clock::duration applyBatches ( std::string const & filename, size_t & messages, size_t & bytes, Mode mode )
+{
+	std::vector < Message > parsed;
+	MappedFile infile ( filename );
+	MessageView line;
+	Message message;
+	while ( infile.nextLine ( line ) )
+	{
+		FeedHandler::parse ( line, message );
+		parsed.push_back ( message );
+	}
+	messages = parsed.size();
+	bytes = infile.size();
+	NullSink null_sink;
+	OutputBuffer out ( null_sink );
+	FeedHandler feed;
+	Clock::time_point start ( Clock::now() );
+	for ( size_t i = 0; i < parsed.size(); i += batch_size )
+		feed.processBatch ( &parsed[i], std::min ( batch_size, parsed.size() - i ), out, !netting, netting );
+	return Clock::now() - start;
+}
+
+/*
+ * The whole feed written to /dev/null, either straight from this thread or through a writer thread
+ * ( see AsyncWriter ). Closing the writer, so waiting until everything is out, is part of the time.
+ */
+template < bool async >
+static Clock::duration feedToDevNull ( std::string const & filename, size_t & messages, size_t & bytes, Mode mode )
+{
+	int fd ( open ( "/dev/null", O_WRONLY ) );
+	FeedHandler feed;
+	uint32_t counter ( 0 );
+	messages = bytes = 0;
+	Clock::time_point start ( Clock::now() );
+	{
+		FdSink fd_sink ( fd );
+		AsyncWriter async_sink ( fd );
+		OutputBuffer out ( async ? static_cast < OutputSink & > ( async_sink ) : fd_sink );
+		MappedFile infile ( filename );
+		MessageView line;
+		while ( infile.nextLine ( line ) )
+		{
+			processLine ( feed, line, counter, out, mode );
+			messages++;
+			bytes += line.size() + 1;
+		}
+		out.flush();
+		async_sink.close();
+	}
+	Clock::duration elapsed ( Clock::now() - start );
+	close ( fd );
+	return elapsed;
+}
+
+/* Counts what we would have written */
+class CountingSink : public OutputSink
+{
+public:
+	CountingSink() : bytes ( 0 ) {}
+	virtual void write ( const char * data, size_t size )
+	{
+		bytes += size;
+	}
+	size_t bytes;
+};
+
+/*
+ * Printing a book that's thousands of levels deep on both sides ( see OrderList::print ). Between two snapshots we
+ * bring down the volume of either a single order or of every order in the book, and only the printing is timed.
+ * One message here is one snapshot.
+ */
+template < bool every_level >
+static Clock::duration renderDeepBook ( std::string const & filename, size_t & messages, size_t & bytes, Mode mode )
+{
+	static const uint32_t levels_per_side ( 5000 );
+	static const uint32_t snapshots ( 200 );
+	static const uint32_t volume ( 1000000 );
+	FeedHandler feed;
+	NullSink null_sink;
+	OutputBuffer discard ( null_sink );
+	CountingSink counting_sink;
+	OutputBuffer out ( counting_sink );
+	Message message;
+	message.volume = volume;
+	for ( uint32_t i = 0; i < 2 * levels_per_side; i++ )
+	{
+		message.type = MessageType::ADD;
+		message.order_id = i + 1;
+		message.side = i < levels_per_side ? OrderSide::BUY : OrderSide::SELL;
+		message.price = i < levels_per_side ? 100000 - i : 200000 + i;
+		feed.processMessage ( message, discard );
+	}
+	Clock::duration elapsed ( Clock::duration::zero() );
+	for ( uint32_t s = 0; s < snapshots; s++ )
+	{
+		message.type = MessageType::MODIFY;
+		message.volume = volume - s - 1;
+		for ( uint32_t i = every_level ? 0 : s % ( 2 * levels_per_side ); i < 2 * levels_per_side; i++ )
+		{
+			message.order_id = i + 1;
+			message.side = i < levels_per_side ? OrderSide::BUY : OrderSide::SELL;
+			message.price = i < levels_per_side ? 100000 - i : 200000 + i;
+			feed.processMessage ( message, discard );
+			if ( !every_level )
+				break;
+		}
+		Clock::time_point start ( Clock::now() );
+		feed.printCurrentOrderBook ( out );
+		elapsed += Clock::now() - start;
+	}
+	out.flush();
+	messages = snapshots;
+	bytes = counting_sink.bytes;
+	return elapsed;
+}
+
+/*
+ * Resting orders coming and going without a level ever being created or removed: 10000 orders on 100 levels a side,
+ * then every message cancels the oldest order and adds a new one at the same price - or with requeue, brings the
+ * volume of the oldest order up, so it goes to the back of its level. Only the book, straight through its interface.
+ */
+template < bool requeue >
+static Clock::duration orderQueue ( std::string const & filename, size_t & messages, size_t & bytes, Mode mode )
+{
+	static const uint32_t resting ( 10000 );
+	static const uint32_t levels ( 100 );
+	static const uint32_t operations ( 1000000 );
+	ErrorSummary errors;
+	OrderBook book ( errors );
+	for ( uint32_t id = 1; id <= resting; id++ )
+		book.add ( new Order ( id, id % 2 ? OrderSide::BUY : OrderSide::SELL, 10, id % 2 ? 100000 - id / 2 % levels * 10 : 200000 + id / 2 % levels * 10 ) );
+	Clock::time_point start ( Clock::now() );
+	for ( uint32_t i = 0; i < operations; i++ )
+	{
+		uint32_t id ( i % resting + 1 );
+		OrderSide::Side side ( id % 2 ? OrderSide::BUY : OrderSide::SELL );
+		uint32_t price ( id % 2 ? 100000 - id / 2 % levels * 10 : 200000 + id / 2 % levels * 10 );
+		if ( requeue )
+			book.modify ( id, side, 11 + i, price );
+		else
+		{
+			delete book.remove ( id, side, 10, price );
+			book.add ( new Order ( id, side, 10, price ) );
+		}
+	}
+	Clock::duration elapsed ( Clock::now() - start );
+	messages = operations;
+	bytes = operations * sizeof ( Message );
+	return elapsed;
+}
+
+// the slowest 100 inserts in a row we've seen while filling up an index
+static Clock::duration slowest_inserts;
+
+/*
+ * Filling up an order index ( a FlatIndex, or a StdIndex on a std::unordered_map ) with this many live orders from nothing, without reserving, so it has to grow on the way - or
+ * with churn, a million messages on an index that's already full: look up a live order, cancel the oldest one and
+ * add a new one. Order ids go up one at a time, like they do in a feed. The orders are never looked at, so they're
+ * only made up pointers.
+ */
+template < class Index, uint32_t live, bool churn >
+static Clock::duration orderIndex ( std::string const & filename, size_t & messages, size_t & bytes, Mode mode )
+{
+	static const uint32_t operations ( 1000000 );
+	Index * index ( new Index() );
+	Clock::duration elapsed ( 0 );
+	Clock::time_point start ( Clock::now() );
+	Clock::time_point batch_start ( start );
+	for ( uint32_t id = 1; id <= live; id++ )
+	{
+		index->insert ( id, reinterpret_cast < Order_ptr > ( static_cast < uintptr_t > ( id ) * 64 ) );
+		if ( !churn && id % 100 == 0 )
+		{
+			Clock::time_point now ( Clock::now() );
+			slowest_inserts = std::max ( slowest_inserts, now - batch_start );
+			batch_start = now;
+		}
+	}
+	if ( churn )
+	{
+		uint32_t random ( 12345 );
+		uint64_t found ( 0 );
+		start = Clock::now();
+		for ( uint32_t i = 0; i < operations; i++ )
+		{
+			random = random * 1103515245 + 12345;
+			uint32_t oldest ( i + 1 );
+			found += index->find ( oldest + ( random >> 8 ) % live ) != 0;
+			index->erase ( oldest );
+			index->insert ( oldest + live, reinterpret_cast < Order_ptr > ( static_cast < uintptr_t > ( oldest + live ) * 64 ) );
+		}
+		sink = found;
+	}
+	elapsed = Clock::now() - start;
+	delete index;
+	messages = churn ? operations : live;
+	bytes = messages * sizeof ( Message );
+	return elapsed;
+}
+
+/*
+ * A book growing to a million live orders on 10000 levels a side, straight through its interface. With teardown,
+ * only taking it down again is timed: deleting every order on the way ( 1 ), or abandoning them and resetting their
+ * pool ( 2 ).
+ */
+template < int teardown >
+static Clock::duration growBook ( std::string const & filename, size_t & messages, size_t & bytes, Mode mode )
+{
+	static const uint32_t orders ( 1000000 );
+	static const uint32_t levels ( 10000 );
+	ErrorSummary errors;
+	Clock::time_point start ( Clock::now() );
+	OrderBook * book ( new OrderBook ( errors ) );
+	for ( uint32_t id = 1; id <= orders; id++ )
+		book->add ( new Order ( id, id % 2 ? OrderSide::BUY : OrderSide::SELL, 10, id % 2 ? 1000000 - id / 2 % levels * 10 : 2000000 + id / 2 % levels * 10 ) );
+	if ( teardown )
+		start = Clock::now();
+	if ( teardown == 2 )
+	{
+		book->abandonOrders();
+		PoolAllocator<Order>::instance().reset();
+	}
+	delete book;
+	Clock::duration elapsed ( Clock::now() - start );
+	messages = orders;
+	bytes = orders * sizeof ( Message );
+	return elapsed;
+}
+
+/*
+ * Walking every queue of a book of 1M orders over 10000 levels a side, the way matching does: each order's volume and
+ * when it was queued. The orders were added a level at a time round robin, so the next order in a queue is
+ * never the one next to it in memory - it's how many orders fit in a cache line that counts.
+ */
+static Clock::duration walkBook ( std::string const & filename, size_t & messages, size_t & bytes, Mode mode )
+{
+	static const uint32_t orders ( 1000000 );
+	static const uint32_t levels ( 10000 );
+	static const int passes ( 10 );
+	ErrorSummary errors;
+	OrderBook book ( errors );
+	for ( uint32_t id = 1; id <= orders; id++ )
+		book.add ( new Order ( id, id % 2 ? OrderSide::BUY : OrderSide::SELL, 10, id % 2 ? 1000000 - id / 2 % levels * 10 : 2000000 + id / 2 % levels * 10 ) );
+	uint64_t total ( 0 );
+	Clock::time_point start ( Clock::now() );
+	for ( int pass = 0; pass < passes; pass++ )
+	{
+		for ( OrderBook::BuyPriceLevelMap::const_iterator level = book.buys().begin(); level != book.buys().end(); ++level )
+			for ( OrderList::iterator iter = level->second->begin(); iter != level->second->end(); ++iter )
+				total += ( *iter )->volume() + ( *iter )->sequenceId();
+		for ( OrderBook::SellPriceLevelMap::const_iterator level = book.sells().begin(); level != book.sells().end(); ++level )
+			for ( OrderList::iterator iter = level->second->begin(); iter != level->second->end(); ++iter )
+				total += ( *iter )->volume() + ( *iter )->sequenceId();
+	}
+	Clock::duration elapsed ( Clock::now() - start );
+	sink += total;
+	messages = orders * passes;
+	bytes = messages * sizeof ( Message );
+	return elapsed;
+}
+
+/*
+ * The same queues as walkBook, without a book around them, in two layouts. Apart: 16 bytes of id, volume, price and
+ * sequence id per order, the size the hot path reads, with the links of the queues in an array of their own - that's
+ * the only way to get an order down to 16 bytes. Together: those 16 bytes and the two links in one 32 byte record,
+ * the way an Order has them.
+ */
+struct WalkedOrder
+{
+	uint32_t order_id;
+	uint32_t volume;
+	uint32_t price;
+	uint32_t sequence_id;
+};
+
+struct LinkedOrder
+{
+	WalkedOrder order;
+	LinkedOrder * prev;
+	LinkedOrder * next;
+};
+
+struct OrderLinks
+{
+	uint32_t prev;
+	uint32_t next;
+};
+
+template < bool apart >
+static Clock::duration walkLayout ( std::string const & filename, size_t & messages, size_t & bytes, Mode mode )
+{
+	static const uint32_t orders ( 1000000 );
+	static const uint32_t levels ( 10000 );
+	static const int passes ( 10 );
+	static const uint32_t none ( std::numeric_limits < uint32_t >::max() );
+	std::vector < WalkedOrder > hot ( apart ? orders : 0 );
+	std::vector < OrderLinks > links ( apart ? orders : 0 );
+	std::vector < LinkedOrder > linked ( apart ? 0 : orders );
+	std::vector < uint32_t > fronts ( 2 * levels, none ), backs ( 2 * levels, none );
+	// order i goes to the back of the level walkBook would have put it on
+	for ( uint32_t i = 0; i < orders; i++ )
+	{
+		uint32_t id ( i + 1 );
+		uint32_t queue ( ( id % 2 ) * levels + id / 2 % levels );
+		WalkedOrder order = { id, 10, 1000000, i };
+		if ( apart )
+		{
+			hot[i] = order;
+			links[i].prev = backs[queue];
+			links[i].next = none;
+			if ( backs[queue] != none )
+				links[ backs[queue] ].next = i;
+		}
+		else
+		{
+			linked[i].order = order;
+			linked[i].prev = backs[queue] != none ? &linked[ backs[queue] ] : 0;
+			linked[i].next = 0;
+			if ( backs[queue] != none )
+				linked[ backs[queue] ].next = &linked[i];
+		}
+		if ( fronts[queue] == none )
+			fronts[queue] = i;
+		backs[queue] = i;
+	}
+	uint64_t total ( 0 );
+	Clock::time_point start ( Clock::now() );
+	for ( int pass = 0; pass < passes; pass++ )
+		for ( uint32_t queue = 0; queue < 2 * levels; queue++ )
+		{
+			if ( apart )
+				for ( uint32_t i = fronts[queue]; i != none; i = links[i].next )
+					total += hot[i].volume + hot[i].sequence_id;
+			else
+				for ( LinkedOrder * order = &linked[ fronts[queue] ]; order; order = order->next )
+					total += order->order.volume + order->order.sequence_id;
+		}
+	Clock::duration elapsed ( Clock::now() - start );
+	sink += total;
+	messages = orders * passes;
+	bytes = messages * sizeof ( Message );
+	return elapsed;
+}
+
+/*
+ * A feed much bigger than bigger.txt, made up on the spot: a million messages, mostly adds, modifies and removes
+ * around a slowly moving price, with the odd trade in between. Only made once.
+ */
+static std::string const & generatedFeed()
+{
+	static std::string feed;
+	if ( !feed.empty() )
+		return feed;
+	static const uint32_t messages ( 1000000 );
+	static const uint32_t live_orders ( 5000 );
+	char line[ 64 ];
+	uint32_t random ( 12345 );
+	for ( uint32_t i = 0; i < messages; i++ )
+	{
+		random = random * 1103515245 + 12345;
+		uint32_t order_id ( random % live_orders + 1 );
+		bool buy ( order_id % 2 );
+		// buys below 100, sells above
+		uint32_t price ( buy ? 99000 - ( random >> 16 ) % 500 * 10 : 101000 + ( random >> 16 ) % 500 * 10 );
+		const char * actions ( "AAMXT" );
+		char action ( actions[ ( random >> 8 ) % 5 ] );
+		int length;
+		if ( action == 'T' )
+			length = snprintf ( line, sizeof ( line ), "T,%u,%u.%03u\n", random % 10 + 1, price / 1000, price % 1000 );
+		else
+			length = snprintf ( line, sizeof ( line ), "%c,%u,%c,%u,%u.%03u\n", action, order_id, buy ? 'B' : 'S', random % 100 + 1, price / 1000, price % 1000 );
+		feed.append ( line, length );
+	}
+	return feed;
+}
+
+/*
+ * Parsing on parser threads of their own while this thread applies the messages ( see ParsePipeline ), on the input
+ * file or the generated one. No parsers means we parse on this thread ourselves, which is what we're up against.
+ */
+template < size_t parsers, bool generated >
+static Clock::duration pipelined ( std::string const & filename, size_t & messages, size_t & bytes, Mode mode )
+{
+	MappedFile infile ( filename );
+	const char * data ( generated ? generatedFeed().data() : infile.data() );
+	size_t size ( generated ? generatedFeed().size() : infile.size() );
+	NullSink null_sink;
+	OutputBuffer out ( null_sink );
+	FeedHandler feed;
+	messages = 0;
+	bytes = size;
+	Message message;
+	Clock::time_point start ( Clock::now() );
+	if ( parsers )
+	{
+		ParsePipeline pipeline ( data, size, parsers );
+		for ( ; pipeline.next ( message ); messages++ )
+			feed.processMessage ( message, out );
+	}
+	else
+		for ( const char * pos = data, * end = data + size; pos < end; messages++ )
+		{
+			const char * line_end ( static_cast < const char * > ( memchr ( pos, '\n', end - pos ) ) );
+			if ( !line_end )
+				line_end = end;
+			feed.processMessage ( MessageView ( pos, line_end - pos ), out );
+			pos = line_end + 1;
+		}
+	return Clock::now() - start;
+}
+
+/*
+ * The generated feed again, but spread over 64 instruments, and already parsed.
+ */
+static std::vector < Message > const & generatedInstruments()
+{
+	static std::vector < Message > messages;
+	if ( !messages.empty() )
+		return messages;
+	std::string const & feed ( generatedFeed() );
+	std::string line;
+	Message message;
+	uint32_t counter ( 0 );
+	for ( const char * pos = feed.data(), * end = feed.data() + feed.size(); pos < end; counter++ )
+	{
+		const char * line_end ( static_cast < const char * > ( memchr ( pos, '\n', end - pos ) ) );
+		char symbol[ 16 ];
+		line.assign ( pos, line_end );
+		line.append ( symbol, snprintf ( symbol, sizeof ( symbol ), ",SYM%u", counter * 2654435761u % 64 ) );
+		FeedHandler::parse ( line, message );
+		messages.push_back ( message );
+		pos = line_end + 1;
+	}
+	return messages;
+}
+
+/*
+ * Applying the 64 instrument feed on this thread, or spread over worker threads of their own ( see ShardedFeed ).
+ * Waiting until every worker is done is part of the time.
+ */
+template < size_t workers >
+static Clock::duration sharded ( std::string const & filename, size_t & messages, size_t & bytes, Mode mode )
+{
+	std::vector < Message > const & parsed ( generatedInstruments() );
+	messages = parsed.size();
+	bytes = parsed.size() * sizeof ( Message );
+	Clock::time_point start ( Clock::now() );
+	if ( workers )
+	{
+		ShardedFeed feed ( workers );
+		for ( size_t i = 0; i < parsed.size(); i++ )
+			feed.process ( parsed[i] );
+		feed.close();
+		return Clock::now() - start;
+	}
+	NullSink null_sink;
+	OutputBuffer out ( null_sink );
+	FeedHandler feed;
+	for ( size_t i = 0; i < parsed.size(); i += MessageBatch::capacity )
+		feed.processBatch ( &parsed[i], std::min ( MessageBatch::capacity, parsed.size() - i ), out, false );
+	return Clock::now() - start;
+}
+
+/* What FeedHandler does with an order or a trade, for either kind of book */
+template < class Book >
+static void applyToBook ( Book & book, ErrorSummary & errors, Message const & message, OutputBuffer & out )
+{
+	switch ( message.type )
+	{
+	case MessageType::ADD:
+	case MessageType::REMOVE:
+	case MessageType::MODIFY:
+		if ( book.isCrossed() && book.waitingForTrades() )
+			errors.no_trades_when_they_should_happen++;
+		if ( message.type == MessageType::ADD )
+		{
+			Order_ptr order ( new Order ( message.order_id, message.side, message.volume, message.price ) );
+			if ( !book.add ( order ) )
+				delete order;
+		}
+		else if ( message.type == MessageType::REMOVE )
+			delete book.remove ( message.order_id, message.side, message.volume, message.price );
+		else
+			book.modify ( message.order_id, message.side, message.volume, message.price );
+		break;
+	case MessageType::TRADE:
+		book.handleTrade ( message.volume, message.price, out );
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ * Like the generated feed, but the prices are all over the place: any price from 0.01 to 2000.00, buys below 1000
+ * and sells above. That's 100000 ticks a side, more than a PriceLadder window gets to cover. Already parsed.
+ */
+static std::vector < Message > const & generatedWideFeed()
+{
+	static std::vector < Message > messages;
+	if ( !messages.empty() )
+		return messages;
+	static const uint32_t live_orders ( 5000 );
+	uint32_t random ( 54321 );
+	const MessageType::Type types[] = { MessageType::ADD, MessageType::ADD, MessageType::MODIFY, MessageType::REMOVE, MessageType::TRADE };
+	for ( uint32_t i = 0; i < 1000000; i++ )
+	{
+		random = random * 1103515245 + 12345;
+		Message message;
+		message.type = types[ ( random >> 8 ) % 5 ];
+		message.order_id = random % live_orders + 1;
+		message.side = message.order_id % 2 ? OrderSide::BUY : OrderSide::SELL;
+		message.volume = random % 100 + 1;
+		message.price = ( message.side == OrderSide::BUY ? 10 : 1000010 ) + ( random >> 12 ) % 100000 * 10;
+		messages.push_back ( message );
+	}
+	return messages;
+}
+
+// what the last bookLevels run published in level deltas, and for how many messages
+static size_t delta_bytes;
+static size_t delta_messages;
+
+/*
+ * Only the book: the messages are parsed up front, and go straight into a book with its levels in a PriceLevelMap
+ * or a PriceLadder. From the input file, the generated feed or the one with prices all over the place. If we publish,
+ * every level that changes goes out as a LevelDelta record.
+ */
+template < class Book, int feed, bool publish = false >
+static Clock::duration bookLevels ( std::string const & filename, size_t & messages, size_t & bytes, Mode mode )
+{
+	static std::vector < Message > parsed;
+	if ( parsed.empty() )
+	{
+		MappedFile infile ( filename );
+		const char * data ( feed ? generatedFeed().data() : infile.data() );
+		size_t size ( feed ? generatedFeed().size() : infile.size() );
+		if ( feed == 2 )
+			parsed = generatedWideFeed();
+		else
+			for ( const char * pos = data, * end = data + size; pos < end; )
+			{
+				const char * line_end ( static_cast < const char * > ( memchr ( pos, '\n', end - pos ) ) );
+				if ( !line_end )
+					line_end = end;
+				Message message;
+				FeedHandler::parse ( MessageView ( pos, line_end - pos ), message );
+				parsed.push_back ( message );
+				pos = line_end + 1;
+			}
+	}
+	NullSink null_sink;
+	OutputBuffer out ( null_sink );
+	CountingSink delta_sink;
+	OutputBuffer delta_out ( delta_sink );
+	LevelDeltaPublisher publisher ( delta_out );
+	ErrorSummary errors;
+	messages = parsed.size();
+	bytes = parsed.size() * sizeof ( Message );
+	Clock::time_point start ( Clock::now() );
+	{
+		Book book ( errors );
+		if ( publish )
+			book.setLevelListener ( &publisher );
+		for ( size_t i = 0; i < parsed.size(); i++ )
+			applyToBook ( book, errors, parsed[i], out );
+		sink = book.topOfBookSum();
+		delta_out.flush();
+	}
+	Clock::duration elapsed ( Clock::now() - start );
+	delta_bytes = delta_sink.bytes;
+	delta_messages = messages;
+	return elapsed;
+}
+
+// what the levels of the last priceLevels run took on the heap, and how many of them there were
+static uint64_t level_bytes;
+static size_t level_count;
+
+/*
+ * A PriceLevelMap of 10000 levels, then a million messages that look up a level, and add or remove it if it's
+ * there or not: at prices in 32 bit ticks, in 64 bit ticks ( past what 32 bits can take ), or as 16 bit offsets
+ * from the lowest one. Only the levels, there are no orders in them.
+ */
+template < class Price, bool relative >
+static Clock::duration priceLevels ( std::string const & filename, size_t & messages, size_t & bytes, Mode mode )
+{
+	static const uint32_t levels ( 10000 );
+	static const uint32_t operations ( 1000000 );
+	static const uint64_t lowest ( sizeof ( Price ) > 4 ? 5000000000000ull : 1000000 );
+	uint64_t found ( 0 );
+	uint64_t before ( AllocationCounter::bytes() );
+	Clock::time_point start ( Clock::now() );
+	{
+		PriceLevelMap < std::greater < Price > > map;
+		for ( uint32_t i = 0; i < levels; i++ )
+		{
+			uint64_t price ( lowest + i * 5 );
+			map.add ( static_cast < Price > ( relative ? price - lowest : price ) );
+		}
+		level_bytes = AllocationCounter::bytes() - before;
+		level_count = map.size();
+		uint32_t random ( 13579 );
+		for ( uint32_t i = 0; i < operations; i++ )
+		{
+			random = random * 1103515245 + 12345;
+			uint64_t price ( lowest + ( random >> 8 ) % levels * 5 );
+			Price key ( static_cast < Price > ( relative ? price - lowest : price ) );
+			if ( !map.find ( key ) )
+				map.add ( key );
+			else if ( random >> 31 )
+				map.remove ( key );
+			else
+				found++;
+		}
+	}
+	Clock::duration elapsed ( Clock::now() - start );
+	sink = found;
+	messages = levels + operations;
+	bytes = messages * sizeof ( Price );
+	return elapsed;
+}
+
+/*
+ * A million prices, with 6 decimals, read into ticks of the traits' scale ( see FeedHandler::parsePrice ). Only
+ * made once.
+ */
+template < class Traits >
+static Clock::duration parsePrices ( std::string const & filename, size_t & messages, size_t & bytes, Mode mode )
+{
+	static std::string text;
+	static const uint32_t prices ( 1000000 );
+	if ( text.empty() )
+	{
+		uint32_t random ( 97531 );
+		char price[ 32 ];
+		for ( uint32_t i = 0; i < prices; i++ )
+		{
+			random = random * 1103515245 + 12345;
+			text.append ( price, snprintf ( price, sizeof ( price ), "%u.%06u,", ( random >> 8 ) % 4000, random % 1000000 ) );
+		}
+	}
+	typename Traits::Price ticks;
+	uint64_t checksum ( 0 );
+	Clock::time_point start ( Clock::now() );
+	for ( const char * pos = text.data(), * end = text.data() + text.size(); pos < end; pos++ )
+		if ( FeedHandler::parsePrice < Traits > ( pos, end, ticks ) )
+			checksum += ticks;
+	Clock::duration elapsed ( Clock::now() - start );
+	sink = checksum;
+	messages = prices;
+	bytes = text.size();
+	return elapsed;
+}
+
+/* One order for the matching engine: resting, aggressive, or cancelling one that rested before */
+struct EngineOrder
+{
+	bool cancel;
+	OrderType::Type type;
+	uint32_t order_id;
+	OrderSide::Side side;
+	uint32_t volume;
+	uint32_t price;
+};
+
+/* Adds up every fill, like anyone listening would at least have to look at them */
+class FillCounter : public FillListener
+{
+public:
+	FillCounter() : fills ( 0 ), volume ( 0 ) {}
+	virtual void filled ( Fill const & fill )
+	{
+		fills++;
+		volume += fill.volume;
+	}
+	size_t fills;
+	uint64_t volume;
+};
+
+// how many fills the last matchingEngine run made, and for how many orders
+static size_t engine_fills;
+static size_t engine_orders;
+
+/*
+ * A million orders for the matching engine, made up once for every aggressive ratio. Out of every 100, that many are
+ * aggressive: a limit order reaching a couple of levels into the other side, an IOC doing the same, or every now and
+ * then a market order. Half of the rest rest within 50 levels of the middle without crossing, the other half cancel
+ * one of the last 4096 orders that rested - which may well have traded away by then.
+ */
+template < uint32_t aggressive >
+static std::vector < EngineOrder > const & generatedEngineOrders()
+{
+	static std::vector < EngineOrder > orders;
+	if ( !orders.empty() )
+		return orders;
+	static const uint32_t count ( 1000000 );
+	static const uint32_t middle ( 100000 );
+	std::vector < EngineOrder > rested ( 4096 );
+	uint32_t random ( 24680 );
+	for ( uint32_t id = 1; id <= count; id++ )
+	{
+		random = random * 1103515245 + 12345;
+		EngineOrder order;
+		order.cancel = false;
+		order.type = OrderType::LIMIT;
+		order.order_id = id;
+		order.side = random % 2 ? OrderSide::BUY : OrderSide::SELL;
+		order.volume = ( random >> 16 ) % 100 + 1;
+		uint32_t levels ( ( random >> 10 ) % 50 + 1 );
+		if ( ( random >> 8 ) % 100 < aggressive )
+		{
+			uint32_t kind ( ( random >> 24 ) % 10 );
+			order.type = kind == 0 ? OrderType::MARKET : kind < 4 ? OrderType::IOC : OrderType::LIMIT;
+			order.price = order.side == OrderSide::BUY ? middle + levels % 3 * 10 : middle - levels % 3 * 10;
+		}
+		else if ( ( random >> 8 ) % 2 || id < rested.size() )
+		{
+			order.price = order.side == OrderSide::BUY ? middle - levels * 10 : middle + levels * 10;
+			rested[ id % rested.size() ] = order;
+		}
+		else
+		{
+			order = rested[ ( random >> 4 ) % rested.size() ];
+			order.cancel = true;
+		}
+		orders.push_back ( order );
+	}
+	return orders;
+}
+
+/*
+ * Our own matching, straight through the book: every order goes to execute(), or cancels. One message here is one
+ * order, whatever it did.
+ */
+template < class Book, uint32_t aggressive >
+static Clock::duration matchingEngine ( std::string const & filename, size_t & messages, size_t & bytes, Mode mode )
+{
+	std::vector < EngineOrder > const & orders ( generatedEngineOrders < aggressive >() );
+	ErrorSummary errors;
+	FillCounter counter;
+	messages = orders.size();
+	bytes = orders.size() * sizeof ( EngineOrder );
+	Clock::time_point start ( Clock::now() );
+	{
+		Book book ( errors );
+		book.setFillListener ( &counter );
+		for ( size_t i = 0; i < orders.size(); i++ )
+		{
+			EngineOrder const & order ( orders[i] );
+			if ( order.cancel )
+				delete book.remove ( order.order_id, order.side, order.volume, order.price );
+			else
+				book.execute ( order.order_id, order.side, order.volume, order.price, order.type );
+		}
+		sink = book.topOfBookSum() + counter.volume;
+	}
+	Clock::duration elapsed ( Clock::now() - start );
+	engine_fills = counter.fills;
+	engine_orders = orders.size();
+	return elapsed;
+}
+
+/* Keeps everything we write */
+class StringSink : public OutputSink
+{
+public:
+	virtual void write ( const char * data, size_t size )
+	{
+		text.append ( data, size );
+	}
+	std::string text;
+};
+
+static size_t snapshot_bytes;
+
+/*
+ * A book of 5M orders over 10000 levels a side, as a snapshot ( see BasicOrderBook::save ). Saving it, or loading it
+ * into an empty book - without taking the book down again, that's growBook's business. The orders go with their pool
+ * every time, so we load into fresh memory like a process that's just started would.
+ */
+template < bool load >
+static Clock::duration snapshotBook ( std::string const & filename, size_t & messages, size_t & bytes, Mode mode )
+{
+	static const uint32_t orders ( 5000000 );
+	static const uint32_t levels ( 10000 );
+	static std::string snapshot;
+	ErrorSummary errors;
+	if ( snapshot.empty() )
+	{
+		OrderBook book ( errors );
+		for ( uint32_t id = 1; id <= orders; id++ )
+			book.add ( new Order ( id, id % 2 ? OrderSide::BUY : OrderSide::SELL, id % 100 + 1, id % 2 ? 1000000 - id / 2 % levels * 10 : 2000000 + id / 2 % levels * 10 ) );
+		StringSink saved;
+		{
+			OutputBuffer out ( saved );
+			SnapshotWriter writer ( out );
+			book.save ( writer );
+		}
+		snapshot.swap ( saved.text );
+		book.abandonOrders();
+		PoolAllocator<Order>::instance().reset();
+	}
+	OrderBook * book ( new OrderBook ( errors ) );
+	SnapshotReader in ( snapshot.data(), snapshot.size() );
+	Clock::time_point start ( Clock::now() );
+	if ( !book->load ( in ) )
+		std::cerr << "Couldn't load our own snapshot" << std::endl;
+	Clock::duration elapsed ( Clock::now() - start );
+	if ( !load )
+	{
+		StringSink saved;
+		saved.text.reserve ( snapshot.size() );
+		start = Clock::now();
+		{
+			OutputBuffer out ( saved );
+			SnapshotWriter writer ( out );
+			book->save ( writer );
+		}
+		elapsed = Clock::now() - start;
+	}
+	sink = book->topOfBookSum();
+	book->abandonOrders();
+	delete book;
+	PoolAllocator<Order>::instance().reset();
+	snapshot_bytes = snapshot.size();
+	messages = orders;
+	bytes = snapshot.size();
+	return elapsed;
+}
+
+static AsyncWriterStats journal_stats;
+
+/*
+ * The 64 instrument feed applied one message at a time, as Main does, without a journal or with every message
+ * appended to one first ( see Journal ) - the difference is what the journal costs us per message. Closing it, so
+ * waiting for the last commit, is part of the time. Or the journal that leaves behind, replayed into an empty feed.
+ */
+template < int journal >
+static Clock::duration journaled ( std::string const & filename, size_t & messages, size_t & bytes, Mode mode )
+{
+	static const char * journal_file ( "benchmarks.journal" );
+	std::vector < Message > const & parsed ( generatedInstruments() );
+	messages = parsed.size();
+	bytes = parsed.size() * Journal::record_size;
+	unlink ( journal_file );
+	NullSink null_sink;
+	OutputBuffer out ( null_sink );
+	FeedHandler feed;
+	if ( journal == 2 )
+	{
+		{
+			Journal writer ( journal_file );
+			for ( size_t i = 0; i < parsed.size(); i++ )
+				writer.append ( parsed[i] );
+		}
+		MappedFile replayed ( journal_file );
+		Clock::time_point start ( Clock::now() );
+		if ( Journal::replay ( replayed.data(), replayed.size(), feed ) != parsed.size() )
+			std::cerr << "Couldn't replay our own journal" << std::endl;
+		Clock::duration elapsed ( Clock::now() - start );
+		unlink ( journal_file );
+		return elapsed;
+	}
+	Clock::time_point start ( Clock::now() );
+	std::unique_ptr < Journal > writer ( journal ? new Journal ( journal_file ) : 0 );
+	for ( size_t i = 0; i < parsed.size(); i++ )
+	{
+		if ( writer )
+			writer->append ( parsed[i] );
+		feed.processMessage ( parsed[i], out );
+	}
+	if ( writer )
+	{
+		writer->close();
+		journal_stats = writer->stats();
+	}
+	Clock::duration elapsed ( Clock::now() - start );
+	unlink ( journal_file );
+	return elapsed;
+}
+
+/* Applies every message to a feed of its own, the way MessageProcessor would without the book printing */
+class FeedProcessor
+{
+public:
+	FeedProcessor() : m_out ( m_null_sink ) {}
+	void process ( Message const & message )
+	{
+		m_feed.processMessage ( message, m_out );
+	}
+private:
+	NullSink m_null_sink;
+	OutputBuffer m_out;
+	FeedHandler m_feed;
+};
+
+/* Does nothing at all, so all that's left is how late the pacer hands a message over */
+struct IdleProcessor
+{
+	void process ( Message const & message ) {}
+};
+
+static LatencyHistogram replay_latencies;
+
+/*
+ * The 64 instruments through a ReplayDriver as fast as it can go, against 'no journal' that's what keeping track
+ * of every message costs. Or 20000 messages captured 10us apart replayed as captured, to nothing: the latencies are
+ * how far off the pacer is, and it takes 0.2s whatever we do.
+ */
+template < bool paced >
+static Clock::duration replayed ( std::string const & filename, size_t & messages, size_t & bytes, Mode mode )
+{
+	std::vector < Message > const & parsed ( generatedInstruments() );
+	ReplayDriver driver ( paced ? 1 : 0 );
+	messages = paced ? 20000 : parsed.size();
+	bytes = messages * sizeof ( Message );
+	FeedProcessor feed;
+	IdleProcessor idle;
+	Message added;
+	added.type = MessageType::ADD;
+	Clock::time_point start ( Clock::now() );
+	for ( size_t i = 0; i < messages; i++ )
+	{
+		if ( paced )
+			driver.replay ( i * 10000, true, added, idle );
+		else
+			driver.replay ( 0, false, parsed[i], feed );
+	}
+	Clock::duration elapsed ( Clock::now() - start );
+	replay_latencies = driver.latencies ( MessageType::ADD );
+	return elapsed;
+}
+
+typedef Clock::duration ( *Benchmark ) ( std::string const &, size_t &, size_t &, Mode );
+
+/* Returns the best time we got */
+static Clock::duration run ( const char * name, Benchmark benchmark, std::string const & filename, Mode mode, int repetitions )
+{
+	size_t messages ( 0 ), bytes ( 0 );
+	Clock::duration best ( Clock::duration::max() );
+	uint64_t allocated ( 0 );
+	for ( int i = 0; i < repetitions; i++ )
+	{
+		uint64_t before ( AllocationCounter::allocations() );
+		Clock::duration elapsed ( benchmark ( filename, messages, bytes, mode ) );
+		// setting up counts as well, but we only keep the last run: the feeds we make up once are there by then
+		allocated = AllocationCounter::allocations() - before;
+		best = std::min ( best, elapsed );
+	}
+	report ( name, messages, bytes, best, allocated );
+	return best;
+}
+
+int main ( int argc, char **argv )
+{
+	const std::string filename ( argc >= 2 ? argv[1] : "bigger.txt" );
+	int repetitions ( argc >= 3 ? atoi ( argv[2] ) : 5 );
+	if ( !MappedFile ( filename ).good() || repetitions <= 0 )
+	{
+		std::cerr << "Usage: benchmarks [input file] [repetitions]" << std::endl;
+		return 1;
+	}
+	std::cout << "Input: " << filename << ", best of " << repetitions << std::endl;
+	run ( "ingest getline", readGetline, filename, INGEST, repetitions );
+	run ( "ingest mmap", readMappedFile, filename, INGEST, repetitions );
+	run ( "ingest stream file", readStream < false, false >, filename, INGEST, repetitions );
+	run ( "ingest stream pipe", readStream < true, false >, filename, INGEST, repetitions );
+	run ( "ingest stream pipe io_uring", readStream < true, true >, filename, INGEST, repetitions );
+	run ( "parse", parseOnly, filename, PARSE, repetitions );
+	run ( "ingest+parse getline", readGetline, filename, PARSE, repetitions );
+	run ( "ingest+parse mmap", readMappedFile, filename, PARSE, repetitions );
+	run ( "decode binary", readBinary, filename, PARSE, repetitions );
+	run ( "apply text mmap", readMappedFile, filename, APPLY, repetitions );
+	run ( "apply stream pipe", readStream < true, false >, filename, APPLY, repetitions );
+	run ( "apply stream pipe io_uring", readStream < true, true >, filename, APPLY, repetitions );
+	run ( "apply binary", readBinary, filename, APPLY, repetitions );
+	run ( "apply batches of 10", applyBatches < 10, false >, filename, APPLY, repetitions );
+	run ( "apply batches of 256", applyBatches < 256, false >, filename, APPLY, repetitions );
+	run ( "apply netted batches of 10", applyBatches < 10, true >, filename, APPLY, repetitions );
+	run ( "apply netted batches of 256", applyBatches < 256, true >, filename, APPLY, repetitions );
+	run ( "ingest+feed getline", readGetline, filename, FEED, repetitions );
+	run ( "ingest+feed mmap", readMappedFile, filename, FEED, repetitions );
+	run ( "ingest+feed binary", readBinary, filename, FEED, repetitions );
+	run ( "feed to /dev/null", feedToDevNull < false >, filename, FEED, repetitions );
+	run ( "feed to /dev/null async", feedToDevNull < true >, filename, FEED, repetitions );
+	run ( "apply mmap, no pipeline", pipelined < 0, false >, filename, APPLY, repetitions );
+	run ( "apply mmap, 1 parser thread", pipelined < 1, false >, filename, APPLY, repetitions );
+	run ( "apply mmap, 2 parser threads", pipelined < 2, false >, filename, APPLY, repetitions );
+	run ( "apply 1M generated, no pipeline", pipelined < 0, true >, filename, APPLY, repetitions );
+	run ( "apply 1M generated, 1 parser", pipelined < 1, true >, filename, APPLY, repetitions );
+	run ( "apply 1M generated, 2 parsers", pipelined < 2, true >, filename, APPLY, repetitions );
+	run ( "apply 1M generated, 3 parsers", pipelined < 3, true >, filename, APPLY, repetitions );
+	run ( "apply 1M generated, 4 parsers", pipelined < 4, true >, filename, APPLY, repetitions );
+	run ( "64 instruments, no workers", sharded < 0 >, filename, APPLY, repetitions );
+	run ( "64 instruments, 1 worker", sharded < 1 >, filename, APPLY, repetitions );
+	run ( "64 instruments, 2 workers", sharded < 2 >, filename, APPLY, repetitions );
+	run ( "64 instruments, 4 workers", sharded < 4 >, filename, APPLY, repetitions );
+	run ( "order queue, cancel+add", orderQueue < false >, filename, APPLY, repetitions );
+	run ( "order queue, requeue", orderQueue < true >, filename, APPLY, repetitions );
+	run ( "book growing to 1M orders", growBook < 0 >, filename, APPLY, repetitions );
+	run ( "book of 1M orders, teardown", growBook < 1 >, filename, APPLY, repetitions );
+	run ( "book of 1M orders, pool reset", growBook < 2 >, filename, APPLY, repetitions );
+	run ( "walk queues of 1M orders", walkBook, filename, APPLY, repetitions );
+	run ( "walk queues, 16+8 bytes apart", walkLayout < true >, filename, APPLY, repetitions );
+	run ( "walk queues, 32 bytes together", walkLayout < false >, filename, APPLY, repetitions );
+	static const char * index_names[] = { "10k", "1M", "10M" };
+	for ( int i = 0; i < 3; i++ )
+	{
+		std::string flat ( std::string ( "order index flat, " ) + index_names[i] );
+		std::string node ( std::string ( "order index unordered_map, " ) + index_names[i] );
+		Benchmark fill_flat[] = { orderIndex < FlatIndex < Order_ptr >, 10000, false >, orderIndex < FlatIndex < Order_ptr >, 1000000, false >, orderIndex < FlatIndex < Order_ptr >, 10000000, false > };
+		Benchmark fill_node[] = { orderIndex < StdIndex < Order_ptr >, 10000, false >, orderIndex < StdIndex < Order_ptr >, 1000000, false >, orderIndex < StdIndex < Order_ptr >, 10000000, false > };
+		Benchmark churn_flat[] = { orderIndex < FlatIndex < Order_ptr >, 10000, true >, orderIndex < FlatIndex < Order_ptr >, 1000000, true >, orderIndex < FlatIndex < Order_ptr >, 10000000, true > };
+		Benchmark churn_node[] = { orderIndex < StdIndex < Order_ptr >, 10000, true >, orderIndex < StdIndex < Order_ptr >, 1000000, true >, orderIndex < StdIndex < Order_ptr >, 10000000, true > };
+		// flat first: the first allocation after freeing millions of nodes pays for tidying up the heap
+		slowest_inserts = Clock::duration ( 0 );
+		run ( ( flat + " fill" ).c_str(), fill_flat[i], filename, APPLY, repetitions );
+		std::cout << "    slowest 100 inserts: " << std::chrono::duration_cast < std::chrono::microseconds > ( slowest_inserts ).count() << " us" << std::endl;
+		slowest_inserts = Clock::duration ( 0 );
+		run ( ( node + " fill" ).c_str(), fill_node[i], filename, APPLY, repetitions );
+		std::cout << "    slowest 100 inserts: " << std::chrono::duration_cast < std::chrono::microseconds > ( slowest_inserts ).count() << " us" << std::endl;
+		run ( ( flat + " churn" ).c_str(), churn_flat[i], filename, APPLY, repetitions );
+		run ( ( node + " churn" ).c_str(), churn_node[i], filename, APPLY, repetitions );
+	}
+	run ( "book levels std", bookLevels < StdOrderBook, 0 >, filename, APPLY, repetitions );
+	run ( "book levels tree", bookLevels < OrderBook, 0 >, filename, APPLY, repetitions );
+	run ( "book levels ladder", bookLevels < LadderOrderBook, 0 >, filename, APPLY, repetitions );
+	run ( "book levels tree, deltas", bookLevels < OrderBook, 0, true >, filename, APPLY, repetitions );
+	std::cout << "    level deltas: " << static_cast < double > ( delta_bytes ) / delta_messages << " bytes/msg" << std::endl;
+	run ( "book levels std, 1M generated", bookLevels < StdOrderBook, 1 >, filename, APPLY, repetitions );
+	run ( "book levels tree, 1M generated", bookLevels < OrderBook, 1 >, filename, APPLY, repetitions );
+	run ( "book levels ladder, 1M generated", bookLevels < LadderOrderBook, 1 >, filename, APPLY, repetitions );
+	run ( "book levels tree, 1M generated, deltas", bookLevels < OrderBook, 1, true >, filename, APPLY, repetitions );
+	std::cout << "    level deltas: " << static_cast < double > ( delta_bytes ) / delta_messages << " bytes/msg" << std::endl;
+	run ( "book levels std, 1M wide", bookLevels < StdOrderBook, 2 >, filename, APPLY, repetitions );
+	run ( "book levels tree, 1M wide", bookLevels < OrderBook, 2 >, filename, APPLY, repetitions );
+	run ( "book levels ladder, 1M wide", bookLevels < LadderOrderBook, 2 >, filename, APPLY, repetitions );
+	const char * level_names[] = { "price levels, 32 bit ticks", "price levels, 64 bit ticks", "price levels, 16 bit offsets" };
+	Benchmark level_maps[] = { priceLevels < uint32_t, false >, priceLevels < uint64_t, false >, priceLevels < uint16_t, true > };
+	for ( int i = 0; i < 3; i++ )
+	{
+		run ( level_names[i], level_maps[i], filename, APPLY, repetitions );
+		std::cout << "    heap: " << std::setprecision ( 1 ) << static_cast < double > ( level_bytes ) / level_count << " bytes/level" << std::endl;
+	}
+	run ( "parse prices, 0.001 in 32 bits", parsePrices < DefaultPriceTraits >, filename, PARSE, repetitions );
+	run ( "parse prices, 0.01 in 32 bits", parsePrices < CentPriceTraits >, filename, PARSE, repetitions );
+	run ( "parse prices, 0.000001 in 64 bits", parsePrices < WidePriceTraits >, filename, PARSE, repetitions );
+	const char * engine_names[] = { "matching engine tree, 10% aggressive", "matching engine ladder, 10% aggressive", "matching engine tree, 30% aggressive" };
+	Benchmark engines[] = { matchingEngine < OrderBook, 10 >, matchingEngine < LadderOrderBook, 10 >, matchingEngine < OrderBook, 30 > };
+	for ( int i = 0; i < 3; i++ )
+	{
+		Clock::duration best ( run ( engine_names[i], engines[i], filename, APPLY, repetitions ) );
+		std::cout << "    " << std::setprecision ( 0 ) << engine_orders / std::chrono::duration < double > ( best ).count() << " orders/s, " <<
+				  std::setprecision ( 2 ) << static_cast < double > ( engine_fills ) / engine_orders << " fills/order" << std::endl;
+	}
+	run ( "snapshot of 5M orders, save", snapshotBook < false >, filename, APPLY, repetitions );
+	run ( "snapshot of 5M orders, load", snapshotBook < true >, filename, APPLY, repetitions );
+	std::cout << "    snapshot: " << std::setprecision ( 1 ) << static_cast < double > ( snapshot_bytes ) / 1000000 << " MB" << std::endl;
+	Clock::duration unjournaled ( run ( "64 instruments, no journal", journaled < 0 >, filename, APPLY, repetitions ) );
+	Clock::duration with_journal ( run ( "64 instruments, journal", journaled < 1 >, filename, APPLY, repetitions ) );
+	std::cout << "    journal: " << std::setprecision ( 1 ) << std::chrono::duration < double, std::nano > ( with_journal - unjournaled ).count() / generatedInstruments().size() << " ns/msg, " <<
+			  journal_stats.syncs << " syncs of " << journal_stats.sync_ns / 1000 / std::max < uint64_t > ( journal_stats.syncs, 1 ) << " us on average, " <<
+			  journal_stats.max_sync_ns / 1000 << " us at most" << std::endl;
+	run ( "64 instruments, journal replay", journaled < 2 >, filename, APPLY, repetitions );
+	run ( "64 instruments, replay as fast as we can", replayed < false >, filename, APPLY, repetitions );
+	std::cout << "    adds: " << std::setprecision ( 2 ) << replay_latencies.percentile ( 50 ) / 1000.0 << " us at 50%, " <<
+			  replay_latencies.percentile ( 99 ) / 1000.0 << " us at 99%" << std::endl;
+	run ( "replay 10us apart, paced", replayed < true >, filename, APPLY, repetitions );
+	std::cout << "    pacer: " << std::setprecision ( 2 ) << replay_latencies.percentile ( 50 ) / 1000.0 << " us late at 50%, " <<
+			  replay_latencies.percentile ( 99 ) / 1000.0 << " us at 99%, " << replay_latencies.max() / 1000.0 << " us at most" << std::endl;
+	run ( "print 10000 levels, 1 changed", renderDeepBook < false >, filename, FEED, repetitions );
+	run ( "print 10000 levels, all changed", renderDeepBook < true >, filename, FEED, repetitions );
+	return 0;
+}
@@ -0,0 +1,36 @@
+#include <assert.h>
+#include <cstring>
+
+#include "BinaryFeed.hpp"
+
+namespace JumpInterview {
+	namespace OrderBook {
+
+		const char BinaryFeed::f_magic[4] = { 'J', 'O', 'B', 'F' };
+
+		bool BinaryFeed::isBinary ( const char * data, size_t size )
+		{
+			return size >= header_size &&
+				   !memcmp ( data, f_magic, sizeof ( f_magic ) ) &&
+				   LittleEndian::read32 ( data + sizeof ( f_magic ) ) == version;
+		}
+
+		void BinaryFeed::writeHeader ( char * out )
+		{
+			memcpy ( out, f_magic, sizeof ( f_magic ) );
+			LittleEndian::write32 ( out + sizeof ( f_magic ), version );
+		}
+
+		void BinaryFeed::encode ( Message const & message, char * out )
+		{
+			static const char types[] = { 'A', 'X', 'M', 'T', 'C', 'W' };
+			assert ( message.type < sizeof ( types ) );
+			out[0] = types[ message.type ];
+			out[1] = message.side == OrderSide::BUY ? 'B' : 'S';
+			out[2] = out[3] = 0;
+			LittleEndian::write32 ( out + 4, message.order_id );
+			LittleEndian::write32 ( out + 8, message.volume );
+			LittleEndian::write32 ( out + 12, message.price );
+		}
+	}
+}
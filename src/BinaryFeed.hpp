@@ -0,0 +1,83 @@
+#ifndef __BINARY_FEED_HPP__
+#define __BINARY_FEED_HPP__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "Endian.hpp"
+#include "Message.hpp"
+
+namespace JumpInterview {
+	namespace OrderBook {
+
+		/*
+		 * A fixed width binary version of our text feed. A file starts with an 8 byte header ( "JOBF" and a version ),
+		 * followed by nothing but 16 byte records. Everything is little-endian:
+		 *
+		 *   offset  size  field
+		 *   0       1     type      'A', 'X', 'M', 'T' - or 'C'/'W' for lines that were corrupted/weird in the text feed
+		 *   1       1     side      'B' or 'S', unused for trades
+		 *   2       2     reserved  always 0
+		 *   4       4     order id  unused for trades
+		 *   8       4     volume
+		 *   12      4     price     already in ticks ( see Constants::price_scale )
+		 *
+		 * We keep the lines we couldn't parse as records of their own, so a converted feed still produces exactly
+		 * the same output and error summary as the text it came from.
+		 *
+		 * There's no symbol field, a binary feed only ever carries the default instrument.
+		 */
+		class BinaryFeed
+		{
+		public:
+			static const size_t header_size = 8;
+			static const size_t record_size = 16;
+			static const uint32_t version = 1;
+
+			/* Does this buffer start with our header? */
+			static bool isBinary ( const char * data, size_t size );
+			static void writeHeader ( char * out );
+
+			static void encode ( Message const & message, char * out );
+
+			/* Records we don't recognise decode into CORRUPTED messages. This is on the hot path, so it lives in the header */
+			static void decode ( const char * in, Message & message )
+			{
+				switch ( in[0] )
+				{
+				case 'A':
+					message.type = MessageType::ADD;
+					break;
+				case 'X':
+					message.type = MessageType::REMOVE;
+					break;
+				case 'M':
+					message.type = MessageType::MODIFY;
+					break;
+				case 'T':
+					message.type = MessageType::TRADE;
+					break;
+				case 'W':
+					message.type = MessageType::WEIRD;
+					break;
+				default:
+					message.type = MessageType::CORRUPTED;
+					break;
+				}
+				message.side = in[1] == 'S' ? OrderSide::SELL : OrderSide::BUY;
+				message.order_id = LittleEndian::read32 ( in + 4 );
+				message.volume = LittleEndian::read32 ( in + 8 );
+				message.price = LittleEndian::read32 ( in + 12 );
+				// there's no room for a symbol, a binary feed is for a single instrument
+				message.symbol = 0;
+				// we didn't necessarily write this file ourselves, so the same rules as for text apply
+				if ( message.type <= MessageType::MODIFY && ( !message.volume || !message.price ) )
+					message.type = MessageType::WEIRD;
+			}
+		private:
+			static const char f_magic[4];
+		};
+	}
+}
+
+#endif
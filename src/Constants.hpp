@@ -1,6 +1,8 @@
 #ifndef __CONSTANTS_HPP__
 #define __CONSTANTS_HPP__
 
+#include <stdint.h>
+
 namespace JumpInterview {
 	namespace OrderBook {
 		namespace Constants	{
@@ -9,7 +11,12 @@ namespace JumpInterview {
 			// * Prices are always positive ( not neccessarily the case, for instance a put spread or irs can have a negative price )
 			// * The tick size is more than 0.001.
 			// If that's not the case, this number should be higher.
-			static const double round_size ( 1000.0 );
+			static constexpr double round_size ( 1000.0 );
+			// The same scale as an integer, the FeedHandler reads prices straight into ticks with this one.
+			// It has to be a power of 10.
+			static constexpr uint32_t price_scale ( 1000 );
+			// .. and how many decimals that gives us when we write a price out again
+			static constexpr uint32_t price_decimals ( 3 );
 		}
 	}
 }
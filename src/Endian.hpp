@@ -0,0 +1,46 @@
+#ifndef __ENDIAN_HPP__
+#define __ENDIAN_HPP__
+
+#include <stdint.h>
+
+namespace JumpInterview {
+	namespace OrderBook {
+		/*
+		 * Every binary format we write ( the binary feed, level deltas, the journal and snapshots ) is little-endian,
+		 * whatever machine wrote it. The compiler turns each of these into a single store or load on a little-endian
+		 * machine, so they're fine on the hot path too - as long as the shifts are spelled out like this, a loop over
+		 * the bytes doesn't get that for reads.
+		 */
+		namespace LittleEndian {
+			inline void write32 ( char * out, uint32_t value )
+			{
+				out[0] = static_cast < char > ( value );
+				out[1] = static_cast < char > ( value >> 8 );
+				out[2] = static_cast < char > ( value >> 16 );
+				out[3] = static_cast < char > ( value >> 24 );
+			}
+
+			inline void write64 ( char * out, uint64_t value )
+			{
+				write32 ( out, static_cast < uint32_t > ( value ) );
+				write32 ( out + 4, static_cast < uint32_t > ( value >> 32 ) );
+			}
+
+			inline uint32_t read32 ( const char * in )
+			{
+				const unsigned char * bytes ( reinterpret_cast < const unsigned char * > ( in ) );
+				return static_cast < uint32_t > ( bytes[0] ) |
+					   static_cast < uint32_t > ( bytes[1] ) << 8 |
+					   static_cast < uint32_t > ( bytes[2] ) << 16 |
+					   static_cast < uint32_t > ( bytes[3] ) << 24;
+			}
+
+			inline uint64_t read64 ( const char * in )
+			{
+				return read32 ( in ) | static_cast < uint64_t > ( read32 ( in + 4 ) ) << 32;
+			}
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,107 @@
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "BinaryFeed.hpp"
+#include "FeedHandler.hpp"
+#include "MappedFile.hpp"
+
+using namespace JumpInterview::OrderBook;
+
+/*
+ * Puts a capture time in front of every line of a text feed, as if it had come in at this many messages a second
+ * ( see ReplayDriver ). The first one was captured at 0.
+ */
+static int stamp ( MappedFile & infile, std::ofstream & outfile, const char * outname, double rate )
+{
+	MessageView line;
+	uint64_t messages ( 0 );
+	while ( infile.nextLine ( line ) )
+	{
+		outfile << static_cast < uint64_t > ( messages++ * 1e9 / rate ) << ',';
+		outfile.write ( line.data(), line.size() );
+		outfile << '\n';
+	}
+	outfile.close();
+	if ( !outfile.good() )
+	{
+		std::cerr << "Problems writing file [" << outname << "]" << std::endl;
+		return 1;
+	}
+	std::cout << "Stamped " << messages << " messages" << std::endl;
+	return 0;
+}
+
+/*
+ * Turns a text feed into a binary one ( see BinaryFeed.hpp ), so you can compare the two on the same feed. With
+ * 'stamp=<messages per second>' it turns it into a captured text feed instead.
+ *
+ * feedconv [text input file] [output file] [stamp=<messages per second>]
+ */
+int main ( int argc, char **argv )
+{
+	if ( argc < 3 )
+	{
+		std::cerr << "Usage: feedconv [text input file] [output file] [stamp=<messages per second>]" << std::endl;
+		return 1;
+	}
+	double rate ( argc >= 4 && !strncmp ( argv[3], "stamp=", 6 ) ? atof ( argv[3] + 6 ) : 0 );
+	if ( argc >= 4 && rate <= 0 )
+	{
+		std::cerr << "Usage: feedconv [text input file] [output file] [stamp=<messages per second>]" << std::endl;
+		return 1;
+	}
+	MappedFile infile ( argv[1] );
+	if ( !infile.good() )
+	{
+		std::cerr << "Problems finding/opening file [" << argv[1] << "]" << std::endl;
+		return 1;
+	}
+	std::ofstream outfile ( argv[2], std::ios::out | std::ios::binary | std::ios::trunc );
+	if ( !outfile.good() )
+	{
+		std::cerr << "Problems creating file [" << argv[2] << "]" << std::endl;
+		return 1;
+	}
+	if ( rate > 0 )
+		return stamp ( infile, outfile, argv[2], rate );
+	// write in large blocks rather than a record at a time
+	static const size_t records_per_block ( 4096 );
+	char block[ records_per_block * BinaryFeed::record_size ];
+	size_t used ( 0 );
+	BinaryFeed::writeHeader ( block );
+	outfile.write ( block, BinaryFeed::header_size );
+	uint32_t messages ( 0 ), failures ( 0 ), with_symbol ( 0 );
+	MessageView line;
+	Message message;
+	while ( infile.nextLine ( line ) )
+	{
+		FeedHandler::parse ( line, message );
+		BinaryFeed::encode ( message, block + used );
+		used += BinaryFeed::record_size;
+		if ( used == sizeof ( block ) )
+		{
+			outfile.write ( block, used );
+			used = 0;
+		}
+		messages++;
+		if ( message.type == MessageType::CORRUPTED || message.type == MessageType::WEIRD )
+			failures++;
+		if ( message.symbol )
+			with_symbol++;
+	}
+	outfile.write ( block, used );
+	outfile.close();
+	if ( !outfile.good() )
+	{
+		std::cerr << "Problems writing file [" << argv[2] << "]" << std::endl;
+		return 1;
+	}
+	std::cout << "Converted " << messages << " messages, " << failures << " of which we couldn't parse" << std::endl;
+	// binary records don't have a symbol, those messages all end up with the default instrument
+	if ( with_symbol )
+		std::cerr << with_symbol << " messages had a symbol, the binary feed doesn't keep it" << std::endl;
+	return 0;
+}
@@ -1,10 +1,10 @@
-#include <algorithm>
+#include <cmath>
+#include <cstdlib>
 #include <iostream>
 #include <limits>
+#include <string>
 #include <assert.h>
-#include <stdlib.h>
 #include <stdexcept>
-#include <cmath>
 
 #include "FeedHandler.hpp"
 
@@ -30,8 +30,19 @@ namespace JumpInterview {
 		// also, allow dos style formatting .. where our lines still have a \r at the end
 		const char FeedHandler::f_return ( '\r' );
 
+		static_assert ( Constants::price_scale == Constants::round_size, "we parse and print prices with different scales" );
+
+		// a double holds every integer below 2^53, and every power of 10 up to 10^22, exactly
+		static const uint64_t f_exact_mantissa ( 1ull << 53 );
+		static const double f_powers_of_10[] =
+		{
+			1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+			1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+		};
+		static const uint32_t f_exact_powers ( sizeof ( f_powers_of_10 ) / sizeof ( f_powers_of_10[0] ) );
+
 		FeedHandler::FeedHandler( ) :
-			m_book ( m_error_summary )
+			m_default ( 0 )
 		{
 		}
 
@@ -41,225 +52,560 @@ namespace JumpInterview {
 
 		void FeedHandler::processMessage ( const std::string &line, std::ostream &os )
 		{
-			static const char * nan ( "NAN" );
-			try
+			processMessage ( MessageView ( line ), os );
+		}
+
+		void FeedHandler::processMessage ( MessageView const & line, std::ostream &os )
+		{
+			StreamSink sink ( os );
+			OutputBuffer out ( sink );
+			processMessage ( line, out );
+		}
+
+		void FeedHandler::processMessage ( Message const & message, std::ostream &os )
+		{
+			StreamSink sink ( os );
+			OutputBuffer out ( sink );
+			processMessage ( message, out );
+		}
+
+		void FeedHandler::processRecord ( const char * record, std::ostream &os )
+		{
+			StreamSink sink ( os );
+			OutputBuffer out ( sink );
+			processRecord ( record, out );
+		}
+
+		void FeedHandler::processBatch ( Message const * messages, size_t count, std::ostream &os, bool per_message_output, bool netting )
+		{
+			StreamSink sink ( os );
+			OutputBuffer out ( sink );
+			processBatch ( messages, count, out, per_message_output, netting );
+		}
+
+		void FeedHandler::processMessage ( MessageView const & line, OutputBuffer & out )
+		{
+			Message message;
+			parse ( line, message );
+			processMessage ( message, out );
+		}
+
+		void FeedHandler::processRecord ( const char * record, OutputBuffer & out )
+		{
+			Message message;
+			BinaryFeed::decode ( record, message );
+			processMessage ( message, out );
+		}
+
+		void FeedHandler::processMessage ( Message const & message, OutputBuffer & out )
+		{
+			applyMessage ( message, out );
+			printMidPrice ( route ( message.symbol ), out );
+		}
+
+		/*
+		 * Without per message output we only write the mid price once the whole batch is done ( trades still write
+		 * their volume as they happen ), for the instrument the last message was for. That's also the only time we're allowed to net, because netting means
+		 * some of the states in between never happen.
+		 */
+		void FeedHandler::processBatch ( Message const * messages, size_t count, OutputBuffer & out, bool per_message_output, bool netting )
+		{
+			if ( per_message_output )
 			{
-				size_t i = line.find ( f_sep, 0 );
-				// orders are more likely, let's help predictive branching and process those first
-				if ( i == 1 && line.size() > 3 &&
-						(
-							line[0] == f_add ||
-							line[0] == f_remove ||
-							line[0] == f_modify ) )
-					processOrderMessage ( line, os );
-				else if ( i == 1 && line.size() > 3 && line[0] == f_trade )
-					processTradeMessage ( line, os );
-				else
-					m_error_summary.corrupted_messages++;
-			} catch ( std::runtime_error & )
+				for ( size_t i = 0; i < count; i++ )
+				{
+					applyMessage ( messages[i], out );
+					printMidPrice ( route ( messages[i].symbol ), out );
+				}
+				return;
+			}
+			if ( netting )
 			{
-				// ouch - I really shouldn't get here
-				m_error_summary.unexpected_exception++;
+				netBatch ( messages, count );
+				for ( size_t i = 0; i < count; i++ )
+					if ( !m_netted_away[i] )
+						applyMessage ( m_netted[i], out );
 			}
-			double const & mid ( m_book.midPrice() );
-			if ( mid == std::numeric_limits<double>::max() )
-				os << nan << std::endl;
 			else
-				os << mid << std::endl;
-		}
-
-		// I could have split the string into tokens, but this way I don't have to allocate memory for strings..
-		// I also could have decided to use only 2 size_t's and keep on checking that we're on the right track, I decided
-		// not to do that to make predictive branching easier - we process everything in one go and carry on. We expect
-		// most messages to be well-formed anyway.
-		void FeedHandler::processOrderMessage ( const std::string &line, std::ostream &os )
-		{
-			assert ( line[0] == f_add ||
-					 line[0] == f_remove ||
-					 line[0] == f_modify );
-			size_t order_id_begin ( 2 );
-			size_t order_id_end ( line.find ( f_sep, order_id_begin ) );
-			size_t side_begin ( order_id_end + 1 );
-			size_t volume_begin ( side_begin + 2 );
-			size_t volume_end ( line.find ( f_sep, volume_begin ) );
-			size_t price_begin ( volume_end + 1 );
-			size_t comment ( line.find ( f_comment, price_begin ) );
-			size_t whitespace ( line.find ( f_whitespace, price_begin ) );
-			assert ( ( whitespace == std::string::npos && comment == std::string::npos ) ||	( whitespace != comment ) );
-			size_t return_chr ( line.find ( f_return, price_begin ) );
-			// read until the end of the line or the first whitespace, comma
-			size_t price_end ( std::min ( comment, std::min ( whitespace, return_chr ) ) != std::string::npos ?
-							   std::min ( comment, std::min ( whitespace , return_chr ) ) : line.size() );
-			uint32_t order_id;
-			uint32_t volume;
-			double price;
-			bool failure = (
-							   /* parse the order id */
-							   order_id_end <= order_id_begin ||
-							   !tryParse ( line.data() + order_id_begin,
-										   order_id_end - order_id_begin,
-										   order_id ) ||
-							   /* check that the side is B or S */
-							   ( line[side_begin] != f_buy && line[side_begin] != f_sell ) ||
-							   /* parse the volume */
-							   volume_end <= volume_begin ||
-							   !tryParse ( line.data() + volume_begin,
-										   volume_end - volume_begin,
-										   volume ) ||
-							   /* finally, parse the price */
-							   price_end <= price_begin ||
-							   !tryParse ( line.data() + price_begin,
-										   price_end - price_begin,
-										   price ) || /* Why not, allow and order id of 0 */
-							   price <= 0 ||
-							   price > maxPrice() ||
-							   volume == 0 /* An order with a volume of 0? I don't think so! If that's a modify it should be an 'X' instead! */ );
-			if ( !failure )
+				for ( size_t i = 0; i < count; i++ )
+					applyMessage ( messages[i], out );
+			printMidPrice ( route ( count ? messages[ count - 1 ].symbol : 0 ), out );
+		}
+
+		/*
+		 * Orders that get added and then removed or modified within the same batch don't have to go anywhere near the
+		 * book for the first message:
+		 *  -> Add then remove ( same side and price, like the book would check ) - neither happens
+		 *  -> Add then modify to a new price or up in volume - it would lose its priority anyway, so we just add it
+		 *     where the modify was
+		 *  -> Add then modify down in volume - keeps its priority, so we add it with the lower volume straight away
+		 * We only do this for orders the book doesn't know about yet, so a duplicate add still ends up as an error,
+		 * and never across a trade because we check trades against the book as it was. An add and a remove or modify
+		 * only go together when they're for the same instrument. The resulting book is the same,
+		 * but anything we'd have counted about the states in between ( no_trades_when_they_should_happen ) isn't.
+		 */
+		void FeedHandler::netBatch ( Message const * messages, size_t count )
+		{
+			m_netted.assign ( messages, messages + count );
+			m_netted_away.assign ( count, false );
+			m_pending_adds.clear();
+			for ( size_t i = 0; i < count; i++ )
 			{
-				// once the book is crossed we generate expected trades.
-				// before we see any more order messages, we expect new trades to match those we expected
-				if ( m_book.isCrossed() && m_book.waitingForTrades() )
-					m_error_summary.no_trades_when_they_should_happen++;
-				switch ( line[0] )
+				Message & message ( m_netted[i] );
+				if ( message.type == MessageType::TRADE )
 				{
-				case f_add:
+					m_pending_adds.clear();
+					continue;
+				}
+				if ( message.type == MessageType::ADD )
 				{
-					Order_ptr order ( new Order  (
-										  order_id,
-										  line[side_begin] == f_buy ? OrderSide::BUY : OrderSide::SELL,
-										  volume,
-										  static_cast < uint32_t > ( std::floor ( price * Constants::round_size ) ) ) );
-					assert ( order != 0 );
-					assert ( order->volume() == volume );
-					assert ( order->orderId() == order_id );
-					// if we can't add this order, we have to dispose it ourselves
-					if ( !m_book.add ( order ) )
-						delete ( order );
-					break;
+					// a second add for the same id is a duplicate. That depends on the first one actually being
+					// in the book at that point, so we leave this id alone from now on
+					if ( !m_pending_adds.erase ( message.order_id ) && !route ( message.symbol ).book.contains ( message.order_id ) )
+						m_pending_adds.insert ( std::make_pair ( message.order_id, i ) );
+					continue;
 				}
-				case f_remove:
+				if ( message.type != MessageType::REMOVE && message.type != MessageType::MODIFY )
+					continue;
+				PendingAdds::iterator pending ( m_pending_adds.find ( message.order_id ) );
+				if ( pending == m_pending_adds.end() )
+					continue;
+				Message & add ( m_netted[pending->second] );
+				// one we can't net still happens, to an order the book hasn't seen yet, so just like a duplicate add
+				// we leave this id alone from now on
+				if ( add.side != message.side || add.symbol != message.symbol ||
+						( message.type == MessageType::REMOVE && add.price != message.price ) )
 				{
-					// order will be disposed as soon as this goes out of scope
-					Order_ptr order ( m_book.remove ( order_id,
-													  line[side_begin] == f_buy ? OrderSide::BUY : OrderSide::SELL,
-													  volume,
-													  static_cast < uint32_t > ( std::floor ( price * Constants::round_size ) ) ) );
-					if ( order )
-						delete ( order );
-					break;
+					m_pending_adds.erase ( pending );
+					continue;
 				}
-				case f_modify:
+				if ( message.type == MessageType::REMOVE )
 				{
-					m_book.modify ( order_id,
-									line[side_begin] == f_buy ? OrderSide::BUY : OrderSide::SELL,
-									volume,
-									static_cast < uint32_t > ( std::floor ( price * Constants::round_size ) ) );
-					break;
+					m_netted_away[pending->second] = true;
+					m_netted_away[i] = true;
+					m_pending_adds.erase ( pending );
 				}
+				else if ( add.price != message.price || add.volume < message.volume )
+				{
+					m_netted_away[pending->second] = true;
+					message.type = MessageType::ADD;
+					pending->second = i;
+				}
+				else
+				{
+					add.volume = message.volume;
+					m_netted_away[i] = true;
+				}
+			}
+		}
+
+		Instrument & FeedHandler::route ( Symbol symbol )
+		{
+			return !symbol ? m_default : m_instruments.find ( symbol );
+		}
+
+		void FeedHandler::applyMessage ( Message const & message, OutputBuffer & out )
+		{
+			Instrument & instrument ( route ( message.symbol ) );
+			try
+			{
+				switch ( message.type )
+				{
+				// orders are more likely, let's help predictive branching and process those first
+				case MessageType::ADD:
+				case MessageType::REMOVE:
+				case MessageType::MODIFY:
+					processOrderMessage ( instrument, message );
+					break;
+				case MessageType::TRADE:
+					processTradeMessage ( instrument, message, out );
+					break;
+				case MessageType::WEIRD:
+					instrument.errors.out_of_bounds_or_weird_numbers++;
+					break;
 				default:
-					// error!
+					instrument.errors.corrupted_messages++;
 					break;
 				}
+			} catch ( std::runtime_error & )
+			{
+				// ouch - I really shouldn't get here
+				instrument.errors.unexpected_exception++;
 			}
-			else if ( price_begin == std::string::npos )
-				m_error_summary.corrupted_messages ++;
+		}
+
+		/*
+		 * Written from the prices in ticks, see NumberFormat. It's the same text as the double we keep in the book.
+		 */
+		void FeedHandler::printMidPrice ( Instrument const & instrument, OutputBuffer & out ) const
+		{
+			static const char * nan ( "NAN" );
+			uint64_t sum ( instrument.book.topOfBookSum() );
+			if ( !sum )
+				out.append ( nan );
 			else
-				m_error_summary.out_of_bounds_or_weird_numbers++;
-		}
-
-		void FeedHandler::processTradeMessage ( const std::string &line, std::ostream &os )
-		{
-			assert ( line[0] == f_trade );
-			size_t volume_begin ( 2 );
-			size_t volume_end ( line.find ( f_sep, volume_begin ) );
-			size_t price_begin ( volume_end + 1 );
-			size_t comment ( line.find ( f_comment, price_begin ) );
-			size_t whitespace ( line.find ( f_whitespace, price_begin ) );
-			size_t return_chr ( line.find ( f_return, price_begin ) );
-			// read until the end of the line or the first whitespace, comma
-			size_t price_end ( std::min ( comment, std::min ( whitespace, return_chr ) ) != std::string::npos ?
-							   std::min ( comment, std::min ( whitespace, return_chr ) ) : line.size() );
-			uint32_t volume;
-			double price;
-			bool failure = (
-							   /* parse the volume */
-							   volume_end <= volume_begin ||
-							   !tryParse ( line.data() + volume_begin,
-										   volume_end - volume_begin,
-										   volume ) ||
-							   /* parse the price */
-							   price_end <= price_begin ||
-							   !tryParse ( line.data() + price_begin,
-										   price_end - price_begin,
-										   price ) ||
-							   price < 0 ||
-							   price > maxPrice() );
-			if ( !failure )
-				m_book.handleTrade ( volume, static_cast < uint32_t > ( std::floor ( price * Constants::round_size ) ), os );
-			else if ( price_begin == std::string::npos )
-				m_error_summary.corrupted_messages++;
+				out.appendMidPrice ( sum );
+			out.endLine();
+		}
+
+		void FeedHandler::processOrderMessage ( Instrument & instrument, Message const & message )
+		{
+			assert ( message.type == MessageType::ADD ||
+					 message.type == MessageType::REMOVE ||
+					 message.type == MessageType::MODIFY );
+			// once the book is crossed we generate expected trades.
+			// before we see any more order messages, we expect new trades to match those we expected
+			OrderBook & book ( instrument.book );
+			if ( book.isCrossed() && book.waitingForTrades() )
+				instrument.errors.no_trades_when_they_should_happen++;
+			switch ( message.type )
+			{
+			case MessageType::ADD:
+			{
+				Order_ptr order ( new Order  (
+									  message.order_id,
+									  message.side,
+									  message.volume,
+									  message.price ) );
+				assert ( order != 0 );
+				assert ( order->volume() == message.volume );
+				assert ( order->orderId() == message.order_id );
+				// if we can't add this order, we have to dispose it ourselves
+				if ( !book.add ( order ) )
+					delete ( order );
+				break;
+			}
+			case MessageType::REMOVE:
+			{
+				// order will be disposed as soon as this goes out of scope
+				Order_ptr order ( book.remove ( message.order_id,
+												  message.side,
+												  message.volume,
+												  message.price ) );
+				if ( order )
+					delete ( order );
+				break;
+			}
+			case MessageType::MODIFY:
+			{
+				book.modify ( message.order_id,
+								message.side,
+								message.volume,
+								message.price );
+				break;
+			}
+			default:
+				// error!
+				break;
+			}
+		}
+
+		void FeedHandler::processTradeMessage ( Instrument & instrument, Message const & message, OutputBuffer & out )
+		{
+			assert ( message.type == MessageType::TRADE );
+			instrument.book.handleTrade ( message.volume, message.price, out );
+		}
+
+		/*
+		 * One pass over the line, front to back. Every field has to end exactly where we expect it to; the order id
+		 * and volume end in a separator, the price at the end of the line, where a comment starts or at the separator
+		 * in front of the optional symbol. We don't
+		 * allocate, don't copy and ( unless a price has more digits than a double holds ) don't go through strtod.
+		 *
+		 * Anything that doesn't even start like a message is corrupted, a message with fields we can't
+		 * make sense of is weird.
+		 */
+		void FeedHandler::parse ( MessageView const & line, Message & message )
+		{
+			message = Message();
+			if ( line.size() <= 3 || line[1] != f_sep )
+				return;
+			switch ( line[0] )
+			{
+			case f_add:
+				message.type = MessageType::ADD;
+				break;
+			case f_remove:
+				message.type = MessageType::REMOVE;
+				break;
+			case f_modify:
+				message.type = MessageType::MODIFY;
+				break;
+			case f_trade:
+				message.type = MessageType::TRADE;
+				break;
+			default:
+				return;
+			}
+			const char * pos ( line.data() + 2 );
+			const char * end ( line.data() + line.size() );
+			bool success;
+			if ( message.type == MessageType::TRADE )
+				success = (
+							  parseUInt ( pos, end, message.volume ) &&
+							  parsePrice < DefaultPriceTraits > ( pos, end, message.price ) &&
+							  parseSymbol ( pos, end, message.symbol ) );
 			else
-				m_error_summary.out_of_bounds_or_weird_numbers++;
+				success = (
+							  parseUInt ( pos, end, message.order_id ) &&
+							  parseSide ( pos, end, message.side ) &&
+							  parseUInt ( pos, end, message.volume ) &&
+							  parsePrice < DefaultPriceTraits > ( pos, end, message.price ) &&
+							  parseSymbol ( pos, end, message.symbol ) &&
+							  message.price > 0 &&
+							  message.volume > 0 /* An order with a volume of 0? I don't think so! If that's a modify it should be an 'X' instead! */ );
+			if ( !success )
+				message.type = MessageType::WEIRD;
 		}
 
 		void FeedHandler::printCurrentOrderBook ( std::ostream &os ) const
 		{
-			m_book.print ( os );
+			StreamSink sink ( os );
+			OutputBuffer out ( sink );
+			printCurrentOrderBook ( out );
+		}
+
+		void FeedHandler::printCurrentOrderBook ( OutputBuffer & out ) const
+		{
+			m_default.printBook ( out );
+			std::vector < Symbol > const & symbols ( m_instruments.symbols() );
+			for ( size_t i = 0; i < symbols.size(); i++ )
+				m_instruments.find ( symbols[i] )->printBook ( out );
 		}
 
 		void FeedHandler::printErrorSummary ( std::ostream & os ) const
 		{
-			os << "Errors:" << std::endl;
-			os << m_error_summary;
+			m_default.printErrors ( os );
+			std::vector < Symbol > const & symbols ( m_instruments.symbols() );
+			for ( size_t i = 0; i < symbols.size(); i++ )
+				m_instruments.find ( symbols[i] )->printErrors ( os );
 		}
 
 		OrderBook const & FeedHandler::book() const
 		{
-			return m_book;
+			return m_default.book;
 		}
 
 		ErrorSummary const & FeedHandler::errors() const
 		{
-			return m_error_summary;
+			return m_default.errors;
+		}
+
+		Instrument const * FeedHandler::instrument ( Symbol symbol ) const
+		{
+			return !symbol ? &m_default : m_instruments.find ( symbol );
+		}
+
+		InstrumentRegistry const & FeedHandler::instruments() const
+		{
+			return m_instruments;
+		}
+
+		void FeedHandler::resetSession()
+		{
+			m_default.book.abandonOrders();
+			std::vector < Symbol > const & symbols ( m_instruments.symbols() );
+			for ( size_t i = 0; i < symbols.size(); i++ )
+				m_instruments.find ( symbols[i] ).book.abandonOrders();
+			m_pending_adds.clear();
+			PoolAllocator<Order>::instance().reset();
+		}
+
+		void FeedHandler::saveSnapshot ( OutputBuffer & out, uint64_t position ) const
+		{
+			SnapshotWriter writer ( out );
+			writer.writeHeader();
+			writer.write64 ( position );
+			std::vector < Symbol > const & symbols ( m_instruments.symbols() );
+			writer.write32 ( static_cast < uint32_t > ( symbols.size() + 1 ) );
+			saveInstrument ( m_default, writer );
+			for ( size_t i = 0; i < symbols.size(); i++ )
+				saveInstrument ( *m_instruments.find ( symbols[i] ), writer );
+		}
+
+		void FeedHandler::saveInstrument ( Instrument const & instrument, SnapshotWriter & out )
+		{
+			out.write64 ( instrument.symbol );
+			out.write ( instrument.errors );
+			instrument.book.save ( out );
 		}
 
-		bool FeedHandler::tryParse ( const char * input, size_t len, double & out )
+		bool FeedHandler::loadSnapshot ( const char * data, size_t size, uint64_t & position )
 		{
-			char* endptr;
-			out = strtod ( input, &endptr );
-			// success if we processed exactly the number of characters we expected
-			return ( endptr == input + len );
+			assert ( !m_instruments.size() && m_default.book.buys().empty() && m_default.book.sells().empty() );
+			SnapshotReader reader ( data, size );
+			if ( !reader.readHeader() )
+				return false;
+			position = reader.read64();
+			uint32_t instruments ( reader.read32() );
+			InstrumentRegistry const & known ( m_instruments );
+			for ( uint32_t i = 0; reader.good() && i < instruments; i++ )
+			{
+				Symbol symbol ( reader.read64() );
+				// the default instrument comes first, and only first, and every other one just the once
+				if ( !reader.good() || !i != !symbol || ( symbol && known.find ( symbol ) ) )
+				{
+					reader.fail();
+					break;
+				}
+				Instrument & instrument ( symbol ? m_instruments.find ( symbol ) : m_default );
+				reader.read ( instrument.errors );
+				instrument.book.load ( reader );
+			}
+			return instruments && reader.good() && !reader.remaining();
 		}
 
-		bool FeedHandler::tryParse ( const char * input, size_t len, uint32_t & out )
+		bool FeedHandler::hasErrors() const
 		{
-			char * endptr;
-			out = strtoul ( input, &endptr, 10 );
-			// success if we processed exactly the number of characters we expected and there's no '-' in there
-			return ( std::find ( input, input + len, '-' ) == input + len &&
-					 endptr == input + len &&
-					 ( len < 10 || !isUIntOverflow ( input, len ) ) );
+			if ( !m_default.errors.empty() )
+				return true;
+			std::vector < Symbol > const & symbols ( m_instruments.symbols() );
+			for ( size_t i = 0; i < symbols.size(); i++ )
+				if ( !m_instruments.find ( symbols[i] )->errors.empty() )
+					return true;
+			return false;
+		}
+
+		inline bool FeedHandler::isDigit ( char c )
+		{
+			return static_cast < unsigned char > ( c - '0' ) < 10;
 		}
 
 		/*
-		 * A not so quick check to see if the value's bigger than uint32_t::max
+		 * Reads an unsigned integer followed by a separator, and moves past both. Like strtoul we skip leading
+		 * whitespace, unlike strtoul we don't allow a sign and we stop the moment we don't fit in a uint32_t.
 		 */
-		bool FeedHandler::isUIntOverflow ( const char * input, size_t len )
+		bool FeedHandler::parseUInt ( const char * & pos, const char * end, uint32_t & out )
 		{
-			static const char * max_size ( "4294967295" );
-			if ( len > 10 )
-				return true;
-			for ( size_t i = 0; i < len && input[i] >= max_size[i] ; i++ )
+			while ( pos < end && ( *pos == f_whitespace || *pos == '\t' ) )
+				pos++;
+			const char * begin ( pos );
+			uint64_t value ( 0 );
+			for ( ; pos < end && isDigit ( *pos ); pos++ )
 			{
-				if ( input[i] > max_size[i] )
-					return true;
+				value = value * 10 + ( *pos - '0' );
+				if ( value > std::numeric_limits<uint32_t>::max() )
+					return false;
 			}
-			return false;
+			if ( pos == begin || pos == end || *pos != f_sep )
+				return false;
+			out = static_cast < uint32_t > ( value );
+			pos++;
+			return true;
+		}
+
+		bool FeedHandler::parseSide ( const char * & pos, const char * end, OrderSide::Side & out )
+		{
+			if ( end - pos < 2 || ( pos[0] != f_buy && pos[0] != f_sell ) || pos[1] != f_sep )
+				return false;
+			out = pos[0] == f_buy ? OrderSide::BUY : OrderSide::SELL;
+			pos += 2;
+			return true;
+		}
+
+		/*
+		 * Reads a decimal price straight into ticks. Just like multiplying by the scale and rounding down, we drop any
+		 * decimals beyond the ones the scale has - without ever going through a double, so 2.01 really ends up as 2010
+		 * ticks. Unless the traits round through a double, the way the feed always has: then 2.01 is 2009 ticks,
+		 * exactly what strtod, multiplying and rounding down made of it. We still read the digits ourselves, into an
+		 * integer - dividing that by a power of 10 is the same double strtod comes up with, as long as both fit in a
+		 * double's 53 bits. Only a price with more digits than that goes through strtod itself.
+		 * The price has to fit in a Price worth of ticks, and it has to end at the end of the line, a comment or
+		 * the separator in front of a symbol.
+		 */
+		template < class Traits >
+		bool FeedHandler::parsePrice ( const char * & pos, const char * end, typename Traits::Price & out )
+		{
+			static const uint64_t max_units ( std::numeric_limits < typename Traits::Price >::max() / Traits::price_scale );
+			static const uint64_t max_ticks ( max_units * Traits::price_scale );
+			const char * begin ( pos );
+			uint64_t units ( 0 );
+			bool has_digits ( false );
+			for ( ; pos < end && isDigit ( *pos ); pos++ )
+			{
+				units = units * 10 + ( *pos - '0' );
+				if ( units > max_units )
+					return false;
+				has_digits = true;
+			}
+			uint64_t ticks ( units * Traits::price_scale );
+			// anything beyond the decimals we keep only matters if it pushes us over our maximum price
+			bool truncated ( false );
+			bool too_big ( false );
+			// every digit, for when we round through a double
+			uint64_t mantissa ( units );
+			uint32_t decimals ( 0 );
+			bool exact ( true );
+			if ( pos < end && *pos == '.' )
+			{
+				uint32_t scale ( Traits::price_scale );
+				for ( pos++; pos < end && isDigit ( *pos ); pos++ )
+				{
+					if ( scale > 1 )
+					{
+						scale /= 10;
+						// with 64 bits worth of ticks, going over could wrap around before we get to check
+						uint64_t add ( static_cast < uint64_t > ( *pos - '0' ) * scale );
+						if ( add > max_ticks - ticks )
+							too_big = true;
+						else
+							ticks += add;
+					}
+					else if ( *pos != '0' )
+						truncated = true;
+					if ( Traits::rounds_through_double )
+					{
+						exact = exact && mantissa < f_exact_mantissa / 10;
+						mantissa = mantissa * 10 + ( *pos - '0' );
+						decimals++;
+					}
+					has_digits = true;
+				}
+			}
+			if ( !has_digits ||
+					( pos != end && *pos != f_whitespace && *pos != f_comment && *pos != f_return && *pos != f_sep ) )
+				return false;
+			if ( Traits::rounds_through_double )
+			{
+				double price ( exact && decimals < f_exact_powers ?
+							   mantissa / f_powers_of_10[ decimals ] :
+							   strtod ( std::string ( begin, pos ).c_str(), 0 ) );
+				if ( price > max_units )
+					return false;
+				out = static_cast < typename Traits::Price > ( std::floor ( price * Traits::price_scale ) );
+				return true;
+			}
+			if ( too_big || ( ticks == max_ticks && truncated ) )
+				return false;
+			out = static_cast < typename Traits::Price > ( ticks );
+			return true;
 		}
 
-		constexpr double FeedHandler::maxPrice()
+		template bool FeedHandler::parsePrice < DefaultPriceTraits > ( const char * & pos, const char * end, uint32_t & out );
+		template bool FeedHandler::parsePrice < CentPriceTraits > ( const char * & pos, const char * end, uint32_t & out );
+		template bool FeedHandler::parsePrice < WidePriceTraits > ( const char * & pos, const char * end, uint64_t & out );
+
+		/*
+		 * The optional last field: a separator followed by 1 to 8 characters up to the end of the line or a comment.
+		 * No separator at all means there's no symbol, and we leave it at 0.
+		 */
+		bool FeedHandler::parseSymbol ( const char * & pos, const char * end, Symbol & out )
 		{
-			return std::floor ( std::numeric_limits<uint32_t>::max() / Constants::round_size );
+			if ( pos == end || *pos != f_sep )
+				return true;
+			pos++;
+			Symbol symbol ( 0 );
+			size_t length ( 0 );
+			for ( ; pos < end && *pos != f_whitespace && *pos != f_comment && *pos != f_return; pos++, length++ )
+			{
+				if ( length == sizeof ( Symbol ) || *pos == f_sep )
+					return false;
+				symbol |= static_cast < Symbol > ( static_cast < unsigned char > ( *pos ) ) << ( 56 - 8 * length );
+			}
+			if ( !length )
+				return false;
+			out = symbol;
+			return true;
 		}
 	}
 }
@@ -1,24 +1,89 @@
 #ifndef __FEED_HANDLER_HPP
 #define __FEED_HANDLER_HPP
 
+#include <unordered_map>
+#include <vector>
+
 #include "Constants.hpp"
 #include "Order.hpp"
 #include "OrderBook.hpp"
 #include "ErrorSummary.hpp"
+#include "Instrument.hpp"
+#include "MessageView.hpp"
+#include "Message.hpp"
+#include "BinaryFeed.hpp"
+#include "OutputBuffer.hpp"
+#include "PriceTraits.hpp"
+#include "Snapshot.hpp"
 
 namespace JumpInterview {
 	namespace OrderBook {
 
+		/*
+		 * Messages that say which instrument they're for go to that instrument's book, anything else goes to the
+		 * default instrument. With just the one instrument, that's all there is.
+		 */
 		class FeedHandler
 		{
 		public:
 			FeedHandler( );
 			~FeedHandler();
+			/*
+			 * Everything we write goes through an OutputBuffer. The std::ostream versions are there for convenience
+			 * ( the tests use them ), they put a buffer in front of the stream and flush it before they return.
+			 */
 			void processMessage ( const std::string &line, std::ostream &os );
+			void processMessage ( MessageView const & line, std::ostream &os );
+			void processMessage ( Message const & message, std::ostream &os );
+			void processMessage ( MessageView const & line, OutputBuffer & out );
+			void processMessage ( Message const & message, OutputBuffer & out );
+			/* A single BinaryFeed::record_size record */
+			void processRecord ( const char * record, std::ostream &os );
+			void processRecord ( const char * record, OutputBuffer & out );
+			/*
+			 * Applies count messages in one go. With per_message_output the output is exactly what processMessage would
+			 * have written for every one of them, otherwise we write the mid price once at the end, and may net out
+			 * messages that cancel each other out ( see netBatch )
+			 */
+			void processBatch ( Message const * messages, size_t count, std::ostream &os, bool per_message_output = true, bool netting = false );
+			void processBatch ( Message const * messages, size_t count, OutputBuffer & out, bool per_message_output = true, bool netting = false );
+			/* The default instrument's book, followed by every other instrument's in symbol order */
 			void printCurrentOrderBook ( std::ostream &os ) const;
+			void printCurrentOrderBook ( OutputBuffer & out ) const;
 			void printErrorSummary ( std::ostream & os ) const;
+			/* The default instrument */
 			OrderBook const & book() const;
 			ErrorSummary const & errors() const;
+			/* 0 if we've never seen a message for it */
+			Instrument const * instrument ( Symbol symbol ) const;
+			InstrumentRegistry const & instruments() const;
+			/* Did anything go wrong, for any instrument? */
+			bool hasErrors() const;
+			/*
+			 * Starts a new session: every book is emptied, and the orders in them go in one go rather than one by one
+			 * ( see PoolAllocator::reset ). That's every order on this thread, so no other FeedHandler on this thread may
+			 * have any left. We still know every instrument, and what went wrong with it.
+			 */
+			void resetSession();
+			/*
+			 * Every instrument's book and errors as a snapshot ( see Snapshot.hpp ), along with position: how many
+			 * messages went into them, so whoever loads it knows where to pick up the feed.
+			 */
+			void saveSnapshot ( OutputBuffer & out, uint64_t position ) const;
+			/*
+			 * Only into a FeedHandler that hasn't seen a message yet. False if it isn't a snapshot we can make sense of,
+			 * and then what's in the books is anybody's guess - throw the FeedHandler away.
+			 */
+			bool loadSnapshot ( const char * data, size_t size, uint64_t & position );
+
+			/* Turns a line into a message, without touching the book. Lines we can't parse become CORRUPTED/WEIRD messages */
+			static void parse ( MessageView const & line, Message & message );
+			/*
+			 * Reads a decimal price into ticks of the traits' scale, and moves pos past it. False if it isn't one, or
+			 * if it doesn't fit in a Price. Compiled for DefaultPriceTraits, CentPriceTraits and WidePriceTraits.
+			 */
+			template < class Traits >
+			static bool parsePrice ( const char * & pos, const char * end, typename Traits::Price & out );
 		private:
 			static const char f_add ;
 			static const char f_remove;
@@ -32,18 +97,29 @@ namespace JumpInterview {
 			static const char f_comment;
 			static const char f_whitespace;
 			static const char f_return;
-			FeedHandler ( FeedHandler const & rhs ) : m_book ( m_error_summary ) {}
+			FeedHandler ( FeedHandler const & rhs ) : m_default ( 0 ) {}
+
+			static void saveInstrument ( Instrument const & instrument, SnapshotWriter & out );
+			inline Instrument & route ( Symbol symbol );
+			inline void applyMessage ( Message const & message, OutputBuffer & out );
+			inline void printMidPrice ( Instrument const & instrument, OutputBuffer & out ) const;
+			void netBatch ( Message const * messages, size_t count );
+			inline void processOrderMessage ( Instrument & instrument, Message const & message );
+			inline void processTradeMessage ( Instrument & instrument, Message const & message, OutputBuffer & out );
 
-			inline void processOrderMessage ( const std::string &line, std::ostream &os );
-			inline void processTradeMessage ( const std::string &line, std::ostream &os );
+			static inline bool isDigit ( char c );
+			static bool parseUInt ( const char * & pos, const char * end, uint32_t & out );
+			static bool parseSide ( const char * & pos, const char * end, OrderSide::Side & out );
+			static bool parseSymbol ( const char * & pos, const char * end, Symbol & out );
 
-			static bool tryParse ( const char * input, size_t len, double & out );
-			static bool tryParse ( const char * input, size_t len, uint32_t & out );
-			static bool isUIntOverflow ( const char * input, size_t len );
-			static constexpr double maxPrice();
+			Instrument m_default;
+			InstrumentRegistry m_instruments;
 
-			ErrorSummary m_error_summary;
-			OrderBook m_book;
+			/* scratch space for netting batches, kept around so we don't allocate for every batch */
+			typedef std::unordered_map < uint32_t, size_t > PendingAdds;
+			std::vector < Message > m_netted;
+			std::vector < bool > m_netted_away;
+			PendingAdds m_pending_adds;
 		};
 	}
 }
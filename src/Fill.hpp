@@ -0,0 +1,48 @@
+#ifndef __FILL_HPP__
+#define __FILL_HPP__
+
+#include <stdint.h>
+
+#include "Order.hpp"
+
+namespace JumpInterview {
+	namespace OrderBook {
+
+		/* What happens to an order we match ourselves ( see BasicOrderBook::execute ), once it's done all it can */
+		namespace OrderType
+		{
+			enum Type
+			{
+				// what's left rests in the book, at its price
+				LIMIT,
+				// immediate or cancel: trades what it can at its price or better, what's left is dropped
+				IOC,
+				// trades what it can at any price, what's left is dropped
+				MARKET
+			};
+		}
+
+		/* An incoming order trading against one resting order, at the resting order's price */
+		struct Fill
+		{
+			Fill() : aggressor_id ( 0 ), aggressor_side ( OrderSide::BUY ), resting_id ( 0 ), price ( 0 ), volume ( 0 ), resting_volume_left ( 0 ) {}
+			uint32_t aggressor_id;
+			OrderSide::Side aggressor_side;
+			uint32_t resting_id;
+			uint32_t price;
+			uint32_t volume;
+			// 0 when the resting order is gone
+			uint32_t resting_volume_left;
+		};
+
+		/* Whoever wants to hear about every fill a book makes, as it happens ( see BasicOrderBook::setFillListener ) */
+		class FillListener
+		{
+		public:
+			virtual ~FillListener() {}
+			virtual void filled ( Fill const & fill ) = 0;
+		};
+	}
+}
+
+#endif
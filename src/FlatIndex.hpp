@@ -0,0 +1,383 @@
+#ifndef __FLAT_INDEX_HPP__
+#define __FLAT_INDEX_HPP__
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <sys/mman.h>
+
+namespace JumpInterview {
+	namespace OrderBook {
+
+		/*
+		 * A hash table from uint32_t keys ( order ids ) to small values ( an Order_ptr ), with everything in one flat
+		 * array of slots: no nodes, no buckets, no modulo. Open addressing with linear probing, Robin Hood style - on
+		 * the way to a free slot, whoever's closer to home makes room for whoever's further away. That keeps every
+		 * probe short, and a miss can stop as soon as it meets someone closer to home than it would have been.
+		 *
+		 * Erasing shifts the rest of the run back by one, so there are no tombstones and the table never has to be
+		 * cleaned up.
+		 *
+		 * Growing doesn't move everything in one go, which would stall us for milliseconds once there are millions of
+		 * orders. We set up a table twice the size, and every insert or erase after that moves a handful of runs over
+		 * from the old one, long before the new one fills up. Until then, a lookup that isn't in the new table looks
+		 * in the old one as well. reserve() does grow in one go: that's what you call before you get going. It pays for
+		 * a big table's pages right away too, and asks for huge pages for it - millions of orders end up all over the
+		 * table, and every one of them would otherwise cost a walk through the page tables as well as a cache miss.
+		 *
+		 * The slots start out zeroed, and a big table is only paid for as its pages get touched. Giving a big table back
+		 * in one go takes milliseconds as well, so we map those ourselves, and once we've moved out of one we unmap it
+		 * a piece at a time - another piece with every insert or erase.
+		 */
+		template < class T >
+		class FlatIndex
+		{
+		public:
+			static const size_t min_capacity = 16;
+			// slots we move over from the old table for every insert or erase while we're growing
+			static const size_t migrate_step = 16;
+			// tables from this size on ( in bytes ) are mapped, and unmapped this much at a time
+			static const size_t map_threshold = 1 << 20;
+			static const size_t release_step = 1 << 20;
+
+			FlatIndex() :
+				m_size ( 0 ),
+				m_cursor ( 0 ),
+				m_to_migrate ( 0 ),
+				m_retired ( 0 ),
+				m_retired_bytes ( 0 )
+			{
+				allocate ( m_table, min_capacity );
+			}
+
+			~FlatIndex()
+			{
+				release ( m_table );
+				release ( m_old );
+				releaseRetired ( m_retired_bytes );
+			}
+
+			size_t size() const
+			{
+				return m_size;
+			}
+
+			bool empty() const
+			{
+				return !m_size;
+			}
+
+			/* How many slots we've got, not counting a table we're still moving out of */
+			size_t capacity() const
+			{
+				return m_table.mask + 1;
+			}
+
+			/* Are we still moving slots over from a smaller table? */
+			bool rehashing() const
+			{
+				return m_old.slots != 0;
+			}
+
+			/* 0 if we don't have it */
+			T * find ( uint32_t key )
+			{
+				Slot * slot ( lookup ( m_table, key ) );
+				if ( !slot && m_old.slots )
+					slot = lookup ( m_old, key );
+				return slot ? &slot->value : 0;
+			}
+
+			T const * find ( uint32_t key ) const
+			{
+				return const_cast < FlatIndex * > ( this )->find ( key );
+			}
+
+			/* False ( and nothing changes ) if we already have this key */
+			bool insert ( uint32_t key, T const & value )
+			{
+				if ( find ( key ) )
+					return false;
+				if ( m_old.slots )
+					migrate ( migrate_step );
+				else if ( overloaded ( m_size + 1, capacity() ) )
+					grow ( capacity() * 2 );
+				else if ( m_retired_bytes )
+					releaseRetired ( release_step );
+				place ( m_table, key, value );
+				m_size++;
+				return true;
+			}
+
+			/* False if we didn't have this key */
+			bool erase ( uint32_t key )
+			{
+				Table * table ( &m_table );
+				Slot * slot ( lookup ( m_table, key ) );
+				if ( !slot && m_old.slots )
+				{
+					table = &m_old;
+					slot = lookup ( m_old, key );
+				}
+				if ( !slot )
+					return false;
+				shiftBack ( *table, slot - table->slots );
+				m_size--;
+				if ( m_old.slots )
+					migrate ( migrate_step );
+				else if ( m_retired_bytes )
+					releaseRetired ( release_step );
+				return true;
+			}
+
+			/* Makes room for this many keys, so we won't have to grow until we've got more than that */
+			void reserve ( size_t count )
+			{
+				size_t wanted ( min_capacity );
+				while ( overloaded ( count, wanted ) )
+					wanted *= 2;
+				if ( wanted <= capacity() )
+					return;
+				finishMigrating();
+				grow ( wanted, true );
+				finishMigrating();
+			}
+
+			/* Keeps the slots we've got */
+			void clear()
+			{
+				release ( m_old );
+				m_to_migrate = 0;
+				memset ( m_table.slots, 0, capacity() * sizeof ( Slot ) );
+				m_size = 0;
+			}
+		private:
+			// the values are copied around with memcpy and the slots start out zeroed
+			static_assert ( std::is_trivially_copyable < T >::value, "FlatIndex values must be trivially copyable" );
+
+			struct Slot
+			{
+				T value;
+				uint32_t key;
+				// how far we are from the slot we hash to, plus one. 0 for an empty slot
+				uint32_t distance;
+			};
+
+			struct Table
+			{
+				Table() : slots ( 0 ), mask ( 0 ), shift ( 0 ), mapped ( false ) {}
+				Slot * slots;
+				size_t mask;
+				// how far to shift the hash to get a block
+				unsigned shift;
+				bool mapped;
+			};
+
+			// 16 slots to a block
+			static const unsigned block_bits = 4;
+
+			FlatIndex ( FlatIndex const & rhs ) {}
+
+			/* We keep at least an eighth of the slots free */
+			static bool overloaded ( size_t count, size_t slots )
+			{
+				return count > slots - slots / 8;
+			}
+
+			static void allocate ( Table & table, size_t capacity, bool prefault = false )
+			{
+				assert ( capacity && ! ( capacity & ( capacity - 1 ) ) );
+				size_t bytes ( capacity * sizeof ( Slot ) );
+				table.mapped = bytes >= map_threshold;
+				if ( table.mapped )
+				{
+					void * slots ( mmap ( 0, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 ) );
+					table.slots = slots == MAP_FAILED ? 0 : static_cast < Slot * > ( slots );
+					if ( prefault && table.slots )
+					{
+#ifdef MADV_HUGEPAGE
+						madvise ( slots, bytes, MADV_HUGEPAGE );
+#endif
+						for ( size_t offset = 0; offset < bytes; offset += 4096 )
+							static_cast < volatile char * > ( slots )[ offset ] = 0;
+					}
+				}
+				else
+					table.slots = static_cast < Slot * > ( std::calloc ( capacity, sizeof ( Slot ) ) );
+				if ( !table.slots )
+					throw std::bad_alloc();
+				table.mask = capacity - 1;
+				table.shift = 64;
+				while ( capacity > 1 << block_bits )
+				{
+					table.shift--;
+					capacity /= 2;
+				}
+			}
+
+			/*
+			 * Order ids mostly come one after the other, so we keep every 16 of them that only differ in their last bits
+			 * next to each other: they share a couple of cache lines, and a feed adding and removing orders in order
+			 * keeps hitting the same ones. Which block of 16 slots they get is a hash of the rest of the id -
+			 * multiplying spreads it over the top bits, and we take those.
+			 */
+			static size_t home ( Table const & table, uint32_t key )
+			{
+				size_t block ( table.shift >= 64 ? 0 : ( ( key >> block_bits ) * 0x9E3779B97F4A7C15ull ) >> table.shift );
+				return block << block_bits | ( key & ( ( 1 << block_bits ) - 1 ) );
+			}
+
+			static Slot * lookup ( Table const & table, uint32_t key )
+			{
+				size_t index ( home ( table, key ) );
+				for ( uint32_t distance = 1; ; distance++ )
+				{
+					Slot & slot ( table.slots[ index ] );
+					// an empty slot, or someone who'd have had to make room for us
+					if ( slot.distance < distance )
+						return 0;
+					if ( slot.key == key )
+						return &slot;
+					index = ( index + 1 ) & table.mask;
+				}
+			}
+
+			/* The key mustn't be in there already */
+			static void place ( Table & table, uint32_t key, T const & value )
+			{
+				Slot entry;
+				entry.value = value;
+				entry.key = key;
+				entry.distance = 1;
+				size_t index ( home ( table, key ) );
+				while ( true )
+				{
+					Slot & slot ( table.slots[ index ] );
+					if ( !slot.distance )
+					{
+						slot = entry;
+						return;
+					}
+					if ( slot.distance < entry.distance )
+						std::swap ( slot, entry );
+					index = ( index + 1 ) & table.mask;
+					entry.distance++;
+				}
+			}
+
+			/* Empties this slot, and moves everyone after it that isn't at home one closer */
+			static void shiftBack ( Table & table, size_t index )
+			{
+				size_t next ( ( index + 1 ) & table.mask );
+				while ( table.slots[ next ].distance > 1 )
+				{
+					table.slots[ index ] = table.slots[ next ];
+					table.slots[ index ].distance--;
+					index = next;
+					next = ( next + 1 ) & table.mask;
+				}
+				table.slots[ index ].distance = 0;
+			}
+
+			/*
+			 * Starts moving everything into a table of this size. We move runs in the order they're in, starting right
+			 * after an empty slot, and only ever stop in between two runs: nobody in the old table ever has to probe
+			 * through a slot we've already emptied. An erase in the old table only shifts back within its own run,
+			 * so that stays true.
+			 */
+			void grow ( size_t new_capacity, bool prefault = false )
+			{
+				assert ( !m_old.slots );
+				// we've never got more than one table to unmap
+				releaseRetired ( m_retired_bytes );
+				m_old = m_table;
+				m_table = Table();
+				allocate ( m_table, new_capacity, prefault );
+				size_t start ( 0 );
+				while ( m_old.slots[ start ].distance )
+					start++;
+				m_cursor = ( start + 1 ) & m_old.mask;
+				m_to_migrate = m_old.mask + 1;
+			}
+
+			/* Moves at least this many slots, and whatever is left of the run we end up in */
+			void migrate ( size_t slots )
+			{
+				while ( m_to_migrate )
+				{
+					Slot & slot ( m_old.slots[ m_cursor ] );
+					// anyone at home starts a new run, and so does an empty slot
+					if ( !slots && slot.distance <= 1 )
+						return;
+					if ( slot.distance )
+					{
+						place ( m_table, slot.key, slot.value );
+						slot.distance = 0;
+					}
+					m_cursor = ( m_cursor + 1 ) & m_old.mask;
+					m_to_migrate--;
+					if ( slots )
+						slots--;
+				}
+				if ( m_old.mapped )
+				{
+					releaseRetired ( m_retired_bytes );
+					m_retired = reinterpret_cast < char * > ( m_old.slots );
+					m_retired_bytes = ( m_old.mask + 1 ) * sizeof ( Slot );
+					m_old = Table();
+				}
+				else
+					release ( m_old );
+			}
+
+			static void release ( Table & table )
+			{
+				if ( table.mapped )
+					munmap ( table.slots, ( table.mask + 1 ) * sizeof ( Slot ) );
+				else
+					std::free ( table.slots );
+				table = Table();
+			}
+
+			/* Unmaps this much of the table we've moved out of, from the end */
+			void releaseRetired ( size_t bytes )
+			{
+				bytes = std::min ( bytes, m_retired_bytes );
+				m_retired_bytes -= bytes;
+				if ( bytes )
+					munmap ( m_retired + m_retired_bytes, bytes );
+			}
+
+			void finishMigrating()
+			{
+				if ( m_old.slots )
+					migrate ( m_to_migrate );
+			}
+
+			Table m_table;
+			// the table we're moving out of while we grow
+			Table m_old;
+			size_t m_size;
+			// the next slot to move in the old table, and how many we've got left
+			size_t m_cursor;
+			size_t m_to_migrate;
+			// what's still mapped of the last table we moved out of
+			char * m_retired;
+			size_t m_retired_bytes;
+		};
+
+		template < class T > const size_t FlatIndex<T>::min_capacity;
+		template < class T > const size_t FlatIndex<T>::migrate_step;
+		template < class T > const unsigned FlatIndex<T>::block_bits;
+		template < class T > const size_t FlatIndex<T>::map_threshold;
+		template < class T > const size_t FlatIndex<T>::release_step;
+	}
+}
+
+#endif
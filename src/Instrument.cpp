@@ -0,0 +1,78 @@
+#include <assert.h>
+#include <algorithm>
+
+#include "Instrument.hpp"
+
+namespace JumpInterview {
+	namespace OrderBook {
+
+		char * Instrument::formatSymbol ( char * out, Symbol symbol )
+		{
+			for ( ; symbol; symbol <<= 8 )
+				*out++ = static_cast < char > ( symbol >> 56 );
+			return out;
+		}
+
+		void Instrument::printBook ( OutputBuffer & out ) const
+		{
+			if ( symbol )
+			{
+				char formatted[ sizeof ( Symbol ) ];
+				out.append ( '[' );
+				out.append ( formatted, formatSymbol ( formatted, symbol ) - formatted );
+				out.append ( ']' );
+				out.endLine();
+			}
+			book.print ( out );
+		}
+
+		void Instrument::printErrors ( std::ostream & os ) const
+		{
+			os << "Errors";
+			if ( symbol )
+			{
+				char formatted[ sizeof ( Symbol ) ];
+				os << " [";
+				os.write ( formatted, formatSymbol ( formatted, symbol ) - formatted );
+				os << "]";
+			}
+			os << ":" << std::endl;
+			os << errors;
+		}
+
+		InstrumentRegistry::InstrumentRegistry() :
+			m_last ( 0 )
+		{
+		}
+
+		Instrument const * InstrumentRegistry::find ( Symbol symbol ) const
+		{
+			Instruments::const_iterator iter ( m_instruments.find ( symbol ) );
+			return iter != m_instruments.end() ? iter->second.get() : 0;
+		}
+
+		size_t InstrumentRegistry::size() const
+		{
+			return m_instruments.size();
+		}
+
+		std::vector < Symbol > const & InstrumentRegistry::symbols() const
+		{
+			return m_symbols;
+		}
+
+		Instrument & InstrumentRegistry::insert ( Symbol symbol )
+		{
+			assert ( symbol );
+			std::unique_ptr < Instrument > & instrument ( m_instruments[ symbol ] );
+			if ( !instrument )
+			{
+				instrument.reset ( new Instrument ( symbol ) );
+				// a new instrument is rare enough to keep these sorted as we go
+				m_symbols.insert ( std::lower_bound ( m_symbols.begin(), m_symbols.end(), symbol ), symbol );
+			}
+			m_last = instrument.get();
+			return *instrument;
+		}
+	}
+}
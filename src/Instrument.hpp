@@ -0,0 +1,76 @@
+#ifndef __INSTRUMENT_HPP__
+#define __INSTRUMENT_HPP__
+
+#include <memory>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+#include "ErrorSummary.hpp"
+#include "Message.hpp"
+#include "OrderBook.hpp"
+#include "OutputBuffer.hpp"
+
+namespace JumpInterview {
+	namespace OrderBook {
+
+		/*
+		 * Everything we know about one instrument: its book, and what went wrong with its messages.
+		 */
+		struct Instrument
+		{
+			Instrument ( Symbol instrument_symbol ) : symbol ( instrument_symbol ), book ( errors ) {}
+
+			/* The book, with a line saying which instrument this is in front of it - unless it's the default one */
+			void printBook ( OutputBuffer & out ) const;
+			/* Same as the book, the default instrument's errors don't get the symbol */
+			void printErrors ( std::ostream & os ) const;
+
+			/* Up to 8 characters, written without a terminating 0. Returns the end of what we wrote */
+			static char * formatSymbol ( char * out, Symbol symbol );
+
+			const Symbol symbol;
+			// has to be there before the book, the book counts into it
+			ErrorSummary errors;
+			OrderBook book;
+		private:
+			Instrument ( Instrument const & rhs ) : symbol ( 0 ), book ( errors ) {}
+		};
+
+		/*
+		 * Every instrument other than the default one, created the first time we see a message for it. Messages for
+		 * the same instrument tend to come in runs, so we remember the last one we handed out.
+		 */
+		class InstrumentRegistry
+		{
+		public:
+			InstrumentRegistry();
+
+			Instrument & find ( Symbol symbol )
+			{
+				if ( m_last && m_last->symbol == symbol )
+					return *m_last;
+				return insert ( symbol );
+			}
+
+			/* 0 if we've never seen it */
+			Instrument const * find ( Symbol symbol ) const;
+
+			size_t size() const;
+			/* Every symbol we know, in order */
+			std::vector < Symbol > const & symbols() const;
+		private:
+			typedef std::unordered_map < Symbol, std::unique_ptr < Instrument > > Instruments;
+
+			InstrumentRegistry ( InstrumentRegistry const & rhs ) {}
+
+			Instrument & insert ( Symbol symbol );
+
+			Instruments m_instruments;
+			std::vector < Symbol > m_symbols;
+			Instrument * m_last;
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,127 @@
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "BinaryFeed.hpp"
+#include "Endian.hpp"
+#include "Journal.hpp"
+
+namespace JumpInterview {
+	namespace OrderBook {
+
+		const char Journal::f_magic[4] = { 'J', 'O', 'B', 'J' };
+
+		/*
+		 * A new journal gets its header, an old one loses whatever's left of a record we were writing when we died -
+		 * the next one has to start where a record starts. Either way that's committed before we append anything.
+		 */
+		Journal::Journal ( std::string const & filename, GroupCommit commit ) :
+			m_fd ( open ( filename.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644 ) ),
+			m_recovered ( 0 )
+		{
+			struct stat info;
+			if ( m_fd < 0 || fstat ( m_fd, &info ) )
+				return;
+			size_t size ( info.st_size );
+			if ( !size )
+			{
+				char header[ header_size ];
+				memcpy ( header, f_magic, sizeof ( f_magic ) );
+				LittleEndian::write32 ( header + sizeof ( f_magic ), version );
+				if ( !FdSink::writeAll ( m_fd, header, header_size ) )
+					return;
+				size = header_size;
+			}
+			else
+			{
+				char header[ header_size ];
+				if ( size < header_size || pread ( m_fd, header, header_size, 0 ) != static_cast < ssize_t > ( header_size ) || !isJournal ( header, header_size ) )
+					return;
+				m_recovered = ( size - header_size ) / record_size;
+				size_t whole ( header_size + m_recovered * record_size );
+				if ( whole != size && ftruncate ( m_fd, whole ) )
+					return;
+			}
+			if ( fdatasync ( m_fd ) )
+				return;
+			m_writer.reset ( new AsyncWriter ( m_fd, RingFullPolicy::BLOCK, AsyncWriter::default_capacity, commit ) );
+		}
+
+		Journal::~Journal()
+		{
+			close();
+			if ( m_fd >= 0 )
+				::close ( m_fd );
+		}
+
+		bool Journal::good() const
+		{
+			return m_writer.get() != 0;
+		}
+
+		uint64_t Journal::recovered() const
+		{
+			return m_recovered;
+		}
+
+		void Journal::close()
+		{
+			if ( m_writer )
+				m_writer->close();
+		}
+
+		uint64_t Journal::committed() const
+		{
+			return m_writer ? m_writer->committed() : 0;
+		}
+
+		AsyncWriterStats const & Journal::stats() const
+		{
+			return m_writer ? m_writer->stats() : m_no_stats;
+		}
+
+		void Journal::encode ( Message const & message, char * out )
+		{
+			BinaryFeed::encode ( message, out );
+			LittleEndian::write64 ( out + BinaryFeed::record_size, message.symbol );
+		}
+
+		void Journal::decode ( const char * in, Message & message )
+		{
+			BinaryFeed::decode ( in, message );
+			message.symbol = LittleEndian::read64 ( in + BinaryFeed::record_size );
+		}
+
+		bool Journal::isJournal ( const char * data, size_t size )
+		{
+			return size >= header_size &&
+				   !memcmp ( data, f_magic, sizeof ( f_magic ) ) &&
+				   LittleEndian::read32 ( data + sizeof ( f_magic ) ) == version;
+		}
+
+		uint64_t Journal::replay ( const char * data, size_t size, FeedHandler & feed, uint64_t from )
+		{
+			if ( !isJournal ( data, size ) )
+				return 0;
+			uint64_t records ( ( size - header_size ) / record_size );
+			NullSink null_sink;
+			OutputBuffer out ( null_sink );
+			Message messages[ MessageBatch::capacity ];
+			for ( uint64_t i = from; i < records; )
+			{
+				size_t count ( 0 );
+				for ( ; count < MessageBatch::capacity && i < records; count++, i++ )
+					decode ( data + header_size + i * record_size, messages[ count ] );
+				feed.processBatch ( messages, count, out, false );
+			}
+			return records;
+		}
+
+		const size_t Journal::header_size;
+		const size_t Journal::record_size;
+		const uint32_t Journal::version;
+		const size_t Journal::default_commit_bytes;
+		const uint32_t Journal::default_commit_us;
+	}
+}
@@ -0,0 +1,89 @@
+#ifndef __JOURNAL_HPP__
+#define __JOURNAL_HPP__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <string>
+
+#include "AsyncWriter.hpp"
+#include "FeedHandler.hpp"
+#include "Message.hpp"
+
+namespace JumpInterview {
+	namespace OrderBook {
+
+		/*
+		 * A write-ahead journal: every message is appended to it before it's applied, so after a crash the books can
+		 * be rebuilt from the journal rather than from the whole feed. That's every message we're given, the ones we
+		 * can't make anything of included - they count towards the error summary too.
+		 *
+		 * A journal starts with an 8 byte header ( "JOBJ" and a version ), followed by nothing but 24 byte records:
+		 *
+		 *   offset  size  field
+		 *   0       16    message   a BinaryFeed record
+		 *   16      8     symbol    little-endian, 0 for the default instrument
+		 *
+		 * Appending only copies the record into an AsyncWriter's ring. Its writer thread writes them out and commits
+		 * them in groups ( see GroupCommit ), so we never wait for the disk unless the ring is full. A crash loses
+		 * whatever wasn't committed yet, never more than one group. If it happens half way through a record, that
+		 * record is cut off the next time we open the journal.
+		 */
+		class Journal
+		{
+		public:
+			static const size_t header_size = 8;
+			static const size_t record_size = 24;
+			static const uint32_t version = 1;
+			// 256KB is about 10000 messages
+			static const size_t default_commit_bytes = 256 * 1024;
+			static const uint32_t default_commit_us = 2000;
+
+			/* Appends to the journal in this file, or starts one if there isn't one yet */
+			Journal ( std::string const & filename, GroupCommit commit = GroupCommit ( default_commit_bytes, default_commit_us ) );
+			/* Closes if we haven't yet */
+			~Journal();
+
+			/* False if we couldn't open it, or it isn't a journal. Nothing gets appended then */
+			bool good() const;
+			/* How many whole records were in there when we opened it */
+			uint64_t recovered() const;
+
+			void append ( Message const & message )
+			{
+				char record[ record_size ];
+				encode ( message, record );
+				if ( m_writer )
+					m_writer->write ( record, record_size );
+			}
+
+			/* Waits until everything we appended has been written and committed */
+			void close();
+			/* How many bytes of records are safely on disk so far ( see AsyncWriter::committed ) */
+			uint64_t committed() const;
+			/* Only complete once we're closed */
+			AsyncWriterStats const & stats() const;
+
+			static void encode ( Message const & message, char * out );
+			static void decode ( const char * in, Message & message );
+			/* Does this buffer start with our header? */
+			static bool isJournal ( const char * data, size_t size );
+			/*
+			 * Applies every whole record from the from'th one on to the feed, as fast as we can: in batches, and
+			 * without any output, that was written the first time around. Returns how many records there are.
+			 */
+			static uint64_t replay ( const char * data, size_t size, FeedHandler & feed, uint64_t from = 0 );
+		private:
+			static const char f_magic[4];
+
+			Journal ( Journal const & rhs ) {}
+
+			int m_fd;
+			uint64_t m_recovered;
+			AsyncWriterStats m_no_stats;
+			std::unique_ptr < AsyncWriter > m_writer;
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,57 @@
+#include <assert.h>
+#include <cstring>
+
+#include "Endian.hpp"
+#include "LevelDelta.hpp"
+
+namespace JumpInterview {
+	namespace OrderBook {
+
+		static const char f_actions[] = { 'N', 'U', 'D' };
+
+		LevelDeltaPublisher::LevelDeltaPublisher ( OutputBuffer & out ) :
+			m_out ( out ),
+			m_published ( 0 )
+		{
+		}
+
+		void LevelDeltaPublisher::levelChanged ( LevelDelta const & delta )
+		{
+			char record[ record_size ];
+			encode ( delta, record );
+			m_out.append ( record, record_size );
+			m_published++;
+		}
+
+		size_t LevelDeltaPublisher::published() const
+		{
+			return m_published;
+		}
+
+		void LevelDeltaPublisher::encode ( LevelDelta const & delta, char * out )
+		{
+			assert ( delta.action < sizeof ( f_actions ) );
+			out[0] = f_actions[ delta.action ];
+			out[1] = delta.side == OrderSide::BUY ? 'B' : 'S';
+			out[2] = out[3] = 0;
+			LittleEndian::write32 ( out + 4, delta.level.price );
+			LittleEndian::write32 ( out + 8, delta.level.orders );
+			LittleEndian::write64 ( out + 12, delta.level.volume );
+		}
+
+		bool LevelDeltaPublisher::decode ( const char * in, LevelDelta & delta )
+		{
+			const char * action ( static_cast < const char * > ( memchr ( f_actions, in[0], sizeof ( f_actions ) ) ) );
+			if ( !action || ( in[1] != 'B' && in[1] != 'S' ) )
+				return false;
+			delta.action = static_cast < LevelAction::Action > ( action - f_actions );
+			delta.side = in[1] == 'B' ? OrderSide::BUY : OrderSide::SELL;
+			delta.level.price = LittleEndian::read32 ( in + 4 );
+			delta.level.orders = LittleEndian::read32 ( in + 8 );
+			delta.level.volume = LittleEndian::read64 ( in + 12 );
+			return true;
+		}
+
+		const size_t LevelDeltaPublisher::record_size;
+	}
+}
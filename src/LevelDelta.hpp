@@ -0,0 +1,87 @@
+#ifndef __LEVEL_DELTA_HPP__
+#define __LEVEL_DELTA_HPP__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "Order.hpp"
+#include "OutputBuffer.hpp"
+
+namespace JumpInterview {
+	namespace OrderBook {
+
+		/* One price level of the book, the way it looks from the outside: no orders, just how much there is */
+		struct DepthLevel
+		{
+			DepthLevel() : price ( 0 ), orders ( 0 ), volume ( 0 ) {}
+			uint32_t price;
+			uint32_t orders;
+			uint64_t volume;
+		};
+
+		namespace LevelAction
+		{
+			enum Action
+			{
+				NEW,
+				UPDATE,
+				// there's nothing left at this price
+				DELETE
+			};
+		}
+
+		/* A level that came, changed or went. A deleted level has no orders and no volume left */
+		struct LevelDelta
+		{
+			LevelDelta() : action ( LevelAction::NEW ), side ( OrderSide::BUY ) {}
+			LevelAction::Action action;
+			OrderSide::Side side;
+			DepthLevel level;
+		};
+
+		/* Whoever wants to hear about every level that changes in a book, as it happens ( see BasicOrderBook::setLevelListener ) */
+		class LevelListener
+		{
+		public:
+			virtual ~LevelListener() {}
+			virtual void levelChanged ( LevelDelta const & delta ) = 0;
+		};
+
+		/*
+		 * Writes every level delta it hears about to an OutputBuffer, as a fixed width binary record. Everything is
+		 * little-endian:
+		 *
+		 *   offset  size  field
+		 *   0       1     action    'N', 'U' or 'D'
+		 *   1       1     side      'B' or 'S'
+		 *   2       2     reserved  always 0
+		 *   4       4     price     in ticks ( see Constants::round_size )
+		 *   8       4     orders
+		 *   12      8     volume
+		 *
+		 * An order that's requeued at the same price ( its volume went up ) while it was the only one there, shows up as
+		 * a delete followed by a new level.
+		 */
+		class LevelDeltaPublisher : public LevelListener
+		{
+		public:
+			static const size_t record_size = 20;
+
+			LevelDeltaPublisher ( OutputBuffer & out );
+			virtual void levelChanged ( LevelDelta const & delta );
+			/* How many records we've written */
+			size_t published() const;
+
+			static void encode ( LevelDelta const & delta, char * out );
+			/* False for a record we don't recognise */
+			static bool decode ( const char * in, LevelDelta & delta );
+		private:
+			LevelDeltaPublisher ( LevelDeltaPublisher const & rhs ) : m_out ( rhs.m_out ) {}
+
+			OutputBuffer & m_out;
+			size_t m_published;
+		};
+	}
+}
+
+#endif
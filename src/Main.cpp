@@ -1,49 +1,387 @@
 #include <fstream>
+#include <cstdlib>
 #include <cstring>
+#include <algorithm>
 #include <string>
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "FeedHandler.hpp"
+#include "Journal.hpp"
+#include "MappedFile.hpp"
+#include "BinaryFeed.hpp"
+#include "AsyncWriter.hpp"
+#include "ParsePipeline.hpp"
+#include "Replay.hpp"
+#include "ShardedFeed.hpp"
+#include "StreamReader.hpp"
 
 using namespace JumpInterview::OrderBook;
 
+/*
+ * Every message ends up here, and every 10th message we print the whole book. With 'batch' we collect those
+ * 10 messages first and hand them to the FeedHandler in one go, which still gives us exactly the same output.
+ * With 'net' on top of that, the FeedHandler nets out what it can and only writes the mid price after every batch.
+ * With 'shard-N' the messages go to a ShardedFeed instead, which doesn't write anything until we're done.
+ * After resume() we skip the messages that are already in the books, and carry on counting from there - so we print
+ * the book, and batches start, at the same messages they would have without the snapshot. With a journal, every
+ * message we don't skip is appended to it before it's applied.
+ */
+class MessageProcessor
+{
+public:
+	static const uint32_t book_interval = 10;
+
+	MessageProcessor ( FeedHandler & feed, OutputBuffer & out, bool batch, bool netting, ShardedFeed * sharded ) :
+		m_feed ( feed ),
+		m_out ( out ),
+		m_sharded ( sharded ),
+		m_batch ( batch || netting ),
+		m_netting ( netting ),
+		m_journal ( 0 ),
+		m_skip ( 0 ),
+		m_counter ( 0 ),
+		m_batched ( 0 )
+	{
+	}
+
+	void setJournal ( Journal * journal )
+	{
+		m_journal = journal;
+	}
+
+	/* The books already have the first position messages in them ( see FeedHandler::loadSnapshot ) */
+	void resume ( uint64_t position )
+	{
+		m_skip = m_counter = position;
+	}
+
+	/* How many messages the books have had, once we've flushed */
+	uint64_t position() const
+	{
+		return m_counter + m_batched;
+	}
+
+	void process ( Message const & message )
+	{
+		if ( m_skip )
+		{
+			m_skip--;
+			return;
+		}
+		if ( m_journal )
+			m_journal->append ( message );
+		if ( m_sharded )
+		{
+			m_sharded->process ( message );
+			return;
+		}
+		if ( !m_batch )
+		{
+			m_feed.processMessage ( message, m_out );
+			if ( ++m_counter % book_interval == 0 ) {
+				m_feed.printCurrentOrderBook ( m_out );
+			}
+			return;
+		}
+		m_messages[ m_batched++ ] = message;
+		if ( ( m_counter + m_batched ) % book_interval == 0 )
+			flush();
+	}
+
+	/* Hands over whatever we've still got batched up */
+	void flush()
+	{
+		if ( !m_batched )
+			return;
+		m_feed.processBatch ( m_messages, m_batched, m_out, !m_netting, m_netting );
+		m_counter += m_batched;
+		// batches end on every 10th message, apart from the last one
+		if ( m_counter % book_interval == 0 )
+			m_feed.printCurrentOrderBook ( m_out );
+		m_batched = 0;
+	}
+private:
+	FeedHandler & m_feed;
+	OutputBuffer & m_out;
+	ShardedFeed * m_sharded;
+	bool m_batch;
+	bool m_netting;
+	Journal * m_journal;
+	uint64_t m_skip;
+	uint64_t m_counter;
+	uint32_t m_batched;
+	Message m_messages[ book_interval ];
+};
+
 int main ( int argc, char **argv )
 {
 	FeedHandler feed;
-	std::string line;
-	std::iostream null_str ( 0 );
-	std::cout.precision ( 8 );
 	if ( argc < 2 )
 	{
 		std::cerr << "You have to supply a valid filename." << std::endl;
 		return 1; // failure
 	}
 	const std::string filename ( argv[1] );
-	// the 'silent' flag will still do all processing and everything, but instead of writing
+	// the 'silent' flag will still do all processing and everything ( formatting included ), but instead of writing
 	// to std::cout we now write to an empty sink. I do this to test the speed of the program itself because
 	// even diverting the output to /dev/null would take up a lot of time.
 	// obviously it would be faster to skip printing messages alltogether when we supply 'silent' but that
 	// would be cheating and not particularly helpful when profiling
-	bool silent ( argc >= 3 && !strcmp ( argv[2], "silent" ) );
-	std::ostream & os ( silent ? null_str : std::cout );
-	// will close on destruction
-	std::ifstream infile ( filename.c_str(), std::ios::in );
-	if ( !infile.good() )
+	bool silent ( false );
+	// 'mmap' maps the whole file and parses the lines in place, instead of copying every one of them into a string
+	bool use_mmap ( false );
+	// '-' as the file reads stdin, 'stream' reads a file the same way: in large blocks, without mapping it ( see
+	// StreamReader ). 'uring' does those reads through io_uring, if the kernel lets us
+	bool stream ( filename == "-" );
+	bool use_io_uring ( false );
+	// 'batch' and 'net', see MessageProcessor
+	bool batch ( false );
+	bool netting ( false );
+	// 'async' hands our output to a writer thread of its own, so a slow stdout doesn't hold up the book.
+	// 'async-spin' and 'async-drop' do the same, but spin or drop output when it can't keep up ( see RingFullPolicy )
+	bool async ( false );
+	RingFullPolicy::Policy policy ( RingFullPolicy::BLOCK );
+	// 'pipeline' parses a text file on a thread of its own while this one applies the messages, 'pipeline-4' uses
+	// 4 parser threads ( see ParsePipeline )
+	size_t parsers ( 0 );
+	// 'shard-4' spreads the instruments over 4 worker threads, and only writes their books and errors at the end
+	size_t shards ( 0 );
+	// 'snapshot=<file>' writes the books to a file when we're done, 'resume=<file>' starts from one instead of
+	// from scratch, and skips the messages that are already in it ( see FeedHandler::saveSnapshot ). With 'net' that
+	// has to be a snapshot taken after a whole number of batches, or what gets netted away isn't the same
+	const char * snapshot_file ( 0 );
+	const char * resume_file ( 0 );
+	// 'journal=<file>' appends every message to a write-ahead journal before we apply it ( see Journal ). Whatever is
+	// in there already, from a run that didn't make it to the end, is replayed first - on top of the snapshot we
+	// resume from, if there is one - and that many messages of the input are skipped
+	const char * journal_file ( 0 );
+	// 'replay=1' plays a captured feed back at the pace it was captured at, 'replay=10' ten times as fast and
+	// 'replay=max' as fast as we can - and tells us how long every kind of message took, from when it was due
+	// until we were done with it ( see ReplayDriver ). It's one message at a time on this thread, from the start
+	double replay_speed ( -1 );
+	for ( int i = 2; i < argc; i++ )
+	{
+		if ( !strcmp ( argv[i], "silent" ) )
+			silent = true;
+		else if ( !strcmp ( argv[i], "mmap" ) )
+			use_mmap = true;
+		else if ( !strcmp ( argv[i], "stream" ) )
+			stream = true;
+		else if ( !strcmp ( argv[i], "uring" ) )
+			use_io_uring = true;
+		else if ( !strcmp ( argv[i], "batch" ) )
+			batch = true;
+		else if ( !strcmp ( argv[i], "net" ) )
+			netting = true;
+		else if ( !strncmp ( argv[i], "async", 5 ) )
+		{
+			async = true;
+			if ( !strcmp ( argv[i], "async-spin" ) )
+				policy = RingFullPolicy::SPIN;
+			else if ( !strcmp ( argv[i], "async-drop" ) )
+				policy = RingFullPolicy::DROP;
+		}
+		else if ( !strncmp ( argv[i], "pipeline", 8 ) )
+			parsers = argv[i][8] == '-' ? std::max ( atoi ( argv[i] + 9 ), 1 ) : 1;
+		else if ( !strncmp ( argv[i], "shard-", 6 ) )
+			shards = std::max ( atoi ( argv[i] + 6 ), 1 );
+		else if ( !strncmp ( argv[i], "snapshot=", 9 ) )
+			snapshot_file = argv[i] + 9;
+		else if ( !strncmp ( argv[i], "resume=", 7 ) )
+			resume_file = argv[i] + 7;
+		else if ( !strncmp ( argv[i], "journal=", 8 ) )
+			journal_file = argv[i] + 8;
+		else if ( !strncmp ( argv[i], "replay=", 7 ) )
+			replay_speed = strcmp ( argv[i] + 7, "max" ) ? atof ( argv[i] + 7 ) : 0;
+	}
+	if ( shards && ( snapshot_file || resume_file || journal_file ) )
+	{
+		std::cerr << "Snapshots and journals are for a single FeedHandler, not for shards." << std::endl;
+		return 1;
+	}
+	std::unique_ptr < ReplayDriver > replay ( replay_speed >= 0 ? new ReplayDriver ( replay_speed ) : 0 );
+	if ( replay && ( stream || parsers || shards || batch || netting || resume_file || journal_file ) )
+	{
+		std::cerr << "A replay plays a captured file from the start, one message at a time on this thread." << std::endl;
+		return 1;
+	}
+	// we write everything through one big buffer, the stream only ever sees whole blocks of it
+	NullSink null_sink;
+	StreamSink cout_sink ( std::cout );
+	std::unique_ptr < AsyncWriter > async_writer ( async && !silent ? new AsyncWriter ( STDOUT_FILENO, policy ) : 0 );
+	OutputBuffer out ( silent ? static_cast < OutputSink & > ( null_sink ) :
+					   async_writer ? static_cast < OutputSink & > ( *async_writer ) : cout_sink );
+	std::unique_ptr < ShardedFeed > sharded ( shards ? new ShardedFeed ( shards ) : 0 );
+	MessageProcessor processor ( feed, out, batch, netting, sharded.get() );
+	uint64_t position ( 0 );
+	if ( resume_file )
+	{
+		MappedFile snapshot ( resume_file );
+		if ( !snapshot.good() || !feed.loadSnapshot ( snapshot.data(), snapshot.size(), position ) )
+		{
+			std::cerr << "Problems loading snapshot [" << resume_file << "]" << std::endl;
+			return 1;
+		}
+	}
+	std::unique_ptr < Journal > journal ( journal_file ? new Journal ( journal_file ) : 0 );
+	if ( journal )
+	{
+		if ( !journal->good() )
+		{
+			std::cerr << "Problems opening journal [" << journal_file << "]" << std::endl;
+			return 1;
+		}
+		// a journal always starts where the feed does, so it can't be behind the snapshot - not even a brand new one
+		if ( journal->recovered() < position )
+		{
+			std::cerr << "Journal [" << journal_file << "] ends before snapshot [" << resume_file << "] does" << std::endl;
+			return 1;
+		}
+		if ( journal->recovered() > position )
+		{
+			MappedFile replayed ( journal_file );
+			Journal::replay ( replayed.data(), replayed.size(), feed, position );
+			std::cerr << "Replayed " << journal->recovered() - position << " messages from journal [" << journal_file << "]" << std::endl;
+			position = journal->recovered();
+		}
+		processor.setJournal ( journal.get() );
+	}
+	processor.resume ( position );
+	Message message;
+	// will unmap on destruction. Even if we end up reading it line by line, this is the quickest way to
+	// find out if we've been given a binary feed ( see BinaryFeed.hpp ) rather than text.
+	// A stream we can't map, so there's no peeking at the header either: that's text only.
+	MappedFile mapped_file ( stream ? std::string() : filename );
+	if ( !stream && !mapped_file.good() )
 	{
 		std::cerr << "Problems finding/opening file [" << filename << "]" << std::endl;
 		return 1; // another failure.
 	}
-	uint32_t counter = 0;
-	while ( std::getline ( infile, line ) ) {
-		feed.processMessage ( line, os );
-		if ( ++counter % 10 == 0 ) {
-			feed.printCurrentOrderBook ( os );
+	if ( stream )
+	{
+		int fd ( filename == "-" ? STDIN_FILENO : open ( filename.c_str(), O_RDONLY ) );
+		if ( fd < 0 )
+		{
+			std::cerr << "Problems finding/opening file [" << filename << "]" << std::endl;
+			return 1; // another failure.
+		}
+		{
+			StreamReader reader ( fd, use_io_uring );
+			MessageView line;
+			while ( reader.nextLine ( line ) )
+			{
+				FeedHandler::parse ( line, message );
+				processor.process ( message );
+			}
+			if ( !reader.good() )
+				std::cerr << "Problems reading [" << filename << "], stopped early" << std::endl;
+		}
+		if ( fd != STDIN_FILENO )
+			close ( fd );
+	}
+	else if ( replay )
+	{
+		if ( BinaryFeed::isBinary ( mapped_file.data(), mapped_file.size() ) )
+		{
+			std::cerr << "A binary feed has no capture times to replay [" << filename << "]" << std::endl;
+			return 1;
+		}
+		MessageView line;
+		uint64_t capture_ns ( 0 );
+		while ( mapped_file.nextLine ( line ) )
+		{
+			bool timed ( ReplayDriver::parse ( line, capture_ns, message ) );
+			replay->replay ( capture_ns, timed, message, processor );
+		}
+	}
+	else if ( BinaryFeed::isBinary ( mapped_file.data(), mapped_file.size() ) )
+	{
+		// fixed width records, there's nothing to split or parse
+		const char * record ( mapped_file.data() + BinaryFeed::header_size );
+		const char * end ( mapped_file.data() + mapped_file.size() );
+		for ( ; record + BinaryFeed::record_size <= end; record += BinaryFeed::record_size )
+		{
+			BinaryFeed::decode ( record, message );
+			processor.process ( message );
+		}
+		// half a record is still a message, just not one we can make anything of
+		if ( record != end )
+			processor.process ( Message() );
+	}
+	else if ( parsers )
+	{
+		ParsePipeline pipeline ( mapped_file.data(), mapped_file.size(), parsers );
+		while ( pipeline.next ( message ) )
+			processor.process ( message );
+	}
+	else if ( use_mmap )
+	{
+		MessageView line;
+		while ( mapped_file.nextLine ( line ) )
+		{
+			FeedHandler::parse ( line, message );
+			processor.process ( message );
+		}
+	}
+	else
+	{
+		// will close on destruction
+		std::ifstream infile ( filename.c_str(), std::ios::in );
+		if ( !infile.good() )
+		{
+			std::cerr << "Problems finding/opening file [" << filename << "]" << std::endl;
+			return 1; // another failure.
+		}
+		std::string line;
+		while ( std::getline ( infile, line ) )
+		{
+			FeedHandler::parse ( line, message );
+			processor.process ( message );
+		}
+	}
+	processor.flush();
+	if ( journal )
+		journal->close();
+	if ( snapshot_file )
+	{
+		std::ofstream snapshot ( snapshot_file, std::ios::out | std::ios::binary | std::ios::trunc );
+		StreamSink snapshot_sink ( snapshot );
+		{
+			OutputBuffer snapshot_out ( snapshot_sink );
+			feed.saveSnapshot ( snapshot_out, processor.position() );
 		}
+		snapshot.close();
+		if ( !snapshot )
+			std::cerr << "Problems writing snapshot [" << snapshot_file << "]" << std::endl;
+	}
+	if ( sharded )
+	{
+		sharded->close();
+		sharded->printCurrentOrderBook ( out );
 	}
-	feed.printCurrentOrderBook ( os );
-	( os ) << std::endl;
+	else
+		feed.printCurrentOrderBook ( out );
+	out.endLine();
+	// everything we've written so far has to come before the error summary
+	out.flush();
+	if ( async_writer )
+	{
+		async_writer->close();
+		// stdout is what we produce, so this goes somewhere else
+		std::cerr << async_writer->stats();
+	}
+	if ( replay )
+		std::cerr << *replay;
 	// errors are pretty relevant - you can't silence the truth
+	if ( sharded )
+	{
+		sharded->printErrorSummary ( std::cout );
+		return sharded->hasErrors();
+	}
 	feed.printErrorSummary ( std::cout );
-	return !feed.errors().empty();
+	return feed.hasErrors();
 }
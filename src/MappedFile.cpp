@@ -0,0 +1,80 @@
+#include <assert.h>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "MappedFile.hpp"
+
+namespace JumpInterview {
+	namespace OrderBook {
+
+		MappedFile::MappedFile ( std::string const & filename ) :
+			m_fd ( open ( filename.c_str(), O_RDONLY ) ),
+			m_data ( 0 ),
+			m_size ( 0 ),
+			m_offset ( 0 )
+		{
+			struct stat st;
+			if ( m_fd < 0 || fstat ( m_fd, &st ) != 0 )
+				return;
+			m_size = st.st_size;
+			// you can't map an empty file, but there's nothing to read from it either
+			if ( !m_size )
+				return;
+			void * data ( mmap ( 0, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0 ) );
+			if ( data == MAP_FAILED )
+			{
+				m_size = 0;
+				close ( m_fd );
+				m_fd = -1;
+				return;
+			}
+			m_data = static_cast < char * > ( data );
+			// we read front to back exactly once, so let the kernel read ahead aggressively and drop pages behind us.
+			// Hugepages are only a hint, not every filesystem supports them for file backed mappings.
+			madvise ( m_data, m_size, MADV_SEQUENTIAL );
+#ifdef MADV_HUGEPAGE
+			madvise ( m_data, m_size, MADV_HUGEPAGE );
+#endif
+		}
+
+		MappedFile::~MappedFile()
+		{
+			if ( m_data )
+				munmap ( m_data, m_size );
+			if ( m_fd >= 0 )
+				close ( m_fd );
+		}
+
+		bool MappedFile::good() const
+		{
+			return m_fd >= 0;
+		}
+
+		const char * MappedFile::data() const
+		{
+			return m_data;
+		}
+
+		size_t MappedFile::size() const
+		{
+			return m_size;
+		}
+
+		bool MappedFile::nextLine ( MessageView & line )
+		{
+			if ( m_offset >= m_size )
+				return false;
+			const char * begin ( m_data + m_offset );
+			const char * end ( static_cast < const char * > ( memchr ( begin, '\n', m_size - m_offset ) ) );
+			if ( !end )
+				end = m_data + m_size;
+			line = MessageView ( begin, end - begin );
+			// skip the '\n' itself
+			m_offset = end - m_data + 1;
+			return true;
+		}
+	}
+}
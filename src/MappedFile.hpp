@@ -0,0 +1,38 @@
+#ifndef __MAPPED_FILE_HPP__
+#define __MAPPED_FILE_HPP__
+
+#include <string>
+
+#include "MessageView.hpp"
+
+namespace JumpInterview {
+	namespace OrderBook {
+
+		/*
+		 * Maps a whole input file into memory and hands out its lines as views straight into the mapping.
+		 * Lines are split exactly like std::getline would ( on '\n', a trailing line without one still counts ),
+		 * so the FeedHandler sees the same messages either way - just without a copy per line.
+		 */
+		class MappedFile
+		{
+		public:
+			MappedFile ( std::string const & filename );
+			~MappedFile();
+
+			bool good() const;
+			const char * data() const;
+			size_t size() const;
+
+			/* Returns false once we've run out of lines */
+			bool nextLine ( MessageView & line );
+		private:
+			MappedFile ( MappedFile const & rhs ) {}
+			int m_fd;
+			char * m_data;
+			size_t m_size;
+			size_t m_offset;
+		};
+	}
+}
+
+#endif
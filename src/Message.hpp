@@ -0,0 +1,66 @@
+#ifndef __MESSAGE_HPP__
+#define __MESSAGE_HPP__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "Order.hpp"
+
+namespace JumpInterview {
+	namespace OrderBook {
+
+		namespace MessageType
+		{
+			enum Type
+			{
+				ADD,
+				REMOVE,
+				MODIFY,
+				TRADE,
+				// we couldn't make anything of it at all
+				CORRUPTED,
+				// looks like a message, but the numbers/side are out of bounds or just weird
+				WEIRD
+			};
+		}
+
+		/*
+		 * The instrument a message is for: up to 8 characters packed into an integer, first character highest, so
+		 * comparing, hashing and copying them is cheap and they still sort alphabetically. 0 means the message didn't
+		 * say, which is the default instrument.
+		 */
+		typedef uint64_t Symbol;
+
+		/*
+		 * A message as it comes out of the parser, prices are already in ticks ( see Constants::round_size ).
+		 * Trades only use volume, price and symbol. Messages we couldn't parse are kept as well, because they still
+		 * count as a message and still get counted as an error once we process them.
+		 */
+		struct Message
+		{
+			Message() : type ( MessageType::CORRUPTED ), side ( OrderSide::BUY ), order_id ( 0 ), volume ( 0 ), price ( 0 ), symbol ( 0 ) {}
+			MessageType::Type type;
+			OrderSide::Side side;
+			uint32_t order_id;
+			uint32_t volume;
+			uint32_t price;
+			Symbol symbol;
+		};
+
+		/*
+		 * Messages on their way from one thread to another ( see ParsePipeline and ShardedFeed ). The ParsePipeline
+		 * cuts its input into chunks, and marks the last batch of every chunk ( which may well be empty ).
+		 */
+		struct MessageBatch
+		{
+			static const size_t capacity = 64;
+
+			MessageBatch() : count ( 0 ), end_of_chunk ( false ) {}
+			uint32_t count;
+			bool end_of_chunk;
+			Message messages[ capacity ];
+		};
+	}
+}
+
+#endif
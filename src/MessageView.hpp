@@ -0,0 +1,68 @@
+#ifndef __MESSAGE_VIEW_HPP__
+#define __MESSAGE_VIEW_HPP__
+
+#include <string>
+#include <cstring>
+
+namespace JumpInterview {
+	namespace OrderBook {
+
+		/*
+		 * A pointer/length pair that looks just enough like a std::string for the FeedHandler to parse it.
+		 * It doesn't own anything, so whatever it points to ( a std::string, a memory mapped file .. ) has to
+		 * outlive it. This lets us hand over lines without copying them first.
+		 */
+		class MessageView
+		{
+		public:
+			static const size_t npos = std::string::npos;
+
+			MessageView() : m_data ( 0 ), m_size ( 0 )
+			{
+			}
+
+			MessageView ( const char * data, size_t size ) : m_data ( data ), m_size ( size )
+			{
+			}
+
+			MessageView ( std::string const & str ) : m_data ( str.data() ), m_size ( str.size() )
+			{
+			}
+
+			const char * data() const
+			{
+				return m_data;
+			}
+
+			size_t size() const
+			{
+				return m_size;
+			}
+
+			bool empty() const
+			{
+				return !m_size;
+			}
+
+			/* Like a const std::string, reading just past the end gives us a terminating 0 rather than garbage */
+			char operator[] ( size_t pos ) const
+			{
+				return pos < m_size ? m_data[pos] : 0;
+			}
+
+			/* Same as std::string::find, returns npos if we can't find it */
+			size_t find ( char c, size_t pos ) const
+			{
+				if ( pos >= m_size )
+					return npos;
+				const void * found ( memchr ( m_data + pos, c, m_size - pos ) );
+				return found ? static_cast < const char * > ( found ) - m_data : npos;
+			}
+		private:
+			const char * m_data;
+			size_t m_size;
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,354 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "AllocationCounter.hpp"
+#include "FeedHandler.hpp"
+#include "OrderBook.hpp"
+#include "OutputBuffer.hpp"
+#include "PoolAllocator.hpp"
+
+using namespace JumpInterview::OrderBook;
+
+/*
+ * One book operation at a time, each on a book that's set up for it beforehand, so what we time is that operation
+ * and nothing else. Every benchmark runs once to warm up ( the caches, the branch predictor, and the pool and the
+ * heap growing to the size they'll have ), and then as many times as we're asked to. We report the best and the
+ * median run, in nanoseconds per operation, and how many heap allocations every operation makes.
+ *
+ * The same numbers go to a CSV file, one line per benchmark and always in the same order, so two runs can be diffed.
+ *
+ * microbench [results file, defaults to microbench.csv] [repetitions, defaults to 10]
+ */
+typedef std::chrono::steady_clock Clock;
+
+// results we compute but don't need end up here, so they can't be optimised away
+static volatile uint64_t sink;
+
+/* What one run measured. Only what's between start() and stop() counts, and a run can do that more than once */
+class Measurement
+{
+public:
+	Measurement() : ops ( 0 ), elapsed ( 0 ), allocations ( 0 ), bytes ( 0 ), m_allocations ( 0 ), m_bytes ( 0 ) {}
+
+	void start()
+	{
+		m_allocations = AllocationCounter::allocations();
+		m_bytes = AllocationCounter::bytes();
+		m_start = Clock::now();
+	}
+
+	void stop()
+	{
+		elapsed += Clock::now() - m_start;
+		allocations += AllocationCounter::allocations() - m_allocations;
+		bytes += AllocationCounter::bytes() - m_bytes;
+	}
+
+	size_t ops;
+	Clock::duration elapsed;
+	uint64_t allocations;
+	uint64_t bytes;
+private:
+	Clock::time_point m_start;
+	uint64_t m_allocations;
+	uint64_t m_bytes;
+};
+
+typedef void ( *MicroBenchmark ) ( Measurement & measurement );
+
+/*
+ * A book that takes its orders with it in one go when it's done: they're abandoned and given back with their pool, so
+ * no run pays for taking down the one before it.
+ */
+struct ScratchBook
+{
+	ScratchBook() : book ( errors ), out ( null_sink ) {}
+	~ScratchBook()
+	{
+		book.abandonOrders();
+		PoolAllocator<Order>::instance().reset();
+	}
+
+	ErrorSummary errors;
+	OrderBook book;
+	NullSink null_sink;
+	OutputBuffer out;
+};
+
+static const uint32_t operations ( 100000 );
+// the books we take orders from have this many levels, of this many orders each
+static const uint32_t levels ( 100 );
+static const uint32_t per_level ( operations / levels );
+static const uint32_t lowest_price ( 1000000 );
+static const uint32_t tick ( 10 );
+
+static uint32_t priceOf ( uint32_t id )
+{
+	return lowest_price + id % levels * tick;
+}
+
+/* Buys, order 1 to operations, dealt out over the levels: every level's queue is in order of id */
+static void fillBook ( OrderBook & book, uint32_t volume )
+{
+	book.reserve ( operations );
+	for ( uint32_t id = 1; id <= operations; id++ )
+		book.add ( new Order ( id, OrderSide::BUY, volume, priceOf ( id ) ) );
+}
+
+/* Every order at a price of its own, and those come in no particular order */
+static void addNewLevel ( Measurement & measurement )
+{
+	ScratchBook scratch;
+	scratch.book.reserve ( operations );
+	measurement.start();
+	for ( uint32_t i = 0; i < operations; i++ )
+		scratch.book.add ( new Order ( i + 1, OrderSide::BUY, 100, lowest_price + i * 7919 % operations * tick ) );
+	measurement.stop();
+	measurement.ops = operations;
+}
+
+/* At the back of one of the levels that are already there */
+static void addExistingLevel ( Measurement & measurement )
+{
+	ScratchBook scratch;
+	scratch.book.reserve ( operations + levels );
+	for ( uint32_t i = 0; i < levels; i++ )
+		scratch.book.add ( new Order ( operations + i + 1, OrderSide::BUY, 100, priceOf ( i ) ) );
+	measurement.start();
+	for ( uint32_t id = 1; id <= operations; id++ )
+		scratch.book.add ( new Order ( id, OrderSide::BUY, 100, priceOf ( id ) ) );
+	measurement.stop();
+	measurement.ops = operations;
+}
+
+/*
+ * Every order goes, either from the front of its level's queue, the back, or right in the middle of what's left of
+ * it. Deleting them is part of it, that's what FeedHandler does with a removed order as well.
+ */
+template < int where >
+static void removeOrders ( Measurement & measurement )
+{
+	ScratchBook scratch;
+	fillBook ( scratch.book, 100 );
+	std::vector < uint32_t > order;
+	order.reserve ( operations );
+	if ( where == 0 )
+		for ( uint32_t id = 1; id <= operations; id++ )
+			order.push_back ( id );
+	else if ( where == 2 )
+		for ( uint32_t id = operations; id >= 1; id-- )
+			order.push_back ( id );
+	else
+	{
+		// what every level would look like, taking one from the middle of each in turn
+		std::vector < std::vector < uint32_t > > queues ( levels );
+		for ( uint32_t id = 1; id <= operations; id++ )
+			queues[ id % levels ].push_back ( id );
+		for ( uint32_t left = per_level; left > 0; left-- )
+			for ( uint32_t level = 0; level < levels; level++ )
+			{
+				std::vector < uint32_t > & queue ( queues[ level ] );
+				order.push_back ( queue[ queue.size() / 2 ] );
+				queue.erase ( queue.begin() + queue.size() / 2 );
+			}
+	}
+	measurement.start();
+	for ( uint32_t i = 0; i < operations; i++ )
+		delete scratch.book.remove ( order[i], OrderSide::BUY, 100, priceOf ( order[i] ) );
+	measurement.stop();
+	measurement.ops = operations;
+}
+
+/*
+ * Down keeps the order where it is, up sends it to the back of its level, and a new price to the back of the level
+ * next to it.
+ */
+template < int change >
+static void modifyOrders ( Measurement & measurement )
+{
+	ScratchBook scratch;
+	fillBook ( scratch.book, 1000 );
+	measurement.start();
+	for ( uint32_t id = 1; id <= operations; id++ )
+	{
+		uint32_t price ( priceOf ( id ) );
+		if ( change == 0 )
+			scratch.book.modify ( id, OrderSide::BUY, 999, price );
+		else if ( change == 1 )
+			scratch.book.modify ( id, OrderSide::BUY, 1001, price );
+		else
+			scratch.book.modify ( id, OrderSide::BUY, 1000, priceOf ( id + 1 ) );
+	}
+	measurement.stop();
+	measurement.ops = operations;
+}
+
+/*
+ * A trade while the book isn't crossed is only printed and counted as an error. While it is, every trade is matched
+ * with the next resting order we expect it to have traded with: here a single buy has crossed a level of operations
+ * sells, and every trade is with the next one of those.
+ */
+template < bool crossed >
+static void handleTrades ( Measurement & measurement )
+{
+	ScratchBook scratch;
+	scratch.book.reserve ( operations + 1 );
+	for ( uint32_t id = 1; id <= operations; id++ )
+		scratch.book.add ( new Order ( id, OrderSide::SELL, 1, lowest_price ) );
+	scratch.book.add ( new Order ( operations + 1, OrderSide::BUY, crossed ? operations : 1, crossed ? lowest_price + tick : lowest_price - tick ) );
+	measurement.start();
+	for ( uint32_t i = 0; i < operations; i++ )
+		scratch.book.handleTrade ( 1, lowest_price, scratch.out );
+	measurement.stop();
+	measurement.ops = operations;
+	if ( crossed && scratch.errors.trades_with_no_corresponding_order )
+		std::cerr << "Trades that didn't match while crossed: " << scratch.errors.trades_with_no_corresponding_order << std::endl;
+}
+
+/*
+ * A buy that crosses depth levels of sells, with one order each, and the trades that settle it: one for every level,
+ * each matched with what we expect while we walk down the other side ( see BasicOrderBook::startExpectedTrades ).
+ * The buy goes again afterwards, so the next one crosses the same levels. One operation is all of that.
+ */
+template < uint32_t depth >
+static void sweepLevels ( Measurement & measurement )
+{
+	static const uint32_t sweeps ( std::max < uint32_t > ( operations / depth, 100 ) );
+	static const uint32_t volume ( 10 );
+	ScratchBook scratch;
+	scratch.book.reserve ( depth + 1 );
+	for ( uint32_t i = 0; i < depth; i++ )
+		scratch.book.add ( new Order ( i + 1, OrderSide::SELL, volume, lowest_price + i * tick ) );
+	// a tick through the last level
+	uint32_t limit ( lowest_price + depth * tick );
+	measurement.start();
+	for ( uint32_t sweep = 0; sweep < sweeps; sweep++ )
+	{
+		scratch.book.add ( new Order ( depth + 1, OrderSide::BUY, depth * volume, limit ) );
+		for ( uint32_t i = 0; i < depth; i++ )
+			scratch.book.handleTrade ( volume, lowest_price + i * tick, scratch.out );
+		delete scratch.book.remove ( depth + 1, OrderSide::BUY, depth * volume, limit );
+	}
+	measurement.stop();
+	measurement.ops = sweeps;
+	if ( scratch.errors.trades_with_no_corresponding_order )
+		std::cerr << "Trades that didn't match while sweeping: " << scratch.errors.trades_with_no_corresponding_order << std::endl;
+}
+
+/* Adds, removes, modifies and trades, some with a symbol, the way they'd come in */
+static std::vector < std::string > const & generatedLines()
+{
+	static std::vector < std::string > lines;
+	if ( !lines.empty() )
+		return lines;
+	char line[ 64 ];
+	for ( uint32_t i = 0; i < operations; i++ )
+	{
+		uint32_t id ( i / 4 + 100000 );
+		const char * side ( id % 2 ? "B" : "S" );
+		double price ( 100 + id % 500 * 0.01 );
+		switch ( i % 4 )
+		{
+		case 0:
+			snprintf ( line, sizeof ( line ), "A,%u,%s,%u,%.2f", id, side, i % 100 + 1, price );
+			break;
+		case 1:
+			snprintf ( line, sizeof ( line ), "M,%u,%s,%u,%.2f,SYM%u", id, side, i % 100 + 2, price, id % 64 );
+			break;
+		case 2:
+			snprintf ( line, sizeof ( line ), "T,%u,%.2f", i % 100 + 1, price );
+			break;
+		default:
+			snprintf ( line, sizeof ( line ), "X,%u,%s,%u,%.2f", id, side, i % 100 + 2, price );
+		}
+		lines.push_back ( line );
+	}
+	return lines;
+}
+
+/* FeedHandler::parse on its own, without the book */
+static void parseOnly ( Measurement & measurement )
+{
+	std::vector < std::string > const & lines ( generatedLines() );
+	Message message;
+	uint64_t total ( 0 );
+	measurement.start();
+	for ( size_t i = 0; i < lines.size(); i++ )
+	{
+		FeedHandler::parse ( lines[i], message );
+		total += message.price;
+	}
+	measurement.stop();
+	sink = total;
+	measurement.ops = lines.size();
+}
+
+static void run ( const char * name, MicroBenchmark benchmark, int repetitions, std::ostream & results )
+{
+	{
+		Measurement warmup;
+		benchmark ( warmup );
+	}
+	std::vector < double > ns_per_op;
+	Measurement measurement;
+	for ( int i = 0; i < repetitions; i++ )
+	{
+		measurement = Measurement();
+		benchmark ( measurement );
+		ns_per_op.push_back ( std::chrono::duration < double, std::nano > ( measurement.elapsed ).count() / measurement.ops );
+	}
+	std::sort ( ns_per_op.begin(), ns_per_op.end() );
+	double best ( ns_per_op.front() ), median ( ns_per_op[ ns_per_op.size() / 2 ] );
+	// the same every time, so the last run's will do
+	double allocs_per_op ( static_cast < double > ( measurement.allocations ) / measurement.ops );
+	double bytes_per_op ( static_cast < double > ( measurement.bytes ) / measurement.ops );
+	std::cout << std::left << std::setw ( 32 ) << name << std::right << std::fixed << std::setprecision ( 1 ) <<
+			  std::setw ( 10 ) << best << " ns/op " <<
+			  std::setw ( 10 ) << median << " median" <<
+			  std::setprecision ( 2 ) << std::setw ( 10 ) << allocs_per_op << " allocs/op" << std::endl;
+	results << name << ',' << measurement.ops << ',' << repetitions << ',' << std::fixed << std::setprecision ( 1 ) << best << ',' << median << ',' <<
+			std::setprecision ( 3 ) << allocs_per_op << ',' << bytes_per_op << std::endl;
+}
+
+int main ( int argc, char **argv )
+{
+	const std::string filename ( argc >= 2 ? argv[1] : "microbench.csv" );
+	int repetitions ( argc >= 3 ? atoi ( argv[2] ) : 10 );
+	std::ofstream results ( filename.c_str(), std::ios::out | std::ios::trunc );
+	if ( !results.good() || repetitions <= 0 )
+	{
+		std::cerr << "Usage: microbench [results file] [repetitions]" << std::endl;
+		return 1;
+	}
+	std::cout << "Results: " << filename << ", " << repetitions << " repetitions after a warmup" << std::endl;
+	results << "name,ops,repetitions,best_ns_per_op,median_ns_per_op,allocs_per_op,bytes_per_op" << std::endl;
+	run ( "add new level", addNewLevel, repetitions, results );
+	run ( "add existing level", addExistingLevel, repetitions, results );
+	run ( "remove head", removeOrders < 0 >, repetitions, results );
+	run ( "remove middle", removeOrders < 1 >, repetitions, results );
+	run ( "remove tail", removeOrders < 2 >, repetitions, results );
+	run ( "modify volume down", modifyOrders < 0 >, repetitions, results );
+	run ( "modify volume up", modifyOrders < 1 >, repetitions, results );
+	run ( "modify price", modifyOrders < 2 >, repetitions, results );
+	run ( "trade not crossed", handleTrades < false >, repetitions, results );
+	run ( "trade crossed", handleTrades < true >, repetitions, results );
+	run ( "sweep 1 level", sweepLevels < 1 >, repetitions, results );
+	run ( "sweep 10 levels", sweepLevels < 10 >, repetitions, results );
+	run ( "sweep 100 levels", sweepLevels < 100 >, repetitions, results );
+	run ( "sweep 1000 levels", sweepLevels < 1000 >, repetitions, results );
+	run ( "parse", parseOnly, repetitions, results );
+	results.close();
+	if ( !results.good() )
+	{
+		std::cerr << "Problems writing [" << filename << "]" << std::endl;
+		return 1;
+	}
+	return 0;
+}
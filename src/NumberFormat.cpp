@@ -0,0 +1,77 @@
+#include <assert.h>
+#include <cstdio>
+
+#include "NumberFormat.hpp"
+
+namespace JumpInterview {
+	namespace OrderBook {
+
+		static const double f_powers_of_ten[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+
+		static_assert ( Constants::price_decimals + 1 < sizeof ( f_powers_of_ten ) / sizeof ( f_powers_of_ten[0] ), "we can't write prices with this many decimals" );
+
+		uint32_t NumberFormat::countDigits ( uint64_t value )
+		{
+			uint32_t digits ( 1 );
+			for ( ; value >= 10; value /= 10 )
+				digits++;
+			return digits;
+		}
+
+		char * NumberFormat::formatUInt ( char * out, uint64_t value )
+		{
+			char * end ( out + countDigits ( value ) );
+			char * pos ( end );
+			do
+			{
+				*--pos = '0' + value % 10;
+				value /= 10;
+			}
+			while ( value );
+			return end;
+		}
+
+		char * NumberFormat::formatFixed ( char * out, uint64_t mantissa, uint32_t decimals )
+		{
+			assert ( decimals < sizeof ( f_powers_of_ten ) / sizeof ( f_powers_of_ten[0] ) );
+			if ( !mantissa )
+			{
+				*out++ = '0';
+				return out;
+			}
+			// trailing zeros after the decimal point never get written
+			while ( decimals && mantissa % 10 == 0 )
+			{
+				mantissa /= 10;
+				decimals--;
+			}
+			// now every digit we have left is significant. Where the decimal point goes decides between
+			// plain and scientific notation, exactly like %g: the exponent has to be in [-4, precision)
+			int32_t digits ( countDigits ( mantissa ) );
+			int32_t exponent ( digits - static_cast < int32_t > ( decimals ) - 1 );
+			if ( digits > static_cast < int32_t > ( significant_digits ) || exponent < -4 || exponent >= static_cast < int32_t > ( significant_digits ) )
+			{
+				// this has to be rounded ( or is ridiculously small ), let printf do what it always did
+				int written ( snprintf ( out, max_length, "%.*g", significant_digits, mantissa / f_powers_of_ten[ decimals ] ) );
+				assert ( written > 0 && static_cast < size_t > ( written ) < max_length );
+				return out + written;
+			}
+			if ( exponent < 0 )
+			{
+				*out++ = '0';
+				*out++ = '.';
+				for ( int32_t i = exponent + 1; i < 0; i++ )
+					*out++ = '0';
+				return formatUInt ( out, mantissa );
+			}
+			if ( !decimals )
+				return formatUInt ( out, mantissa );
+			// write all digits one position to the right of where they go, then shift the integer part back over the gap
+			char * end ( formatUInt ( out + 1, mantissa ) );
+			for ( int32_t i = 0; i <= exponent; i++ )
+				out[i] = out[i + 1];
+			out[exponent + 1] = '.';
+			return end;
+		}
+	}
+}
@@ -0,0 +1,62 @@
+#ifndef __NUMBER_FORMAT_HPP__
+#define __NUMBER_FORMAT_HPP__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "Constants.hpp"
+#include "PriceTraits.hpp"
+
+namespace JumpInterview {
+	namespace OrderBook {
+
+		/*
+		 * Writes our integer prices and volumes as text, straight into a buffer the caller owns. Nothing gets
+		 * allocated and nothing goes through a double.
+		 *
+		 * We used to let an ostream with precision 8 do this for prices, so formatFixed writes exactly what
+		 * '%.8g' would have: trailing zeros dropped, no decimal point if there's nothing after it. That's exact for
+		 * anything with up to 8 significant digits, which covers every price we've ever seen. Anything longer has
+		 * to be rounded like printf does it, so that ( rare ) case still goes through snprintf.
+		 *
+		 * Every function returns the end of what it wrote, there's no terminating 0.
+		 */
+		class NumberFormat
+		{
+		public:
+			// the longest thing we'll ever write ( a uint64_t is 20 digits, a double with 8 significant digits
+			// in scientific notation a lot less )
+			static const size_t max_length = 32;
+			static const uint32_t significant_digits = 8;
+
+			static char * formatUInt ( char * out, uint64_t value );
+
+			/* Writes mantissa / 10^decimals */
+			static char * formatFixed ( char * out, uint64_t mantissa, uint32_t decimals );
+
+			/* A price in ticks, see Constants::price_scale */
+			static char * formatPrice ( char * out, uint32_t ticks )
+			{
+				return formatPrice < DefaultPriceTraits > ( out, ticks );
+			}
+
+			/* The same thing, in ticks of any other scale */
+			template < class Traits >
+			static char * formatPrice ( char * out, typename Traits::Price ticks )
+			{
+				static_assert ( Traits::price_decimals + 1 < 10, "we can't write prices with this many decimals" );
+				return formatFixed ( out, ticks, Traits::price_decimals );
+			}
+
+			/* Half of the sum of two prices in ticks. Multiplying by 5 and adding a decimal keeps that exact */
+			static char * formatMidPrice ( char * out, uint64_t sum_of_ticks )
+			{
+				return formatFixed ( out, sum_of_ticks * 5, Constants::price_decimals + 1 );
+			}
+		private:
+			static uint32_t countDigits ( uint64_t value );
+		};
+	}
+}
+
+#endif
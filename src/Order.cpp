@@ -1,7 +1,8 @@
 #include <assert.h>
+#include <algorithm>
 #include <cstring>
-#include <cmath>
-#include <sstream>
+#include <new>
+#include <sys/mman.h>
 
 #include "Constants.hpp"
 #include "Order.hpp"
@@ -21,13 +22,15 @@ namespace JumpInterview {
 					   uint32_t volume,
 					   uint32_t price ) :
 			m_order_id ( order_id ),
-			m_side ( side ),
 			m_volume ( volume ),
-			m_price ( price )
+			m_price ( price ),
+			m_sequence_id ( 0 ),
+			m_side ( side ),
+			m_prev ( 0 ),
+			m_next ( 0 )
 		{
 			assert ( m_volume > 0 );
 			assert ( m_price > 0 );
-			m_formatted_string[0] = 0;
 		}
 
 		uint32_t Order::orderId() const  {
@@ -35,7 +38,7 @@ namespace JumpInterview {
 		}
 
 		OrderSide::Side Order::side() const  {
-			return m_side;
+			return static_cast < OrderSide::Side > ( m_side );
 		}
 
 		uint32_t Order::volume() const  {
@@ -52,37 +55,46 @@ namespace JumpInterview {
 			assert ( volume > 0 && price > 0 );
 			m_volume = volume;
 			m_price = price;
-			// the next time we want to print this order, we have to reformat it
-			m_formatted_string[0] = 0;
+			// the text we had for this order no longer matches, so the next time we print it, it's reformatted
 		}
 
-		char * Order::format()
+		/*
+		 * "id: Side volume @ price", written straight into an entry of the OrderTextCache. The longest we can get is
+		 * "4294967295: Sell 4294967295 @ 4294967.3", 40 characters with the 0 at the end.
+		 */
+		char * Order::format ( char * text ) const
 		{
-			static const char * semicolon ( ":" );
-			static const char * buy ( "Buy" );
-			static const char * sell ( "Sell" );
-			static const char * space ( " " );
-			static const char * at ( "@" );
-			assert ( !m_formatted_string[0] );
-			std::stringstream ss;
-			// let this do the rounding.
-			ss.precision ( 8 );
-			ss <<
-			   m_order_id << semicolon << space <<
-			   ( m_side == OrderSide::BUY ? buy : sell ) << space <<
-			   m_volume << space <<
-			   at << space <<
-			   ( m_price / Constants::round_size );
-			assert ( ss.tellp() < 40 );
-			ss.read ( m_formatted_string, ss.tellp() );
+			static const char * buy ( "Buy " );
+			static const char * sell ( "Sell " );
+			static const char * at ( " @ " );
+			char * pos ( NumberFormat::formatUInt ( text, m_order_id ) );
+			*pos++ = ':';
+			*pos++ = ' ';
+			const char * side ( m_side == OrderSide::BUY ? buy : sell );
+			size_t side_length ( m_side == OrderSide::BUY ? 4 : 5 );
+			memcpy ( pos, side, side_length );
+			pos = NumberFormat::formatUInt ( pos + side_length, m_volume );
+			memcpy ( pos, at, 3 );
+			pos = NumberFormat::formatPrice ( pos + 3, m_price );
+			assert ( pos < text + OrderTextCache::text_size );
 			// this is now the end of the string
-			m_formatted_string[ss.tellp()] = 0;
-			return m_formatted_string;
+			*pos = 0;
+			return text;
+		}
+
+		const char * Order::formatted() const
+		{
+			return OrderTextCache::instance().text ( *this );
+		}
+
+		void Order::print ( OutputBuffer & out )
+		{
+			out.append ( formatted() );
 		}
 
 		void Order::print ( std::ostream& os )
 		{
-			os << ( !m_formatted_string[0] ? format() : m_formatted_string ) ;
+			os << formatted();
 		}
 
 		/*
@@ -93,6 +105,83 @@ namespace JumpInterview {
 			order.print ( os );
 			return os;
 		}
+
+		OrderTextCache::OrderTextCache() :
+			m_entries ( 0 ),
+			m_mask ( 0 ),
+			m_misses ( 0 )
+		{
+			fit ( min_entries );
+		}
+
+		OrderTextCache::~OrderTextCache()
+		{
+			munmap ( m_entries, ( m_mask + 1 ) * sizeof ( Entry ) );
+		}
+
+		OrderTextCache & OrderTextCache::instance()
+		{
+			static thread_local OrderTextCache cache;
+			return cache;
+		}
+
+		size_t OrderTextCache::entries() const
+		{
+			return m_mask + 1;
+		}
+
+		size_t OrderTextCache::misses() const
+		{
+			return m_misses;
+		}
+
+		const char * OrderTextCache::text ( Order const & order )
+		{
+			// orders sit next to each other in their pool, so this is their slot number - or as good as
+			Entry & entry ( m_entries[ reinterpret_cast < uintptr_t > ( &order ) / sizeof ( Order ) & m_mask ] );
+			if ( entry.volume != order.m_volume || entry.price != order.m_price || entry.order_id != order.m_order_id || entry.side != order.m_side )
+			{
+				entry.order_id = order.m_order_id;
+				entry.volume = order.m_volume;
+				entry.price = order.m_price;
+				entry.side = order.m_side;
+				order.format ( entry.text );
+				m_misses++;
+			}
+			return entry.text;
+		}
+
+		void OrderTextCache::fitPool()
+		{
+			fit ( PoolAllocator<Order>::instance().capacity() );
+		}
+
+		/*
+		 * Grows to a power of two with room for this many slots. The entries are mapped, so they start out empty and
+		 * on a cache line of their own. Whatever we had is lost, but that's just formatting it again.
+		 */
+		void OrderTextCache::fit ( size_t slots )
+		{
+			slots = std::min < size_t > ( slots, max_entries );
+			size_t entries ( m_entries ? m_mask + 1 : 0 );
+			if ( slots <= entries )
+				return;
+			if ( !entries )
+				entries = 1;
+			while ( entries < slots )
+				entries *= 2;
+			void * mapped ( mmap ( 0, entries * sizeof ( Entry ), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 ) );
+			if ( mapped == MAP_FAILED )
+				throw std::bad_alloc();
+			if ( m_entries )
+				munmap ( m_entries, ( m_mask + 1 ) * sizeof ( Entry ) );
+			m_entries = static_cast < Entry * > ( mapped );
+			m_mask = entries - 1;
+		}
+
+		const size_t OrderTextCache::min_entries;
+		const size_t OrderTextCache::max_entries;
+		const size_t OrderTextCache::text_size;
 	}
 }
 
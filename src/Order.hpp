@@ -8,6 +8,7 @@
 #include <iostream>
 
 #include "PoolAllocator.hpp"
+#include "OutputBuffer.hpp"
 
 namespace JumpInterview {
 	namespace OrderBook {
@@ -22,22 +23,53 @@ namespace JumpInterview {
 		}
 
 		class Order;
+		class OrderTextCache;
 		typedef Order * Order_ptr;
+		template < class Policy >
+		class BasicOrderBook;
 
+		/*
+		 * Everything the book looks at while it's adding, matching and walking queues is 16 bytes: our id, volume,
+		 * price, and when we were queued with our side packed in with it. The links of our queue ( see OrderList )
+		 * make it 32, so two orders share a cache line. Keeping the links in an array of their own would get us down
+		 * to 16, but then every step along a queue touches two cache lines rather than one - 'make bench' has both
+		 * layouts, and that's the slower one. The text we print isn't in here at all - that's in the OrderTextCache,
+		 * and only for as long as we're being printed.
+		 */
 		class Order
 		{
 		public:
 			friend class OrderList;
+			friend class OrderTextCache;
 			Order ( uint32_t order_id,
 					OrderSide::Side side,
 					uint32_t volume,
 					uint32_t price );
 
-			friend class OrderBook;
+			template < class Policy >
+			friend class BasicOrderBook;
 			uint32_t orderId() const;
 			OrderSide::Side side() const;
 			uint32_t volume() const;
 			uint32_t price() const;
+			/*
+			 * When we were queued at our price level. When crossing, we use this to find out at what level that should happen.
+			 * We've only got 31 bits for it, so this wraps around at 2^31 rather than 2^32 - compare them with queuedBefore
+			 */
+			uint32_t sequenceId() const
+			{
+				return m_sequence_id;
+			}
+
+			/*
+			 * Whether sequence id a came before b, even if they wrapped around in between: as long as they're less than
+			 * 2^30 apart, a is before b if it takes less than half way round to get from a to b.
+			 */
+			static bool queuedBefore ( uint32_t a, uint32_t b )
+			{
+				// the difference in 31 bits, moved up to the top so its top bit is the sign
+				return static_cast < int32_t > ( ( a - b ) << 1 ) < 0;
+			}
 
 			static inline void* operator new ( std::size_t sz )
 			{
@@ -49,17 +81,71 @@ namespace JumpInterview {
 				PoolAllocator<Order>::instance().deallocate ( static_cast< Order * > ( p ), sizeof ( Order ) ) ;
 			}
 
+			void print ( OutputBuffer & out );
 			void print ( std::ostream& os );
 		private:
 			Order ( Order const & rhs ) {}
 			uint32_t m_order_id;
-			OrderSide::Side m_side;
 			uint32_t m_volume;
 			uint32_t m_price;
-			char m_formatted_string[ 40 ];
+			uint32_t m_sequence_id : 31;
+			uint32_t m_side : 1;
+			// our place in the queue at our price level, see OrderList. 0 when we're not queued
+			Order * m_prev;
+			Order * m_next;
 
 			void modify ( uint32_t volume, uint32_t price );
-			inline char * format();
+			const char * formatted() const;
+			char * format ( char * text ) const;
+		};
+
+		/*
+		 * The text of the orders we've printed, away from the orders themselves. Every order slot in the pool has an
+		 * entry here, found by its address: orders that are next to each other in the pool never push each other
+		 * out. An entry remembers what it was formatted from, so there's nothing to clear when an order is modified,
+		 * deleted or its slot reused - it simply doesn't match anymore, and gets formatted again the next time it's
+		 * printed. We grow along with the pool, up to max_entries; past that, orders share entries.
+		 */
+		class OrderTextCache
+		{
+		public:
+			static const size_t min_entries = 1024;
+			static const size_t max_entries = 1 << 18;
+			// "4294967295: Sell 4294967295 @ 4294967.3" is the longest there is, and an entry is one cache line
+			static const size_t text_size = 48;
+
+			/* Just like the pool, every thread has one of its own */
+			static OrderTextCache & instance();
+			~OrderTextCache();
+			/* This order as "id: Side volume @ price", formatted if we don't have it yet. Good until the next call */
+			const char * text ( Order const & order );
+			/*
+			 * Grows to an entry for every slot the pool has by now, up to max_entries. Once for every book we print
+			 * ( see BasicOrderBook::print ), rather than for every order in it.
+			 */
+			void fitPool();
+			size_t entries() const;
+			/* How many times we had to format an order */
+			size_t misses() const;
+		private:
+			struct Entry
+			{
+				uint32_t order_id;
+				// 0 for an entry we haven't used yet, no order has that
+				uint32_t volume;
+				uint32_t price;
+				uint32_t side;
+				char text[ text_size ];
+			};
+			static_assert ( sizeof ( Entry ) == 64, "an OrderTextCache entry should be one cache line" );
+
+			OrderTextCache();
+			OrderTextCache ( OrderTextCache const & rhs ) {}
+			void fit ( size_t slots );
+
+			Entry * m_entries;
+			size_t m_mask;
+			size_t m_misses;
 		};
 
 		std::ostream& operator<< ( std::ostream& os, Order& order );
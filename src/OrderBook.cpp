@@ -1,6 +1,7 @@
 #include <algorithm>
 #include <assert.h>
 #include <functional>
+#include <limits>
 
 #include "Constants.hpp"
 #include "OrderBook.hpp"
@@ -8,40 +9,56 @@
 namespace JumpInterview {
 	namespace OrderBook {
 
-		OrderBook::OrderBook ( ErrorSummary & error_summary ) :
+		template < class Policy >
+		BasicOrderBook < Policy >::BasicOrderBook ( ErrorSummary & error_summary ) :
 			m_error_summary ( error_summary ),
 			m_sequence_id ( 0 ),
 			m_mid_price ( std::numeric_limits<double>::max() ),
-			m_am_expecting_trades ( false )
+			m_top_of_book_sum ( 0 ),
+			m_am_expecting_trades ( false ),
+			m_level_listener ( 0 ),
+			m_fill_listener ( 0 )
 		{
-			m_add_functors[ OrderSide::BUY ] = std::bind ( &OrderBook::add<BuyPriceLevelMap>, this, std::ref ( m_buys ), std::placeholders::_1 );
-			m_add_functors[ OrderSide::SELL ] = std::bind ( &OrderBook::add<SellPriceLevelMap>, this, std::ref ( m_sells ), std::placeholders::_1 );
-			m_remove_functors [ OrderSide::BUY ] = std::bind ( &OrderBook::remove<BuyPriceLevelMap>, this, std::ref ( m_buys ), std::placeholders::_1, std::placeholders::_2 );
-			m_remove_functors [ OrderSide::SELL ] = std::bind ( &OrderBook::remove<SellPriceLevelMap>, this, std::ref ( m_sells ), std::placeholders::_1, std::placeholders::_2 );
-			m_modify_functors [ OrderSide::BUY ] = std::bind ( &OrderBook::modify<BuyPriceLevelMap>, this, std::ref ( m_buys ), std::placeholders::_1, std::placeholders::_2, std::placeholders::_3 );
-			m_modify_functors [ OrderSide::SELL ] = std::bind ( &OrderBook::modify<SellPriceLevelMap>, this, std::ref ( m_sells ), std::placeholders::_1, std::placeholders::_2, std::placeholders::_3 );
-			// Unlike the other functions, this is located in the map itself.
-			m_match_functors [ OrderSide::SELL ] = std::bind ( &BuyPriceLevelMap::matchTrades, std::ref ( m_buys ), std::placeholders::_1, std::placeholders::_2, std::placeholders::_3 );
-			m_match_functors [ OrderSide::BUY ] = std::bind ( &SellPriceLevelMap::matchTrades, std::ref ( m_sells ), std::placeholders::_1, std::placeholders::_2, std::placeholders::_3 );
 		}
 
 		/*
 		* The orderbook knows all about our orders, so should dealloc them here
 		*/
-		OrderBook::~OrderBook()
+		template < class Policy >
+		BasicOrderBook < Policy >::~BasicOrderBook()
 		{
 			m_buys.clear();
 			m_sells.clear();
-			clearExpectedTrades();
 		}
 
-		void OrderBook::clearExpectedTrades()
+		template < class Policy >
+		void BasicOrderBook < Policy >::reserve ( size_t orders )
 		{
-			for ( Trade_vct::const_iterator iter = m_expected_trades.begin();
-					iter != m_expected_trades.end();
-					iter++ )
-				delete ( *iter );
-			m_expected_trades.clear();
+			m_all_orders.reserve ( orders );
+		}
+
+		template < class Policy >
+		void BasicOrderBook < Policy >::abandonOrders()
+		{
+			// the levels still go one by one, but we don't step through the orders in them
+			for ( typename BuyPriceLevelMap::const_iterator iter = m_buys.begin(); iter != m_buys.end(); iter++ )
+			{
+				iter->second->discard();
+				if ( m_level_listener )
+					publish ( LevelAction::DELETE, OrderSide::BUY, iter->first, *iter->second );
+			}
+			for ( typename SellPriceLevelMap::const_iterator iter = m_sells.begin(); iter != m_sells.end(); iter++ )
+			{
+				iter->second->discard();
+				if ( m_level_listener )
+					publish ( LevelAction::DELETE, OrderSide::SELL, iter->first, *iter->second );
+			}
+			m_buys.clear();
+			m_sells.clear();
+			m_all_orders.clear();
+			m_expected_trades = ExpectedTrades();
+			m_am_expecting_trades = false;
+			calculateMidPrice();
 		}
 
 		/*
@@ -49,13 +66,16 @@ namespace JumpInterview {
 		* and add the order to it.
 		* Returns true if succesful, false if the order already exists
 		*/
-		bool OrderBook::add ( Order_ptr const & order )
+		template < class Policy >
+		bool BasicOrderBook < Policy >::add ( Order_ptr const & order )
 		{
 			assert ( order->price() > 0 );
-			OrderDict::iterator iter ( m_all_orders.find ( order->orderId() ) );
-			if ( iter == m_all_orders.end() )
+			if ( m_all_orders.insert ( order->orderId(), order ) )
 			{
-				m_all_orders.insert ( std::make_pair ( order->orderId(), m_add_functors [ order->side() ] ( order ) ) );
+				if ( order->side() == OrderSide::BUY )
+					add ( m_buys, order );
+				else
+					add ( m_sells, order );
 				return true;
 			}
 			else
@@ -65,40 +85,46 @@ namespace JumpInterview {
 			}
 		}
 
+		template < class Policy >
 		template <class T>
-		OrderNode_list::iterator OrderBook::add ( T & map, Order_ptr const & order )
+		void BasicOrderBook < Policy >::add ( T & map, Order_ptr const & order )
 		{
-			OrderList_ptr & list ( map.add ( order->price() ) );
-			OrderNode_list::iterator return_iter = list->add ( order, m_sequence_id++ );
+			typename T::Queue_ptr & list ( map.add ( order->price() ) );
+			list->add ( order, m_sequence_id++ );
+			map.adjustTotals ( order->volume(), 1 );
+			if ( m_level_listener )
+				publish ( list->size() == 1 ? LevelAction::NEW : LevelAction::UPDATE, order->side(), order->price(), *list );
 			// if we are the top level, and there's just our new price in it, surely the mid price has changed ( if there's something on the other side .. )
 			if ( map.begin()->second == list && list->size() == 1 )
 			{
 				calculateMidPrice();
-				m_expected_trades.clear();
+				m_expected_trades = ExpectedTrades();
 				m_am_expecting_trades = isCrossed();
 			}
-			assert ( ( *return_iter )->order() == order );
-			return return_iter;
 		}
 
 		/*
 		* Removes the order from the map and list.
 		* Is still up to the calling function to dispose
 		*/
-		Order_ptr OrderBook::remove ( uint32_t order_id,
+		template < class Policy >
+		Order_ptr BasicOrderBook < Policy >::remove ( uint32_t order_id,
 									  OrderSide::Side side,
 									  uint32_t volume,
 									  uint32_t price )
 		{
-			OrderDict::iterator iter ( m_all_orders.find ( order_id ) );
+			Order_ptr const * found ( m_all_orders.find ( order_id ) );
 			// don't check the volume - that might have changed without the user realising it
-			if ( iter != m_all_orders.end() &&
-					( *iter->second )->order()->side() == side &&
-					( *iter->second )->order()->price() == price )
+			if ( found &&
+					( *found )->side() == side &&
+					( *found )->price() == price )
 			{
-				Order_ptr order ( ( *iter->second )->order() );
-				m_remove_functors [ order->side() ] ( iter->second, price );
-				m_all_orders.erase ( iter );
+				Order_ptr order ( *found );
+				if ( order->side() == OrderSide::BUY )
+					remove ( m_buys, order );
+				else
+					remove ( m_sells, order );
+				m_all_orders.erase ( order_id );
 				return order;
 			}
 			else
@@ -106,15 +132,23 @@ namespace JumpInterview {
 			return 0;
 		}
 
+		template < class Policy >
 		template <class T>
-		void OrderBook::remove ( T & map,
-								 OrderNode_list::iterator & order_iter,
-								 uint32_t price )
+		void BasicOrderBook < Policy >::remove ( T & map,
+								 Order_ptr const & order )
 		{
 			assert ( !map.empty() );
-			OrderList_ptr price_level ( map.add ( price ) );
+			uint32_t price ( order->price() );
+			// gone once we remove the level, we don't look at it after that
+			typename T::Queue_ptr const & price_level ( map.add ( price ) );
 			bool was_top_level ( map.begin()->second == price_level );
-			price_level->remove ( order_iter );
+			// if it's the next one we expect to trade with, the one after it is now
+			if ( order == m_expected_trades.next )
+				m_expected_trades.next = order->m_next;
+			price_level->remove ( order );
+			map.adjustTotals ( - static_cast < int64_t > ( order->volume() ), -1 );
+			if ( m_level_listener )
+				publish ( price_level->empty() ? LevelAction::DELETE : LevelAction::UPDATE, order->side(), price, *price_level );
 			if ( price_level->empty() )
 			{
 				map.remove ( price );
@@ -131,19 +165,23 @@ namespace JumpInterview {
 		* ( Unexpected ) -> A new order gets created because we don't know about the original order
 		* ( Unexpected ) -> If the side doesn't match, we just note this
 		*/
-		void OrderBook::modify ( uint32_t order_id,
+		template < class Policy >
+		void BasicOrderBook < Policy >::modify ( uint32_t order_id,
 								 OrderSide::Side side,
 								 uint32_t volume,
 								 uint32_t price )
 		{
-			OrderDict::iterator iter ( m_all_orders.find ( order_id ) );
-			if ( iter != m_all_orders.end() )
+			Order_ptr const * found ( m_all_orders.find ( order_id ) );
+			if ( found )
 			{
-				Order_ptr const & order ( ( *iter->second )->order() );
-				if ( order->side() == side )
-					iter->second = m_modify_functors [ side ] ( iter->second, volume, price );
-				else
+				// a copy, the slot it's in is only good until the index changes
+				Order_ptr order ( *found );
+				if ( order->side() != side )
 					m_error_summary.order_modify_on_wrong_side ++;
+				else if ( side == OrderSide::BUY )
+					modify ( m_buys, order, volume, price );
+				else
+					modify ( m_sells, order, volume, price );
 			}
 			else
 			{
@@ -158,31 +196,35 @@ namespace JumpInterview {
 			}
 		}
 
+		template < class Policy >
 		template <class T>
-		OrderNode_list::iterator OrderBook::modify ( T & map,
-				OrderNode_list::iterator & order_iter,
+		void BasicOrderBook < Policy >::modify ( T & map,
+				Order_ptr const & order,
 				uint32_t volume,
 				uint32_t price )
 		{
-			Order_ptr order ( ( *order_iter )->order() );
 			if ( order->volume() < volume ||
 					order->price() != price )
 			{
-				remove ( map, order_iter, order->price() ); 	/* remove at the old level */
+				remove ( map, order ); 			/* remove at the old level */
 				order->modify ( volume, price ); 		/* modify the contents */
-				return add ( map, order ); 			/* and add at new level */
+				add ( map, order ); 			/* and add at the back of the new level */
 			}
 			else
 			{
 				// volume goes down ( either execution or user change ) - keep priority
-				order->modify ( volume, price );
-				return order_iter;
+				map.adjustTotals ( static_cast < int64_t > ( volume ) - order->volume(), 0 );
+				typename T::Queue_ptr const & level ( map.add ( price ) );
+				level->reduce ( order, volume );
+				if ( m_level_listener )
+					publish ( LevelAction::UPDATE, order->side(), price, *level );
 			}
 		}
 
-		void OrderBook::handleTrade ( uint32_t volume,
+		template < class Policy >
+		void BasicOrderBook < Policy >::handleTrade ( uint32_t volume,
 									  uint32_t price,
-									  std::ostream &os )
+									  OutputBuffer & out )
 		{
 			// Even if the trade's unexpected, we print this ..
 			static const char at ( '@' );
@@ -190,19 +232,29 @@ namespace JumpInterview {
 				m_trade_summary.last_volume++;
 			else
 				m_trade_summary.reset ( price, volume ) ;
-			os << m_trade_summary.last_volume << at << ( m_trade_summary.last_level / Constants::round_size ) << std::endl;
-			// at the first trade that arrives since we crossed, we calculate our vector of expected trades.
-			// we will now match every trade with the top of this vector.
+			out.appendUInt ( m_trade_summary.last_volume );
+			out.append ( at );
+			out.appendPrice ( m_trade_summary.last_level );
+			out.endLine();
+			// at the first trade that arrives since we crossed, we start walking the orders we expect to trade with.
+			// we will now match every trade with the next one of those.
 			if ( isCrossed() )
 			{
-				if ( m_expected_trades.empty() )
+				uint32_t expected_volume, expected_price;
+				if ( !nextExpectedTrade ( expected_volume, expected_price ) )
 				{
 					if ( m_am_expecting_trades )
 					{
-						// make sure we only fill this vector once for every time we reach a new top price level that crosses
-						calculateExpectedTrades();
+						// make sure we only start once for every time we reach a new top price level that crosses
+						startExpectedTrades();
 						m_am_expecting_trades = false;
-						assert ( !m_expected_trades.empty() );
+						bool expecting ( nextExpectedTrade ( expected_volume, expected_price ) );
+						assert ( expecting );
+						if ( !expecting )
+						{
+							m_error_summary.trades_with_no_corresponding_order++;
+							return;
+						}
 					}
 					else
 					{
@@ -211,14 +263,12 @@ namespace JumpInterview {
 						return;
 					}
 				}
-				assert ( !m_expected_trades.empty() );
-				Trade_ptr first_expected ( *m_expected_trades.begin() );
-				if ( first_expected->price() == price &&
-						first_expected->volume() == volume )
+				if ( expected_price == price &&
+						expected_volume == volume )
 				{
 					// great stuff, this one matches!
-					delete ( first_expected );
-					m_expected_trades.erase ( m_expected_trades.begin() );
+					m_expected_trades.volume_to_go -= volume;
+					m_expected_trades.next = m_expected_trades.next->m_next;
 				}
 				else
 					m_error_summary.trades_with_no_corresponding_order++;
@@ -227,7 +277,79 @@ namespace JumpInterview {
 				m_error_summary.trades_with_no_corresponding_order++;
 		}
 
-		double const & OrderBook::midPrice() const
+		template < class Policy >
+		uint32_t BasicOrderBook < Policy >::execute ( uint32_t order_id,
+				OrderSide::Side side,
+				uint32_t volume,
+				uint32_t price,
+				OrderType::Type type )
+		{
+			if ( m_all_orders.find ( order_id ) )
+			{
+				m_error_summary.duplicate_order_id++;
+				return 0;
+			}
+			bool any_price ( type == OrderType::MARKET );
+			uint32_t filled ( side == OrderSide::BUY ?
+							  match ( m_sells, order_id, side, volume, price, any_price ) :
+							  match ( m_buys, order_id, side, volume, price, any_price ) );
+			// only a limit order stays around with what's left of it. It can't cross anymore, we've taken all there was
+			if ( type == OrderType::LIMIT && filled < volume )
+				add ( new Order ( order_id, side, volume - filled, price ) );
+			return filled;
+		}
+
+		/*
+		 * The front of the best level is always next in line, so we never look further than that: every order we look
+		 * at either trades in full and goes, or takes what's left of the incoming order.
+		 */
+		template < class Policy >
+		template <class T>
+		uint32_t BasicOrderBook < Policy >::match ( T & map,
+				uint32_t order_id,
+				OrderSide::Side side,
+				uint32_t volume,
+				uint32_t price,
+				bool any_price )
+		{
+			static typename T::Compare better;
+			Fill fill;
+			fill.aggressor_id = order_id;
+			fill.aggressor_side = side;
+			uint32_t filled ( 0 );
+			while ( filled < volume && !map.empty() )
+			{
+				Order_ptr resting ( map.begin()->second->front() );
+				// the best we've got is worse than the price we're willing to pay
+				if ( !any_price && better ( price, resting->price() ) )
+					break;
+				fill.resting_id = resting->orderId();
+				fill.price = resting->price();
+				fill.volume = std::min ( volume - filled, resting->volume() );
+				fill.resting_volume_left = resting->volume() - fill.volume;
+				filled += fill.volume;
+				if ( fill.resting_volume_left )
+					modify ( map, resting, fill.resting_volume_left, fill.price );
+				else
+				{
+					remove ( map, resting );
+					m_all_orders.erase ( fill.resting_id );
+					delete resting;
+				}
+				if ( m_fill_listener )
+					m_fill_listener->filled ( fill );
+			}
+			return filled;
+		}
+
+		template < class Policy >
+		void BasicOrderBook < Policy >::setFillListener ( FillListener * listener )
+		{
+			m_fill_listener = listener;
+		}
+
+		template < class Policy >
+		double const & BasicOrderBook < Policy >::midPrice() const
 		{
 			return m_mid_price;
 		}
@@ -237,53 +359,327 @@ namespace JumpInterview {
 		* expected trade price as the mid price. Or, see what the new mid price would be after we actually trade. Those are not a real reflection of
 		* what we see here though, so I decided to just use the average anyway.
 		*/
-		void OrderBook::calculateMidPrice()
+		template < class Policy >
+		uint64_t BasicOrderBook < Policy >::topOfBookSum() const
+		{
+			return m_top_of_book_sum;
+		}
+
+		/*
+		 * We keep the sum of both prices in ticks around as well, that's what we print - without any rounding.
+		 */
+		template < class Policy >
+		void BasicOrderBook < Policy >::calculateMidPrice()
 		{
-			m_mid_price = ( m_buys.empty() || m_sells.empty() ) ?
+			m_top_of_book_sum = ( m_buys.empty() || m_sells.empty() ) ?
+								0 :
+								static_cast < uint64_t > ( m_buys.begin()->first ) + m_sells.begin()->first;
+			m_mid_price = !m_top_of_book_sum ?
 						  std::numeric_limits<double>::max() :
-						  ( m_buys.begin()->first + m_sells.begin()->first ) / ( Constants::round_size * 2.0 ) ;
+						  m_top_of_book_sum / ( Constants::round_size * 2.0 ) ;
 		}
 
 		/*
-		* Will be called whenever we add a new pricelevel, because that's exactly when we expect to trade potentially.
+		* Called at the first trade after we've crossed. We find out which order crossed last: that one trades against
+		* the orders on the other side, top of the book first, for as long as their levels are better than its price.
 		*/
-		void OrderBook::calculateExpectedTrades()
+		template < class Policy >
+		void BasicOrderBook < Policy >::startExpectedTrades()
 		{
 			assert ( m_am_expecting_trades );
+			m_expected_trades = ExpectedTrades();
 			if ( isCrossed() )
 			{
-				clearExpectedTrades();
-				OrderNode_ptr buy_node ( *m_buys.begin()->second->begin() );
-				OrderNode_ptr sell_node ( *m_sells.begin()->second->begin() );
-				Order_ptr const & most_recent_order ( buy_node->sequence_id() > sell_node->sequence_id() ?
-													  buy_node->order() :
-													  sell_node->order() );
-				// now that we know the most recent order, find out which orders get matched against this on the other side
-				unsigned int volume_to_go ( most_recent_order->volume() );
-				m_match_functors [ most_recent_order->side() ] ( m_expected_trades, most_recent_order->price(), volume_to_go );
+				Order_ptr buy_order ( m_buys.begin()->second->front() );
+				Order_ptr sell_order ( m_sells.begin()->second->front() );
+				Order_ptr most_recent_order ( Order::queuedBefore ( sell_order->sequenceId(), buy_order->sequenceId() ) ?
+											 buy_order :
+											 sell_order );
+				ExpectedTrades & expected ( m_expected_trades );
+				expected.active = true;
+				// and we walk the other side
+				expected.side = most_recent_order->side() == OrderSide::BUY ? OrderSide::SELL : OrderSide::BUY;
+				expected.limit = most_recent_order->price();
+				expected.volume_to_go = most_recent_order->volume();
+				expected.next = most_recent_order == buy_order ? sell_order : buy_order;
+				expected.level_price = expected.next->price();
+				// an Order only keeps 31 bits of it, so this wraps around every 2^31 adds. Order::queuedBefore copes with
+				// that, but only for orders that were queued less than 2^30 adds apart: one that's been resting while
+				// more than a billion others were added in the same session looks like it came in after we crossed,
+				// and isn't expected to trade
+				expected.sequence_bound = m_sequence_id & 0x7FFFFFFF;
+			}
+		}
+
+		/* The next trade we expect, if there is one. Doesn't move past it, that's up to whoever sees it come in */
+		template < class Policy >
+		bool BasicOrderBook < Policy >::nextExpectedTrade ( uint32_t & volume, uint32_t & price ) const
+		{
+			if ( !( m_expected_trades.side == OrderSide::BUY ? settleExpectedTrades ( m_buys ) : settleExpectedTrades ( m_sells ) ) )
+				return false;
+			Order_ptr order ( m_expected_trades.next );
+			volume = std::min ( m_expected_trades.volume_to_go, order->volume() );
+			price = order->price();
+			return true;
+		}
+
+		/*
+		 * Makes sure the next order we expect to trade with is one that was there when we started, moving on to the
+		 * next level if we have to. Orders in a level are queued in the order they came in, so once we see one that's
+		 * too new, the rest of the level is as well.
+		 */
+		template < class Policy >
+		template <class T>
+		bool BasicOrderBook < Policy >::settleExpectedTrades ( T const & map ) const
+		{
+			static typename T::Compare better;
+			ExpectedTrades & expected ( m_expected_trades );
+			while ( expected.active && expected.volume_to_go > 0 )
+			{
+				if ( expected.next && Order::queuedBefore ( expected.next->sequenceId(), expected.sequence_bound ) )
+				{
+					if ( !better ( expected.level_price, expected.limit ) )
+						break;
+					return true;
+				}
+				typename T::const_iterator level ( map.after ( expected.level_price ) );
+				if ( level == map.end() || !better ( level->first, expected.limit ) )
+					break;
+				expected.level_price = level->first;
+				expected.next = level->second->front();
 			}
+			expected.active = false;
+			return false;
 		}
 
-		bool OrderBook::isCrossed() const
+		template < class Policy >
+		bool BasicOrderBook < Policy >::contains ( uint32_t order_id ) const
+		{
+			return m_all_orders.find ( order_id ) != 0;
+		}
+
+		template < class Policy >
+		bool BasicOrderBook < Policy >::isCrossed() const
 		{
 			return ( !m_buys.empty() &&
 					 !m_sells.empty() &&
-					 ( *m_buys.begin()->second->begin() )->order()->price() >= ( *m_sells.begin()->second->begin() )->order()->price() );
+					 m_buys.begin()->second->front()->price() >= m_sells.begin()->second->front()->price() );
+		}
+
+		template < class Policy >
+		bool BasicOrderBook < Policy >::waitingForTrades() const
+		{
+			uint32_t volume, price;
+			return m_am_expecting_trades || nextExpectedTrade ( volume, price );
+		}
+
+		template < class Policy >
+		size_t BasicOrderBook < Policy >::getDepth ( OrderSide::Side side, DepthLevel * levels, size_t n ) const
+		{
+			return side == OrderSide::BUY ? getDepth ( m_buys, levels, n ) : getDepth ( m_sells, levels, n );
+		}
+
+		template < class Policy >
+		template <class T>
+		size_t BasicOrderBook < Policy >::getDepth ( T const & map, DepthLevel * levels, size_t n )
+		{
+			size_t count ( 0 );
+			for ( typename T::const_iterator iter = map.begin(); iter != map.end() && count < n; iter++, count++ )
+			{
+				levels[ count ].price = iter->first;
+				levels[ count ].orders = static_cast < uint32_t > ( iter->second->size() );
+				levels[ count ].volume = iter->second->volume();
+			}
+			return count;
+		}
+
+		template < class Policy >
+		void BasicOrderBook < Policy >::setLevelListener ( LevelListener * listener )
+		{
+			m_level_listener = listener;
+		}
+
+		template < class Policy >
+		template <class T>
+		void BasicOrderBook < Policy >::publish ( LevelAction::Action action, OrderSide::Side side, uint32_t price, T const & level )
+		{
+			LevelDelta delta;
+			delta.action = action;
+			delta.side = side;
+			delta.level.price = price;
+			delta.level.orders = static_cast < uint32_t > ( level.size() );
+			delta.level.volume = level.volume();
+			m_level_listener->levelChanged ( delta );
+		}
+
+		/*
+		 * After the FeedHandler's part of the snapshot, a book is:
+		 *
+		 *   size         field
+		 *   4            sequence id        the next one we hand out
+		 *   4, 4         trade summary      the last price we traded at, and how many trades there were
+		 *   1            expecting trades   we crossed, but haven't had a trade since
+		 *   1, 1         expected trades    whether we're walking the other side, and which side that is
+		 *   4 x 4                           limit, volume to go, level price and sequence bound
+		 *   1, 4                            whether there's an order we expect to trade with next, and its id
+		 *   8            orders             in the whole book, so we can make room for all of them in one go
+		 *   and the buys, then the sells:
+		 *   4, 8         levels, orders
+		 *   and for every level, top of the book first:
+		 *   4, 4         price, orders
+		 *   and for every order in it, front of the queue first:
+		 *   4, 4, 4      order id, volume, sequence id
+		 */
+		template < class Policy >
+		void BasicOrderBook < Policy >::save ( SnapshotWriter & out ) const
+		{
+			ExpectedTrades const & expected ( m_expected_trades );
+			out.write32 ( m_sequence_id );
+			out.write32 ( m_trade_summary.last_level );
+			out.write32 ( m_trade_summary.last_volume );
+			out.write8 ( m_am_expecting_trades );
+			out.write8 ( expected.active );
+			out.write8 ( expected.side );
+			out.write32 ( expected.limit );
+			out.write32 ( expected.volume_to_go );
+			out.write32 ( expected.level_price );
+			out.write32 ( expected.sequence_bound );
+			out.write8 ( expected.next != 0 );
+			out.write32 ( expected.next ? expected.next->orderId() : 0 );
+			out.write64 ( m_buys.orders() + m_sells.orders() );
+			saveLevels ( m_buys, out );
+			saveLevels ( m_sells, out );
 		}
 
-		bool OrderBook::waitingForTrades() const
+		template < class Policy >
+		template <class T>
+		void BasicOrderBook < Policy >::saveLevels ( T const & map, SnapshotWriter & out )
+		{
+			out.write32 ( static_cast < uint32_t > ( map.size() ) );
+			out.write64 ( map.orders() );
+			for ( typename T::const_iterator level = map.begin(); level != map.end(); level++ )
+			{
+				out.write32 ( level->first );
+				out.write32 ( static_cast < uint32_t > ( level->second->size() ) );
+				for ( OrderList::iterator iter = level->second->begin(); iter != level->second->end(); iter++ )
+				{
+					out.write32 ( ( *iter )->orderId() );
+					out.write32 ( ( *iter )->volume() );
+					out.write32 ( ( *iter )->sequenceId() );
+				}
+			}
+		}
+
+		template < class Policy >
+		bool BasicOrderBook < Policy >::load ( SnapshotReader & in )
+		{
+			assert ( m_all_orders.empty() );
+			m_sequence_id = in.read32();
+			uint32_t last_level ( in.read32() );
+			m_trade_summary.reset ( last_level, in.read32() );
+			m_am_expecting_trades = in.read8();
+			ExpectedTrades expected;
+			expected.active = in.read8();
+			uint8_t side ( in.read8() );
+			expected.side = side ? OrderSide::SELL : OrderSide::BUY;
+			expected.limit = in.read32();
+			expected.volume_to_go = in.read32();
+			expected.level_price = in.read32();
+			expected.sequence_bound = in.read32();
+			bool has_next ( in.read8() );
+			uint32_t next_id ( in.read32() );
+			uint64_t orders ( in.read64() );
+			// every order takes 12 bytes, we don't go making room for more than there can be in what's left
+			bool loaded ( in.good() && side <= OrderSide::SELL && orders <= in.remaining() / 12 );
+			if ( loaded )
+			{
+				// everything we need for them, in one go ( and we pay for their pages now, not one order at a time )
+				m_all_orders.reserve ( orders );
+				PoolAllocator<Order>::instance().reserve ( orders );
+				loaded = loadLevels ( m_buys, OrderSide::BUY, in ) && loadLevels ( m_sells, OrderSide::SELL, in ) && m_all_orders.size() == orders;
+			}
+			if ( loaded && has_next )
+			{
+				Order_ptr const * next ( m_all_orders.find ( next_id ) );
+				loaded = next && ( *next )->side() == expected.side;
+				if ( loaded )
+					expected.next = *next;
+			}
+			if ( !loaded )
+			{
+				// the orders we did get go with their levels
+				m_buys.clear();
+				m_sells.clear();
+				m_all_orders.clear();
+				expected = ExpectedTrades();
+				m_am_expecting_trades = false;
+				in.fail();
+			}
+			m_expected_trades = expected;
+			calculateMidPrice();
+			return loaded;
+		}
+
+		/* The pool and the index have room for every order by now, and a level's totals are only adjusted once it's complete */
+		template < class Policy >
+		template <class T>
+		bool BasicOrderBook < Policy >::loadLevels ( T & map, OrderSide::Side side, SnapshotReader & in )
 		{
-			return m_am_expecting_trades || !m_expected_trades.empty();
+			static typename T::Compare better;
+			uint32_t levels ( in.read32() );
+			uint64_t orders ( in.read64() );
+			if ( !in.good() )
+				return false;
+			uint64_t loaded ( 0 );
+			uint32_t previous ( 0 );
+			for ( uint32_t i = 0; i < levels; i++ )
+			{
+				uint32_t price ( in.read32() );
+				uint32_t count ( in.read32() );
+				// top of the book first, and there's no such thing as an empty level
+				if ( !in.good() || !price || !count || ( i && !better ( previous, price ) ) || loaded + count > orders )
+					return false;
+				typename T::Queue_ptr & list ( map.add ( price ) );
+				uint64_t volume ( 0 );
+				for ( uint32_t j = 0; j < count; j++ )
+				{
+					uint32_t order_id ( in.read32() );
+					uint32_t order_volume ( in.read32() );
+					uint32_t sequence_id ( in.read32() );
+					if ( !in.good() || !order_volume || sequence_id > 0x7FFFFFFF )
+						return false;
+					Order_ptr order ( new Order ( order_id, side, order_volume, price ) );
+					if ( !m_all_orders.insert ( order_id, order ) )
+					{
+						delete order;
+						return false;
+					}
+					list->add ( order, sequence_id );
+					volume += order_volume;
+				}
+				map.adjustTotals ( volume, count );
+				loaded += count;
+				previous = price;
+			}
+			return loaded == orders;
 		}
 
-		void OrderBook::print ( std::ostream &os ) const
+		template < class Policy >
+		void BasicOrderBook < Policy >::print ( OutputBuffer & out ) const
 		{
 			static const char * buys ( "Buys:" );
 			static const char * sells ( "Sells:" );
-			os << buys << std::endl;
-			m_buys.print ( os );
-			os << sells << std::endl;
-			m_sells.print ( os );
+			OrderTextCache::instance().fitPool();
+			out.append ( buys );
+			out.endLine();
+			m_buys.print ( out );
+			out.append ( sells );
+			out.endLine();
+			m_sells.print ( out );
 		}
+
+		template class BasicOrderBook < BookPolicy < PriceLevelMap > >;
+		template class BasicOrderBook < BookPolicy < PriceLadder > >;
+		template class BasicOrderBook < BookPolicy < PriceLevelMap, OrderList, StdIndex < Order_ptr > > >;
 	}
-}
+}
\ No newline at end of file
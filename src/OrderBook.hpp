@@ -2,12 +2,16 @@
 #define __ORDER_BOOK_HPP__
 
 #include <map>
-#include <unordered_map>
 #include <functional>
 
+#include "Fill.hpp"
+#include "FlatIndex.hpp"
+#include "LevelDelta.hpp"
 #include "Order.hpp"
+#include "PriceLadder.hpp"
 #include "PriceLevelMap.hpp"
-#include "Trade.hpp"
+#include "Snapshot.hpp"
+#include "StdIndex.hpp"
 #include "OrderList.hpp"
 #include "ErrorSummary.hpp"
 
@@ -26,14 +30,65 @@ namespace JumpInterview {
 			uint32_t last_volume;
 		};
 
-		class OrderBook
+		/*
+		 * The trades we expect since we crossed, worked out one at a time as they come in: a cursor into the resting
+		 * orders on the other side, from the top of the book down. Only orders that were already there when the
+		 * first trade came in count, and only for as long as their level still crosses.
+		 */
+		struct ExpectedTrades
+		{
+			ExpectedTrades() : active ( false ), side ( OrderSide::BUY ), limit ( 0 ), volume_to_go ( 0 ), level_price ( 0 ), next ( 0 ), sequence_bound ( 0 ) {}
+			bool active;
+			// the side of the resting orders we walk
+			OrderSide::Side side;
+			// the price of the order that crossed, and how much of its volume we haven't seen trade yet
+			uint32_t limit;
+			uint32_t volume_to_go;
+			// the level we're in, and the order we expect to trade next. 0 once we've had every order in this level
+			uint32_t level_price;
+			Order_ptr next;
+			// orders queued from this sequence id on came in after we started
+			uint32_t sequence_bound;
+		};
+
+		/*
+		 * What a BasicOrderBook is made of. The price levels on either side are kept in a Levels: a PriceLevelMap or a
+		 * PriceLadder, ordered by the side's comparator so the top of the book comes first. Every level is a Queue of
+		 * orders, and the Index finds an order by its id ( a FlatIndex, or a StdIndex ).
+		 */
+		template < template < class, class > class Levels,
+				 class Queue = OrderList,
+				 class OrderIndex = FlatIndex < Order_ptr >,
+				 class BuyCompare = std::greater<uint32_t>,
+				 class SellCompare = std::less<uint32_t> >
+		struct BookPolicy
+		{
+			typedef Levels < BuyCompare, Queue > BuyLevels;
+			typedef Levels < SellCompare, Queue > SellLevels;
+			typedef OrderIndex Index;
+		};
+
+		/*
+		 * Everything the book does to one side is resolved when it's compiled: we branch on the side once, and from
+		 * there on every call goes straight to that side's levels, so it can all be inlined.
+		 */
+		template < class Policy >
+		class BasicOrderBook
 		{
 		public:
-			typedef PriceLevelMap < std::greater<uint32_t> > BuyPriceLevelMap;
-			typedef PriceLevelMap < std::less<uint32_t> > SellPriceLevelMap;
+			typedef typename Policy::BuyLevels BuyPriceLevelMap;
+			typedef typename Policy::SellLevels SellPriceLevelMap;
 
-			OrderBook ( ErrorSummary & error_summary );
-			~OrderBook();
+			BasicOrderBook ( ErrorSummary & error_summary );
+			~BasicOrderBook();
+
+			/* Makes room for this many live orders up front, so the order index doesn't have to grow on the way */
+			void reserve ( size_t orders );
+			/*
+			 * Empties the book without deleting a single order: they're only given back by PoolAllocator<Order>::reset(),
+			 * all of them at once ( see FeedHandler::resetSession ).
+			 */
+			void abandonOrders();
 
 			bool add ( Order_ptr const & order ) ;
 			Order_ptr remove ( uint32_t order_id,
@@ -47,13 +102,50 @@ namespace JumpInterview {
 
 			void handleTrade ( uint32_t volume,
 							   uint32_t price,
-							   std::ostream &os ) ;
+							   OutputBuffer & out ) ;
+
+			/*
+			 * Matches an incoming order ourselves, rather than waiting for the feed to tell us what traded: against the
+			 * other side's best level first, and within a level in the order they were queued. Every fill goes to the
+			 * fill listener. A resting order that's filled in full leaves the book and is deleted, one that isn't keeps
+			 * its place with what's left. What happens to what's left of the incoming order is up to its type. Nothing
+			 * is allocated, unless what's left of a LIMIT order rests. Returns how much of it was filled.
+			 */
+			uint32_t execute ( uint32_t order_id,
+							   OrderSide::Side side,
+							   uint32_t volume,
+							   uint32_t price,
+							   OrderType::Type type = OrderType::LIMIT );
+			/* Tells the listener about every fill execute() makes from now on. 0 to stop */
+			void setFillListener ( FillListener * listener );
 
 			double const & midPrice() const;
-			void print ( std::ostream &os ) const;
+			/* The top buy and sell price added together, in ticks - or 0 if we don't have a mid price */
+			uint64_t topOfBookSum() const;
+			void print ( OutputBuffer & out ) const;
+			bool contains ( uint32_t order_id ) const;
 			bool isCrossed() const;
 			bool waitingForTrades() const;
 
+			/*
+			 * The top n levels on this side, best first, as their price, number of orders and volume. Written into the
+			 * caller's levels, nothing is allocated. Returns how many levels there were, up to n.
+			 */
+			size_t getDepth ( OrderSide::Side side, DepthLevel * levels, size_t n ) const;
+			/* Tells the listener about every level that comes, changes or goes from now on. 0 to stop */
+			void setLevelListener ( LevelListener * listener );
+
+			/*
+			 * Everything we know as part of a snapshot ( see Snapshot.hpp ): every order in queue order, and where we
+			 * are with the trades we expect. The listeners don't come into it.
+			 */
+			void save ( SnapshotWriter & out ) const;
+			/*
+			 * Builds the book from a snapshot in one go, a level at a time, rather than adding every order the way
+			 * the feed does. Only into an empty book. False if it doesn't make sense, and the book is empty again then.
+			 */
+			bool load ( SnapshotReader & in );
+
 			BuyPriceLevelMap const & buys() const
 			{
 				return m_buys;
@@ -64,53 +156,77 @@ namespace JumpInterview {
 				return m_sells;
 			}
 		private:
-			typedef std::unordered_map < uint32_t, OrderNode_list::iterator > OrderDict;
+			// every order we have, by id. The orders themselves know where they are in their level's queue
+			typedef typename Policy::Index OrderDict;
 
 			ErrorSummary & m_error_summary;
 			uint32_t m_sequence_id;
 			double m_mid_price;
+			uint64_t m_top_of_book_sum;
 			BuyPriceLevelMap m_buys;
 			SellPriceLevelMap m_sells;
 			OrderDict m_all_orders;
 			TradeSummary m_trade_summary;
-			Trade_vct m_expected_trades;
+			// moves on by itself when we look at it, even if we're const
+			mutable ExpectedTrades m_expected_trades;
 			bool m_am_expecting_trades;
-
-			/*
-			 * When we need to operate on an (Buy/Sell)OrderMap, we just use these bound functions.
-			 * They are indexed by order type, and we don't have to supply the map or comparison operator anymore.
-			 */
-			typedef std::function<OrderNode_list::iterator ( Order_ptr const & ) > Add_functor;
-			typedef std::function<void ( OrderNode_list::iterator &, uint32_t ) > Remove_functor;
-			typedef std::function<OrderNode_list::iterator ( OrderNode_list::iterator &, uint32_t, uint32_t ) > Modify_functor;
-			typedef std::function<void ( Trade_vct & vct, uint32_t, uint32_t & ) > Match_functor;
-			Add_functor m_add_functors[2];
-			Remove_functor m_remove_functors[2];
-			Modify_functor m_modify_functors[2];
-			Match_functor m_match_functors[2];
+			LevelListener * m_level_listener;
+			FillListener * m_fill_listener;
 
 			void calculateMidPrice();
-			void calculateExpectedTrades();
-			void clearExpectedTrades();
+			void startExpectedTrades();
+			bool nextExpectedTrade ( uint32_t & volume, uint32_t & price ) const;
+
+			template <class T>
+			bool settleExpectedTrades ( T const & map ) const;
+
+			template <class T>
+			uint32_t match ( T & map,
+							 uint32_t order_id,
+							 OrderSide::Side side,
+							 uint32_t volume,
+							 uint32_t price,
+							 bool any_price );
+
+			template <class T>
+			static void saveLevels ( T const & map, SnapshotWriter & out );
 
 			template <class T>
-			OrderNode_list::iterator add ( T & map,
-										   Order_ptr const & order );
+			bool loadLevels ( T & map, OrderSide::Side side, SnapshotReader & in );
+
+			template <class T>
+			static size_t getDepth ( T const & map, DepthLevel * levels, size_t n );
+
+			template <class T>
+			void publish ( LevelAction::Action action, OrderSide::Side side, uint32_t price, T const & level );
+
+			template <class T>
+			void add ( T & map,
+					   Order_ptr const & order );
 
 			template <class T>
 			void remove ( T & map,
-						  OrderNode_list::iterator & order_iter,
-						  uint32_t price );
+						  Order_ptr const & order );
 
 			template <class T>
-			OrderNode_list::iterator modify ( T & map,
-											  OrderNode_list::iterator & order,
-											  uint32_t volume,
-											  uint32_t price );
+			void modify ( T & map,
+						  Order_ptr const & order,
+						  uint32_t volume,
+						  uint32_t price );
 		};
 
+		typedef BasicOrderBook < BookPolicy < PriceLevelMap > > OrderBook;
+		/* The same book, with its levels on a PriceLadder */
+		typedef BasicOrderBook < BookPolicy < PriceLadder > > LadderOrderBook;
+		/* Levels and order index on std containers, like the book used to have */
+		typedef BasicOrderBook < BookPolicy < PriceLevelMap, OrderList, StdIndex < Order_ptr > > > StdOrderBook;
 		typedef OrderBook * OrderBook_ptr;
 
+		// all of them are compiled once, in OrderBook.cpp
+		extern template class BasicOrderBook < BookPolicy < PriceLevelMap > >;
+		extern template class BasicOrderBook < BookPolicy < PriceLadder > >;
+		extern template class BasicOrderBook < BookPolicy < PriceLevelMap, OrderList, StdIndex < Order_ptr > > >;
+
 	}
 }
 
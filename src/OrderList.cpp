@@ -6,61 +6,120 @@
 namespace JumpInterview {
 	namespace OrderBook {
 
-		OrderList::OrderList()
+		OrderList::OrderList() :
+			m_front ( 0 ),
+			m_back ( 0 ),
+			m_size ( 0 ),
+			m_volume ( 0 ),
+			m_dirty ( true )
 		{
 		}
 
 		OrderList::~OrderList()
 		{
-			for ( OrderNode_list::iterator iter = m_list.begin();
-					iter != m_list.end();
-					iter++ )
-				delete ( ( *iter )->order() );
+			while ( m_front )
+			{
+				Order_ptr order ( m_front );
+				m_front = order->m_next;
+				delete ( order );
+			}
 		}
 
-		OrderNode_list::iterator OrderList::begin()
+		void OrderList::discard()
 		{
-			return m_list.begin();
+			m_front = m_back = 0;
+			m_size = 0;
+			m_volume = 0;
+			m_dirty = true;
 		}
 
-		OrderNode_list::iterator OrderList::end()
+		OrderList::iterator OrderList::begin() const
 		{
-			return m_list.end();
+			return iterator ( m_front );
+		}
+
+		OrderList::iterator OrderList::end() const
+		{
+			return iterator();
 		}
 
 		bool OrderList::empty() const
 		{
-			return m_list.empty();
+			return !m_front;
 		}
 
 		size_t OrderList::size() const
 		{
-			return m_list.size();
+			return m_size;
+		}
+
+		void OrderList::add ( Order_ptr order,
+							  uint32_t sequence_id )
+		{
+			assert ( !order->m_prev && !order->m_next && m_front != order );
+			order->m_sequence_id = sequence_id;
+			order->m_prev = m_back;
+			if ( m_back )
+				m_back->m_next = order;
+			else
+				m_front = order;
+			m_back = order;
+			m_size++;
+			m_volume += order->m_volume;
+			m_dirty = true;
+		}
+
+		void OrderList::remove ( Order_ptr order )
+		{
+			assert ( m_size > 0 );
+			if ( order->m_prev )
+				order->m_prev->m_next = order->m_next;
+			else
+			{
+				assert ( m_front == order );
+				m_front = order->m_next;
+			}
+			if ( order->m_next )
+				order->m_next->m_prev = order->m_prev;
+			else
+			{
+				assert ( m_back == order );
+				m_back = order->m_prev;
+			}
+			order->m_prev = order->m_next = 0;
+			m_size--;
+			m_volume -= order->m_volume;
+			m_dirty = true;
 		}
 
-		OrderNode_list::iterator OrderList::add ( Order_ptr const & order,
-				uint32_t sequence_id )
+		void OrderList::reduce ( Order_ptr order, uint32_t volume )
 		{
-			OrderNode_ptr node = std::make_shared < OrderNode > ( order, sequence_id );
-			m_list.push_back ( node );
-			OrderNode_list::iterator last ( m_list.end() );
-			return --last;
+			assert ( volume <= order->m_volume );
+			m_volume -= order->m_volume - volume;
+			order->modify ( volume, order->m_price );
+			// it stays where it is, but has to be printed again
+			m_dirty = true;
 		}
 
-		void OrderList::remove ( OrderNode_list::iterator order_iter )
+		void OrderList::print ( OutputBuffer & out )
 		{
-			OrderNode_list::iterator c_iter ( m_list.begin() );
-			m_list.erase ( order_iter );
+			assert ( !empty() );
+			if ( m_dirty )
+				render();
+			out.append ( m_rendered.data(), m_rendered.size() );
 		}
 
-		std::ostream& operator<< ( std::ostream& os, OrderList& list )
+		void OrderList::render()
 		{
-			assert ( !list.empty() );
-			for ( OrderNode_list::iterator iter = list.begin();
-					iter != list.end();
-					iter++ )
-				os << * ( *iter )->order() << std::endl;
-			return os;
+			static const char newline ( '\n' );
+			OrderTextCache & cache ( OrderTextCache::instance() );
+			m_rendered.clear();
+			for ( Order_ptr order = m_front; order; order = order->m_next )
+			{
+				m_rendered += cache.text ( *order );
+				m_rendered += newline;
+			}
+			m_dirty = false;
 		}
 	}
-}
+}
\ No newline at end of file
@@ -2,8 +2,8 @@
 #define __ORDER_LIST_HPP__
 
 #include <stdint.h>
-#include <list>
 #include <memory>
+#include <string>
 
 #include "Order.hpp"
 #include "PoolAllocator.hpp"
@@ -12,55 +12,83 @@
 namespace JumpInterview {
 	namespace OrderBook {
 
-		// An order node only contains a pointer to an order. It is not in charge of disposing it
-		// when we remove it from the list.
-		class OrderNode
+		/*
+		 * The orders at one price level, front of the queue first. The queue runs through the orders themselves ( see
+		 * Order ), so adding, removing and moving an order to the back are just a couple of pointers - nothing gets
+		 * allocated. Whatever's still queued when the list goes, goes with it.
+		 *
+		 * We keep count of the orders and their volume as they come and go, so how much there is at this price
+		 * never takes a walk through the queue.
+		 */
+		class OrderList
 		{
 		public:
-			OrderNode ( Order_ptr const & order,
-						uint32_t sequence_id ) : m_order ( order ),
-				m_sequence_id ( sequence_id )
+			/* Walks the queue front to back, and hands out the orders */
+			class iterator
 			{
-			}
+			public:
+				iterator ( Order_ptr order = 0 ) : m_order ( order ) {}
 
-			Order_ptr const & order() const
-			{
-				return m_order;
-			}
+				Order_ptr operator* () const
+				{
+					return m_order;
+				}
 
-			uint32_t const & sequence_id() const
-			{
-				return m_sequence_id;
-			}
+				iterator & operator++ ()
+				{
+					m_order = m_order->m_next;
+					return *this;
+				}
 
-			static inline void* operator new ( std::size_t sz )
-			{
-				return PoolAllocator<OrderNode>::instance().allocate ( sz ) ;
-			}
+				iterator operator++ ( int )
+				{
+					iterator previous ( *this );
+					m_order = m_order->m_next;
+					return previous;
+				}
 
-			static inline void operator delete ( void* p )
-			{
-				PoolAllocator<OrderNode>::instance().deallocate ( static_cast< OrderNode * > ( p ), sizeof ( OrderNode ) ) ;
-			}
-		private:
-			Order_ptr m_order;
-			// when crossing, we use this to find out at what level that should happen
-			uint32_t m_sequence_id;
-		};
-		typedef std::shared_ptr < OrderNode > OrderNode_ptr;
-		typedef std::list < OrderNode_ptr > OrderNode_list;
+				bool operator== ( iterator const & rhs ) const
+				{
+					return m_order == rhs.m_order;
+				}
+
+				bool operator!= ( iterator const & rhs ) const
+				{
+					return m_order != rhs.m_order;
+				}
+			private:
+				Order_ptr m_order;
+			};
 
-		class OrderList
-		{
-		public:
 			OrderList();
 			~OrderList();
-			OrderNode_list::iterator add ( Order_ptr const & order, uint32_t sequence_id );
-			void remove ( OrderNode_list::iterator order_iter );
+			/* To the back of the queue. The order can't be in any list at this point */
+			void add ( Order_ptr order, uint32_t sequence_id );
+			/* From anywhere in the queue. Is still up to the caller to dispose */
+			void remove ( Order_ptr order );
+			/* Forgets every order without deleting them, for when their pool is about to be reset */
+			void discard();
 			bool empty() const;
 			size_t size() const;
-			OrderNode_list::iterator begin();
-			OrderNode_list::iterator end();
+			/* The volume of all of our orders together */
+			uint64_t volume() const
+			{
+				return m_volume;
+			}
+			/* The order at the front of the queue, 0 if we're empty */
+			Order_ptr front() const
+			{
+				return m_front;
+			}
+			iterator begin() const;
+			iterator end() const;
+			/*
+			 * Every order on its own line, front of the queue first. We keep the text we wrote last time around,
+			 * and only write it again when something in this level changed since.
+			 */
+			void print ( OutputBuffer & out );
+			/* The order's volume goes down to this, and it keeps its place in the queue */
+			void reduce ( Order_ptr order, uint32_t volume );
 			static inline void* operator new ( std::size_t sz )
 			{
 				return PoolAllocator<OrderList>::instance().allocate ( sz ) ;
@@ -71,13 +99,18 @@ namespace JumpInterview {
 				PoolAllocator<OrderList>::instance().deallocate ( static_cast< OrderList * > ( p ), sizeof ( OrderList ) ) ;
 			}
 		private:
-			;
 			OrderList ( OrderList const & rhs ) {}
-			OrderNode_list m_list;
+			Order_ptr m_front;
+			Order_ptr m_back;
+			size_t m_size;
+			uint64_t m_volume;
+			// what print wrote last time, valid unless we're dirty. Keeps its capacity, so re-rendering doesn't allocate
+			std::string m_rendered;
+			bool m_dirty;
+
+			void render();
 		};
 		typedef std::shared_ptr < OrderList > OrderList_ptr;
-
-		std::ostream& operator<< ( std::ostream& os, OrderList& order );
 	}
 }
 
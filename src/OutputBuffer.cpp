@@ -0,0 +1,48 @@
+#include <assert.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "OutputBuffer.hpp"
+
+namespace JumpInterview {
+	namespace OrderBook {
+
+		bool FdSink::writeAll ( int fd, const char * data, size_t size )
+		{
+			while ( size )
+			{
+				ssize_t written ( ::write ( fd, data, size ) );
+				if ( written < 0 )
+				{
+					if ( errno == EINTR )
+						continue;
+					return false;
+				}
+				data += written;
+				size -= written;
+			}
+			return true;
+		}
+
+		OutputBuffer::OutputBuffer ( OutputSink & sink, size_t capacity ) :
+			m_sink ( sink ),
+			// whatever we get asked for, a formatted number has to fit
+			m_buffer ( capacity < NumberFormat::max_length ? NumberFormat::max_length : capacity ),
+			m_used ( 0 )
+		{
+		}
+
+		OutputBuffer::~OutputBuffer()
+		{
+			flush();
+		}
+
+		void OutputBuffer::flush()
+		{
+			assert ( m_used <= m_buffer.size() );
+			if ( m_used )
+				m_sink.write ( &m_buffer[0], m_used );
+			m_used = 0;
+		}
+	}
+}
@@ -0,0 +1,140 @@
+#ifndef __OUTPUT_BUFFER_HPP__
+#define __OUTPUT_BUFFER_HPP__
+
+#include <stdint.h>
+#include <cstring>
+#include <ostream>
+#include <vector>
+
+#include "NumberFormat.hpp"
+
+namespace JumpInterview {
+	namespace OrderBook {
+
+		/*
+		 * Wherever our output ends up. An OutputBuffer only ever hands it big blocks.
+		 */
+		class OutputSink
+		{
+		public:
+			virtual ~OutputSink() {}
+			virtual void write ( const char * data, size_t size ) = 0;
+		};
+
+		class StreamSink : public OutputSink
+		{
+		public:
+			StreamSink ( std::ostream & os ) : m_os ( os ) {}
+			virtual void write ( const char * data, size_t size )
+			{
+				m_os.write ( data, size );
+			}
+		private:
+			std::ostream & m_os;
+		};
+
+		/* Straight into a file descriptor with write(2), there's no stream in between */
+		class FdSink : public OutputSink
+		{
+		public:
+			FdSink ( int fd ) : m_fd ( fd ) {}
+			virtual void write ( const char * data, size_t size )
+			{
+				writeAll ( m_fd, data, size );
+			}
+
+			/* Keeps going after short writes and interruptions. Returns false if we couldn't write it all */
+			static bool writeAll ( int fd, const char * data, size_t size );
+		private:
+			int m_fd;
+		};
+
+		/* Throws everything away, for 'silent' and the benchmarks. We still do all the formatting */
+		class NullSink : public OutputSink
+		{
+		public:
+			virtual void write ( const char * data, size_t size ) {}
+		};
+
+		/*
+		 * Everything we write goes through here. We fill up a block of memory and only hand it to the sink when it's
+		 * full or when we're asked to flush, instead of flushing the stream after every single line like std::endl
+		 * would. Numbers are formatted in place with NumberFormat, so writing a line doesn't allocate anything.
+		 *
+		 * The appends are on the hot path, so they live in the header.
+		 */
+		class OutputBuffer
+		{
+		public:
+			static const size_t default_capacity = 64 * 1024;
+
+			OutputBuffer ( OutputSink & sink, size_t capacity = default_capacity );
+			/* Flushes whatever is left */
+			~OutputBuffer();
+
+			void append ( char c )
+			{
+				*reserve ( 1 ) = c;
+				m_used++;
+			}
+
+			void append ( const char * data, size_t size )
+			{
+				if ( size > m_buffer.size() )
+				{
+					// doesn't fit anyway, don't bother copying
+					flush();
+					m_sink.write ( data, size );
+					return;
+				}
+				memcpy ( reserve ( size ), data, size );
+				m_used += size;
+			}
+
+			void append ( const char * str )
+			{
+				append ( str, strlen ( str ) );
+			}
+
+			void appendUInt ( uint64_t value )
+			{
+				m_used = NumberFormat::formatUInt ( reserve ( NumberFormat::max_length ), value ) - &m_buffer[0];
+			}
+
+			void appendPrice ( uint32_t ticks )
+			{
+				m_used = NumberFormat::formatPrice ( reserve ( NumberFormat::max_length ), ticks ) - &m_buffer[0];
+			}
+
+			void appendMidPrice ( uint64_t sum_of_ticks )
+			{
+				m_used = NumberFormat::formatMidPrice ( reserve ( NumberFormat::max_length ), sum_of_ticks ) - &m_buffer[0];
+			}
+
+			/* What std::endl used to be, minus the flush */
+			void endLine()
+			{
+				append ( '\n' );
+			}
+
+			/* Hands everything we've got to the sink */
+			void flush();
+		private:
+			OutputBuffer ( OutputBuffer const & rhs ) : m_sink ( rhs.m_sink ) {}
+
+			/* Makes sure there's room for size more bytes, and returns where they go */
+			char * reserve ( size_t size )
+			{
+				if ( m_used + size > m_buffer.size() )
+					flush();
+				return &m_buffer[ m_used ];
+			}
+
+			OutputSink & m_sink;
+			std::vector < char > m_buffer;
+			size_t m_used;
+		};
+	}
+}
+
+#endif
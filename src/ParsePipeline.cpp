@@ -0,0 +1,132 @@
+#include <assert.h>
+#include <cstring>
+
+#include "FeedHandler.hpp"
+#include "ParsePipeline.hpp"
+
+namespace JumpInterview {
+	namespace OrderBook {
+
+		ParsePipeline::ParsePipeline ( const char * data, size_t size, size_t parsers, size_t chunk_size ) :
+			m_data ( data ),
+			m_size ( size ),
+			m_chunk_size ( chunk_size ? chunk_size : 1 ),
+			m_chunks ( ( size + m_chunk_size - 1 ) / m_chunk_size ),
+			m_stopping ( false ),
+			m_chunk ( 0 ),
+			m_batch ( 0 ),
+			m_position ( 0 ),
+			m_book_stalls ( 0 )
+		{
+			if ( !parsers )
+				parsers = 1;
+			for ( size_t i = 0; i < parsers; i++ )
+				m_rings.push_back ( std::unique_ptr < BatchRing > ( new BatchRing ( default_ring_capacity ) ) );
+			for ( size_t i = 0; i < parsers; i++ )
+				m_threads.push_back ( std::thread ( &ParsePipeline::parse, this, i ) );
+		}
+
+		ParsePipeline::~ParsePipeline()
+		{
+			m_stopping.store ( true );
+			for ( size_t i = 0; i < m_threads.size(); i++ )
+				m_threads[i].join();
+		}
+
+		size_t ParsePipeline::parsers() const
+		{
+			return m_rings.size();
+		}
+
+		uint64_t ParsePipeline::bookStalls() const
+		{
+			return m_book_stalls;
+		}
+
+		/*
+		 * A chunk starts at the first line that starts within its chunk_size bytes. That's the byte after the first
+		 * '\n' we find from the last byte of the chunk before - or the end of the input, if there's no such line.
+		 */
+		const char * ParsePipeline::chunkBegin ( size_t chunk ) const
+		{
+			if ( !chunk )
+				return m_data;
+			if ( chunk >= m_chunks )
+				return m_data + m_size;
+			size_t offset ( chunk * m_chunk_size - 1 );
+			const char * newline ( static_cast < const char * > ( memchr ( m_data + offset, '\n', m_size - offset ) ) );
+			return newline ? newline + 1 : m_data + m_size;
+		}
+
+		/*
+		 * A parser thread: every parsers'th chunk, front to back, into its own ring.
+		 */
+		void ParsePipeline::parse ( size_t parser )
+		{
+			BatchRing & ring ( *m_rings[ parser ] );
+			MessageBatch batch;
+			for ( size_t chunk = parser; chunk < m_chunks; chunk += m_rings.size() )
+			{
+				const char * pos ( chunkBegin ( chunk ) );
+				const char * end ( chunkBegin ( chunk + 1 ) );
+				batch.count = 0;
+				batch.end_of_chunk = false;
+				while ( pos < end )
+				{
+					const char * line_end ( static_cast < const char * > ( memchr ( pos, '\n', end - pos ) ) );
+					if ( !line_end )
+						line_end = end;
+					FeedHandler::parse ( MessageView ( pos, line_end - pos ), batch.messages[ batch.count++ ] );
+					if ( batch.count == MessageBatch::capacity )
+					{
+						push ( ring, batch );
+						batch.count = 0;
+					}
+					pos = line_end + 1;
+				}
+				batch.end_of_chunk = true;
+				push ( ring, batch );
+				if ( m_stopping.load ( std::memory_order_relaxed ) )
+					return;
+			}
+		}
+
+		void ParsePipeline::push ( BatchRing & ring, MessageBatch const & batch )
+		{
+			// the book thread is the only one that can make room, so let it have the core
+			while ( !ring.tryPush ( batch ) )
+			{
+				if ( m_stopping.load ( std::memory_order_relaxed ) )
+					return;
+				std::this_thread::yield();
+			}
+		}
+
+		bool ParsePipeline::next ( Message & message )
+		{
+			while ( !m_batch || m_position == m_batch->count )
+			{
+				if ( m_batch )
+				{
+					// done with this one, it can go back to the parser
+					bool end_of_chunk ( m_batch->end_of_chunk );
+					m_rings[ m_chunk % m_rings.size() ]->pop ( 1 );
+					m_batch = 0;
+					if ( end_of_chunk )
+						m_chunk++;
+				}
+				if ( m_chunk == m_chunks )
+					return false;
+				BatchRing & ring ( *m_rings[ m_chunk % m_rings.size() ] );
+				while ( !ring.front ( m_batch ) )
+				{
+					m_book_stalls++;
+					std::this_thread::yield();
+				}
+				m_position = 0;
+			}
+			message = m_batch->messages[ m_position++ ];
+			return true;
+		}
+	}
+}
@@ -0,0 +1,78 @@
+#ifndef __PARSE_PIPELINE_HPP__
+#define __PARSE_PIPELINE_HPP__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "Message.hpp"
+#include "SpscRing.hpp"
+
+namespace JumpInterview {
+	namespace OrderBook {
+
+		/*
+		 * Parses a text feed on parser threads of its own, while the thread calling next() applies the messages.
+		 *
+		 * The input is cut into chunks of about chunk_size bytes, always at the start of a line: a chunk holds every
+		 * line that starts within its chunk_size bytes, so every parser can work out where its chunks begin and end
+		 * without talking to anyone. Chunk k goes to parser k % parsers, and every parser has a ring of its own to
+		 * the book thread ( see SpscRing ). The book thread reads chunk 0 from ring 0, chunk 1 from ring 1 and so on,
+		 * which gives it the messages in exactly the order they were in the file.
+		 *
+		 * We only parse here - lines we can't make anything of still come out as CORRUPTED/WEIRD messages and only
+		 * get counted once the FeedHandler applies them, so the ErrorSummary comes out the same as it would on a
+		 * single thread. Lines are split exactly like MappedFile::nextLine does it.
+		 *
+		 * Whatever data points to has to outlive us, and next() may only be called from one thread.
+		 */
+		class ParsePipeline
+		{
+		public:
+			static const size_t default_chunk_size = 64 * 1024;
+			// batches per parser that can be waiting for the book thread
+			static const size_t default_ring_capacity = 64;
+
+			/* Starts the parser threads straight away */
+			ParsePipeline ( const char * data, size_t size, size_t parsers, size_t chunk_size = default_chunk_size );
+			/* Stops the parser threads, even if we haven't had every message yet */
+			~ParsePipeline();
+
+			/* The next message in the feed, returns false once we've had all of them */
+			bool next ( Message & message );
+
+			size_t parsers() const;
+			/* How often the book thread found the ring it needed empty and had to wait for a parser */
+			uint64_t bookStalls() const;
+		private:
+			typedef SpscRing < MessageBatch > BatchRing;
+
+			ParsePipeline ( ParsePipeline const & rhs ) {}
+
+			void parse ( size_t parser );
+			void push ( BatchRing & ring, MessageBatch const & batch );
+			const char * chunkBegin ( size_t chunk ) const;
+
+			const char * m_data;
+			size_t m_size;
+			size_t m_chunk_size;
+			size_t m_chunks;
+			std::vector < std::unique_ptr < BatchRing > > m_rings;
+			std::atomic < bool > m_stopping;
+
+			// the book thread's side
+			size_t m_chunk;
+			MessageBatch const * m_batch;
+			uint32_t m_position;
+			uint64_t m_book_stalls;
+
+			// last, everything they use has to be there already
+			std::vector < std::thread > m_threads;
+		};
+	}
+}
+
+#endif
@@ -2,71 +2,255 @@
 #define __POOL_ALLOCATOR_HPP__
 
 #include <assert.h>
-#include <stack>
-#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <mutex>
+#include <new>
+#include <vector>
+#include <sys/mman.h>
 
 namespace JumpInterview {
 	namespace OrderBook {
 
+		struct PoolChunk
+		{
+			PoolChunk ( char * chunk_data, size_t chunk_bytes ) : data ( chunk_data ), bytes ( chunk_bytes ) {}
+			char * data;
+			size_t bytes;
+		};
+		typedef std::vector < PoolChunk > PoolChunks;
+
+		/*
+		 * Where the chunks of a pool go when its thread ends. What was allocated on that thread may well still be in use
+		 * somewhere else ( a ShardedFeed's books are taken down after its workers are gone ), so they stay mapped
+		 * until we exit.
+		 */
+		class OrphanedChunks
+		{
+		public:
+			static void adopt ( PoolChunks const & chunks )
+			{
+				if ( chunks.empty() )
+					return;
+				OrphanedChunks & orphans ( instance() );
+				std::lock_guard < std::mutex > lock ( orphans.m_mutex );
+				orphans.m_chunks.insert ( orphans.m_chunks.end(), chunks.begin(), chunks.end() );
+			}
+		private:
+			OrphanedChunks() {}
+			OrphanedChunks ( OrphanedChunks const & rhs ) {}
+
+			~OrphanedChunks()
+			{
+				for ( size_t i = 0; i < m_chunks.size(); i++ )
+					munmap ( m_chunks[i].data, m_chunks[i].bytes );
+			}
+
+			static OrphanedChunks & instance()
+			{
+				static OrphanedChunks orphans;
+				return orphans;
+			}
+
+			std::mutex m_mutex;
+			PoolChunks m_chunks;
+		};
+
 		/*
-		 * We expect the number of objects to stay relatively stable once we're in business. If that's not the case,
-		 * it makes more sense to allocate memory in chunks. For instance by creating a T* chunk = new T[25] and filling
-		 * the stack with those whenever it's empty. There are two downsides to this:
+		 * Hands out objects from large chunks of memory, so growing to a million orders means a couple of hundred
+		 * mmaps rather than a million mallocs. Within a chunk we just move on to the next slot, and every object that's
+		 * given back goes onto a free list that runs through the slots themselves - the next allocation takes it from
+		 * there. Nothing is given back to the system one object at a time, so we never get smaller than we've been.
 		 *
-		 * 1. The T objects need to have a default () constructor that's accessible by the PoolAllocator.
-		 * 2. Slightly more memory overhead because every time we allocate 25, we've got 24 waiting there to be taken up.
+		 * A chunk holds chunkSize() objects, unless we're asked to reserve() more in one go. Chunks can be prefaulted,
+		 * so we don't take a page fault for every page the first time we get to it, and be backed by huge pages.
 		 *
-		 * I decided not to do this, but if the situation calls for it, that would definitely be possible.
+		 * reset() gives back every chunk at once, without looking at a single object in them. That's how a whole
+		 * session's worth of orders goes ( see FeedHandler::resetSession ), rather than deleting them one by one.
 		 */
 		template <class T>
-		class PoolAllocator : public std::allocator<T>
+		class PoolAllocator
 		{
 		public:
-			/* The pool allocator cuts down on the number of mallocs we have to do. On the flip-side, it is less memory efficient.  */
-			PoolAllocator<T> ( )
+			static const size_t default_chunk_size = 4096;
+			static const size_t huge_page_size = 2 * 1024 * 1024;
+
+			PoolAllocator<T> ( ) :
+				m_free ( 0 ),
+				m_free_count ( 0 ),
+				m_next ( 0 ),
+				m_end ( 0 ),
+				m_capacity ( 0 ),
+				m_chunk_size ( default_chunk_size ),
+				m_prefault ( false ),
+				m_huge_pages ( false )
 			{
 			}
 
+			/*
+			 * Every thread gets a pool of its own, so books on different threads ( see ShardedFeed ) never share one.
+			 * Whatever one thread frees just ends up in its own pool, even if another thread allocated it. The same
+			 * goes for the settings below: they're only for the thread that makes them.
+			 */
 			static PoolAllocator<T> & instance()
 			{
-				static PoolAllocator<T> instance;
+				static thread_local PoolAllocator<T> instance;
 				return instance;
 			}
 
 			~PoolAllocator<T>()
 			{
-				while ( !m_stack.empty() )
-				{
-					T* top = m_stack.top();
-					assert ( top );
-					std::allocator<T>::deallocate ( top, sizeof ( T ) );
-					m_stack.pop();
-				}
+				OrphanedChunks::adopt ( m_chunks );
 			}
 
 			T* allocate ( size_t n, const void * hint = 0 )
 			{
-				if ( m_stack.empty() )
-					return std::allocator<T>::allocate ( n, hint );
-				T* t = m_stack.top();
-				m_stack.pop();
+				assert ( n <= sizeof ( T ) );
+				if ( m_free )
+				{
+					FreeSlot * slot ( m_free );
+					m_free = slot->next;
+					m_free_count--;
+					return reinterpret_cast < T * > ( slot );
+				}
+				if ( m_next == m_end )
+					addChunk ( m_chunk_size );
+				T * t ( reinterpret_cast < T * > ( m_next ) );
+				m_next += slot_size;
 				return t;
 			}
 
 			void deallocate ( T* t, size_t n )
 			{
-				static const size_t max_size ( 1000 );
 				assert ( t );
-				if ( m_stack.size() < max_size )
-					m_stack.push ( t );
-				else
-					std::allocator<T>::deallocate ( t, n );
+				FreeSlot * slot ( reinterpret_cast < FreeSlot * > ( t ) );
+				slot->next = m_free;
+				m_free = slot;
+				m_free_count++;
+			}
+
+			/*
+			 * Makes sure we can hand out this many objects before we need another chunk. The chunk we add for that is
+			 * prefaulted: whoever reserves is about to use it.
+			 */
+			void reserve ( size_t objects )
+			{
+				size_t available ( m_free_count + ( m_end - m_next ) / slot_size );
+				if ( available < objects )
+					addChunk ( objects - available, true );
+			}
+
+			/* Every object we ever handed out goes, in one go. None of them may be in use anymore, or on another thread's free list */
+			void reset()
+			{
+				for ( size_t i = 0; i < m_chunks.size(); i++ )
+					munmap ( m_chunks[i].data, m_chunks[i].bytes );
+				m_chunks.clear();
+				m_free = 0;
+				m_free_count = 0;
+				m_next = m_end = 0;
+				m_capacity = 0;
+			}
+
+			/* How many objects the chunks we add from now on hold */
+			void setChunkSize ( size_t objects )
+			{
+				m_chunk_size = std::max < size_t > ( objects, 1 );
+			}
+
+			size_t chunkSize() const
+			{
+				return m_chunk_size;
+			}
+
+			/* Touch every page of a new chunk straight away */
+			void setPrefault ( bool prefault )
+			{
+				m_prefault = prefault;
+			}
+
+			/* New chunks are rounded up to, and aligned on, huge pages - and we ask for those */
+			void setHugePages ( bool huge_pages )
+			{
+				m_huge_pages = huge_pages;
+			}
+
+			size_t chunks() const
+			{
+				return m_chunks.size();
+			}
+
+			/* How many objects all of our chunks hold together */
+			size_t capacity() const
+			{
+				return m_capacity;
 			}
 
 		private:
-			std::stack<T*> m_stack;
+			struct FreeSlot
+			{
+				FreeSlot * next;
+			};
+
+			static const size_t slot_alignment = alignof ( T ) > alignof ( FreeSlot ) ? alignof ( T ) : alignof ( FreeSlot );
+			// every slot has to fit a T, or a link in the free list when it's free
+			static const size_t slot_size = ( ( sizeof ( T ) > sizeof ( FreeSlot ) ? sizeof ( T ) : sizeof ( FreeSlot ) ) + slot_alignment - 1 ) / slot_alignment * slot_alignment;
+
 			PoolAllocator<T> ( PoolAllocator<T> const & rhs ) {}
+
+			void addChunk ( size_t objects, bool prefault = false )
+			{
+				size_t page ( m_huge_pages ? huge_page_size : 4096 );
+				size_t bytes ( ( objects * slot_size + page - 1 ) / page * page );
+				int flags ( MAP_PRIVATE | MAP_ANONYMOUS );
+#ifdef MAP_POPULATE
+				if ( m_prefault || prefault )
+					flags |= MAP_POPULATE;
+#endif
+				// a huge page has to start on a huge page, so we map one more and cut off what we don't need
+				size_t mapped ( m_huge_pages ? bytes + huge_page_size : bytes );
+				void * memory ( mmap ( 0, mapped, PROT_READ | PROT_WRITE, flags, -1, 0 ) );
+				if ( memory == MAP_FAILED )
+					throw std::bad_alloc();
+				char * data ( static_cast < char * > ( memory ) );
+				if ( m_huge_pages )
+				{
+					char * aligned ( reinterpret_cast < char * > ( ( reinterpret_cast < uintptr_t > ( data ) + huge_page_size - 1 ) / huge_page_size * huge_page_size ) );
+					if ( aligned != data )
+						munmap ( data, aligned - data );
+					if ( aligned + bytes != data + mapped )
+						munmap ( aligned + bytes, data + mapped - aligned - bytes );
+					data = aligned;
+#ifdef MADV_HUGEPAGE
+					madvise ( data, bytes, MADV_HUGEPAGE );
+#endif
+				}
+				m_chunks.push_back ( PoolChunk ( data, bytes ) );
+				// whatever's left of the chunk we were in goes on the free list, so it isn't lost
+				for ( ; m_next != m_end; m_next += slot_size )
+					deallocate ( reinterpret_cast < T * > ( m_next ), slot_size );
+				m_next = data;
+				m_end = data + bytes / slot_size * slot_size;
+				m_capacity += bytes / slot_size;
+			}
+
+			FreeSlot * m_free;
+			size_t m_free_count;
+			// what we haven't handed out yet in the last chunk
+			char * m_next;
+			char * m_end;
+			PoolChunks m_chunks;
+			size_t m_capacity;
+			size_t m_chunk_size;
+			bool m_prefault;
+			bool m_huge_pages;
 		};
+
+		template <class T> const size_t PoolAllocator<T>::default_chunk_size;
+		template <class T> const size_t PoolAllocator<T>::huge_page_size;
+		template <class T> const size_t PoolAllocator<T>::slot_alignment;
+		template <class T> const size_t PoolAllocator<T>::slot_size;
 	}
 }
 
@@ -0,0 +1,574 @@
+#ifndef __PRICE_LADDER_HPP__
+#define __PRICE_LADDER_HPP__
+
+#include <assert.h>
+#include <stdint.h>
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "OrderList.hpp"
+
+namespace JumpInterview {
+	namespace OrderBook {
+
+		/* Which end of the ladder is the top of the book */
+		template <class T>
+		struct LadderDirection;
+
+		template <>
+		struct LadderDirection < std::less<uint32_t> >
+		{
+			static const bool ascending = true;
+		};
+
+		template <>
+		struct LadderDirection < std::greater<uint32_t> >
+		{
+			static const bool ascending = false;
+		};
+
+		/*
+		 * The same thing as a PriceLevelMap, but the levels are kept in an array with a slot for every tick in a window
+		 * of prices. Finding a level is an index, so is adding one - there's no tree and no hash table. The tick is
+		 * whatever all prices we've seen have in common, so the window isn't wasted on prices that can't happen.
+		 *
+		 * An occupancy bitmap with a bit for every slot, and on top of that a bit for every word of the level below,
+		 * finds the top of the book ( and the next level from there ) with a find-first-set per level.
+		 *
+		 * When a price falls outside of the window, we move the window so it covers all of our levels again, and
+		 * grow it if it has to. Only once it's as large as we let it get, levels far away from the top of the book go
+		 * into a tree ( they're hardly ever touched there ) - while the window follows the top of the book.
+		 * Every one of these moves is O(window), but they only happen when prices drift.
+		 */
+		template < class T, class Queue = OrderList >
+		class PriceLadder
+		{
+		public:
+			// the window's bitmaps and ticks are worked out in 32 bits, so that's what our prices are
+			typedef uint32_t Price;
+			typedef std::shared_ptr < Queue > Queue_ptr;
+			typedef std::pair < uint32_t, Queue_ptr > Level;
+			// what puts the top of the book first
+			typedef T Compare;
+			static const size_t min_window = 256;
+			static const size_t default_max_window = 1 << 16;
+
+			class const_iterator
+			{
+			public:
+				const_iterator() : m_ladder ( 0 ), m_phase ( AFTER ), m_slot ( npos ) {}
+
+				Level const & operator* () const
+				{
+					return m_phase == WINDOW ? m_ladder->m_levels[ m_slot ] : m_far->second;
+				}
+
+				Level const * operator-> () const
+				{
+					return &**this;
+				}
+
+				const_iterator & operator++ ()
+				{
+					if ( m_phase == WINDOW )
+						m_slot = m_ladder->nextSlot ( m_slot );
+					else
+						++m_far;
+					settle();
+					return *this;
+				}
+
+				const_iterator operator++ ( int )
+				{
+					const_iterator previous ( *this );
+					++*this;
+					return previous;
+				}
+
+				bool operator== ( const_iterator const & rhs ) const
+				{
+					return m_phase == rhs.m_phase && ( m_phase == WINDOW ? m_slot == rhs.m_slot : m_far == rhs.m_far );
+				}
+
+				bool operator!= ( const_iterator const & rhs ) const
+				{
+					return !( *this == rhs );
+				}
+			private:
+				friend class PriceLadder;
+				// the far levels that come before the window, the window itself, and the far levels after it
+				enum Phase { BEFORE, WINDOW, AFTER };
+
+				const_iterator ( PriceLadder const * ladder, Phase phase, typename PriceLadder::FarLevels::const_iterator far ) :
+					m_ladder ( ladder ),
+					m_phase ( phase ),
+					m_far ( far ),
+					m_slot ( phase == WINDOW ? ladder->m_best : npos )
+				{
+					settle();
+				}
+
+				/* At this slot in the window, with far pointing at the first far level after it */
+				const_iterator ( PriceLadder const * ladder, size_t slot, typename PriceLadder::FarLevels::const_iterator far ) :
+					m_ladder ( ladder ),
+					m_phase ( WINDOW ),
+					m_far ( far ),
+					m_slot ( slot )
+				{
+					settle();
+				}
+
+				/* Moves on to the next phase, for as long as there's nothing left in this one */
+				void settle()
+				{
+					if ( m_phase == BEFORE )
+					{
+						if ( m_far != m_ladder->m_far.end() && m_ladder->beforeWindow ( m_far->first ) )
+							return;
+						m_phase = WINDOW;
+						m_slot = m_ladder->m_best;
+					}
+					if ( m_phase == WINDOW && m_slot == npos )
+						m_phase = AFTER;
+				}
+
+				PriceLadder const * m_ladder;
+				Phase m_phase;
+				typename PriceLadder::FarLevels::const_iterator m_far;
+				size_t m_slot;
+			};
+
+			PriceLadder ( size_t max_window = default_max_window ) :
+				m_max_window ( std::max ( roundUp ( max_window ), min_window ) ),
+				m_base ( 0 ),
+				m_tick ( 0 ),
+				m_best ( npos ),
+				m_window_size ( 0 ),
+				m_volume ( 0 ),
+				m_orders ( 0 )
+			{
+				resize ( min_window );
+			}
+
+			/* Add ( or Find ) the price level. O(1) unless we have to move the window */
+			Queue_ptr & add ( uint32_t price )
+			{
+				size_t slot ( slotOf ( price ) );
+				if ( slot == npos )
+					return addOutside ( price );
+				Level & level ( m_levels[ slot ] );
+				if ( !level.second )
+				{
+					level.second = std::make_shared < Queue > ();
+					occupy ( slot );
+				}
+				return level.second;
+			}
+
+			/* Remove ( O(1) ) the price level */
+			void remove ( uint32_t price )
+			{
+				size_t slot ( slotOf ( price ) );
+				if ( slot == npos )
+				{
+					typename FarLevels::iterator iter ( m_far.find ( price ) );
+					assert ( iter != m_far.end() );
+					assert ( iter->second.second->empty() );
+					m_far.erase ( iter );
+					return;
+				}
+				assert ( m_levels[ slot ].second && m_levels[ slot ].second->empty() );
+				m_levels[ slot ].second.reset();
+				vacate ( slot );
+			}
+
+			bool empty() const
+			{
+				return !m_window_size && m_far.empty();
+			}
+
+			size_t size() const
+			{
+				return m_window_size + m_far.size();
+			}
+
+			void clear()
+			{
+				for ( size_t slot ( m_best ); slot != npos; slot = nextSlot ( slot ) )
+					m_levels[ slot ].second.reset();
+				for ( size_t i = 0; i < m_bits.size(); i++ )
+					std::fill ( m_bits[i].begin(), m_bits[i].end(), 0 );
+				m_far.clear();
+				m_best = npos;
+				m_window_size = 0;
+				m_volume = 0;
+				m_orders = 0;
+			}
+
+			/* The level at this price, 0 if we don't have it. O(1), unless it's a far level */
+			Queue const * find ( uint32_t price ) const
+			{
+				size_t slot ( slotOf ( price ) );
+				if ( slot != npos )
+					return m_levels[ slot ].second.get();
+				typename FarLevels::const_iterator iter ( m_far.find ( price ) );
+				return iter == m_far.end() ? 0 : iter->second.second.get();
+			}
+
+			const_iterator begin() const
+			{
+				return const_iterator ( this, const_iterator::BEFORE, m_far.begin() );
+			}
+
+			const_iterator end() const
+			{
+				return const_iterator ( this, const_iterator::AFTER, m_far.end() );
+			}
+
+			/*
+			 * The first level after this price, going down from the top of the book. We don't need a level at this
+			 * price, but it has to be one we've seen: those are always on the window's ticks, if it's in the window.
+			 */
+			const_iterator after ( uint32_t price ) const
+			{
+				if ( beforeWindow ( price ) )
+					return const_iterator ( this, const_iterator::BEFORE, m_far.upper_bound ( price ) );
+				size_t slot ( slotOf ( price ) );
+				if ( slot != npos )
+					return const_iterator ( this, nextSlot ( slot ), m_far.upper_bound ( priceOf ( ascending ? m_levels.size() - 1 : 0 ) ) );
+				assert ( !m_tick || price < m_base || price > lastPrice() );
+				return const_iterator ( this, const_iterator::AFTER, m_far.upper_bound ( price ) );
+			}
+
+			/* How many slots the window has right now, and how far apart they are */
+			size_t window() const
+			{
+				return m_levels.size();
+			}
+
+			uint32_t tick() const
+			{
+				return m_tick;
+			}
+
+			/* Levels that didn't fit in the window */
+			size_t farLevels() const
+			{
+				return m_far.size();
+			}
+
+			void print ( OutputBuffer & out ) const
+			{
+				static const char * empty ( "<empty>" );
+				if ( !this->empty() )
+					for ( const_iterator iter = begin();
+							iter != end();
+							iter++ )
+					{
+						Queue_ptr const & list ( iter->second );
+						list->print ( out );
+					}
+				else
+				{
+					out.append ( empty );
+					out.endLine();
+				}
+			}
+
+			/* All of the volume, and all of the orders, on this side. O(1) */
+			uint64_t volume() const
+			{
+				return m_volume;
+			}
+
+			size_t orders() const
+			{
+				return m_orders;
+			}
+
+			/* Whoever queues, removes or reduces orders in our levels tells us how that changed our totals */
+			void adjustTotals ( int64_t volume, int64_t orders )
+			{
+				m_volume += volume;
+				m_orders += orders;
+			}
+
+		private:
+			typedef std::map < uint32_t, Level, T > FarLevels;
+			static const size_t npos = ~static_cast < size_t > ( 0 );
+			static const bool ascending = LadderDirection<T>::ascending;
+
+			static size_t roundUp ( size_t slots )
+			{
+				size_t rounded ( 1 );
+				while ( rounded < slots )
+					rounded <<= 1;
+				return rounded;
+			}
+
+			static uint32_t gcd ( uint32_t a, uint32_t b )
+			{
+				while ( b )
+				{
+					uint32_t r ( a % b );
+					a = b;
+					b = r;
+				}
+				return a;
+			}
+
+			/* npos if the price doesn't have a slot in the window */
+			size_t slotOf ( uint32_t price ) const
+			{
+				if ( price < m_base || !m_tick )
+					return npos;
+				uint32_t offset ( price - m_base );
+				if ( offset % m_tick )
+					return npos;
+				size_t slot ( offset / m_tick );
+				return slot < m_levels.size() ? slot : npos;
+			}
+
+			uint32_t priceOf ( size_t slot ) const
+			{
+				return m_base + static_cast < uint32_t > ( slot ) * m_tick;
+			}
+
+			/* Does a far level come before the window, going from the top of the book down? */
+			bool beforeWindow ( uint32_t price ) const
+			{
+				return ascending ? price < m_base : static_cast < uint64_t > ( price ) > lastPrice();
+			}
+
+			uint64_t lastPrice() const
+			{
+				return m_base + static_cast < uint64_t > ( m_levels.size() - 1 ) * m_tick;
+			}
+
+			/*
+			 * The slow side of add: it's a far level we already have, or we move the window ( and maybe change the tick )
+			 * so it has a slot for this price. Only if the window can't get any larger, a price that isn't going to be
+			 * the top of the book goes into the far levels.
+			 */
+			Queue_ptr & addOutside ( uint32_t price )
+			{
+				typename FarLevels::iterator far ( m_far.find ( price ) );
+				if ( far != m_far.end() )
+					return far->second.second;
+				uint32_t tick ( gcd ( m_tick, price ) );
+				// the span of prices the window should cover: everything in it right now, and the new price
+				uint32_t low ( price ), high ( price );
+				if ( m_window_size )
+				{
+					uint32_t best ( priceOf ( m_best ) ), worst ( priceOf ( lastSlot() ) );
+					low = std::min ( low, std::min ( best, worst ) );
+					high = std::max ( high, std::max ( best, worst ) );
+				}
+				size_t span ( ( high - low ) / tick + 1 );
+				// leave as much room again, so drifting a bit doesn't move the window straight away
+				size_t window ( std::min ( std::max ( roundUp ( span * 2 ), m_levels.size() ), m_max_window ) );
+				uint64_t base;
+				if ( span <= window )
+				{
+					// as much room on either side
+					uint64_t margin ( static_cast < uint64_t > ( ( window - span ) / 2 ) * tick );
+					base = low > margin ? low - margin : 0;
+				}
+				else if ( !m_window_size || T() ( price, priceOf ( m_best ) ) )
+				{
+					// the top of the book moved away from the window, so the window follows it
+					uint64_t half ( static_cast < uint64_t > ( window / 2 ) * tick );
+					base = price > half ? price - half : 0;
+				}
+				else
+				{
+					// if the tick changes, every price in the window has to be a multiple of it again
+					if ( tick != m_tick )
+						rebuild ( m_base - m_base % tick, m_levels.size(), tick );
+					if ( slotOf ( price ) != npos )
+						return add ( price );
+					Level & level ( m_far[ price ] );
+					level.first = price;
+					level.second = std::make_shared < Queue > ();
+					return level.second;
+				}
+				// the window may not run past the largest price there is
+				uint64_t reach ( static_cast < uint64_t > ( window - 1 ) * tick );
+				base = std::min < uint64_t > ( base, reach < 0xFFFFFFFFull ? 0xFFFFFFFFull - reach : 0 );
+				rebuild ( static_cast < uint32_t > ( base - base % tick ), window, tick );
+				assert ( slotOf ( price ) != npos );
+				return add ( price );
+			}
+
+			/*
+			 * Puts every level we have where it belongs with this window: in its slot if it has one, with the far levels
+			 * if it doesn't.
+			 */
+			void rebuild ( uint32_t base, size_t window, uint32_t tick )
+			{
+				std::vector < Level > levels;
+				levels.reserve ( size() );
+				for ( size_t slot ( m_best ); slot != npos; slot = nextSlot ( slot ) )
+					levels.push_back ( std::move ( m_levels[ slot ] ) );
+				for ( typename FarLevels::iterator iter = m_far.begin(); iter != m_far.end(); iter++ )
+					levels.push_back ( std::move ( iter->second ) );
+				m_far.clear();
+				m_base = base;
+				m_tick = tick;
+				m_best = npos;
+				m_window_size = 0;
+				m_levels.clear();
+				resize ( window );
+				for ( size_t i = 0; i < levels.size(); i++ )
+				{
+					size_t slot ( slotOf ( levels[i].first ) );
+					if ( slot == npos )
+						m_far.insert ( std::make_pair ( levels[i].first, std::move ( levels[i] ) ) );
+					else
+					{
+						m_levels[ slot ] = std::move ( levels[i] );
+						occupy ( slot );
+					}
+				}
+			}
+
+			/* An empty window of this many slots, with a level of bitmap on top of another until there's one word left */
+			void resize ( size_t window )
+			{
+				m_levels.resize ( window );
+				for ( size_t slot = 0; slot < window; slot++ )
+					m_levels[ slot ].first = priceOf ( slot );
+				m_bits.clear();
+				size_t bits ( window );
+				do
+				{
+					bits = ( bits + 63 ) / 64;
+					m_bits.push_back ( std::vector < uint64_t > ( bits, 0 ) );
+				}
+				while ( bits > 1 );
+			}
+
+			void occupy ( size_t slot )
+			{
+				m_window_size++;
+				if ( m_best == npos || ( ascending ? slot < m_best : slot > m_best ) )
+					m_best = slot;
+				for ( size_t level = 0; level < m_bits.size(); level++ )
+				{
+					uint64_t & word ( m_bits[ level ][ slot >> 6 ] );
+					bool was_empty ( !word );
+					word |= 1ull << ( slot & 63 );
+					// the levels above already know there's something in this word
+					if ( !was_empty )
+						break;
+					slot >>= 6;
+				}
+			}
+
+			void vacate ( size_t slot )
+			{
+				assert ( m_window_size );
+				m_window_size--;
+				if ( slot == m_best )
+					m_best = nextSlot ( slot );
+				for ( size_t level = 0; level < m_bits.size(); level++ )
+				{
+					uint64_t & word ( m_bits[ level ][ slot >> 6 ] );
+					word &= ~ ( 1ull << ( slot & 63 ) );
+					if ( word )
+						break;
+					slot >>= 6;
+				}
+			}
+
+			/* The next level going down from the top of the book, npos if this was the last one in the window */
+			size_t nextSlot ( size_t slot ) const
+			{
+				return ascending ? nextAbove ( slot ) : nextBelow ( slot );
+			}
+
+			/* The level in the window that's furthest away from the top of the book */
+			size_t lastSlot() const
+			{
+				size_t slot ( 0 );
+				for ( size_t level = m_bits.size(); level-- > 0; )
+				{
+					uint64_t word ( m_bits[ level ][ slot ] );
+					assert ( word );
+					slot = ( slot << 6 ) | ( ascending ? 63 - __builtin_clzll ( word ) : __builtin_ctzll ( word ) );
+				}
+				return slot;
+			}
+
+			/* Climbs up until a word has a bit after ours, then takes the first bit all the way down again */
+			size_t nextAbove ( size_t slot ) const
+			{
+				size_t level ( 0 );
+				while ( true )
+				{
+					if ( level == m_bits.size() )
+						return npos;
+					unsigned bit ( slot & 63 );
+					uint64_t word ( bit == 63 ? 0 : m_bits[ level ][ slot >> 6 ] & ( ~0ull << ( bit + 1 ) ) );
+					if ( word )
+					{
+						slot = ( slot & ~static_cast < size_t > ( 63 ) ) | __builtin_ctzll ( word );
+						break;
+					}
+					slot >>= 6;
+					level++;
+				}
+				while ( level-- > 0 )
+					slot = ( slot << 6 ) | __builtin_ctzll ( m_bits[ level ][ slot ] );
+				return slot;
+			}
+
+			/* Same thing, the other way around */
+			size_t nextBelow ( size_t slot ) const
+			{
+				size_t level ( 0 );
+				while ( true )
+				{
+					if ( level == m_bits.size() )
+						return npos;
+					unsigned bit ( slot & 63 );
+					uint64_t word ( m_bits[ level ][ slot >> 6 ] & ( ( 1ull << bit ) - 1 ) );
+					if ( word )
+					{
+						slot = ( slot & ~static_cast < size_t > ( 63 ) ) | ( 63 - __builtin_clzll ( word ) );
+						break;
+					}
+					slot >>= 6;
+					level++;
+				}
+				while ( level-- > 0 )
+					slot = ( slot << 6 ) | ( 63 - __builtin_clzll ( m_bits[ level ][ slot ] ) );
+				return slot;
+			}
+
+			const size_t m_max_window;
+			// the price of the first slot, and how far apart the slots are. A tick of 0 means we haven't seen a price yet
+			uint32_t m_base;
+			uint32_t m_tick;
+			std::vector < Level > m_levels;
+			// m_bits[0] has a bit for every slot, every next one a bit for every word of the one before
+			std::vector < std::vector < uint64_t > > m_bits;
+			// the top of the book in the window, npos if the window's empty
+			size_t m_best;
+			size_t m_window_size;
+			FarLevels m_far;
+			uint64_t m_volume;
+			size_t m_orders;
+		};
+
+		template < class T, class Queue > const size_t PriceLadder<T, Queue>::min_window;
+		template < class T, class Queue > const size_t PriceLadder<T, Queue>::default_max_window;
+		template < class T, class Queue > const size_t PriceLadder<T, Queue>::npos;
+		template < class T, class Queue > const bool PriceLadder<T, Queue>::ascending;
+	}
+}
+
+#endif
@@ -6,29 +6,41 @@
 #include <unordered_map>
 
 #include "OrderList.hpp"
-#include "Trade.hpp"
 
 namespace JumpInterview {
 	namespace OrderBook {
 
 		/*
-		 * A map+table that has constant time lookups, but still O(logN) only when we create a new price level
+		 * A map+table that has constant time lookups, but still O(logN) only when we create a new price level.
+		 * Every level is a Queue of orders, an OrderList unless we're told otherwise. A price is whatever the comparator
+		 * compares, so a std::greater<uint64_t> gives us levels at 64 bit prices ( see PriceTraits ).
 		 */
-		template <class T>
+		template < class T, class Queue = OrderList >
 		class PriceLevelMap
 		{
 		public:
-			typedef typename std::map < uint32_t, OrderList_ptr, T > LevelsTree;
+			typedef typename T::first_argument_type Price;
+			typedef std::shared_ptr < Queue > Queue_ptr;
+			typedef typename std::map < Price, Queue_ptr, T > LevelsTree;
+			typedef typename LevelsTree::const_iterator const_iterator;
+			// what puts the top of the book first
+			typedef T Compare;
+
+			PriceLevelMap() :
+				m_volume ( 0 ),
+				m_orders ( 0 )
+			{
+			}
 
 			/* Add( O(1) ) or Find ( O(logN) ) the price level in the map */
-			OrderList_ptr & add ( uint32_t price )
+			Queue_ptr & add ( Price price )
 			{
 				typename LevelsTable::iterator iter ( m_table.find ( price ) );
 				if ( iter != m_table.end() )
 					return iter->second->second;
 				else
 				{
-					OrderList_ptr node_list = std::make_shared < OrderList > ();
+					Queue_ptr node_list = std::make_shared < Queue > ();
 					typename LevelsTree::iterator iter = m_tree.insert ( std::make_pair ( price, node_list ) ).first;
 					m_table.insert ( std::make_pair ( price, iter ) );
 					return iter->second;
@@ -36,7 +48,7 @@ namespace JumpInterview {
 			}
 
 			/* Remove ( O(1) ) the price level from the map */
-			void remove ( uint32_t price )
+			void remove ( Price price )
 			{
 				typename LevelsTable::const_iterator iter ( m_table.find ( price ) );
 				assert ( iter != m_table.end() );
@@ -61,6 +73,15 @@ namespace JumpInterview {
 			{
 				m_table.clear();
 				m_tree.clear();
+				m_volume = 0;
+				m_orders = 0;
+			}
+
+			/* The level at this price, 0 if we don't have it. O(1) */
+			Queue const * find ( Price price ) const
+			{
+				typename LevelsTable::const_iterator iter ( m_table.find ( price ) );
+				return iter == m_table.end() ? 0 : iter->second->second.get();
 			}
 
 			typename LevelsTree::const_iterator begin() const
@@ -73,7 +94,13 @@ namespace JumpInterview {
 				return m_tree.end();
 			}
 
-			void print ( std::ostream& os ) const
+			/* The first level after this price, going down from the top of the book. We don't need a level at this price */
+			const_iterator after ( Price price ) const
+			{
+				return m_tree.upper_bound ( price );
+			}
+
+			void print ( OutputBuffer & out ) const
 			{
 				static const char * empty ( "<empty>" );
 				if ( !m_tree.empty() )
@@ -81,45 +108,40 @@ namespace JumpInterview {
 							iter != m_tree.end();
 							iter++ )
 					{
-						OrderList_ptr const & list ( iter->second );
-						os << *list;
+						Queue_ptr const & list ( iter->second );
+						list->print ( out );
 					}
 				else
-					os << empty << std::endl;
+				{
+					out.append ( empty );
+					out.endLine();
+				}
 			}
 
-			/*
-			 * Starting with the top price level, tries to get 'volume_to_go' down to 0
-			 * This is, if it would have still matched on this side. ( different comparer for B/S )
-			 *
-			 * Does not remove the orders or anything, simply fills in a vector with expected trades
-			 */
-			void matchTrades ( Trade_vct & vct, uint32_t price, uint32_t & volume_to_go )
+			/* All of the volume, and all of the orders, on this side. O(1) */
+			uint64_t volume() const
 			{
-				static T t;
-				assert ( m_tree.size() > 0 );
-				for ( auto iter = m_tree.begin();
-						iter != m_tree.end() && t ( iter->first, price ) && volume_to_go > 0;
-						iter++ )
-				{
-					OrderList_ptr const & list ( iter->second );
-					for ( OrderNode_list::iterator iter = list->begin();
-							iter != list->end() && volume_to_go > 0;
-							iter ++ )
-					{
-						Order_ptr const & order ( ( *iter )->order() );
-						Trade_ptr new_trade ( new Trade ( std::min ( volume_to_go, order->volume() ), order->price() ) );
-						vct.push_back ( new_trade );
-						assert ( volume_to_go >= new_trade->volume() );
-						volume_to_go -= new_trade->volume();
-					}
-				}
+				return m_volume;
+			}
+
+			size_t orders() const
+			{
+				return m_orders;
+			}
+
+			/* Whoever queues, removes or reduces orders in our levels tells us how that changed our totals */
+			void adjustTotals ( int64_t volume, int64_t orders )
+			{
+				m_volume += volume;
+				m_orders += orders;
 			}
 
 		private:
-			typedef typename std::unordered_map < uint32_t, typename LevelsTree::iterator > LevelsTable;
+			typedef typename std::unordered_map < Price, typename LevelsTree::iterator > LevelsTable;
 			LevelsTree m_tree;
 			LevelsTable m_table;
+			uint64_t m_volume;
+			size_t m_orders;
 		};
 	}
 }
@@ -0,0 +1,50 @@
+#ifndef __PRICE_TRAITS_HPP__
+#define __PRICE_TRAITS_HPP__
+
+#include <stdint.h>
+#include <limits>
+
+#include "Constants.hpp"
+
+namespace JumpInterview {
+	namespace OrderBook {
+
+		/* How many decimals a power of 10 gives us */
+		constexpr uint32_t decimalsOf ( uint64_t scale )
+		{
+			return scale < 10 ? 0 : 1 + decimalsOf ( scale / 10 );
+		}
+
+		/*
+		 * What a price is: a number of ticks of 1/scale, kept in a Price. The scale has to be a power of 10, so a price
+		 * still reads and prints as a plain decimal. The feed and the books use DefaultPriceTraits. An instrument with
+		 * coarser ticks, or with prices that don't fit in 32 bits worth of them, can pick something else for parsing
+		 * ( see FeedHandler::parsePrice ), its price levels ( see PriceLevelMap ) and printing ( see NumberFormat ).
+		 *
+		 * through_double is for the feed's own prices, which have always been read as a double, multiplied by the
+		 * scale and rounded down - so 2.01 is 2009 ticks. The books have to stay exactly what they've always been.
+		 */
+		template < class PriceType, uint32_t scale, bool through_double = false >
+		struct PriceTraits
+		{
+			static_assert ( !std::numeric_limits < PriceType >::is_signed, "prices are always positive" );
+			typedef PriceType Price;
+			static const uint32_t price_scale = scale;
+			static const uint32_t price_decimals = decimalsOf ( scale );
+			static const bool rounds_through_double = through_double;
+		};
+
+		template < class PriceType, uint32_t scale, bool through_double > const uint32_t PriceTraits < PriceType, scale, through_double >::price_scale;
+		template < class PriceType, uint32_t scale, bool through_double > const uint32_t PriceTraits < PriceType, scale, through_double >::price_decimals;
+		template < class PriceType, uint32_t scale, bool through_double > const bool PriceTraits < PriceType, scale, through_double >::rounds_through_double;
+
+		/* What the feed has always had: 0.001 ticks in 32 bits, rounded the way a double does */
+		typedef PriceTraits < uint32_t, Constants::price_scale, true > DefaultPriceTraits;
+		/* For instruments that never trade in anything smaller than a cent */
+		typedef PriceTraits < uint32_t, 100 > CentPriceTraits;
+		/* Millionths, in 64 bits */
+		typedef PriceTraits < uint64_t, 1000000 > WidePriceTraits;
+	}
+}
+
+#endif
@@ -0,0 +1,211 @@
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <thread>
+
+#include "FeedHandler.hpp"
+#include "Replay.hpp"
+
+namespace JumpInterview {
+	namespace OrderBook {
+
+		LatencyHistogram::LatencyHistogram() :
+			m_count ( 0 ),
+			m_max ( 0 ),
+			m_sum ( 0 )
+		{
+			memset ( m_buckets, 0, sizeof ( m_buckets ) );
+		}
+
+		/* The first 16 buckets are one nanosecond each, after that every power of two gets 16 of its own */
+		size_t LatencyHistogram::bucket ( uint64_t ns )
+		{
+			if ( ns < sub_buckets )
+				return ns;
+			size_t power ( 63 - __builtin_clzll ( ns ) );
+			return ( power - 3 ) * sub_buckets + ( ( ns >> ( power - 4 ) ) & ( sub_buckets - 1 ) );
+		}
+
+		uint64_t LatencyHistogram::highest ( size_t bucket )
+		{
+			if ( bucket < sub_buckets )
+				return bucket;
+			size_t power ( bucket / sub_buckets + 3 );
+			uint64_t width ( uint64_t ( 1 ) << ( power - 4 ) );
+			return ( sub_buckets + bucket % sub_buckets ) * width + width - 1;
+		}
+
+		void LatencyHistogram::record ( uint64_t ns )
+		{
+			m_buckets[ bucket ( ns ) ]++;
+			m_count++;
+			m_max = std::max ( m_max, ns );
+			m_sum += ns;
+		}
+
+		uint64_t LatencyHistogram::count() const
+		{
+			return m_count;
+		}
+
+		uint64_t LatencyHistogram::max() const
+		{
+			return m_max;
+		}
+
+		double LatencyHistogram::mean() const
+		{
+			return m_count ? static_cast < double > ( m_sum ) / m_count : 0;
+		}
+
+		uint64_t LatencyHistogram::percentile ( double p ) const
+		{
+			if ( !m_count )
+				return 0;
+			// the smallest value that at least p percent of them are at or under
+			uint64_t wanted ( std::max < uint64_t > ( static_cast < uint64_t > ( p / 100 * m_count + 0.5 ), 1 ) );
+			uint64_t seen ( 0 );
+			for ( size_t i = 0; i < bucket_count; i++ )
+			{
+				seen += m_buckets[i];
+				if ( seen >= wanted )
+					return std::min ( highest ( i ), m_max );
+			}
+			return m_max;
+		}
+
+		const size_t LatencyHistogram::sub_buckets;
+		const size_t LatencyHistogram::bucket_count;
+
+		Pacer::Pacer ( Clock::duration spin_time ) :
+			m_spin_time ( spin_time )
+		{
+		}
+
+		void Pacer::waitUntil ( Clock::time_point when )
+		{
+			Clock::time_point now ( Clock::now() );
+			while ( when - now > m_spin_time )
+			{
+				std::this_thread::sleep_for ( when - now - m_spin_time );
+				now = Clock::now();
+			}
+			while ( Clock::now() < when )
+				;
+		}
+
+		const uint32_t Pacer::default_spin_us;
+
+		ReplayDriver::ReplayDriver ( double speed ) :
+			m_speed ( std::max ( speed, 0.0 ) ),
+			m_started ( false ),
+			m_timed ( false ),
+			m_first_capture ( 0 ),
+			m_last_capture ( 0 ),
+			m_late ( 0 )
+		{
+		}
+
+		bool ReplayDriver::parse ( MessageView const & line, uint64_t & capture_ns, Message & message )
+		{
+			size_t pos ( 0 );
+			uint64_t value ( 0 );
+			for ( ; line[pos] >= '0' && line[pos] <= '9'; pos++ )
+				value = value * 10 + ( line[pos] - '0' );
+			if ( !pos || line[pos] != ',' )
+			{
+				FeedHandler::parse ( line, message );
+				return false;
+			}
+			capture_ns = value;
+			FeedHandler::parse ( MessageView ( line.data() + pos + 1, line.size() - pos - 1 ), message );
+			return true;
+		}
+
+		/*
+		 * Messages before the first capture time are due when we get to them. After that, a message is due as long
+		 * after the first timed one as it was captured after it, divided by the speed.
+		 */
+		ReplayDriver::Clock::time_point ReplayDriver::wait ( uint64_t capture_ns, bool has_capture_time )
+		{
+			if ( !m_speed && m_started )
+				return m_end;
+			Clock::time_point now ( Clock::now() );
+			if ( !m_started )
+			{
+				m_started = true;
+				m_start = m_end = now;
+			}
+			if ( !m_speed )
+				return now;
+			if ( has_capture_time && !m_timed )
+			{
+				m_timed = true;
+				m_first_capture = m_last_capture = capture_ns;
+				m_first_due = now;
+			}
+			if ( !m_timed )
+				return now;
+			if ( has_capture_time )
+				m_last_capture = std::max ( m_last_capture, capture_ns );
+			Clock::time_point due ( m_first_due + std::chrono::duration_cast < Clock::duration > (
+										std::chrono::duration < double, std::nano > ( ( m_last_capture - m_first_capture ) / m_speed ) ) );
+			if ( due > now )
+				m_pacer.waitUntil ( due );
+			else if ( due < now )
+				m_late++;
+			return due;
+		}
+
+		void ReplayDriver::done ( MessageType::Type type, Clock::time_point due )
+		{
+			m_end = Clock::now();
+			size_t index ( std::min < size_t > ( type, type_count - 1 ) );
+			m_latencies[ index ].record ( std::max < int64_t > ( std::chrono::duration_cast < std::chrono::nanoseconds > ( m_end - due ).count(), 0 ) );
+		}
+
+		LatencyHistogram const & ReplayDriver::latencies ( MessageType::Type type ) const
+		{
+			return m_latencies[ std::min < size_t > ( type, type_count - 1 ) ];
+		}
+
+		uint64_t ReplayDriver::late() const
+		{
+			return m_late;
+		}
+
+		ReplayDriver::Clock::duration ReplayDriver::elapsed() const
+		{
+			return m_end - m_start;
+		}
+
+		std::ostream& operator<< ( std::ostream& os, const ReplayDriver& driver )
+		{
+			static const char * names[ ReplayDriver::type_count ] = { "A", "X", "M", "T", "unparsed" };
+			static const double percentiles[] = { 50, 90, 99, 99.9 };
+			static const char * percentile_names[] = { "50%", "90%", "99%", "99.9%" };
+			std::ios::fmtflags flags ( os.flags() );
+			std::streamsize precision ( os.precision() );
+			os << std::fixed << std::setprecision ( 1 );
+			uint64_t messages ( 0 );
+			for ( size_t i = 0; i < ReplayDriver::type_count; i++ )
+			{
+				LatencyHistogram const & latencies ( driver.m_latencies[i] );
+				messages += latencies.count();
+				if ( !latencies.count() )
+					continue;
+				os << "[ REPLAY] " << names[i] << ": " << latencies.count() << " messages, latency in us: mean " << latencies.mean() / 1000;
+				for ( size_t p = 0; p < sizeof ( percentiles ) / sizeof ( percentiles[0] ); p++ )
+					os << ", " << percentile_names[p] << " " << latencies.percentile ( percentiles[p] ) / 1000.0;
+				os << ", max " << latencies.max() / 1000.0 << std::endl;
+			}
+			os << "[ REPLAY] " << messages << " messages in " << std::setprecision ( 3 ) << std::chrono::duration < double > ( driver.elapsed() ).count() << "s, " <<
+			   driver.m_late << " of them late" << std::endl;
+			os.flags ( flags );
+			os.precision ( precision );
+			return os;
+		}
+
+		const size_t ReplayDriver::type_count;
+	}
+}
@@ -0,0 +1,131 @@
+#ifndef __REPLAY_HPP__
+#define __REPLAY_HPP__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <chrono>
+#include <ostream>
+
+#include "Message.hpp"
+#include "MessageView.hpp"
+
+namespace JumpInterview {
+	namespace OrderBook {
+
+		/*
+		 * How long things took, in nanoseconds, without keeping every one of them. Every power of two is cut into 16
+		 * buckets, so a percentile is never more than 1/16th off - and never less than what really happened, we give
+		 * the top of its bucket. Anything under 16ns is exact.
+		 */
+		class LatencyHistogram
+		{
+		public:
+			LatencyHistogram();
+
+			void record ( uint64_t ns );
+
+			uint64_t count() const;
+			uint64_t max() const;
+			double mean() const;
+			/* 0 to 100. 0 if there's nothing in here */
+			uint64_t percentile ( double p ) const;
+		private:
+			static const size_t sub_buckets = 16;
+			static const size_t bucket_count = 64 * sub_buckets;
+
+			static size_t bucket ( uint64_t ns );
+			static uint64_t highest ( size_t bucket );
+
+			uint64_t m_buckets[ bucket_count ];
+			uint64_t m_count;
+			uint64_t m_max;
+			uint64_t m_sum;
+		};
+
+		/*
+		 * Waits until a given time, and gets there on the dot: sleeping is cheap but may well oversleep by a scheduler
+		 * tick, spinning isn't. So we sleep until we're spin_time away, and spin the rest.
+		 */
+		class Pacer
+		{
+		public:
+			typedef std::chrono::steady_clock Clock;
+			static const uint32_t default_spin_us = 50;
+
+			Pacer ( Clock::duration spin_time = std::chrono::microseconds ( default_spin_us ) );
+
+			/* Returns straight away if we're already there, or past it */
+			void waitUntil ( Clock::time_point when );
+		private:
+			Clock::duration m_spin_time;
+		};
+
+		/*
+		 * Plays a captured feed back at the pace it was captured at, speed times faster, or as fast as we can ( a speed
+		 * of 0 ). Every message is due at the time it was captured at, relative to the first one, and is handed over
+		 * once it's due. How long it took from then until we were done with it goes into the histogram for its type - so
+		 * when we fall behind, the time a message spent waiting for the ones before it counts too, the way it would have
+		 * in production. As fast as we can, a message is due as soon as we're done with the one before it - so reading and
+		 * parsing it is part of how long it took us, and we only read the clock once a message.
+		 *
+		 * A captured feed is a text feed with the capture time, in nanoseconds, in front of every line:
+		 *
+		 *   1697012345000001234,A,100000,S,1,1075
+		 *
+		 * Only the difference between two of them matters. A line without one ( no message starts with a digit ) is due
+		 * along with the one before it, and so is a line whose capture time went backwards.
+		 */
+		class ReplayDriver
+		{
+		public:
+			typedef Pacer::Clock Clock;
+			// ADD, REMOVE, MODIFY and TRADE, and everything we couldn't make anything of
+			static const size_t type_count = 5;
+
+			ReplayDriver ( double speed );
+
+			/* Splits the capture time off a line, and parses what's left ( see FeedHandler::parse ). False if there isn't one */
+			static bool parse ( MessageView const & line, uint64_t & capture_ns, Message & message );
+
+			/* Waits until a message captured at this time is due, and returns when that was */
+			Clock::time_point wait ( uint64_t capture_ns, bool has_capture_time = true );
+			/* We're done with a message that was due then */
+			void done ( MessageType::Type type, Clock::time_point due );
+
+			/* Does a whole message: waits for it, hands it to whatever has a process ( message ) and records how long that took */
+			template < class Processor >
+			void replay ( uint64_t capture_ns, bool has_capture_time, Message const & message, Processor & processor )
+			{
+				Clock::time_point due ( wait ( capture_ns, has_capture_time ) );
+				processor.process ( message );
+				done ( message.type, due );
+			}
+
+			LatencyHistogram const & latencies ( MessageType::Type type ) const;
+			/* How many messages were already due by the time we got to them */
+			uint64_t late() const;
+			/* From the first message being due until we were done with the last one */
+			Clock::duration elapsed() const;
+
+			/* One line per type, for the ones we've seen */
+			friend std::ostream& operator<< ( std::ostream& os, const ReplayDriver& driver );
+		private:
+			ReplayDriver ( ReplayDriver const & rhs ) {}
+
+			double m_speed;
+			Pacer m_pacer;
+			bool m_started;
+			// have we seen a capture time yet, and when was that one due
+			bool m_timed;
+			uint64_t m_first_capture;
+			uint64_t m_last_capture;
+			Clock::time_point m_first_due;
+			Clock::time_point m_start;
+			Clock::time_point m_end;
+			uint64_t m_late;
+			LatencyHistogram m_latencies[ type_count ];
+		};
+	}
+}
+
+#endif
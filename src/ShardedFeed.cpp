@@ -0,0 +1,137 @@
+#include <assert.h>
+#include <algorithm>
+
+#include "ShardedFeed.hpp"
+
+namespace JumpInterview {
+	namespace OrderBook {
+
+		ShardedFeed::ShardedFeed ( size_t workers ) :
+			m_closing ( false ),
+			m_stalls ( 0 )
+		{
+			if ( !workers )
+				workers = 1;
+			for ( size_t i = 0; i < workers; i++ )
+				m_workers.push_back ( std::unique_ptr < Worker > ( new Worker() ) );
+			// only once they're all there, workerOf depends on how many we've got
+			for ( size_t i = 0; i < workers; i++ )
+				m_workers[i]->thread = std::thread ( &ShardedFeed::run, this, std::ref ( *m_workers[i] ) );
+		}
+
+		ShardedFeed::~ShardedFeed()
+		{
+			close();
+		}
+
+		void ShardedFeed::close()
+		{
+			if ( m_closing.load() )
+				return;
+			for ( size_t i = 0; i < m_workers.size(); i++ )
+				if ( m_workers[i]->pending.count )
+					push ( *m_workers[i] );
+			m_closing.store ( true );
+			for ( size_t i = 0; i < m_workers.size(); i++ )
+				m_workers[i]->thread.join();
+		}
+
+		void ShardedFeed::push ( Worker & worker )
+		{
+			if ( !worker.ring.tryPush ( worker.pending ) )
+			{
+				m_stalls++;
+				// the worker is the only one that can make room, so let it have the core
+				while ( !worker.ring.tryPush ( worker.pending ) )
+					std::this_thread::yield();
+			}
+			worker.pending.count = 0;
+		}
+
+		/*
+		 * A worker thread. We don't keep the output, so we might as well only write the mid price once per batch.
+		 */
+		void ShardedFeed::run ( Worker & worker )
+		{
+			MessageBatch const * batch;
+			while ( true )
+			{
+				if ( worker.ring.front ( batch ) )
+				{
+					worker.feed.processBatch ( batch->messages, batch->count, worker.out, false );
+					worker.ring.pop ( 1 );
+					continue;
+				}
+				// once we're closing nothing new comes in, but something may have just before
+				if ( m_closing.load() )
+				{
+					if ( !worker.ring.front ( batch ) )
+						break;
+					continue;
+				}
+				std::this_thread::yield();
+			}
+			worker.out.flush();
+		}
+
+		size_t ShardedFeed::workers() const
+		{
+			return m_workers.size();
+		}
+
+		FeedHandler const & ShardedFeed::feed ( size_t worker ) const
+		{
+			assert ( worker < m_workers.size() );
+			return m_workers[ worker ]->feed;
+		}
+
+		uint64_t ShardedFeed::stalls() const
+		{
+			return m_stalls;
+		}
+
+		Instrument const * ShardedFeed::instrument ( Symbol symbol ) const
+		{
+			return m_workers[ workerOf ( symbol ) ]->feed.instrument ( symbol );
+		}
+
+		std::vector < Symbol > ShardedFeed::symbols() const
+		{
+			std::vector < Symbol > symbols;
+			for ( size_t i = 0; i < m_workers.size(); i++ )
+			{
+				std::vector < Symbol > const & known ( m_workers[i]->feed.instruments().symbols() );
+				symbols.insert ( symbols.end(), known.begin(), known.end() );
+			}
+			std::sort ( symbols.begin(), symbols.end() );
+			return symbols;
+		}
+
+		/*
+		 * Exactly what a single FeedHandler's printCurrentOrderBook would have written
+		 */
+		void ShardedFeed::printCurrentOrderBook ( OutputBuffer & out ) const
+		{
+			instrument ( 0 )->printBook ( out );
+			std::vector < Symbol > all ( symbols() );
+			for ( size_t i = 0; i < all.size(); i++ )
+				instrument ( all[i] )->printBook ( out );
+		}
+
+		void ShardedFeed::printErrorSummary ( std::ostream & os ) const
+		{
+			instrument ( 0 )->printErrors ( os );
+			std::vector < Symbol > all ( symbols() );
+			for ( size_t i = 0; i < all.size(); i++ )
+				instrument ( all[i] )->printErrors ( os );
+		}
+
+		bool ShardedFeed::hasErrors() const
+		{
+			for ( size_t i = 0; i < m_workers.size(); i++ )
+				if ( m_workers[i]->feed.hasErrors() )
+					return true;
+			return false;
+		}
+	}
+}
@@ -0,0 +1,100 @@
+#ifndef __SHARDED_FEED_HPP__
+#define __SHARDED_FEED_HPP__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <memory>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+#include "FeedHandler.hpp"
+#include "Message.hpp"
+#include "OutputBuffer.hpp"
+#include "SpscRing.hpp"
+
+namespace JumpInterview {
+	namespace OrderBook {
+
+		/*
+		 * Spreads instruments over worker threads. Every worker has a FeedHandler of its own, and every instrument
+		 * belongs to exactly one worker ( picked by hashing its symbol ), so a worker never touches anything another
+		 * one does. The thread calling process() only routes: it collects the messages for every worker in a
+		 * MessageBatch, and hands that over through a lock-free ring of the worker's own ( see SpscRing ).
+		 *
+		 * Messages for the same instrument reach its worker in the order they were processed in, so every book and
+		 * ErrorSummary comes out exactly like a single FeedHandler would have them. There's no order between messages
+		 * for different instruments though, so the workers don't keep what they write for every message ( they still
+		 * format it ). Once we're closed, the books and errors for every instrument can be printed like a single
+		 * FeedHandler would print them.
+		 *
+		 * process() and close() may only be called from one thread.
+		 */
+		class ShardedFeed
+		{
+		public:
+			// batches per worker that can be waiting
+			static const size_t default_ring_capacity = 64;
+
+			/* Starts the workers straight away */
+			ShardedFeed ( size_t workers );
+			/* Closes if we haven't yet */
+			~ShardedFeed();
+
+			void process ( Message const & message )
+			{
+				Worker & worker ( *m_workers[ workerOf ( message.symbol ) ] );
+				worker.pending.messages[ worker.pending.count++ ] = message;
+				if ( worker.pending.count == MessageBatch::capacity )
+					push ( worker );
+			}
+
+			/* Hands over what's left, waits until every worker is done and stops them */
+			void close();
+
+			size_t workers() const;
+			/* Which worker every message for this symbol goes to */
+			size_t workerOf ( Symbol symbol ) const
+			{
+				// multiplying spreads the characters over the top bits, that's where we take our pick from
+				return ( ( symbol * 0x9E3779B97F4A7C15ull ) >> 32 ) % m_workers.size();
+			}
+
+			/* Only once we're closed */
+			FeedHandler const & feed ( size_t worker ) const;
+			void printCurrentOrderBook ( OutputBuffer & out ) const;
+			void printErrorSummary ( std::ostream & os ) const;
+			bool hasErrors() const;
+			/* How often the routing thread found a worker's ring full, and had to wait */
+			uint64_t stalls() const;
+		private:
+			struct Worker
+			{
+				Worker() : out ( sink ), ring ( default_ring_capacity ) {}
+				FeedHandler feed;
+				NullSink sink;
+				OutputBuffer out;
+				SpscRing < MessageBatch > ring;
+				// only touched by the routing thread
+				MessageBatch pending;
+				std::thread thread;
+			};
+
+			ShardedFeed ( ShardedFeed const & rhs ) {}
+
+			void run ( Worker & worker );
+			void push ( Worker & worker );
+			/* The instrument, from whichever worker has it. 0 if nobody's seen it */
+			Instrument const * instrument ( Symbol symbol ) const;
+			/* Every symbol any worker knows, in order */
+			std::vector < Symbol > symbols() const;
+
+			std::vector < std::unique_ptr < Worker > > m_workers;
+			std::atomic < bool > m_closing;
+			uint64_t m_stalls;
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,56 @@
+#include <cstring>
+
+#include "Snapshot.hpp"
+
+namespace JumpInterview {
+	namespace OrderBook {
+
+		static const char f_magic[4] = { 'J', 'O', 'B', 'S' };
+		static const uint32_t f_version ( 1 );
+
+		void SnapshotWriter::writeHeader()
+		{
+			m_out.append ( f_magic, sizeof ( f_magic ) );
+			write32 ( f_version );
+		}
+
+		void SnapshotWriter::write ( ErrorSummary const & errors )
+		{
+			write32 ( errors.corrupted_messages );
+			write32 ( errors.out_of_bounds_or_weird_numbers );
+			write32 ( errors.order_modify_on_order_i_dont_know );
+			write32 ( errors.order_modify_on_wrong_side );
+			write32 ( errors.duplicate_order_id );
+			write32 ( errors.removes_with_no_corresponding_order );
+			write32 ( errors.trades_with_no_corresponding_order );
+			write32 ( errors.no_trades_when_they_should_happen );
+			write32 ( errors.unexpected_exception );
+		}
+
+		bool SnapshotReader::readHeader()
+		{
+			if ( remaining() < sizeof ( f_magic ) || memcmp ( m_pos, f_magic, sizeof ( f_magic ) ) )
+			{
+				fail();
+				return false;
+			}
+			m_pos += sizeof ( f_magic );
+			if ( read32() != f_version )
+				fail();
+			return good();
+		}
+
+		void SnapshotReader::read ( ErrorSummary & errors )
+		{
+			errors.corrupted_messages = read32();
+			errors.out_of_bounds_or_weird_numbers = read32();
+			errors.order_modify_on_order_i_dont_know = read32();
+			errors.order_modify_on_wrong_side = read32();
+			errors.duplicate_order_id = read32();
+			errors.removes_with_no_corresponding_order = read32();
+			errors.trades_with_no_corresponding_order = read32();
+			errors.no_trades_when_they_should_happen = read32();
+			errors.unexpected_exception = read32();
+		}
+	}
+}
@@ -0,0 +1,139 @@
+#ifndef __SNAPSHOT_HPP__
+#define __SNAPSHOT_HPP__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "Endian.hpp"
+#include "ErrorSummary.hpp"
+#include "OutputBuffer.hpp"
+
+namespace JumpInterview {
+	namespace OrderBook {
+
+		/*
+		 * A binary snapshot of a FeedHandler: every instrument's book and errors, and how far into the feed we were, so
+		 * we can pick up from there rather than replay the feed from the first line ( see FeedHandler::saveSnapshot ).
+		 * It starts with an 8 byte header ( "JOBS" and a version ), and everything after that is little-endian:
+		 *
+		 *   size         field
+		 *   8            position     how many messages went into it
+		 *   4            instruments
+		 *   and for every instrument, the default one first:
+		 *   8            symbol       0 for the default instrument
+		 *   9 x 4        errors       every ErrorSummary counter, in the order they're declared
+		 *   ...          book         see BasicOrderBook::save
+		 */
+		class SnapshotWriter
+		{
+		public:
+			SnapshotWriter ( OutputBuffer & out ) : m_out ( out ) {}
+
+			void writeHeader();
+
+			void write8 ( uint8_t value )
+			{
+				m_out.append ( static_cast < char > ( value ) );
+			}
+
+			void write32 ( uint32_t value )
+			{
+				char bytes[4];
+				LittleEndian::write32 ( bytes, value );
+				m_out.append ( bytes, sizeof ( bytes ) );
+			}
+
+			void write64 ( uint64_t value )
+			{
+				char bytes[8];
+				LittleEndian::write64 ( bytes, value );
+				m_out.append ( bytes, sizeof ( bytes ) );
+			}
+
+			void write ( ErrorSummary const & errors );
+		private:
+			SnapshotWriter ( SnapshotWriter const & rhs ) : m_out ( rhs.m_out ) {}
+
+			OutputBuffer & m_out;
+		};
+
+		/*
+		 * Reads a snapshot straight from memory ( a MappedFile, say ). Reading past the end gives us zeros, and we're no
+		 * good from then on - so a caller can read a whole record, and check once whether it was all there.
+		 */
+		class SnapshotReader
+		{
+		public:
+			SnapshotReader ( const char * data, size_t size ) :
+				m_pos ( data ),
+				m_end ( data + size ),
+				m_good ( true )
+			{
+			}
+
+			/* False if it isn't one of ours, or a version we don't know */
+			bool readHeader();
+
+			uint8_t read8()
+			{
+				if ( !has ( 1 ) )
+					return 0;
+				return static_cast < uint8_t > ( *m_pos++ );
+			}
+
+			uint32_t read32()
+			{
+				if ( !has ( 4 ) )
+					return 0;
+				uint32_t value ( LittleEndian::read32 ( m_pos ) );
+				m_pos += 4;
+				return value;
+			}
+
+			uint64_t read64()
+			{
+				if ( !has ( 8 ) )
+					return 0;
+				uint64_t value ( LittleEndian::read64 ( m_pos ) );
+				m_pos += 8;
+				return value;
+			}
+
+			void read ( ErrorSummary & errors );
+
+			/* We've had everything we asked for, and nobody told us it didn't make sense */
+			bool good() const
+			{
+				return m_good;
+			}
+
+			/* For whoever finds that what they read doesn't make sense */
+			void fail()
+			{
+				m_good = false;
+				m_pos = m_end;
+			}
+
+			size_t remaining() const
+			{
+				return m_end - m_pos;
+			}
+		private:
+			SnapshotReader ( SnapshotReader const & rhs ) {}
+
+			bool has ( size_t bytes )
+			{
+				if ( static_cast < size_t > ( m_end - m_pos ) >= bytes )
+					return true;
+				fail();
+				return false;
+			}
+
+			const char * m_pos;
+			const char * m_end;
+			bool m_good;
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef __SPSC_RING_HPP__
+#define __SPSC_RING_HPP__
+
+#include <assert.h>
+#include <stddef.h>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+namespace JumpInterview {
+	namespace OrderBook {
+
+		/*
+		 * A fixed size ring buffer for exactly one producer thread and one consumer thread, without any locks.
+		 *
+		 * Both sides only ever write their own index ( the producer the tail, the consumer the head ). The producer
+		 * keeps a private copy of the head and only looks at the real one when it seems to be running out of room,
+		 * so most pushes don't touch the consumer's cache line at all. Indices keep counting up and we mask them,
+		 * which is why the capacity is a power of 2.
+		 *
+		 * Everything on the producer side may only be called from the producer thread, the same goes for the consumer.
+		 */
+		template < class T >
+		class SpscRing
+		{
+		public:
+			/* Rounded up to a power of 2 */
+			SpscRing ( size_t capacity ) :
+				m_buffer ( roundUp ( capacity ) ),
+				m_mask ( m_buffer.size() - 1 ),
+				m_head ( 0 ),
+				m_cached_tail ( 0 ),
+				m_tail ( 0 ),
+				m_cached_head ( 0 )
+			{
+			}
+
+			size_t capacity() const
+			{
+				return m_buffer.size();
+			}
+
+			/* How much is in there right now. Only a snapshot if you're not the consumer */
+			size_t size() const
+			{
+				return m_tail.load ( std::memory_order_acquire ) - m_head.load ( std::memory_order_acquire );
+			}
+
+			bool empty() const
+			{
+				return !size();
+			}
+
+			/* Producer: how much we could push right now */
+			size_t freeSpace()
+			{
+				size_t tail ( m_tail.load ( std::memory_order_relaxed ) );
+				m_cached_head = m_head.load ( std::memory_order_acquire );
+				return capacity() - ( tail - m_cached_head );
+			}
+
+			/* Producer */
+			bool tryPush ( T const & value )
+			{
+				return push ( &value, 1 ) == 1;
+			}
+
+			/* Producer: pushes as many as fit, and returns how many that were */
+			size_t push ( T const * values, size_t count )
+			{
+				size_t tail ( m_tail.load ( std::memory_order_relaxed ) );
+				size_t available ( capacity() - ( tail - m_cached_head ) );
+				if ( available < count )
+				{
+					// only go and look at where the consumer really is when our copy isn't good enough
+					m_cached_head = m_head.load ( std::memory_order_acquire );
+					available = capacity() - ( tail - m_cached_head );
+				}
+				size_t pushed ( std::min ( count, available ) );
+				// at most two pieces: up to the end of the buffer, and from the start again
+				size_t offset ( tail & m_mask );
+				size_t first ( std::min ( pushed, capacity() - offset ) );
+				std::copy ( values, values + first, &m_buffer[ offset ] );
+				std::copy ( values + first, values + pushed, &m_buffer[0] );
+				m_tail.store ( tail + pushed, std::memory_order_release );
+				return pushed;
+			}
+
+			/* Consumer */
+			bool tryPop ( T & value )
+			{
+				T const * front_values;
+				if ( !front ( front_values ) )
+					return false;
+				value = *front_values;
+				pop ( 1 );
+				return true;
+			}
+
+			/*
+			 * Consumer: points values at the oldest elements without taking them out, and returns how many of them
+			 * sit next to each other in memory ( so not necessarily all we've got, when we wrap around )
+			 */
+			size_t front ( T const * & values )
+			{
+				size_t head ( m_head.load ( std::memory_order_relaxed ) );
+				// we want everything we can get here, so always look at where the producer is now
+				m_cached_tail = m_tail.load ( std::memory_order_acquire );
+				size_t offset ( head & m_mask );
+				values = &m_buffer[ offset ];
+				return std::min ( m_cached_tail - head, capacity() - offset );
+			}
+
+			/* Consumer: we're done with this many elements from the front */
+			void pop ( size_t count )
+			{
+				size_t head ( m_head.load ( std::memory_order_relaxed ) );
+				assert ( count <= m_cached_tail - head );
+				m_head.store ( head + count, std::memory_order_release );
+			}
+		private:
+			// keeps the two sides' indices on separate cache lines
+			static const size_t cache_line = 64;
+
+			SpscRing ( SpscRing const & rhs ) {}
+
+			static size_t roundUp ( size_t capacity )
+			{
+				size_t rounded ( 1 );
+				while ( rounded < capacity )
+					rounded <<= 1;
+				return rounded;
+			}
+
+			std::vector < T > m_buffer;
+			size_t m_mask;
+			char m_pad0[ cache_line ];
+			// the consumer's side
+			std::atomic < size_t > m_head;
+			size_t m_cached_tail;
+			char m_pad1[ cache_line ];
+			// the producer's side
+			std::atomic < size_t > m_tail;
+			size_t m_cached_head;
+			char m_pad2[ cache_line ];
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef __STD_INDEX_HPP__
+#define __STD_INDEX_HPP__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <unordered_map>
+#include <utility>
+
+namespace JumpInterview {
+	namespace OrderBook {
+
+		/*
+		 * A FlatIndex's interface on top of a std::unordered_map - what the order index used to be. It's still there so
+		 * a book on std containers only can be held up against the others ( see StdOrderBook ).
+		 */
+		template < class T >
+		class StdIndex
+		{
+		public:
+			size_t size() const
+			{
+				return m_map.size();
+			}
+
+			bool empty() const
+			{
+				return m_map.empty();
+			}
+
+			/* 0 if we don't have it */
+			T * find ( uint32_t key )
+			{
+				typename Map::iterator iter ( m_map.find ( key ) );
+				return iter == m_map.end() ? 0 : &iter->second;
+			}
+
+			T const * find ( uint32_t key ) const
+			{
+				typename Map::const_iterator iter ( m_map.find ( key ) );
+				return iter == m_map.end() ? 0 : &iter->second;
+			}
+
+			/* False ( and nothing changes ) if we already have this key */
+			bool insert ( uint32_t key, T const & value )
+			{
+				return m_map.insert ( std::make_pair ( key, value ) ).second;
+			}
+
+			/* False if we didn't have this key */
+			bool erase ( uint32_t key )
+			{
+				return m_map.erase ( key ) == 1;
+			}
+
+			void reserve ( size_t count )
+			{
+				m_map.reserve ( count );
+			}
+
+			void clear()
+			{
+				m_map.clear();
+			}
+		private:
+			typedef std::unordered_map < uint32_t, T > Map;
+
+			Map m_map;
+		};
+	}
+}
+
+#endif
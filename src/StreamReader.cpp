@@ -0,0 +1,361 @@
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <sys/stat.h>
+
+#if defined ( __linux__ ) && defined ( __has_include )
+#if __has_include ( <linux/io_uring.h> )
+#define HAVE_IO_URING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#endif
+#endif
+
+#include "StreamReader.hpp"
+
+namespace JumpInterview {
+	namespace OrderBook {
+
+#ifdef HAVE_IO_URING
+		/*
+		 * Just enough io_uring to have one read going at a time, straight on top of the system calls so we don't
+		 * need liburing. If the kernel doesn't have it ( or won't let us have it ), setup fails and we use a thread.
+		 */
+		struct StreamReader::IoUring
+		{
+			IoUring() :
+				ring_fd ( -1 ),
+				sq_ring ( MAP_FAILED ),
+				cq_ring ( MAP_FAILED ),
+				sqes ( MAP_FAILED ),
+				sq_ring_size ( 0 ),
+				cq_ring_size ( 0 ),
+				sqes_size ( 0 ),
+				seekable ( false ),
+				offset ( 0 )
+			{
+			}
+
+			~IoUring()
+			{
+				if ( sqes != MAP_FAILED )
+					munmap ( sqes, sqes_size );
+				if ( cq_ring != MAP_FAILED && cq_ring != sq_ring )
+					munmap ( cq_ring, cq_ring_size );
+				if ( sq_ring != MAP_FAILED )
+					munmap ( sq_ring, sq_ring_size );
+				// this also cancels a read that's still going
+				if ( ring_fd >= 0 )
+					close ( ring_fd );
+			}
+
+			bool setup ( int fd )
+			{
+				struct io_uring_params params;
+				memset ( &params, 0, sizeof ( params ) );
+				ring_fd = syscall ( __NR_io_uring_setup, 2, &params );
+				if ( ring_fd < 0 )
+					return false;
+				sq_ring_size = params.sq_off.array + params.sq_entries * sizeof ( unsigned );
+				cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof ( struct io_uring_cqe );
+				// newer kernels let us map both rings in one go
+				if ( params.features & IORING_FEAT_SINGLE_MMAP )
+					sq_ring_size = cq_ring_size = std::max ( sq_ring_size, cq_ring_size );
+				sq_ring = mmap ( 0, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING );
+				if ( sq_ring == MAP_FAILED )
+					return false;
+				cq_ring = ( params.features & IORING_FEAT_SINGLE_MMAP ) ? sq_ring :
+						  mmap ( 0, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING );
+				if ( cq_ring == MAP_FAILED )
+					return false;
+				sqes_size = params.sq_entries * sizeof ( struct io_uring_sqe );
+				sqes = mmap ( 0, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES );
+				if ( sqes == MAP_FAILED )
+					return false;
+				char * sq ( static_cast < char * > ( sq_ring ) );
+				char * cq ( static_cast < char * > ( cq_ring ) );
+				sq_tail = reinterpret_cast < unsigned * > ( sq + params.sq_off.tail );
+				sq_mask = *reinterpret_cast < unsigned * > ( sq + params.sq_off.ring_mask );
+				sq_array = reinterpret_cast < unsigned * > ( sq + params.sq_off.array );
+				cq_head = reinterpret_cast < unsigned * > ( cq + params.cq_off.head );
+				cq_tail = reinterpret_cast < unsigned * > ( cq + params.cq_off.tail );
+				cq_mask = *reinterpret_cast < unsigned * > ( cq + params.cq_off.ring_mask );
+				cqes = reinterpret_cast < struct io_uring_cqe * > ( cq + params.cq_off.cqes );
+				// a file has to be read at an offset, a pipe doesn't have one
+				struct stat st;
+				seekable = fstat ( fd, &st ) == 0 && S_ISREG ( st.st_mode );
+				if ( seekable )
+				{
+					off_t position ( lseek ( fd, 0, SEEK_CUR ) );
+					seekable = position >= 0;
+					offset = seekable ? position : 0;
+				}
+				return true;
+			}
+
+			/* readv is the oldest read io_uring has, so this works on any kernel that has io_uring at all */
+			bool submitRead ( int fd, char * data, size_t size, uint64_t block )
+			{
+				iov[ block ].iov_base = data;
+				iov[ block ].iov_len = size;
+				unsigned tail ( *sq_tail );
+				unsigned index ( tail & sq_mask );
+				struct io_uring_sqe * sqe ( static_cast < struct io_uring_sqe * > ( sqes ) + index );
+				memset ( sqe, 0, sizeof ( *sqe ) );
+				sqe->opcode = IORING_OP_READV;
+				sqe->fd = fd;
+				sqe->addr = reinterpret_cast < uint64_t > ( &iov[ block ] );
+				sqe->len = 1;
+				sqe->off = seekable ? offset : 0;
+				sqe->user_data = block;
+				sq_array[ index ] = index;
+				__atomic_store_n ( sq_tail, tail + 1, __ATOMIC_RELEASE );
+				return syscall ( __NR_io_uring_enter, ring_fd, 1, 0, 0, 0, 0 ) == 1;
+			}
+
+			/* Waits for the one read we've got going. Returns what read(2) would have */
+			ssize_t wait()
+			{
+				while ( true )
+				{
+					unsigned head ( *cq_head );
+					if ( head != __atomic_load_n ( cq_tail, __ATOMIC_ACQUIRE ) )
+					{
+						ssize_t result ( cqes[ head & cq_mask ].res );
+						__atomic_store_n ( cq_head, head + 1, __ATOMIC_RELEASE );
+						if ( result > 0 && seekable )
+							offset += result;
+						if ( result < 0 )
+						{
+							errno = -result;
+							return -1;
+						}
+						return result;
+					}
+					if ( syscall ( __NR_io_uring_enter, ring_fd, 0, 1, IORING_ENTER_GETEVENTS, 0, 0 ) < 0 && errno != EINTR )
+						return -1;
+				}
+			}
+
+			int ring_fd;
+			void * sq_ring;
+			void * cq_ring;
+			void * sqes;
+			size_t sq_ring_size;
+			size_t cq_ring_size;
+			size_t sqes_size;
+			unsigned * sq_tail;
+			unsigned sq_mask;
+			unsigned * sq_array;
+			unsigned * cq_head;
+			unsigned * cq_tail;
+			unsigned cq_mask;
+			struct io_uring_cqe * cqes;
+			struct iovec iov[2];
+			bool seekable;
+			uint64_t offset;
+		};
+#else
+		struct StreamReader::IoUring
+		{
+		};
+#endif
+
+		StreamReader::StreamReader ( int fd, bool use_io_uring, size_t block_size ) :
+			m_fd ( fd ),
+			m_next ( 0 ),
+			m_pos ( 0 ),
+			m_end ( 0 ),
+			m_carrying ( false ),
+			m_eof ( false ),
+			m_failed ( false ),
+			m_uring ( 0 ),
+			m_request ( -1 ),
+			m_stopping ( false )
+		{
+			m_blocks[0].resize ( block_size ? block_size : 1 );
+			m_blocks[1].resize ( m_blocks[0].size() );
+			m_has_result[0] = m_has_result[1] = false;
+			m_result[0] = m_result[1] = 0;
+#ifdef F_SETPIPE_SZ
+			// a pipe only holds 64KB by default, so the other end has to wait for us far more often than it needs to.
+			// Only a hint, this fails on anything that isn't a pipe ( or past /proc/sys/fs/pipe-max-size )
+			fcntl ( m_fd, F_SETPIPE_SZ, static_cast < int > ( m_blocks[0].size() ) );
+#endif
+#ifdef HAVE_IO_URING
+			if ( use_io_uring )
+			{
+				m_uring = new IoUring();
+				if ( !m_uring->setup ( m_fd ) )
+				{
+					delete m_uring;
+					m_uring = 0;
+				}
+			}
+#endif
+			if ( !m_uring )
+				m_thread = std::thread ( &StreamReader::run, this );
+			startRead ( 0 );
+		}
+
+		StreamReader::~StreamReader()
+		{
+			if ( m_thread.joinable() )
+			{
+				{
+					std::lock_guard < std::mutex > lock ( m_mutex );
+					m_stopping = true;
+					m_requested.notify_one();
+				}
+				m_thread.join();
+			}
+			delete m_uring;
+		}
+
+		bool StreamReader::good() const
+		{
+			return !m_failed;
+		}
+
+		bool StreamReader::usingIoUring() const
+		{
+			return m_uring != 0;
+		}
+
+		bool StreamReader::nextLine ( MessageView & line )
+		{
+			while ( true )
+			{
+				if ( m_pos < m_end )
+				{
+					const char * newline ( static_cast < const char * > ( memchr ( m_pos, '\n', m_end - m_pos ) ) );
+					if ( newline )
+					{
+						if ( m_carrying )
+						{
+							m_carry.append ( m_pos, newline );
+							m_carrying = false;
+							line = MessageView ( m_carry );
+						}
+						else
+							line = MessageView ( m_pos, newline - m_pos );
+						// skip the '\n' itself
+						m_pos = newline + 1;
+						return true;
+					}
+					// the rest of this line is in the next block
+					if ( !m_carrying )
+					{
+						m_carry.clear();
+						m_carrying = true;
+					}
+					m_carry.append ( m_pos, m_end );
+					m_pos = m_end;
+				}
+				if ( m_eof )
+				{
+					// just like std::getline, a last line without a '\n' still counts
+					if ( !m_carrying )
+						return false;
+					m_carrying = false;
+					line = MessageView ( m_carry );
+					return true;
+				}
+				nextBlock();
+			}
+		}
+
+		/*
+		 * Whatever line we handed out last is done with, so the block we're not waiting for is free again - the next
+		 * read goes in there straight away.
+		 */
+		void StreamReader::nextBlock()
+		{
+			ssize_t size ( finishRead ( m_next ) );
+			if ( size <= 0 )
+			{
+				m_eof = true;
+				m_failed = size < 0;
+				return;
+			}
+			startRead ( m_next ^ 1 );
+			m_pos = &m_blocks[ m_next ][0];
+			m_end = m_pos + size;
+			m_next ^= 1;
+		}
+
+		void StreamReader::startRead ( size_t block )
+		{
+#ifdef HAVE_IO_URING
+			if ( m_uring )
+			{
+				if ( !m_uring->submitRead ( m_fd, &m_blocks[ block ][0], m_blocks[ block ].size(), block ) )
+				{
+					// we'll find out when we wait for it
+					m_has_result[ block ] = true;
+					m_result[ block ] = -1;
+				}
+				return;
+			}
+#endif
+			std::lock_guard < std::mutex > lock ( m_mutex );
+			assert ( m_request < 0 );
+			m_request = static_cast < int > ( block );
+			m_requested.notify_one();
+		}
+
+		ssize_t StreamReader::finishRead ( size_t block )
+		{
+#ifdef HAVE_IO_URING
+			if ( m_uring )
+			{
+				if ( m_has_result[ block ] )
+				{
+					m_has_result[ block ] = false;
+					return m_result[ block ];
+				}
+				return m_uring->wait();
+			}
+#endif
+			std::unique_lock < std::mutex > lock ( m_mutex );
+			while ( !m_has_result[ block ] )
+				m_done.wait ( lock );
+			m_has_result[ block ] = false;
+			return m_result[ block ];
+		}
+
+		/*
+		 * The reader thread, when we don't have io_uring. One read per request, and we hand over whatever it got.
+		 */
+		void StreamReader::run()
+		{
+			while ( true )
+			{
+				int block;
+				{
+					std::unique_lock < std::mutex > lock ( m_mutex );
+					while ( m_request < 0 && !m_stopping )
+						m_requested.wait ( lock );
+					if ( m_request < 0 )
+						return;
+					block = m_request;
+					m_request = -1;
+				}
+				ssize_t size;
+				do
+					size = read ( m_fd, &m_blocks[ block ][0], m_blocks[ block ].size() );
+				while ( size < 0 && errno == EINTR );
+				std::lock_guard < std::mutex > lock ( m_mutex );
+				m_result[ block ] = size;
+				m_has_result[ block ] = true;
+				m_done.notify_one();
+			}
+		}
+	}
+}
@@ -0,0 +1,86 @@
+#ifndef __STREAM_READER_HPP__
+#define __STREAM_READER_HPP__
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MessageView.hpp"
+
+namespace JumpInterview {
+	namespace OrderBook {
+
+		/*
+		 * Reads lines from anything we can't map ( stdin, a pipe, a socket .. ) in large blocks, and hands them out as
+		 * views straight into those blocks. Lines are split exactly like MappedFile and std::getline do it.
+		 *
+		 * There are two blocks: while we hand out the lines in one, the next read already goes into the other, either
+		 * on a reader thread of our own or through io_uring if we're asked to and the kernel lets us. Every read hands
+		 * over whatever it got, so a slow pipe doesn't hold up the lines we already have. A line that doesn't fit in
+		 * what we've read so far is the only thing we ever copy: the part we've got is carried over, and the rest
+		 * added once the next block is in.
+		 *
+		 * A line is only good until the next call to nextLine.
+		 */
+		class StreamReader
+		{
+		public:
+			static const size_t default_block_size = 1024 * 1024;
+
+			StreamReader ( int fd, bool use_io_uring = false, size_t block_size = default_block_size );
+			/* Waits for a read that's still going, the fd stays open */
+			~StreamReader();
+
+			/* Returns false once we've run out of lines, or couldn't read any more */
+			bool nextLine ( MessageView & line );
+
+			/* False if a read failed, rather than the stream coming to an end */
+			bool good() const;
+			/* Did we get io_uring? Without it, we read on a thread of our own */
+			bool usingIoUring() const;
+		private:
+			struct IoUring;
+
+			StreamReader ( StreamReader const & rhs ) {}
+
+			void nextBlock();
+			/* Starts reading into this block, without waiting for it */
+			void startRead ( size_t block );
+			/* Waits for the read into this block. Returns what read(2) would have */
+			ssize_t finishRead ( size_t block );
+			void run();
+
+			int m_fd;
+			std::vector < char > m_blocks[2];
+			// the block we're waiting for next
+			size_t m_next;
+			const char * m_pos;
+			const char * m_end;
+			// the start of a line that didn't end in the block it started in
+			std::string m_carry;
+			bool m_carrying;
+			bool m_eof;
+			bool m_failed;
+
+			// ours, 0 when we read on a thread
+			IoUring * m_uring;
+
+			// the reader thread, when we don't have io_uring
+			std::mutex m_mutex;
+			std::condition_variable m_requested;
+			std::condition_variable m_done;
+			// -1 means nobody asked for anything
+			int m_request;
+			bool m_has_result[2];
+			ssize_t m_result[2];
+			bool m_stopping;
+			std::thread m_thread;
+		};
+	}
+}
+
+#endif
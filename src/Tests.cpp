@@ -4,8 +4,14 @@
 #define BOOST_TEST_MODULE JumpBookTests
 
 #include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
 #include <limits>
+#include <map>
+#include <thread>
 #include <iomanip>
+#include <unistd.h>
 
 #include <boost/test/unit_test.hpp>
 #include <boost/format.hpp>
@@ -17,6 +23,24 @@
 #include "OrderList.hpp"
 #include "OrderBook.hpp"
 #include "FeedHandler.hpp"
+#include "MappedFile.hpp"
+#include "BinaryFeed.hpp"
+#include "Fill.hpp"
+#include "FlatIndex.hpp"
+#include "Journal.hpp"
+#include "LevelDelta.hpp"
+#include "NumberFormat.hpp"
+#include "OutputBuffer.hpp"
+#include "SpscRing.hpp"
+#include "AsyncWriter.hpp"
+#include "ParsePipeline.hpp"
+#include "PoolAllocator.hpp"
+#include "PriceTraits.hpp"
+#include "PriceLadder.hpp"
+#include "Replay.hpp"
+#include "ShardedFeed.hpp"
+#include "Snapshot.hpp"
+#include "StreamReader.hpp"
 
 using namespace JumpInterview::OrderBook;
 
@@ -28,6 +52,36 @@ static std::string getFirst ( std::stringstream& ss )
 	return line;
 }
 
+static Message parse ( std::string const & line )
+{
+	Message message;
+	FeedHandler::parse ( line, message );
+	return message;
+}
+
+/*
+ * A made up feed of count messages over these symbols ( "" for none, ",AAPL" and so on ): 40 orders that cross every
+ * so often, the odd trade, and the odd mistake.
+ */
+template < size_t symbol_count >
+static std::vector < Message > generatedFeed ( uint32_t count, const char * const ( & symbols ) [ symbol_count ] )
+{
+	std::vector < Message > messages;
+	for ( uint32_t i = 0; i < count; i++ )
+	{
+		uint32_t order_id ( i % 40 );
+		bool buy ( order_id % 2 );
+		uint32_t price ( buy ? 1000 - i % 7 : 1004 + i % 5 - ( i % 11 == 0 ? 6 : 0 ) );
+		std::string line;
+		if ( i % 13 == 0 )
+			line = boost::str ( boost::format ( "T,%1%,%2%" ) % ( i % 3 + 1 ) % 1000 );
+		else
+			line = boost::str ( boost::format ( "%1%,%2%,%3%,%4%,%5%" ) % "AAMX"[ i % 4 ] % order_id % ( buy ? 'B' : 'S' ) % ( i % 9 + 1 ) % price );
+		messages.push_back ( parse ( line + symbols[ ( i * 3 ) % symbol_count ] ) );
+	}
+	return messages;
+}
+
 BOOST_AUTO_TEST_CASE ( processIncorrectLinesTest )
 {
 	FeedHandler handler;
@@ -145,7 +199,7 @@ BOOST_AUTO_TEST_CASE ( processNonCrossingOrdersTest )
 	BOOST_CHECK_EQUAL ( sells.size(), ( size_t ) 0 );
 	handler.processMessage ( "A,000001,B,1,1000", ss );
 	BOOST_CHECK_EQUAL ( buys.size(), ( size_t ) 1 );
-	order = ( *buys.begin()->second->begin() )->order();
+	order = buys.begin()->second->front();
 	BOOST_CHECK_EQUAL ( order->orderId(), 000001 );
 	BOOST_CHECK_EQUAL ( order->price(), 1000000 );
 	BOOST_CHECK_EQUAL ( order->side(), OrderSide::BUY );
@@ -154,7 +208,7 @@ BOOST_AUTO_TEST_CASE ( processNonCrossingOrdersTest )
 	ss.clear();
 	handler.processMessage ( "A,000002,S,1,1010", ss );
 	BOOST_CHECK_EQUAL ( sells.size(), ( size_t ) 1 );
-	order = ( *sells.begin()->second->begin() )->order();
+	order = sells.begin()->second->front();
 	BOOST_CHECK_EQUAL ( order->orderId(), 000002 );
 	BOOST_CHECK_EQUAL ( order->price(), 1010000 );
 	BOOST_CHECK_EQUAL ( order->side(), OrderSide::SELL );
@@ -163,7 +217,7 @@ BOOST_AUTO_TEST_CASE ( processNonCrossingOrdersTest )
 	ss.clear();
 	handler.processMessage ( "A,000003,S,1,1020", ss );
 	BOOST_CHECK_EQUAL ( sells.size(), ( size_t ) 2 );
-	order = ( *sells.begin()->second->begin() )->order();
+	order = sells.begin()->second->front();
 	BOOST_CHECK_EQUAL ( order->orderId(), 000002 ); // hasn't changed
 	BOOST_CHECK_EQUAL ( order->price(), 1010000 ); // hasn't changed
 	BOOST_CHECK_EQUAL ( order->side(), OrderSide::SELL );
@@ -172,7 +226,7 @@ BOOST_AUTO_TEST_CASE ( processNonCrossingOrdersTest )
 	ss.clear();
 	handler.processMessage ( "A,000004,S,1,1005", ss );
 	BOOST_CHECK_EQUAL ( sells.size(), ( size_t ) 3 );
-	order = ( *sells.begin()->second->begin() )->order();
+	order = sells.begin()->second->front();
 	BOOST_CHECK_EQUAL ( order->orderId(), 000004 ); // has changed
 	BOOST_CHECK_EQUAL ( order->price(), 1005000 ); // has changed
 	BOOST_CHECK_EQUAL ( order->side(), OrderSide::SELL );
@@ -194,7 +248,7 @@ BOOST_AUTO_TEST_CASE ( processModifyingOrdersTest )
 	BOOST_CHECK_EQUAL ( sells.size(), ( size_t ) 0 );
 	handler.processMessage ( "A,000001,B,1,1000", ss );
 	BOOST_CHECK_EQUAL ( buys.size(), ( size_t ) 1 );
-	order = ( *buys.begin()->second->begin() )->order();
+	order = buys.begin()->second->front();
 	BOOST_CHECK_EQUAL ( order->orderId(), 000001 );
 	BOOST_CHECK_EQUAL ( order->price(), 1000000 );
 	BOOST_CHECK_EQUAL ( order->side(), OrderSide::BUY );
@@ -203,7 +257,7 @@ BOOST_AUTO_TEST_CASE ( processModifyingOrdersTest )
 	ss.clear();
 	handler.processMessage ( "A,000002,S,1,1010", ss );
 	BOOST_CHECK_EQUAL ( sells.size(), ( size_t ) 1 );
-	order = ( *sells.begin()->second->begin() )->order();
+	order = sells.begin()->second->front();
 	BOOST_CHECK_EQUAL ( order->orderId(), 000002 );
 	BOOST_CHECK_EQUAL ( order->price(), 1010000 );
 	BOOST_CHECK_EQUAL ( order->side(), OrderSide::SELL );
@@ -213,7 +267,7 @@ BOOST_AUTO_TEST_CASE ( processModifyingOrdersTest )
 	// change price
 	handler.processMessage ( "M,000002,S,1,1020", ss );
 	BOOST_CHECK_EQUAL ( sells.size(), ( size_t ) 1 );
-	order = ( *sells.begin()->second->begin() )->order();
+	order = sells.begin()->second->front();
 	BOOST_CHECK_EQUAL ( order->orderId(), 000002 );
 	BOOST_CHECK_EQUAL ( order->price(), 1020000 );
 	BOOST_CHECK_EQUAL ( order->side(), OrderSide::SELL );
@@ -223,7 +277,7 @@ BOOST_AUTO_TEST_CASE ( processModifyingOrdersTest )
 	// change volume
 	handler.processMessage ( "M,000002,S,1000,1020", ss );
 	BOOST_CHECK_EQUAL ( sells.size(), ( size_t ) 1 );
-	order = ( *sells.begin()->second->begin() )->order();
+	order = sells.begin()->second->front();
 	BOOST_CHECK_EQUAL ( order->orderId(), 000002 );
 	BOOST_CHECK_EQUAL ( order->price(), 1020000 );
 	BOOST_CHECK_EQUAL ( order->volume(), 1000 );
@@ -245,7 +299,7 @@ BOOST_AUTO_TEST_CASE ( processUnknownModifyTest )
 	Order_ptr order = 0;
 	handler.processMessage ( "M,000002,S,1000,1020", ss );
 	BOOST_CHECK_EQUAL ( sells.size(), ( size_t ) 1 );
-	order = ( *sells.begin()->second->begin() )->order();
+	order = sells.begin()->second->front();
 	BOOST_CHECK_EQUAL ( order->orderId(), 000002 );
 	BOOST_CHECK_EQUAL ( order->price(), 1020000 );
 	BOOST_CHECK_EQUAL ( order->volume(), 1000 );
@@ -315,7 +369,7 @@ BOOST_AUTO_TEST_CASE ( processDeletingOrdersTest )
 	BOOST_CHECK_EQUAL ( sells.size(), ( size_t ) 0 );
 	handler.processMessage ( "A,000001,B,1,1000", ss );
 	BOOST_CHECK_EQUAL ( buys.size(), ( size_t ) 1 );
-	order = ( *buys.begin()->second->begin() )->order();
+	order = buys.begin()->second->front();
 	BOOST_CHECK_EQUAL ( order->orderId(), 000001 );
 	BOOST_CHECK_EQUAL ( order->price(), 1000000 );
 	BOOST_CHECK_EQUAL ( order->side(), OrderSide::BUY );
@@ -324,7 +378,7 @@ BOOST_AUTO_TEST_CASE ( processDeletingOrdersTest )
 	ss.clear();
 	handler.processMessage ( "A,000002,S,1,1010", ss );
 	BOOST_CHECK_EQUAL ( sells.size(), ( size_t ) 1 );
-	order = ( *sells.begin()->second->begin() )->order();
+	order = sells.begin()->second->front();
 	BOOST_CHECK_EQUAL ( order->orderId(), 000002 );
 	BOOST_CHECK_EQUAL ( order->price(), 1010000 );
 	BOOST_CHECK_EQUAL ( order->side(), OrderSide::SELL );
@@ -334,7 +388,7 @@ BOOST_AUTO_TEST_CASE ( processDeletingOrdersTest )
 	handler.processMessage ( "A,000003,S,20,1010", ss );
 	BOOST_CHECK_EQUAL ( sells.size(), ( size_t ) 1 /* still 1 price level */ );
 	BOOST_CHECK_EQUAL ( sells.begin()->second->size(), ( size_t ) 2 /* with 2 orders */ );
-	order = ( *sells.begin()->second->begin() )->order();
+	order = sells.begin()->second->front();
 	BOOST_CHECK_EQUAL ( order->orderId(), 000002 );
 	BOOST_CHECK_EQUAL ( order->price(), 1010000 );
 	BOOST_CHECK_EQUAL ( order->volume(), 1 );
@@ -346,7 +400,7 @@ BOOST_AUTO_TEST_CASE ( processDeletingOrdersTest )
 	// mid price shouldn't change
 	handler.processMessage ( "X,000002,S,1,1010", ss );
 	BOOST_CHECK_EQUAL ( sells.size(), ( size_t ) 1 );
-	order = ( *sells.begin()->second->begin() )->order();
+	order = sells.begin()->second->front();
 	BOOST_CHECK_EQUAL ( order->orderId(), 000003 );
 	BOOST_CHECK_EQUAL ( order->price(), 1010000 );
 	BOOST_CHECK_EQUAL ( order->volume(), 20 );
@@ -368,7 +422,7 @@ BOOST_AUTO_TEST_CASE ( processCrossingOrdersTest )
 	BOOST_CHECK_EQUAL ( sells.size(), ( size_t ) 0 );
 	handler.processMessage ( "A,000001,B,4,1010", ss );
 	BOOST_CHECK_EQUAL ( buys.size(), ( size_t ) 1 );
-	order = ( *buys.begin()->second->begin() )->order();
+	order = buys.begin()->second->front();
 	BOOST_CHECK_EQUAL ( order->orderId(), 000001 );
 	BOOST_CHECK_EQUAL ( order->price(), 1010000 );
 	BOOST_CHECK_EQUAL ( order->side(), OrderSide::BUY );
@@ -377,7 +431,7 @@ BOOST_AUTO_TEST_CASE ( processCrossingOrdersTest )
 	ss.clear();
 	handler.processMessage ( "A,000002,S,1,1000", ss );
 	BOOST_CHECK_EQUAL ( sells.size(), ( size_t ) 1 );
-	order = ( *sells.begin()->second->begin() )->order();
+	order = sells.begin()->second->front();
 	BOOST_CHECK_EQUAL ( order->orderId(), 000002 );
 	BOOST_CHECK_EQUAL ( order->price(), 1000000 );
 	BOOST_CHECK_EQUAL ( order->side(), OrderSide::SELL );
@@ -420,7 +474,7 @@ BOOST_AUTO_TEST_CASE ( processCrossingMyModifyingTest )
 	BOOST_CHECK_EQUAL ( sells.size(), ( size_t ) 0 );
 	handler.processMessage ( "A,000001,B,4,1010", ss );
 	BOOST_CHECK_EQUAL ( buys.size(), ( size_t ) 1 );
-	order = ( *buys.begin()->second->begin() )->order();
+	order = buys.begin()->second->front();
 	BOOST_CHECK_EQUAL ( order->orderId(), 000001 );
 	BOOST_CHECK_EQUAL ( order->price(), 1010000 );
 	BOOST_CHECK_EQUAL ( order->side(), OrderSide::BUY );
@@ -429,7 +483,7 @@ BOOST_AUTO_TEST_CASE ( processCrossingMyModifyingTest )
 	ss.clear();
 	handler.processMessage ( "A,000002,S,1,1020", ss );
 	BOOST_CHECK_EQUAL ( sells.size(), ( size_t ) 1 );
-	order = ( *sells.begin()->second->begin() )->order();
+	order = sells.begin()->second->front();
 	BOOST_CHECK_EQUAL ( order->orderId(), 000002 );
 	BOOST_CHECK_EQUAL ( order->price(), 1020000 );
 	BOOST_CHECK_EQUAL ( order->side(), OrderSide::SELL );
@@ -514,7 +568,7 @@ BOOST_AUTO_TEST_CASE ( processNoTradeWhenExpectedTest )
 	BOOST_CHECK_EQUAL ( sells.size(), ( size_t ) 0 );
 	handler.processMessage ( "A,000001,B,1,1020", ss );
 	BOOST_CHECK_EQUAL ( buys.size(), ( size_t ) 1 );
-	order = ( *buys.begin()->second->begin() )->order();
+	order = buys.begin()->second->front();
 	BOOST_CHECK_EQUAL ( order->orderId(), 000001 );
 	BOOST_CHECK_EQUAL ( order->price(), 1020000 );
 	BOOST_CHECK_EQUAL ( order->side(), OrderSide::BUY );
@@ -523,7 +577,7 @@ BOOST_AUTO_TEST_CASE ( processNoTradeWhenExpectedTest )
 	ss.clear();
 	handler.processMessage ( "A,000002,S,2,1010", ss );
 	BOOST_CHECK_EQUAL ( sells.size(), ( size_t ) 1 );
-	order = ( *sells.begin()->second->begin() )->order();
+	order = sells.begin()->second->front();
 	BOOST_CHECK_EQUAL ( order->orderId(), 000002 );
 	BOOST_CHECK_EQUAL ( order->price(), 1010000 );
 	BOOST_CHECK_EQUAL ( order->volume(), 2 );
@@ -536,7 +590,7 @@ BOOST_AUTO_TEST_CASE ( processNoTradeWhenExpectedTest )
 	// that's unexpected
 	handler.processMessage ( "M,000002,S,1,1010", ss );
 	BOOST_CHECK_EQUAL ( sells.size(), ( size_t ) 1 );
-	order = ( *sells.begin()->second->begin() )->order();
+	order = sells.begin()->second->front();
 	BOOST_CHECK_EQUAL ( order->orderId(), 000002 );
 	BOOST_CHECK_EQUAL ( order->price(), 1010000 );
 	BOOST_CHECK_EQUAL ( order->volume(), 1 );
@@ -547,6 +601,1840 @@ BOOST_AUTO_TEST_CASE ( processNoTradeWhenExpectedTest )
 	BOOST_CHECK_EQUAL ( errors.no_trades_when_they_should_happen, ( size_t ) 1 );
 }
 
+BOOST_AUTO_TEST_CASE ( processMessageViewTest )
+{
+	// views don't have to be terminated, the next message can follow straight away
+	FeedHandler handler;
+	OrderBook::BuyPriceLevelMap const & buys ( handler.book().buys() );
+	OrderBook::SellPriceLevelMap const & sells ( handler.book().sells() );
+	std::stringstream ss;
+	const char * buffer ( "A,1,B,1,1000A,2,S,1,10105T,1,10105" );
+	handler.processMessage ( MessageView ( buffer, 12 ), ss );
+	BOOST_CHECK_EQUAL ( buys.size(), ( size_t ) 1 );
+	BOOST_CHECK_EQUAL ( buys.begin()->second->front()->price(), 1000000 );
+	// the '5' after this one belongs to the next message, not to our price
+	handler.processMessage ( MessageView ( buffer + 12, 12 ), ss );
+	BOOST_CHECK_EQUAL ( sells.size(), ( size_t ) 1 );
+	BOOST_CHECK_EQUAL ( sells.begin()->second->front()->price(), 1010000 );
+	ss.str ( "" );
+	ss.clear();
+	handler.processMessage ( MessageView ( buffer + 25, 8 ), ss );
+	BOOST_CHECK_EQUAL ( getFirst ( ss ), "1@1010" );
+	// same as with a std::string, running out of message half way is corrupt or weird, but never a crash
+	handler.processMessage ( MessageView ( buffer, 5 ), ss );
+	handler.processMessage ( MessageView ( buffer, 3 ), ss );
+	BOOST_CHECK_EQUAL ( handler.errors().out_of_bounds_or_weird_numbers, ( uint32_t ) 1 );
+	BOOST_CHECK_EQUAL ( handler.errors().corrupted_messages, ( uint32_t ) 1 );
+}
+
+BOOST_AUTO_TEST_CASE ( mappedFileLinesTest )
+{
+	// we should split lines exactly like std::getline does
+	const std::string filename ( "mapped_file_test.txt" );
+	{
+		std::ofstream out ( filename.c_str() );
+		out << "A,1,B,1,1000\n\nT,1,1000";
+	}
+	MappedFile file ( filename );
+	BOOST_REQUIRE ( file.good() );
+	MessageView line;
+	BOOST_REQUIRE ( file.nextLine ( line ) );
+	BOOST_CHECK_EQUAL ( std::string ( line.data(), line.size() ), "A,1,B,1,1000" );
+	BOOST_REQUIRE ( file.nextLine ( line ) );
+	BOOST_CHECK ( line.empty() );
+	BOOST_REQUIRE ( file.nextLine ( line ) );
+	BOOST_CHECK_EQUAL ( std::string ( line.data(), line.size() ), "T,1,1000" );
+	BOOST_CHECK ( !file.nextLine ( line ) );
+	std::remove ( filename.c_str() );
+	BOOST_CHECK ( !MappedFile ( "this_file_does_not_exist.txt" ).good() );
+}
+
+BOOST_AUTO_TEST_CASE ( parseMessageTest )
+{
+	Message message ( parse ( "A,100000,S,1,1075" ) );
+	BOOST_CHECK_EQUAL ( message.type, MessageType::ADD );
+	BOOST_CHECK_EQUAL ( message.order_id, ( uint32_t ) 100000 );
+	BOOST_CHECK_EQUAL ( message.side, OrderSide::SELL );
+	BOOST_CHECK_EQUAL ( message.volume, ( uint32_t ) 1 );
+	BOOST_CHECK_EQUAL ( message.price, ( uint32_t ) 1075000 );
+	// rounded down the way a double always has, so the books stay what they were
+	message = parse ( "M,8058,B,9,2.01" );
+	BOOST_CHECK_EQUAL ( message.type, MessageType::MODIFY );
+	BOOST_CHECK_EQUAL ( message.price, ( uint32_t ) 2009 );
+	// too many digits for a double to hold, so these go through strtod
+	message = parse ( "M,8058,B,9,2.0100000000000000001" );
+	BOOST_CHECK_EQUAL ( message.price, ( uint32_t ) 2009 );
+	message = parse ( "M,8058,B,9,1.99999999999999999999" );
+	BOOST_CHECK_EQUAL ( message.price, ( uint32_t ) 2000 );
+	// decimals we don't keep are rounded down
+	message = parse ( "X,1,B,1,1.0129 // cancel" );
+	BOOST_CHECK_EQUAL ( message.type, MessageType::REMOVE );
+	BOOST_CHECK_EQUAL ( message.price, ( uint32_t ) 1012 );
+	message = parse ( "T,2,.5\r" );
+	BOOST_CHECK_EQUAL ( message.type, MessageType::TRADE );
+	BOOST_CHECK_EQUAL ( message.volume, ( uint32_t ) 2 );
+	BOOST_CHECK_EQUAL ( message.price, ( uint32_t ) 500 );
+	// the largest price and order id we can store, and just over it
+	message = parse ( "A,4294967295,B,1,4294967.000" );
+	BOOST_CHECK_EQUAL ( message.type, MessageType::ADD );
+	BOOST_CHECK_EQUAL ( message.order_id, std::numeric_limits<uint32_t>::max() );
+	BOOST_CHECK_EQUAL ( message.price, ( uint32_t ) 4294967000u );
+	message = parse ( "A,4294967296,B,1,1000" );
+	BOOST_CHECK_EQUAL ( message.type, MessageType::WEIRD );
+	message = parse ( "A,1,B,1,4294967.0001" );
+	BOOST_CHECK_EQUAL ( message.type, MessageType::WEIRD );
+	message = parse ( "A,1,B,1,4294968" );
+	BOOST_CHECK_EQUAL ( message.type, MessageType::WEIRD );
+	// no exponents, no signs, no prices that round down to nothing
+	message = parse ( "A,1,B,1,1e3" );
+	BOOST_CHECK_EQUAL ( message.type, MessageType::WEIRD );
+	message = parse ( "A,1,B,+1,1000" );
+	BOOST_CHECK_EQUAL ( message.type, MessageType::WEIRD );
+	message = parse ( "A,1,B,1,0.0001" );
+	BOOST_CHECK_EQUAL ( message.type, MessageType::WEIRD );
+	message = parse ( "A,1,B,1,." );
+	BOOST_CHECK_EQUAL ( message.type, MessageType::WEIRD );
+	message = parse ( "Q,1,B,1,1000" );
+	BOOST_CHECK_EQUAL ( message.type, MessageType::CORRUPTED );
+}
+
+BOOST_AUTO_TEST_CASE ( binaryFeedTest )
+{
+	// the same feed as text and as binary records should give us the same book, output and errors
+	static const char * lines[] = { "A,100000,S,1,1075", "A,100001,B,9,1000", "A,100002,S,5,1.25 // comment", "M,100002,S,4,1.25",
+									"A,100003,B,9,1075", "T,1,1075", "X,100001,B,9,1000", "A,-1,B,1,1000", "nonsense"
+								  };
+	FeedHandler text_handler, binary_handler;
+	std::stringstream text_ss, binary_ss;
+	char header[ BinaryFeed::header_size ];
+	BinaryFeed::writeHeader ( header );
+	BOOST_CHECK ( BinaryFeed::isBinary ( header, sizeof ( header ) ) );
+	BOOST_CHECK ( !BinaryFeed::isBinary ( lines[0], strlen ( lines[0] ) ) );
+	for ( size_t i = 0; i < sizeof ( lines ) / sizeof ( lines[0] ); i++ )
+	{
+		Message message ( parse ( lines[i] ) ), decoded;
+		char record[ BinaryFeed::record_size ];
+		BinaryFeed::encode ( message, record );
+		BinaryFeed::decode ( record, decoded );
+		BOOST_CHECK_EQUAL ( decoded.type, message.type );
+		BOOST_CHECK_EQUAL ( decoded.price, message.price );
+		text_handler.processMessage ( std::string ( lines[i] ), text_ss );
+		binary_handler.processRecord ( record, binary_ss );
+	}
+	BOOST_CHECK_EQUAL ( text_ss.str(), binary_ss.str() );
+	text_handler.printCurrentOrderBook ( text_ss );
+	binary_handler.printCurrentOrderBook ( binary_ss );
+	BOOST_CHECK_EQUAL ( text_ss.str(), binary_ss.str() );
+	BOOST_CHECK_EQUAL ( binary_handler.errors().out_of_bounds_or_weird_numbers, ( uint32_t ) 1 );
+	BOOST_CHECK_EQUAL ( binary_handler.errors().corrupted_messages, ( uint32_t ) 1 );
+	// a record for an order without a volume is as weird as the text version would be
+	char record[ BinaryFeed::record_size ] = { 'A', 'B', 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0 };
+	Message message;
+	BinaryFeed::decode ( record, message );
+	BOOST_CHECK_EQUAL ( message.type, MessageType::WEIRD );
+}
+
+BOOST_AUTO_TEST_CASE ( processBatchTest )
+{
+	// with per message output a batch should be indistinguishable from processing the messages one by one
+	static const char * lines[] = { "A,100000,S,1,1075", "A,100001,B,9,1000", "A,100002,B,30,975", "A,100003,S,10,1050", "A,100004,B,10,950",
+									"A,100005,S,2,1025", "A,100006,B,1,1000", "X,100004,B,10,950", "A,100007,S,5,1025", "A,100008,B,3,1050",
+									"T,2,1025", "T,1,1025", "X,100008,B,3,1050", "X,100005,S,2,1025", "M,100007,S,4,1025", "A,,,"
+								  };
+	static const size_t count ( sizeof ( lines ) / sizeof ( lines[0] ) );
+	FeedHandler single_handler, batch_handler;
+	std::stringstream single_ss, batch_ss;
+	std::vector < Message > messages;
+	for ( size_t i = 0; i < count; i++ )
+	{
+		single_handler.processMessage ( std::string ( lines[i] ), single_ss );
+		messages.push_back ( parse ( lines[i] ) );
+	}
+	batch_handler.processBatch ( &messages[0], 7, batch_ss );
+	batch_handler.processBatch ( &messages[7], count - 7, batch_ss );
+	single_handler.printCurrentOrderBook ( single_ss );
+	batch_handler.printCurrentOrderBook ( batch_ss );
+	BOOST_CHECK_EQUAL ( single_ss.str(), batch_ss.str() );
+	BOOST_CHECK_EQUAL ( batch_handler.errors().no_trades_when_they_should_happen, single_handler.errors().no_trades_when_they_should_happen );
+	BOOST_CHECK_EQUAL ( batch_handler.errors().out_of_bounds_or_weird_numbers, ( uint32_t ) 1 );
+}
+
+static void checkSameFeed ( FeedHandler const & feed, FeedHandler const & expected )
+{
+	std::stringstream books, errors, expected_books, expected_errors;
+	feed.printCurrentOrderBook ( books );
+	feed.printErrorSummary ( errors );
+	expected.printCurrentOrderBook ( expected_books );
+	expected.printErrorSummary ( expected_errors );
+	BOOST_CHECK_EQUAL ( books.str(), expected_books.str() );
+	BOOST_CHECK_EQUAL ( errors.str(), expected_errors.str() );
+}
+
+BOOST_AUTO_TEST_CASE ( processBatchNettingTest )
+{
+	FeedHandler handler;
+	OrderBook::BuyPriceLevelMap const & buys ( handler.book().buys() );
+	OrderBook::SellPriceLevelMap const & sells ( handler.book().sells() );
+	std::stringstream ss;
+	handler.processMessage ( "A,5,B,1,1000", ss );
+	ss.str ( "" );
+	ss.clear();
+	Message messages[] =
+	{
+		// added and cancelled straight away
+		parse ( "A,1,S,1,1010" ), parse ( "X,1,S,1,1010" ),
+		// added, then moved up. Order 3 came in between so it should be in front of order 2
+		parse ( "A,2,B,1,990" ), parse ( "A,3,B,1,995" ), parse ( "M,2,B,1,995" ),
+		// added, then modified down. Keeps its place in front of order 6
+		parse ( "A,4,S,5,1020" ), parse ( "A,6,S,5,1020" ), parse ( "M,4,S,2,1020" ),
+		// we already know about this one, so that's a duplicate followed by a remove of the original
+		parse ( "A,5,B,2,1000" ), parse ( "X,5,B,1,1000" )
+	};
+	handler.processBatch ( messages, sizeof ( messages ) / sizeof ( messages[0] ), ss, false, true );
+	// only one mid price, at the end
+	BOOST_CHECK_EQUAL ( ss.str(), "1007.5\n" );
+	BOOST_CHECK_EQUAL ( buys.size(), ( size_t ) 1 );
+	BOOST_CHECK_EQUAL ( buys.begin()->second->size(), ( size_t ) 2 );
+	BOOST_CHECK_EQUAL ( buys.begin()->second->front()->orderId(), ( uint32_t ) 3 );
+	BOOST_CHECK_EQUAL ( buys.begin()->second->front()->price(), ( uint32_t ) 995000 );
+	BOOST_CHECK_EQUAL ( sells.size(), ( size_t ) 1 );
+	BOOST_CHECK_EQUAL ( sells.begin()->second->front()->orderId(), ( uint32_t ) 4 );
+	BOOST_CHECK_EQUAL ( sells.begin()->second->front()->volume(), ( uint32_t ) 2 );
+	BOOST_CHECK ( !handler.book().contains ( 1 ) );
+	BOOST_CHECK ( !handler.book().contains ( 5 ) );
+	BOOST_CHECK_EQUAL ( handler.errors().duplicate_order_id, ( uint32_t ) 1 );
+	// a modify or remove we can't net still happens, so whatever comes after it for the same id can't be netted either
+	Message unnettable[] =
+	{
+		parse ( "A,7,B,5,100" ), parse ( "M,7,S,5,100" ), parse ( "X,7,B,5,100" ),
+		parse ( "A,8,S,5,1100" ), parse ( "X,8,S,5,1101" ), parse ( "X,8,S,5,1100" ),
+		parse ( "A,9,S,5,1200,AAPL" ), parse ( "M,9,S,5,1200" ), parse ( "M,9,S,4,1200,AAPL" )
+	};
+	size_t unnettable_count ( sizeof ( unnettable ) / sizeof ( unnettable[0] ) );
+	FeedHandler netted, unbatched;
+	for ( size_t i = 0; i < unnettable_count; i++ )
+		unbatched.processMessage ( unnettable[i], ss );
+	netted.processBatch ( unnettable, unnettable_count, ss, false, true );
+	checkSameFeed ( netted, unbatched );
+	BOOST_CHECK ( !netted.book().contains ( 7 ) );
+	BOOST_CHECK ( !netted.book().contains ( 8 ) );
+}
+
+/*
+ * Whatever we write has to be exactly what an ostream with precision 8 made of the same price as a double.
+ */
+BOOST_AUTO_TEST_CASE ( numberFormatTest )
+{
+	uint32_t prices[] = { 1, 10, 100, 999, 1000, 1001, 1010, 2010, 99999, 100000, 123456, 1234567, 12345678, 99999999, 100000000,
+						  123456789, 999999999, 1000000000, 4294967295u
+						};
+	for ( size_t i = 0; i < sizeof ( prices ) / sizeof ( prices[0] ); i++ )
+	{
+		char buffer[ NumberFormat::max_length ];
+		std::ostringstream expected;
+		expected.precision ( 8 );
+		expected << prices[i] / Constants::round_size;
+		BOOST_CHECK_EQUAL ( std::string ( buffer, NumberFormat::formatPrice ( buffer, prices[i] ) ), expected.str() );
+		// every mid price between this one and its neighbour
+		for ( uint64_t other = prices[i]; other <= prices[i] + 11ull; other++ )
+		{
+			std::ostringstream expected_mid;
+			expected_mid.precision ( 8 );
+			expected_mid << ( prices[i] + other ) / ( Constants::round_size * 2.0 );
+			BOOST_CHECK_EQUAL ( std::string ( buffer, NumberFormat::formatMidPrice ( buffer, prices[i] + other ) ), expected_mid.str() );
+		}
+		std::ostringstream expected_uint;
+		expected_uint << prices[i];
+		BOOST_CHECK_EQUAL ( std::string ( buffer, NumberFormat::formatUInt ( buffer, prices[i] ) ), expected_uint.str() );
+	}
+	char buffer[ NumberFormat::max_length ];
+	BOOST_CHECK_EQUAL ( std::string ( buffer, NumberFormat::formatFixed ( buffer, 0, 3 ) ), "0" );
+	BOOST_CHECK_EQUAL ( std::string ( buffer, NumberFormat::formatFixed ( buffer, 5, 9 ) ), "5e-09" );
+	BOOST_CHECK_EQUAL ( std::string ( buffer, NumberFormat::formatUInt ( buffer, std::numeric_limits<uint64_t>::max() ) ), "18446744073709551615" );
+}
+
+BOOST_AUTO_TEST_CASE ( outputBufferTest )
+{
+	std::stringstream ss;
+	{
+		StreamSink sink ( ss );
+		// tiny, so we have to flush halfway through
+		OutputBuffer out ( sink, 1 );
+		for ( uint32_t i = 0; i < 20; i++ )
+		{
+			out.appendUInt ( i );
+			out.append ( '@' );
+			out.appendPrice ( i * 500 );
+			out.endLine();
+		}
+		out.append ( "Buys:" );
+		// nothing reaches the stream before we're done or the buffer is full
+		BOOST_CHECK ( ss.str().size() < 20 * 6 );
+	}
+	BOOST_CHECK_EQUAL ( getFirst ( ss ), "0@0" );
+	BOOST_CHECK_EQUAL ( getFirst ( ss ), "1@0.5" );
+	BOOST_CHECK_EQUAL ( getFirst ( ss ), "2@1" );
+	BOOST_CHECK ( ss.str().find ( "19@9.5\nBuys:" ) != std::string::npos );
+}
+
+/*
+ * Levels we didn't touch are written from what we wrote last time, so make sure every kind of change does show up.
+ */
+BOOST_AUTO_TEST_CASE ( incrementalBookPrintTest )
+{
+	FeedHandler handler;
+	std::stringstream ss;
+	handler.processMessage ( "A,1,B,10,1000", ss );
+	handler.processMessage ( "A,2,B,10,1000", ss );
+	handler.processMessage ( "A,3,S,10,1010", ss );
+	ss.str ( "" );
+	handler.printCurrentOrderBook ( ss );
+	BOOST_CHECK_EQUAL ( ss.str(), "Buys:\n1: Buy 10 @ 1000\n2: Buy 10 @ 1000\nSells:\n3: Sell 10 @ 1010\n" );
+	// down in volume, keeps its place
+	handler.processMessage ( "M,2,B,5,1000", ss );
+	ss.str ( "" );
+	handler.printCurrentOrderBook ( ss );
+	BOOST_CHECK_EQUAL ( ss.str(), "Buys:\n1: Buy 10 @ 1000\n2: Buy 5 @ 1000\nSells:\n3: Sell 10 @ 1010\n" );
+	// up in volume, to the back
+	handler.processMessage ( "M,1,B,20,1000", ss );
+	handler.processMessage ( "X,3,S,10,1010", ss );
+	ss.str ( "" );
+	handler.printCurrentOrderBook ( ss );
+	BOOST_CHECK_EQUAL ( ss.str(), "Buys:\n2: Buy 5 @ 1000\n1: Buy 20 @ 1000\nSells:\n<empty>\n" );
+	// and the same again, with nothing changed at all
+	ss.str ( "" );
+	handler.printCurrentOrderBook ( ss );
+	BOOST_CHECK_EQUAL ( ss.str(), "Buys:\n2: Buy 5 @ 1000\n1: Buy 20 @ 1000\nSells:\n<empty>\n" );
+}
+
+BOOST_AUTO_TEST_CASE ( spscRingTest )
+{
+	SpscRing < uint32_t > ring ( 5 );
+	// rounded up
+	BOOST_CHECK_EQUAL ( ring.capacity(), ( size_t ) 8 );
+	uint32_t values[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+	BOOST_CHECK_EQUAL ( ring.push ( values, 6 ), ( size_t ) 6 );
+	uint32_t value ( 0 );
+	BOOST_CHECK ( ring.tryPop ( value ) );
+	BOOST_CHECK_EQUAL ( value, ( uint32_t ) 1 );
+	// wraps around, and only takes what fits
+	BOOST_CHECK_EQUAL ( ring.push ( values + 6, 4 ), ( size_t ) 3 );
+	BOOST_CHECK_EQUAL ( ring.size(), ( size_t ) 8 );
+	BOOST_CHECK ( !ring.tryPush ( 10 ) );
+	uint32_t const * front;
+	// up to the end of the buffer first, then the part that wrapped around
+	BOOST_CHECK_EQUAL ( ring.front ( front ), ( size_t ) 7 );
+	BOOST_CHECK_EQUAL ( front[0], ( uint32_t ) 2 );
+	ring.pop ( 7 );
+	BOOST_CHECK_EQUAL ( ring.front ( front ), ( size_t ) 1 );
+	BOOST_CHECK_EQUAL ( front[0], ( uint32_t ) 9 );
+	ring.pop ( 1 );
+	BOOST_CHECK ( ring.empty() );
+	BOOST_CHECK ( !ring.tryPop ( value ) );
+}
+
+static std::string readAll ( FILE * file )
+{
+	std::string contents;
+	char buffer[ 4096 ];
+	rewind ( file );
+	size_t read;
+	while ( ( read = fread ( buffer, 1, sizeof ( buffer ), file ) ) > 0 )
+		contents.append ( buffer, read );
+	return contents;
+}
+
+/*
+ * A ring much smaller than what we write, so the writer thread has to keep up with us.
+ */
+BOOST_AUTO_TEST_CASE ( asyncWriterTest )
+{
+	std::string expected;
+	for ( uint32_t i = 0; i < 10000; i++ )
+		expected += boost::str ( boost::format ( "%1%@%2%\n" ) % i % ( i * 7 ) );
+	RingFullPolicy::Policy policies[] = { RingFullPolicy::BLOCK, RingFullPolicy::SPIN };
+	for ( size_t p = 0; p < sizeof ( policies ) / sizeof ( policies[0] ); p++ )
+	{
+		FILE * file ( tmpfile() );
+		BOOST_REQUIRE ( file );
+		{
+			AsyncWriter writer ( fileno ( file ), policies[p], 256 );
+			{
+				OutputBuffer out ( writer, 100 );
+				for ( uint32_t i = 0; i < 10000; i++ )
+				{
+					out.appendUInt ( i );
+					out.append ( '@' );
+					out.appendUInt ( i * 7 );
+					out.endLine();
+				}
+			}
+			writer.close();
+			BOOST_CHECK_EQUAL ( writer.stats().bytes_written, expected.size() );
+			BOOST_CHECK_EQUAL ( writer.stats().dropped_bytes, ( uint64_t ) 0 );
+		}
+		BOOST_CHECK ( readAll ( file ) == expected );
+		fclose ( file );
+	}
+	// dropping: whatever made it through has to be whole blocks, and the rest is counted
+	FILE * file ( tmpfile() );
+	BOOST_REQUIRE ( file );
+	AsyncWriter writer ( fileno ( file ), RingFullPolicy::DROP, 64 );
+	std::string block ( 48, 'x' );
+	for ( uint32_t i = 0; i < 1000; i++ )
+		writer.write ( block.data(), block.size() );
+	// never fits
+	writer.write ( expected.data(), expected.size() );
+	writer.close();
+	AsyncWriterStats const & stats ( writer.stats() );
+	BOOST_CHECK_EQUAL ( stats.blocks, ( uint64_t ) 1001 );
+	BOOST_CHECK ( stats.dropped_blocks >= 1 );
+	BOOST_CHECK_EQUAL ( stats.bytes_written + stats.dropped_bytes, 1000 * block.size() + expected.size() );
+	BOOST_CHECK_EQUAL ( readAll ( file ).size(), stats.bytes_written );
+	BOOST_CHECK_EQUAL ( stats.bytes_written % block.size(), ( uint64_t ) 0 );
+	fclose ( file );
+}
+
+/*
+ * However we cut the feed up and however many parsers we use, the book thread has to see exactly the messages
+ * MappedFile would have given us, in the same order.
+ */
+BOOST_AUTO_TEST_CASE ( parsePipelineTest )
+{
+	static const char * lines[] = { "A,100000,S,1,1075", "A,100001,B,9,1000", "", "A,100002,B,30,975\r", "nonsense",
+									"A,100003,S,10,1050 // comment", "A,100004,B,10,950", "T,2,1025", "X,100004,B,10,950", "A,-1,B,1,1000",
+									"M,100003,S,5,1050", "A,100005,B,3,1060", "T,3,1050"
+								  };
+	static const size_t count ( sizeof ( lines ) / sizeof ( lines[0] ) );
+	std::string feed;
+	std::vector < Message > expected;
+	FeedHandler single_handler;
+	std::stringstream single_ss;
+	for ( size_t i = 0; i < count; i++ )
+	{
+		feed += lines[i];
+		feed += '\n';
+		expected.push_back ( parse ( lines[i] ) );
+		single_handler.processMessage ( std::string ( lines[i] ), single_ss );
+	}
+	// and a last line without a newline
+	feed += "X,100005,B,3,1060";
+	expected.push_back ( parse ( "X,100005,B,3,1060" ) );
+	single_handler.processMessage ( std::string ( "X,100005,B,3,1060" ), single_ss );
+	size_t chunk_sizes[] = { 1, 7, 18, 64, ParsePipeline::default_chunk_size };
+	for ( size_t parsers = 1; parsers <= 4; parsers++ )
+		for ( size_t c = 0; c < sizeof ( chunk_sizes ) / sizeof ( chunk_sizes[0] ); c++ )
+		{
+			ParsePipeline pipeline ( feed.data(), feed.size(), parsers, chunk_sizes[c] );
+			FeedHandler handler;
+			std::stringstream ss;
+			Message message;
+			size_t i ( 0 );
+			for ( ; pipeline.next ( message ); i++ )
+			{
+				BOOST_REQUIRE ( i < expected.size() );
+				BOOST_CHECK_EQUAL ( message.type, expected[i].type );
+				BOOST_CHECK_EQUAL ( message.order_id, expected[i].order_id );
+				BOOST_CHECK_EQUAL ( message.price, expected[i].price );
+				handler.processMessage ( message, ss );
+			}
+			BOOST_CHECK_EQUAL ( i, expected.size() );
+			BOOST_CHECK ( !pipeline.next ( message ) );
+			BOOST_CHECK_EQUAL ( ss.str(), single_ss.str() );
+			BOOST_CHECK_EQUAL ( handler.errors().corrupted_messages, single_handler.errors().corrupted_messages );
+			BOOST_CHECK_EQUAL ( handler.errors().out_of_bounds_or_weird_numbers, single_handler.errors().out_of_bounds_or_weird_numbers );
+			BOOST_CHECK_EQUAL ( handler.errors().trades_with_no_corresponding_order, single_handler.errors().trades_with_no_corresponding_order );
+			BOOST_CHECK_EQUAL ( handler.errors().no_trades_when_they_should_happen, single_handler.errors().no_trades_when_they_should_happen );
+		}
+	// nothing at all, and giving up half way with parsers that can't get rid of their batches
+	Message message;
+	BOOST_CHECK ( !ParsePipeline ( 0, 0, 2 ).next ( message ) );
+	std::string big;
+	for ( uint32_t i = 0; i < 100000; i++ )
+		big += "A,1,B,1,1000\n";
+	ParsePipeline pipeline ( big.data(), big.size(), 3, 100 );
+	BOOST_CHECK ( pipeline.next ( message ) );
+	BOOST_CHECK_EQUAL ( message.type, MessageType::ADD );
+}
+
+BOOST_AUTO_TEST_CASE ( parseSymbolTest )
+{
+	// no symbol is the default instrument
+	BOOST_CHECK_EQUAL ( parse ( "A,1,B,1,1000" ).symbol, ( Symbol ) 0 );
+	Message message ( parse ( "A,1,B,1,1000,AAPL" ) );
+	BOOST_CHECK_EQUAL ( message.type, MessageType::ADD );
+	BOOST_CHECK_EQUAL ( message.price, ( uint32_t ) 1000000 );
+	char formatted[ sizeof ( Symbol ) ];
+	BOOST_CHECK_EQUAL ( std::string ( formatted, Instrument::formatSymbol ( formatted, message.symbol ) ), "AAPL" );
+	BOOST_CHECK_EQUAL ( parse ( "T,2,10.5,AAPL // comment" ).symbol, message.symbol );
+	BOOST_CHECK_EQUAL ( parse ( "X,1,B,1,1000,AAPL\r" ).symbol, message.symbol );
+	message = parse ( "M,1,S,1,1000,ABCDEFGH" );
+	BOOST_CHECK_EQUAL ( message.type, MessageType::MODIFY );
+	BOOST_CHECK_EQUAL ( std::string ( formatted, Instrument::formatSymbol ( formatted, message.symbol ) ), "ABCDEFGH" );
+	// they sort like their names do
+	BOOST_CHECK ( parse ( "T,1,1,AB" ).symbol < parse ( "T,1,1,B" ).symbol );
+	BOOST_CHECK ( parse ( "T,1,1,A" ).symbol < parse ( "T,1,1,AB" ).symbol );
+	// too long, empty, or another field after it
+	BOOST_CHECK_EQUAL ( parse ( "A,1,B,1,1000,ABCDEFGHI" ).type, MessageType::WEIRD );
+	BOOST_CHECK_EQUAL ( parse ( "A,1,B,1,1000," ).type, MessageType::WEIRD );
+	BOOST_CHECK_EQUAL ( parse ( "A,1,B,1,1000,AAPL,1" ).type, MessageType::WEIRD );
+	BOOST_CHECK_EQUAL ( parse ( "T,1,1000," ).type, MessageType::WEIRD );
+}
+
+BOOST_AUTO_TEST_CASE ( multiInstrumentTest )
+{
+	FeedHandler handler;
+	std::stringstream ss;
+	// the same order ids, in three different books
+	handler.processMessage ( "A,1,B,10,1000", ss );
+	handler.processMessage ( "A,1,B,5,20,IBM", ss );
+	handler.processMessage ( "A,1,S,7,30,AAPL", ss );
+	handler.processMessage ( "A,2,B,7,29,AAPL", ss );
+	ss.str ( "" );
+	handler.processMessage ( "A,3,S,1,1010", ss );
+	// the mid price of the instrument the message was for
+	BOOST_CHECK_EQUAL ( getFirst ( ss ), "1005" );
+	handler.processMessage ( "X,2,B,7,29,AAPL", ss );
+	BOOST_CHECK_EQUAL ( getFirst ( ss ), "NAN" );
+	BOOST_CHECK_EQUAL ( handler.book().buys().size(), ( size_t ) 1 );
+	BOOST_CHECK_EQUAL ( handler.instruments().size(), ( size_t ) 2 );
+	BOOST_CHECK ( handler.instrument ( parse ( "T,1,1,MSFT" ).symbol ) == 0 );
+	Instrument const * ibm ( handler.instrument ( parse ( "T,1,1,IBM" ).symbol ) );
+	BOOST_REQUIRE ( ibm );
+	BOOST_CHECK ( ibm->book.contains ( 1 ) );
+	BOOST_CHECK ( ibm->book.sells().empty() );
+	// errors are counted against the instrument they happened on
+	handler.processMessage ( "X,5,B,1,20,IBM", ss );
+	handler.processMessage ( "T,1,20,IBM", ss );
+	BOOST_CHECK_EQUAL ( ibm->errors.removes_with_no_corresponding_order, ( uint32_t ) 1 );
+	BOOST_CHECK_EQUAL ( ibm->errors.trades_with_no_corresponding_order, ( uint32_t ) 1 );
+	BOOST_CHECK ( handler.errors().empty() );
+	BOOST_CHECK ( handler.hasErrors() );
+	ss.str ( "" );
+	handler.printCurrentOrderBook ( ss );
+	BOOST_CHECK_EQUAL ( ss.str(), "Buys:\n1: Buy 10 @ 1000\nSells:\n3: Sell 1 @ 1010\n"
+						"[AAPL]\nBuys:\n<empty>\nSells:\n1: Sell 7 @ 30\n"
+						"[IBM]\nBuys:\n1: Buy 5 @ 20\nSells:\n<empty>\n" );
+	ss.str ( "" );
+	handler.printErrorSummary ( ss );
+	BOOST_CHECK ( ss.str().find ( "Errors [IBM]:\n" ) != std::string::npos );
+}
+
+/*
+ * However many workers we spread the instruments over, every book and every error count has to come out exactly
+ * like a single FeedHandler would have them.
+ */
+BOOST_AUTO_TEST_CASE ( shardedFeedTest )
+{
+	static const char * symbols[] = { "", ",AAPL", ",IBM", ",MSFT", ",GOOG", ",X", ",VOD.L", ",BT" };
+	static const size_t symbol_count ( sizeof ( symbols ) / sizeof ( symbols[0] ) );
+	std::vector < Message > messages ( generatedFeed ( 3000, symbols ) );
+	messages.push_back ( parse ( "nonsense" ) );
+	FeedHandler single;
+	std::stringstream discard;
+	for ( size_t i = 0; i < messages.size(); i++ )
+		single.processMessage ( messages[i], discard );
+	std::stringstream single_books, single_errors;
+	single.printCurrentOrderBook ( single_books );
+	single.printErrorSummary ( single_errors );
+	BOOST_CHECK_EQUAL ( single.instruments().size(), symbol_count - 1 );
+	for ( size_t workers = 1; workers <= 3; workers++ )
+	{
+		ShardedFeed sharded ( workers );
+		for ( size_t i = 0; i < messages.size(); i++ )
+			sharded.process ( messages[i] );
+		sharded.close();
+		std::stringstream books, errors;
+		{
+			StreamSink sink ( books );
+			OutputBuffer out ( sink );
+			sharded.printCurrentOrderBook ( out );
+		}
+		sharded.printErrorSummary ( errors );
+		BOOST_CHECK_EQUAL ( books.str(), single_books.str() );
+		BOOST_CHECK_EQUAL ( errors.str(), single_errors.str() );
+		BOOST_CHECK_EQUAL ( sharded.hasErrors(), single.hasErrors() );
+		// and nobody has an instrument that isn't theirs
+		for ( size_t w = 0; w < workers; w++ )
+		{
+			std::vector < Symbol > const & known ( sharded.feed ( w ).instruments().symbols() );
+			for ( size_t i = 0; i < known.size(); i++ )
+				BOOST_CHECK_EQUAL ( sharded.workerOf ( known[i] ), w );
+		}
+	}
+}
+
+/*
+ * Through a pipe, with blocks so small that lines keep ending up in two ( or many more ) of them. We should still
+ * split them exactly like std::getline would.
+ */
+BOOST_AUTO_TEST_CASE ( streamReaderTest )
+{
+	static const char * inputs[] = { "A,1,B,1,1000\n\nT,1,1000", "", "\n", "A,1,B,1,1000\n", "X,100004,B,10,950\r\nT,2,1025\n\n" };
+	size_t block_sizes[] = { 1, 3, 8, StreamReader::default_block_size };
+	for ( size_t i = 0; i < sizeof ( inputs ) / sizeof ( inputs[0] ); i++ )
+	{
+		std::vector < std::string > expected;
+		std::istringstream is ( inputs[i] );
+		std::string line;
+		while ( std::getline ( is, line ) )
+			expected.push_back ( line );
+		for ( size_t b = 0; b < sizeof ( block_sizes ) / sizeof ( block_sizes[0] ); b++ )
+			for ( int use_io_uring = 0; use_io_uring < 2; use_io_uring++ )
+			{
+				int fds[2];
+				BOOST_REQUIRE ( pipe ( fds ) == 0 );
+				BOOST_REQUIRE ( FdSink::writeAll ( fds[1], inputs[i], strlen ( inputs[i] ) ) );
+				close ( fds[1] );
+				std::vector < std::string > lines;
+				{
+					StreamReader reader ( fds[0], use_io_uring, block_sizes[b] );
+					MessageView view;
+					while ( reader.nextLine ( view ) )
+						lines.push_back ( std::string ( view.data(), view.size() ) );
+					BOOST_CHECK ( reader.good() );
+				}
+				close ( fds[0] );
+				BOOST_CHECK ( lines == expected );
+			}
+	}
+	// a file works just as well, and reading something we can't read from isn't the end of the stream
+	const std::string filename ( "stream_reader_test.txt" );
+	{
+		std::ofstream out ( filename.c_str() );
+		for ( uint32_t i = 0; i < 1000; i++ )
+			out << "A," << i << ",B,1,1000\n";
+	}
+	for ( int use_io_uring = 0; use_io_uring < 2; use_io_uring++ )
+	{
+		FILE * file ( fopen ( filename.c_str(), "r" ) );
+		BOOST_REQUIRE ( file );
+		StreamReader reader ( fileno ( file ), use_io_uring, 100 );
+		MessageView view;
+		uint32_t lines ( 0 );
+		for ( ; reader.nextLine ( view ); lines++ )
+			BOOST_CHECK_EQUAL ( parse ( std::string ( view.data(), view.size() ) ).order_id, lines );
+		BOOST_CHECK_EQUAL ( lines, ( uint32_t ) 1000 );
+		fclose ( file );
+	}
+	std::remove ( filename.c_str() );
+	StreamReader reader ( -1 );
+	MessageView view;
+	BOOST_CHECK ( !reader.nextLine ( view ) );
+	BOOST_CHECK ( !reader.good() );
+}
+
+/*
+ * The ladder against the map it stands in for, with a window small enough that it has to move, grow and keep
+ * levels outside of it. The levels have to come out in the same order at every step.
+ */
+template < class T >
+static void checkPriceLadder ( uint32_t spread, uint32_t tick )
+{
+	PriceLevelMap < T > map;
+	PriceLadder < T > ladder ( 512 );
+	std::vector < uint32_t > prices;
+	uint32_t random ( 4321 ), centre ( 100000 ), removed ( 0 );
+	for ( size_t i = 0; i < 20000; i++ )
+	{
+		random = random * 1103515245 + 12345;
+		// the prices drift, like they would in a real book
+		if ( i % 1000 == 0 )
+			centre = ( random >> 8 ) % 2 ? centre + spread : centre - spread / 2;
+		if ( prices.empty() || ( random >> 4 ) % 3 )
+		{
+			uint32_t price ( centre + ( ( random >> 12 ) % spread ) * tick );
+			map.add ( price );
+			ladder.add ( price );
+			if ( std::find ( prices.begin(), prices.end(), price ) == prices.end() )
+				prices.push_back ( price );
+		}
+		else
+		{
+			size_t which ( ( random >> 12 ) % prices.size() );
+			map.remove ( prices[ which ] );
+			ladder.remove ( prices[ which ] );
+			removed = prices[ which ];
+			prices.erase ( prices.begin() + which );
+		}
+		BOOST_REQUIRE_EQUAL ( ladder.size(), map.size() );
+		BOOST_REQUIRE_EQUAL ( ladder.empty(), map.empty() );
+		if ( i % 100 == 0 || prices.size() < 3 )
+		{
+			typename PriceLadder < T >::const_iterator level ( ladder.begin() );
+			for ( auto iter = map.begin(); iter != map.end(); iter++, level++ )
+			{
+				BOOST_REQUIRE ( level != ladder.end() );
+				BOOST_REQUIRE_EQUAL ( level->first, iter->first );
+			}
+			BOOST_REQUIRE ( level == ladder.end() );
+			// the level after any price we've seen, whether it still has a level or not
+			uint32_t from ( removed && ( prices.empty() || i % 200 == 0 ) ? removed : prices.empty() ? centre : prices[ ( random >> 16 ) % prices.size() ] );
+			typename PriceLevelMap < T >::const_iterator map_after ( map.after ( from ) );
+			typename PriceLadder < T >::const_iterator ladder_after ( ladder.after ( from ) );
+			BOOST_REQUIRE_EQUAL ( ladder_after == ladder.end(), map_after == map.end() );
+			if ( map_after != map.end() )
+				BOOST_REQUIRE_EQUAL ( ladder_after->first, map_after->first );
+		}
+		else if ( !map.empty() )
+			BOOST_REQUIRE_EQUAL ( ladder.begin()->first, map.begin()->first );
+	}
+	BOOST_CHECK ( ladder.tick() > 0 );
+	ladder.clear();
+	BOOST_CHECK ( ladder.empty() );
+	BOOST_CHECK ( ladder.begin() == ladder.end() );
+}
+
+BOOST_AUTO_TEST_CASE ( priceLadderTest )
+{
+	// fits in the window, and then levels that don't
+	checkPriceLadder < std::less<uint32_t> > ( 100, 10 );
+	checkPriceLadder < std::greater<uint32_t> > ( 100, 10 );
+	checkPriceLadder < std::less<uint32_t> > ( 5000, 7 );
+	checkPriceLadder < std::greater<uint32_t> > ( 5000, 7 );
+	checkPriceLadder < std::less<uint32_t> > ( 3000, 1 );
+	checkPriceLadder < std::greater<uint32_t> > ( 3000, 1 );
+	// all the way at the edges of what a price can be
+	PriceLadder < std::greater<uint32_t> > ladder;
+	ladder.add ( std::numeric_limits<uint32_t>::max() );
+	ladder.add ( 1 );
+	ladder.add ( std::numeric_limits<uint32_t>::max() - 1 );
+	PriceLadder < std::greater<uint32_t> >::const_iterator level ( ladder.begin() );
+	BOOST_CHECK_EQUAL ( ( level++ )->first, std::numeric_limits<uint32_t>::max() );
+	BOOST_CHECK_EQUAL ( ( level++ )->first, std::numeric_limits<uint32_t>::max() - 1 );
+	BOOST_CHECK_EQUAL ( ( level++ )->first, ( uint32_t ) 1 );
+	BOOST_CHECK ( level == ladder.end() );
+}
+
+/* What FeedHandler does with an order or a trade, for either kind of book */
+template < class Book >
+static void applyToBook ( Book & book, ErrorSummary & errors, Message const & message, OutputBuffer & out )
+{
+	if ( message.type == MessageType::TRADE )
+		book.handleTrade ( message.volume, message.price, out );
+	else
+	{
+		if ( book.isCrossed() && book.waitingForTrades() )
+			errors.no_trades_when_they_should_happen++;
+		if ( message.type == MessageType::ADD )
+		{
+			Order_ptr order ( new Order ( message.order_id, message.side, message.volume, message.price ) );
+			if ( !book.add ( order ) )
+				delete order;
+		}
+		else if ( message.type == MessageType::REMOVE )
+			delete book.remove ( message.order_id, message.side, message.volume, message.price );
+		else
+			book.modify ( message.order_id, message.side, message.volume, message.price );
+	}
+}
+
+/*
+ * A book on other containers has to be exactly the same book, down to what it expects to trade and the errors it counts.
+ */
+/* What a side's levels add up to, walking every order, has to be what they say they are */
+template < class Levels >
+static void checkTotals ( Levels const & levels )
+{
+	uint64_t side_volume ( 0 );
+	size_t side_orders ( 0 );
+	for ( typename Levels::const_iterator level = levels.begin(); level != levels.end(); level++ )
+	{
+		uint64_t volume ( 0 );
+		size_t orders ( 0 );
+		for ( OrderList::iterator iter = level->second->begin(); iter != level->second->end(); iter++ )
+		{
+			volume += ( *iter )->volume();
+			orders++;
+		}
+		BOOST_REQUIRE_EQUAL ( level->second->volume(), volume );
+		BOOST_REQUIRE_EQUAL ( level->second->size(), orders );
+		BOOST_REQUIRE ( levels.find ( level->first ) == level->second.get() );
+		side_volume += volume;
+		side_orders += orders;
+	}
+	BOOST_REQUIRE_EQUAL ( levels.volume(), side_volume );
+	BOOST_REQUIRE_EQUAL ( levels.orders(), side_orders );
+}
+
+template < class Book >
+static void checkSameBook()
+{
+	for ( uint32_t spread = 10; spread <= 100000; spread *= 100 )
+	{
+		ErrorSummary map_errors, other_errors;
+		std::stringstream map_ss, other_ss;
+		StreamSink map_sink ( map_ss ), other_sink ( other_ss );
+		OutputBuffer map_out ( map_sink ), other_out ( other_sink );
+		{
+			OrderBook map_book ( map_errors );
+			Book other_book ( other_errors );
+			uint32_t random ( 777 );
+			// the volume and price of every order in the book
+			std::map < uint32_t, std::pair < uint32_t, uint32_t > > live;
+			for ( size_t i = 0; i < 20000; i++ )
+			{
+				random = random * 1103515245 + 12345;
+				Message message;
+				message.type = ( random >> 8 ) % 7 == 0 ? MessageType::TRADE :
+							   ( random >> 8 ) % 7 < 4 ? MessageType::ADD :
+							   ( random >> 8 ) % 7 < 6 ? MessageType::MODIFY : MessageType::REMOVE;
+				message.order_id = ( random >> 4 ) % 500;
+				message.side = message.order_id % 2 ? OrderSide::BUY : OrderSide::SELL;
+				message.volume = ( random >> 16 ) % 20 + 1;
+				// the sides overlap a little, so we cross now and then
+				message.price = ( message.side == OrderSide::BUY ? 10000000 : 10000000 + spread * 5 ) - spread * 5 + ( random >> 12 ) % spread * 10;
+				// a modify that doesn't change anything isn't something we ever get
+				std::map < uint32_t, std::pair < uint32_t, uint32_t > >::iterator order ( live.find ( message.order_id ) );
+				if ( message.type == MessageType::MODIFY && order != live.end() && order->second == std::make_pair ( message.volume, message.price ) )
+					message.volume++;
+				if ( message.type == MessageType::MODIFY || ( message.type == MessageType::ADD && order == live.end() ) )
+					live[ message.order_id ] = std::make_pair ( message.volume, message.price );
+				else if ( message.type == MessageType::REMOVE && order != live.end() && order->second.second == message.price )
+					live.erase ( order );
+				applyToBook ( map_book, map_errors, message, map_out );
+				applyToBook ( other_book, other_errors, message, other_out );
+				BOOST_REQUIRE_EQUAL ( other_book.topOfBookSum(), map_book.topOfBookSum() );
+				BOOST_REQUIRE_EQUAL ( other_book.isCrossed(), map_book.isCrossed() );
+				if ( i % 1000 == 0 )
+				{
+					map_book.print ( map_out );
+					other_book.print ( other_out );
+					checkTotals ( map_book.buys() );
+					checkTotals ( map_book.sells() );
+					checkTotals ( other_book.buys() );
+					checkTotals ( other_book.sells() );
+					BOOST_REQUIRE ( !map_book.buys().find ( 1 ) );
+				}
+			}
+			map_book.print ( map_out );
+			other_book.print ( other_out );
+		}
+		map_out.flush();
+		other_out.flush();
+		BOOST_CHECK ( other_ss.str() == map_ss.str() );
+		std::stringstream map_summary, other_summary;
+		map_summary << map_errors;
+		other_summary << other_errors;
+		BOOST_CHECK_EQUAL ( other_summary.str(), map_summary.str() );
+	}
+}
+
+BOOST_AUTO_TEST_CASE ( ladderOrderBookTest )
+{
+	checkSameBook < LadderOrderBook >();
+}
+
+/* Levels and order index on nothing but std containers */
+BOOST_AUTO_TEST_CASE ( stdOrderBookTest )
+{
+	checkSameBook < StdOrderBook >();
+}
+
+/*
+ * The queue runs through the orders themselves: taking one out anywhere has to leave the rest in order, and an order
+ * that's out can go straight back in at the back.
+ */
+BOOST_AUTO_TEST_CASE ( orderListTest )
+{
+	std::vector < uint32_t > expected;
+	std::vector < Order_ptr > orders;
+	{
+		OrderList list;
+		BOOST_CHECK ( list.empty() );
+		BOOST_CHECK ( !list.front() );
+		BOOST_CHECK ( list.begin() == list.end() );
+		for ( uint32_t i = 0; i < 5; i++ )
+		{
+			orders.push_back ( new Order ( i, OrderSide::BUY, 10, 1000 ) );
+			list.add ( orders.back(), i );
+		}
+		// the middle, the front, the back - and the one at the front goes to the back again
+		list.remove ( orders[2] );
+		list.remove ( orders[0] );
+		list.remove ( orders[4] );
+		list.remove ( orders[1] );
+		list.add ( orders[1], 5 );
+		BOOST_CHECK_EQUAL ( list.size(), ( size_t ) 2 );
+		BOOST_CHECK_EQUAL ( list.front()->orderId(), ( uint32_t ) 3 );
+		BOOST_CHECK_EQUAL ( orders[1]->sequenceId(), ( uint32_t ) 5 );
+		for ( OrderList::iterator iter = list.begin(); iter != list.end(); iter++ )
+			expected.push_back ( ( *iter )->orderId() );
+		BOOST_CHECK ( expected == std::vector < uint32_t > ( { 3, 1 } ) );
+		list.remove ( orders[3] );
+		list.remove ( orders[1] );
+		BOOST_CHECK ( list.empty() );
+		BOOST_CHECK ( !list.front() );
+		// whatever's still in the list when it goes, goes with it
+		list.add ( orders[1], 6 );
+		list.add ( orders[3], 7 );
+	}
+	delete orders[0];
+	delete orders[2];
+	delete orders[4];
+	// requeueing through the book: more volume goes to the back, less keeps its place
+	ErrorSummary errors;
+	OrderBook book ( errors );
+	for ( uint32_t i = 1; i <= 3; i++ )
+		book.add ( new Order ( i, OrderSide::SELL, 10, 2000 ) );
+	book.modify ( 1, OrderSide::SELL, 20, 2000 );
+	book.modify ( 2, OrderSide::SELL, 5, 2000 );
+	expected.clear();
+	OrderList_ptr const & level ( book.sells().begin()->second );
+	for ( OrderList::iterator iter = level->begin(); iter != level->end(); iter++ )
+		expected.push_back ( ( *iter )->orderId() );
+	BOOST_CHECK ( expected == std::vector < uint32_t > ( { 2, 3, 1 } ) );
+	Order_ptr removed ( book.remove ( 3, OrderSide::SELL, 10, 2000 ) );
+	BOOST_CHECK ( removed );
+	delete removed;
+	BOOST_CHECK_EQUAL ( level->size(), ( size_t ) 2 );
+}
+
+BOOST_AUTO_TEST_CASE ( orderTextCacheTest )
+{
+	BOOST_CHECK_EQUAL ( sizeof ( Order ), ( size_t ) 32 );
+	OrderTextCache & cache ( OrderTextCache::instance() );
+	BOOST_CHECK ( cache.entries() >= OrderTextCache::min_entries );
+	ErrorSummary errors;
+	OrderBook book ( errors );
+	Order_ptr order ( new Order ( 7, OrderSide::SELL, 10, 1010000 ) );
+	book.add ( order );
+	std::stringstream ss;
+	ss << *order;
+	BOOST_CHECK_EQUAL ( ss.str(), "7: Sell 10 @ 1010" );
+	// the second time around, we've got it already
+	size_t misses ( cache.misses() );
+	ss.str ( "" );
+	ss << *order;
+	BOOST_CHECK_EQUAL ( ss.str(), "7: Sell 10 @ 1010" );
+	BOOST_CHECK_EQUAL ( cache.misses(), misses );
+	// modified, it doesn't match anymore
+	book.modify ( 7, OrderSide::SELL, 5, 1010000 );
+	ss.str ( "" );
+	ss << *order;
+	BOOST_CHECK_EQUAL ( ss.str(), "7: Sell 5 @ 1010" );
+	BOOST_CHECK_EQUAL ( cache.misses(), misses + 1 );
+	// and neither does another order in the same slot
+	delete book.remove ( 7, OrderSide::SELL, 5, 1010000 );
+	Order_ptr reused ( new Order ( 8, OrderSide::BUY, 5, 1010000 ) );
+	BOOST_CHECK ( reused == order );
+	ss.str ( "" );
+	ss << *reused;
+	BOOST_CHECK_EQUAL ( ss.str(), "8: Buy 5 @ 1010" );
+	delete reused;
+	// grows along with the pool, once we print a book
+	PoolAllocator < Order >::instance().reserve ( OrderTextCache::max_entries * 2 );
+	size_t entries ( cache.entries() );
+	order = new Order ( 9, OrderSide::BUY, 5, 1010000 );
+	book.add ( order );
+	ss << *order;
+	BOOST_CHECK_EQUAL ( cache.entries(), entries );
+	ss.str ( "" );
+	{
+		StreamSink sink ( ss );
+		OutputBuffer out ( sink );
+		book.print ( out );
+	}
+	BOOST_CHECK_EQUAL ( ss.str(), "Buys:\n9: Buy 5 @ 1010\nSells:\n<empty>\n" );
+	BOOST_CHECK_EQUAL ( cache.entries(), OrderTextCache::max_entries );
+}
+
+BOOST_AUTO_TEST_CASE ( flatIndexTest )
+{
+	FlatIndex < uint32_t > index;
+	BOOST_CHECK ( index.empty() );
+	BOOST_CHECK ( !index.find ( 1 ) );
+	BOOST_CHECK ( !index.erase ( 1 ) );
+	BOOST_CHECK ( index.insert ( 1, 10 ) );
+	BOOST_CHECK ( !index.insert ( 1, 11 ) );
+	BOOST_CHECK_EQUAL ( *index.find ( 1 ), ( uint32_t ) 10 );
+	BOOST_CHECK ( index.erase ( 1 ) );
+	BOOST_CHECK ( !index.find ( 1 ) );
+	// the same thing as a std::map, through plenty of growing ( and erasing while we're at it )
+	std::map < uint32_t, uint32_t > reference;
+	uint32_t random ( 4321 );
+	bool saw_rehashing ( false );
+	for ( uint32_t i = 0; i < 200000; i++ )
+	{
+		random = random * 1103515245 + 12345;
+		// keys close together, like order ids, and now and then one far away
+		uint32_t key ( random % 7 ? i / 2 + ( random >> 8 ) % 64 : random );
+		if ( ( random >> 4 ) % 3 )
+			BOOST_REQUIRE_EQUAL ( index.insert ( key, i ), reference.insert ( std::make_pair ( key, i ) ).second );
+		else
+			BOOST_REQUIRE_EQUAL ( index.erase ( key ), reference.erase ( key ) == 1 );
+		saw_rehashing = saw_rehashing || index.rehashing();
+		BOOST_REQUIRE_EQUAL ( index.size(), reference.size() );
+	}
+	BOOST_CHECK ( saw_rehashing );
+	for ( std::map < uint32_t, uint32_t >::const_iterator iter = reference.begin(); iter != reference.end(); iter++ )
+	{
+		uint32_t const * found ( index.find ( iter->first ) );
+		BOOST_REQUIRE ( found );
+		BOOST_CHECK_EQUAL ( *found, iter->second );
+	}
+	for ( uint32_t i = 0; i < 1000; i++ )
+		BOOST_CHECK_EQUAL ( index.find ( 300000 + i ) != 0, reference.count ( 300000 + i ) == 1 );
+	// erasing everything leaves nothing behind, and we can start over
+	for ( std::map < uint32_t, uint32_t >::const_iterator iter = reference.begin(); iter != reference.end(); iter++ )
+		BOOST_REQUIRE ( index.erase ( iter->first ) );
+	BOOST_CHECK ( index.empty() );
+	BOOST_CHECK ( index.insert ( 5, 5 ) );
+	index.clear();
+	BOOST_CHECK ( !index.find ( 5 ) );
+	// reserving up front means we never have to grow on the way
+	FlatIndex < uint32_t > reserved;
+	reserved.reserve ( 100000 );
+	BOOST_CHECK ( !reserved.rehashing() );
+	size_t capacity ( reserved.capacity() );
+	BOOST_CHECK ( capacity >= 100000 );
+	for ( uint32_t i = 0; i < 100000; i++ )
+		reserved.insert ( i, i );
+	BOOST_CHECK_EQUAL ( reserved.capacity(), capacity );
+	BOOST_CHECK ( !reserved.rehashing() );
+	// and reserving while we're growing finishes that first
+	FlatIndex < uint32_t > growing;
+	uint32_t key ( 0 );
+	while ( !growing.rehashing() )
+		growing.insert ( key++, 0 );
+	growing.reserve ( 100000 );
+	BOOST_CHECK ( !growing.rehashing() );
+	for ( uint32_t i = 0; i < key; i++ )
+		BOOST_REQUIRE ( growing.find ( i ) );
+}
+
+struct PooledThing
+{
+	uint64_t a;
+	uint32_t b;
+};
+
+BOOST_AUTO_TEST_CASE ( poolAllocatorTest )
+{
+	PoolAllocator < PooledThing > pool;
+	pool.setChunkSize ( 100 );
+	BOOST_CHECK_EQUAL ( pool.chunks(), ( size_t ) 0 );
+	// more than a chunk's worth ( a chunk is rounded up to whole pages ), all of them different and properly aligned
+	std::vector < PooledThing * > things;
+	for ( uint32_t i = 0; i < 1000; i++ )
+	{
+		things.push_back ( pool.allocate ( sizeof ( PooledThing ) ) );
+		BOOST_CHECK_EQUAL ( reinterpret_cast < uintptr_t > ( things.back() ) % alignof ( PooledThing ), ( uintptr_t ) 0 );
+		things.back()->a = i;
+		things.back()->b = i;
+	}
+	std::vector < PooledThing * > sorted ( things );
+	std::sort ( sorted.begin(), sorted.end() );
+	BOOST_CHECK ( std::adjacent_find ( sorted.begin(), sorted.end() ) == sorted.end() );
+	for ( uint32_t i = 0; i < 1000; i++ )
+		BOOST_CHECK_EQUAL ( things[i]->a, ( uint64_t ) i );
+	size_t chunks ( pool.chunks() );
+	BOOST_CHECK ( chunks >= 2 );
+	BOOST_CHECK ( pool.capacity() >= 1000 );
+	// what we give back is what we get next, without another chunk
+	pool.deallocate ( things[10], sizeof ( PooledThing ) );
+	pool.deallocate ( things[20], sizeof ( PooledThing ) );
+	BOOST_CHECK_EQUAL ( pool.allocate ( sizeof ( PooledThing ) ), things[20] );
+	BOOST_CHECK_EQUAL ( pool.allocate ( sizeof ( PooledThing ) ), things[10] );
+	BOOST_CHECK_EQUAL ( pool.chunks(), chunks );
+	// reserving means the next ones don't need a chunk anymore
+	pool.reserve ( 5000 );
+	chunks = pool.chunks();
+	for ( uint32_t i = 0; i < 5000; i++ )
+		pool.allocate ( sizeof ( PooledThing ) )->a = i;
+	BOOST_CHECK_EQUAL ( pool.chunks(), chunks );
+	// everything goes at once
+	pool.reset();
+	BOOST_CHECK_EQUAL ( pool.chunks(), ( size_t ) 0 );
+	BOOST_CHECK_EQUAL ( pool.capacity(), ( size_t ) 0 );
+	// prefaulted, and on huge pages if we can get them: either way a chunk is a whole number of them
+	pool.setPrefault ( true );
+	pool.setHugePages ( true );
+	PooledThing * thing ( pool.allocate ( sizeof ( PooledThing ) ) );
+	thing->a = 1;
+	BOOST_CHECK_EQUAL ( reinterpret_cast < uintptr_t > ( thing ) % PoolAllocator < PooledThing >::huge_page_size, ( uintptr_t ) 0 );
+	BOOST_CHECK ( pool.capacity() * sizeof ( PooledThing ) >= PoolAllocator < PooledThing >::huge_page_size );
+	pool.reset();
+}
+
+BOOST_AUTO_TEST_CASE ( resetSessionTest )
+{
+	FeedHandler handler;
+	std::stringstream ss;
+	for ( uint32_t i = 1; i <= 1000; i++ )
+		handler.processMessage ( ( boost::format ( "A,%1%,%2%,10,%3%" ) % i % ( i % 2 ? 'B' : 'S' ) % ( i % 2 ? 1000 - i % 10 : 1100 + i % 10 ) ).str(), ss );
+	handler.processMessage ( "A,1,B,10,1000,FOO", ss );
+	BOOST_CHECK_EQUAL ( handler.book().buys().size(), ( size_t ) 5 );
+	BOOST_CHECK ( PoolAllocator < Order >::instance().chunks() > 0 );
+	handler.resetSession();
+	BOOST_CHECK_EQUAL ( PoolAllocator < Order >::instance().chunks(), ( size_t ) 0 );
+	BOOST_CHECK ( handler.book().buys().empty() );
+	BOOST_CHECK ( handler.book().sells().empty() );
+	BOOST_CHECK ( !handler.book().contains ( 1 ) );
+	BOOST_CHECK ( handler.instrument ( handler.instruments().symbols()[0] )->book.buys().empty() );
+	// and we carry on as if nothing happened, the same ids are new orders again
+	ss.str ( "" );
+	ss.clear();
+	handler.processMessage ( "A,1,B,10,1000", ss );
+	handler.processMessage ( "A,2,S,10,1010", ss );
+	BOOST_CHECK_EQUAL ( getFirst ( ss ), "NAN" );
+	BOOST_CHECK_EQUAL ( handler.book().buys().begin()->second->front()->orderId(), ( uint32_t ) 1 );
+	BOOST_CHECK_EQUAL ( handler.errors().duplicate_order_id, ( uint32_t ) 0 );
+	std::stringstream book;
+	handler.printCurrentOrderBook ( book );
+	BOOST_CHECK ( book.str().find ( "FOO" ) != std::string::npos );
+}
+
+/* Keeps every delta, and what the levels look like after all of them */
+class DeltaRecorder : public LevelListener
+{
+public:
+	virtual void levelChanged ( LevelDelta const & delta )
+	{
+		deltas.push_back ( delta );
+		std::map < uint32_t, DepthLevel > & side ( levels[ delta.side ] );
+		BOOST_REQUIRE_EQUAL ( delta.action == LevelAction::NEW, !side.count ( delta.level.price ) );
+		if ( delta.action == LevelAction::DELETE )
+		{
+			BOOST_REQUIRE_EQUAL ( delta.level.volume, ( uint64_t ) 0 );
+			side.erase ( delta.level.price );
+		}
+		else
+			side[ delta.level.price ] = delta.level;
+	}
+	std::vector < LevelDelta > deltas;
+	std::map < uint32_t, DepthLevel > levels[2];
+};
+
+BOOST_AUTO_TEST_CASE ( levelDeltaTest )
+{
+	ErrorSummary errors;
+	OrderBook book ( errors );
+	DeltaRecorder recorder;
+	book.setLevelListener ( &recorder );
+	book.add ( new Order ( 1, OrderSide::BUY, 10, 1000 ) );
+	book.add ( new Order ( 2, OrderSide::BUY, 5, 1000 ) );
+	book.add ( new Order ( 3, OrderSide::BUY, 7, 990 ) );
+	book.modify ( 1, OrderSide::BUY, 4, 1000 );
+	delete book.remove ( 2, OrderSide::BUY, 5, 1000 );
+	delete book.remove ( 1, OrderSide::BUY, 4, 1000 );
+	LevelAction::Action actions[] = { LevelAction::NEW, LevelAction::UPDATE, LevelAction::NEW, LevelAction::UPDATE, LevelAction::UPDATE, LevelAction::DELETE };
+	uint64_t volumes[] = { 10, 15, 7, 9, 4, 0 };
+	BOOST_REQUIRE_EQUAL ( recorder.deltas.size(), sizeof ( actions ) / sizeof ( actions[0] ) );
+	for ( size_t i = 0; i < recorder.deltas.size(); i++ )
+	{
+		BOOST_CHECK_EQUAL ( recorder.deltas[i].action, actions[i] );
+		BOOST_CHECK_EQUAL ( recorder.deltas[i].level.volume, volumes[i] );
+		BOOST_CHECK_EQUAL ( recorder.deltas[i].side, OrderSide::BUY );
+	}
+	BOOST_CHECK_EQUAL ( recorder.deltas[1].level.orders, ( uint32_t ) 2 );
+	// a lot of orders later, the deltas still add up to the book
+	uint32_t random ( 4242 );
+	// the volume and price of every order we added
+	std::map < uint32_t, std::pair < uint32_t, uint32_t > > live;
+	for ( size_t i = 0; i < 20000; i++ )
+	{
+		random = random * 1103515245 + 12345;
+		uint32_t id ( ( random >> 4 ) % 300 + 10 );
+		OrderSide::Side side ( id % 2 ? OrderSide::BUY : OrderSide::SELL );
+		std::pair < uint32_t, uint32_t > order ( ( random >> 16 ) % 20 + 1, ( side == OrderSide::BUY ? 1000 : 1100 ) + ( random >> 12 ) % 50 * 10 );
+		if ( !live.count ( id ) )
+			book.add ( new Order ( id, side, order.first, order.second ) );
+		else if ( ( random >> 8 ) % 3 )
+		{
+			delete book.remove ( id, side, 0, live[ id ].second );
+			live.erase ( id );
+			continue;
+		}
+		else
+		{
+			// a modify that doesn't change anything isn't something we ever get
+			if ( live[ id ] == order )
+				order.first++;
+			book.modify ( id, side, order.first, order.second );
+		}
+		live[ id ] = order;
+	}
+	BOOST_CHECK_EQUAL ( errors.removes_with_no_corresponding_order, ( uint32_t ) 0 );
+	for ( int side = OrderSide::BUY; side <= OrderSide::SELL; side++ )
+	{
+		DepthLevel depth[ 1000 ];
+		size_t levels ( book.getDepth ( static_cast < OrderSide::Side > ( side ), depth, 1000 ) );
+		BOOST_REQUIRE_EQUAL ( levels, recorder.levels[ side ].size() );
+		BOOST_REQUIRE ( levels > 3 );
+		for ( size_t level = 0; level < levels; level++ )
+		{
+			DepthLevel const & recorded ( recorder.levels[ side ][ depth[ level ].price ] );
+			BOOST_CHECK_EQUAL ( recorded.volume, depth[ level ].volume );
+			BOOST_CHECK_EQUAL ( recorded.orders, depth[ level ].orders );
+		}
+		// best first, and no more than we asked for
+		BOOST_CHECK ( side == OrderSide::BUY ? depth[0].price > depth[1].price : depth[0].price < depth[1].price );
+		BOOST_CHECK_EQUAL ( book.getDepth ( static_cast < OrderSide::Side > ( side ), depth, 3 ), ( size_t ) 3 );
+	}
+	// nothing while we're not listening
+	book.setLevelListener ( 0 );
+	size_t deltas ( recorder.deltas.size() );
+	book.add ( new Order ( 1, OrderSide::BUY, 10, 1000 ) );
+	delete book.remove ( 1, OrderSide::BUY, 10, 1000 );
+	BOOST_CHECK_EQUAL ( recorder.deltas.size(), deltas );
+	book.setLevelListener ( &recorder );
+	// everything that goes, goes as a delete
+	book.abandonOrders();
+	BOOST_CHECK ( recorder.levels[ OrderSide::BUY ].empty() );
+	BOOST_CHECK ( recorder.levels[ OrderSide::SELL ].empty() );
+	// and the records on the wire come back the same
+	std::stringstream ss;
+	{
+		StreamSink sink ( ss );
+		OutputBuffer out ( sink );
+		LevelDeltaPublisher publisher ( out );
+		for ( size_t i = 0; i < 10; i++ )
+			publisher.levelChanged ( recorder.deltas[i] );
+		BOOST_CHECK_EQUAL ( publisher.published(), ( size_t ) 10 );
+	}
+	std::string wire ( ss.str() );
+	BOOST_REQUIRE_EQUAL ( wire.size(), 10 * LevelDeltaPublisher::record_size );
+	for ( size_t i = 0; i < 10; i++ )
+	{
+		LevelDelta delta;
+		BOOST_REQUIRE ( LevelDeltaPublisher::decode ( wire.data() + i * LevelDeltaPublisher::record_size, delta ) );
+		BOOST_CHECK_EQUAL ( delta.action, recorder.deltas[i].action );
+		BOOST_CHECK_EQUAL ( delta.side, recorder.deltas[i].side );
+		BOOST_CHECK_EQUAL ( delta.level.price, recorder.deltas[i].level.price );
+		BOOST_CHECK_EQUAL ( delta.level.orders, recorder.deltas[i].level.orders );
+		BOOST_CHECK_EQUAL ( delta.level.volume, recorder.deltas[i].level.volume );
+	}
+	LevelDelta delta;
+	BOOST_CHECK ( !LevelDeltaPublisher::decode ( "X", delta ) );
+}
+
+/* Keeps every fill */
+class FillRecorder : public FillListener
+{
+public:
+	virtual void filled ( Fill const & fill )
+	{
+		fills.push_back ( fill );
+	}
+	std::vector < Fill > fills;
+};
+
+static void checkFill ( Fill const & fill, uint32_t aggressor_id, uint32_t resting_id, uint32_t price, uint32_t volume, uint32_t resting_volume_left )
+{
+	BOOST_CHECK_EQUAL ( fill.aggressor_id, aggressor_id );
+	BOOST_CHECK_EQUAL ( fill.resting_id, resting_id );
+	BOOST_CHECK_EQUAL ( fill.price, price );
+	BOOST_CHECK_EQUAL ( fill.volume, volume );
+	BOOST_CHECK_EQUAL ( fill.resting_volume_left, resting_volume_left );
+}
+
+/*
+ * Lots of orders, some of them aggressive, through execute(): the book may never be left crossed, and no fill is
+ * at a worse price than the incoming order asked for.
+ */
+template < class Book >
+static void executeRandomOrders ( Book & book, FillRecorder & recorder )
+{
+	uint32_t random ( 9191 );
+	for ( uint32_t id = 1; id <= 20000; id++ )
+	{
+		random = random * 1103515245 + 12345;
+		OrderSide::Side side ( random % 2 ? OrderSide::BUY : OrderSide::SELL );
+		OrderType::Type type ( ( random >> 8 ) % 10 == 0 ? OrderType::MARKET : ( random >> 8 ) % 10 < 3 ? OrderType::IOC : OrderType::LIMIT );
+		uint32_t volume ( ( random >> 16 ) % 50 + 1 );
+		uint32_t price ( 99800 + ( random >> 12 ) % 40 * 10 );
+		size_t before ( recorder.fills.size() );
+		uint32_t filled ( book.execute ( id, side, volume, price, type ) );
+		BOOST_REQUIRE ( !book.isCrossed() );
+		BOOST_REQUIRE_EQUAL ( book.contains ( id ), type == OrderType::LIMIT && filled < volume );
+		uint32_t traded ( 0 );
+		for ( size_t i = before; i < recorder.fills.size(); i++ )
+		{
+			Fill const & fill ( recorder.fills[i] );
+			BOOST_REQUIRE_EQUAL ( fill.aggressor_id, id );
+			BOOST_REQUIRE_EQUAL ( book.contains ( fill.resting_id ), fill.resting_volume_left > 0 );
+			if ( type != OrderType::MARKET )
+				BOOST_REQUIRE ( side == OrderSide::BUY ? fill.price <= price : fill.price >= price );
+			traded += fill.volume;
+		}
+		BOOST_REQUIRE_EQUAL ( traded, filled );
+		if ( id % 1000 == 0 )
+		{
+			checkTotals ( book.buys() );
+			checkTotals ( book.sells() );
+		}
+	}
+}
+
+/* Price first, then time: the best level trades first, and within a level whoever was queued there first */
+BOOST_AUTO_TEST_CASE ( matchingEngineTest )
+{
+	ErrorSummary errors;
+	OrderBook book ( errors );
+	FillRecorder recorder;
+	book.setFillListener ( &recorder );
+	book.add ( new Order ( 1, OrderSide::SELL, 10, 1010 ) );
+	book.add ( new Order ( 2, OrderSide::SELL, 5, 1000 ) );
+	book.add ( new Order ( 3, OrderSide::SELL, 7, 1000 ) );
+	book.add ( new Order ( 4, OrderSide::BUY, 10, 990 ) );
+	BOOST_CHECK_EQUAL ( book.execute ( 10, OrderSide::BUY, 14, 1010, OrderType::IOC ), ( uint32_t ) 14 );
+	BOOST_REQUIRE_EQUAL ( recorder.fills.size(), ( size_t ) 3 );
+	checkFill ( recorder.fills[0], 10, 2, 1000, 5, 0 );
+	checkFill ( recorder.fills[1], 10, 3, 1000, 7, 0 );
+	checkFill ( recorder.fills[2], 10, 1, 1010, 2, 8 );
+	BOOST_CHECK ( !book.contains ( 2 ) && !book.contains ( 3 ) && !book.contains ( 10 ) );
+	BOOST_CHECK_EQUAL ( book.sells().begin()->second->front()->volume(), ( uint32_t ) 8 );
+	BOOST_CHECK_EQUAL ( book.sells().volume(), ( uint64_t ) 8 );
+	// nothing at our price, and nothing rests
+	BOOST_CHECK_EQUAL ( book.execute ( 11, OrderSide::BUY, 5, 1005, OrderType::IOC ), ( uint32_t ) 0 );
+	BOOST_CHECK ( !book.contains ( 11 ) );
+	// what's left of a limit order does rest
+	BOOST_CHECK_EQUAL ( book.execute ( 12, OrderSide::BUY, 10, 1010 ), ( uint32_t ) 8 );
+	BOOST_CHECK ( book.contains ( 12 ) );
+	BOOST_CHECK ( book.sells().empty() );
+	BOOST_CHECK_EQUAL ( book.buys().begin()->first, ( uint32_t ) 1010 );
+	BOOST_CHECK_EQUAL ( book.buys().volume(), ( uint64_t ) 12 );
+	BOOST_CHECK_EQUAL ( book.midPrice(), std::numeric_limits<double>::max() );
+	// a market order takes any price there is
+	BOOST_CHECK_EQUAL ( book.execute ( 13, OrderSide::SELL, 20, 0, OrderType::MARKET ), ( uint32_t ) 12 );
+	BOOST_REQUIRE_EQUAL ( recorder.fills.size(), ( size_t ) 6 );
+	checkFill ( recorder.fills[3], 12, 1, 1010, 8, 0 );
+	checkFill ( recorder.fills[4], 13, 12, 1010, 2, 0 );
+	checkFill ( recorder.fills[5], 13, 4, 990, 10, 0 );
+	BOOST_CHECK_EQUAL ( recorder.fills[5].aggressor_side, OrderSide::SELL );
+	BOOST_CHECK ( book.buys().empty() );
+	BOOST_CHECK ( !book.contains ( 13 ) );
+	// an id we already have doesn't get to trade
+	book.add ( new Order ( 20, OrderSide::SELL, 5, 1000 ) );
+	BOOST_CHECK_EQUAL ( book.execute ( 20, OrderSide::BUY, 5, 1000 ), ( uint32_t ) 0 );
+	BOOST_CHECK_EQUAL ( errors.duplicate_order_id, ( uint32_t ) 1 );
+	BOOST_CHECK_EQUAL ( recorder.fills.size(), ( size_t ) 6 );
+	// and the same orders make the same fills, whatever the levels are kept in
+	ErrorSummary map_errors, ladder_errors;
+	OrderBook map_book ( map_errors );
+	LadderOrderBook ladder_book ( ladder_errors );
+	FillRecorder map_fills, ladder_fills;
+	map_book.setFillListener ( &map_fills );
+	ladder_book.setFillListener ( &ladder_fills );
+	executeRandomOrders ( map_book, map_fills );
+	executeRandomOrders ( ladder_book, ladder_fills );
+	BOOST_REQUIRE ( map_fills.fills.size() > 1000 );
+	BOOST_REQUIRE_EQUAL ( ladder_fills.fills.size(), map_fills.fills.size() );
+	for ( size_t i = 0; i < map_fills.fills.size(); i++ )
+	{
+		BOOST_REQUIRE_EQUAL ( ladder_fills.fills[i].resting_id, map_fills.fills[i].resting_id );
+		BOOST_REQUIRE_EQUAL ( ladder_fills.fills[i].volume, map_fills.fills[i].volume );
+	}
+	BOOST_CHECK_EQUAL ( ladder_book.topOfBookSum(), map_book.topOfBookSum() );
+}
+
+/* Prices in ticks of another scale, or in another type, and as offsets from an anchor */
+BOOST_AUTO_TEST_CASE ( priceTraitsTest )
+{
+	std::string text ( "2.015" );
+	const char * pos ( text.data() );
+	uint32_t ticks;
+	uint64_t wide_ticks;
+	BOOST_CHECK ( FeedHandler::parsePrice < DefaultPriceTraits > ( pos, text.data() + text.size(), ticks ) );
+	BOOST_CHECK_EQUAL ( ticks, ( uint32_t ) 2015 );
+	BOOST_CHECK ( pos == text.data() + text.size() );
+	pos = text.data();
+	BOOST_CHECK ( FeedHandler::parsePrice < CentPriceTraits > ( pos, text.data() + text.size(), ticks ) );
+	BOOST_CHECK_EQUAL ( ticks, ( uint32_t ) 201 );
+	pos = text.data();
+	BOOST_CHECK ( FeedHandler::parsePrice < WidePriceTraits > ( pos, text.data() + text.size(), wide_ticks ) );
+	BOOST_CHECK_EQUAL ( wide_ticks, ( uint64_t ) 2015000 );
+	// more than 32 bits worth of ticks
+	text = "5000000.25";
+	pos = text.data();
+	BOOST_CHECK ( !FeedHandler::parsePrice < DefaultPriceTraits > ( pos, text.data() + text.size(), ticks ) );
+	pos = text.data();
+	BOOST_CHECK ( FeedHandler::parsePrice < WidePriceTraits > ( pos, text.data() + text.size(), wide_ticks ) );
+	BOOST_CHECK_EQUAL ( wide_ticks, 5000000250000ull );
+	// the largest price in cents we take, and one more
+	text = "42949672.00";
+	pos = text.data();
+	BOOST_CHECK ( FeedHandler::parsePrice < CentPriceTraits > ( pos, text.data() + text.size(), ticks ) );
+	BOOST_CHECK_EQUAL ( ticks, ( uint32_t ) 4294967200u );
+	text = "42949672.01";
+	pos = text.data();
+	BOOST_CHECK ( !FeedHandler::parsePrice < CentPriceTraits > ( pos, text.data() + text.size(), ticks ) );
+	// and in millionths, where going over would wrap 64 bits around
+	text = "18446744073709.000000";
+	pos = text.data();
+	BOOST_CHECK ( FeedHandler::parsePrice < WidePriceTraits > ( pos, text.data() + text.size(), wide_ticks ) );
+	BOOST_CHECK_EQUAL ( wide_ticks, 18446744073709000000ull );
+	const char * too_wide[] = { "18446744073709.000001", "18446744073709.9", "18446744073709.551615", "18446744073709.551616", "18446744073709.0000001" };
+	for ( size_t i = 0; i < sizeof ( too_wide ) / sizeof ( too_wide[0] ); i++ )
+	{
+		text = too_wide[i];
+		pos = text.data();
+		BOOST_CHECK_MESSAGE ( !FeedHandler::parsePrice < WidePriceTraits > ( pos, text.data() + text.size(), wide_ticks ), text );
+	}
+	char buffer[ NumberFormat::max_length ];
+	BOOST_CHECK_EQUAL ( std::string ( buffer, NumberFormat::formatPrice < CentPriceTraits > ( buffer, 201 ) ), "2.01" );
+	BOOST_CHECK_EQUAL ( std::string ( buffer, NumberFormat::formatPrice < WidePriceTraits > ( buffer, 123500000 ) ), "123.5" );
+	BOOST_CHECK_EQUAL ( WidePriceTraits::price_decimals, ( uint32_t ) 6 );
+	// and levels at prices that don't fit in 32 bits
+	PriceLevelMap < std::greater < uint64_t > > wide;
+	wide.add ( 10 );
+	wide.add ( 5000000250000ull );
+	BOOST_CHECK_EQUAL ( wide.begin()->first, 5000000250000ull );
+	BOOST_CHECK ( wide.find ( 10 ) );
+	BOOST_CHECK ( !wide.find ( 5000000250000ull + ( 1ull << 32 ) ) );
+	BOOST_CHECK_EQUAL ( wide.after ( 5000000250000ull )->first, ( uint64_t ) 10 );
+	wide.remove ( 5000000250000ull );
+	BOOST_CHECK_EQUAL ( wide.size(), ( size_t ) 1 );
+}
+
+static std::string saveSnapshot ( FeedHandler const & feed, uint64_t position )
+{
+	std::stringstream ss;
+	{
+		StreamSink sink ( ss );
+		OutputBuffer out ( sink );
+		feed.saveSnapshot ( out, position );
+	}
+	return ss.str();
+}
+
+template < class Book >
+static std::string saveBook ( Book const & book )
+{
+	std::stringstream ss;
+	{
+		StreamSink sink ( ss );
+		OutputBuffer out ( sink );
+		SnapshotWriter writer ( out );
+		book.save ( writer );
+	}
+	return ss.str();
+}
+
+template < class Book >
+static std::string printBook ( Book const & book )
+{
+	std::stringstream ss;
+	StreamSink sink ( ss );
+	{
+		OutputBuffer out ( sink );
+		book.print ( out );
+	}
+	return ss.str();
+}
+
+/*
+ * A FeedHandler that picks up from a snapshot taken anywhere in the feed, crossed books and all, has to end up
+ * writing exactly what the one that saw every message did.
+ */
+BOOST_AUTO_TEST_CASE ( snapshotTest )
+{
+	static const char * symbols[] = { "", ",AAPL", ",IBM", ",MSFT", ",GOOG" };
+	std::vector < Message > messages ( generatedFeed ( 3000, symbols ) );
+	FeedHandler original;
+	std::vector < std::string > output;
+	std::vector < std::pair < uint64_t, std::string > > snapshots;
+	size_t crossed ( 0 );
+	for ( size_t i = 0; i < messages.size(); i++ )
+	{
+		if ( i % 37 == 0 )
+		{
+			snapshots.push_back ( std::make_pair ( i, saveSnapshot ( original, i ) ) );
+			crossed += original.book().isCrossed();
+			std::vector < Symbol > const & known ( original.instruments().symbols() );
+			for ( size_t k = 0; k < known.size(); k++ )
+				crossed += original.instrument ( known[k] )->book.isCrossed();
+		}
+		std::stringstream ss;
+		original.processMessage ( messages[i], ss );
+		output.push_back ( ss.str() );
+	}
+	std::stringstream original_books, original_errors;
+	original.printCurrentOrderBook ( original_books );
+	original.printErrorSummary ( original_errors );
+	BOOST_CHECK ( crossed > 0 );
+	for ( size_t s = 0; s < snapshots.size(); s++ )
+	{
+		std::string const & snapshot ( snapshots[s].second );
+		FeedHandler resumed;
+		uint64_t position ( 0 );
+		BOOST_REQUIRE ( resumed.loadSnapshot ( snapshot.data(), snapshot.size(), position ) );
+		BOOST_REQUIRE_EQUAL ( position, snapshots[s].first );
+		// what we loaded saves as the same snapshot
+		BOOST_CHECK ( saveSnapshot ( resumed, position ) == snapshot );
+		std::string expected, got;
+		for ( size_t i = position; i < messages.size(); i++ )
+		{
+			std::stringstream ss;
+			resumed.processMessage ( messages[i], ss );
+			got += ss.str();
+			expected += output[i];
+		}
+		BOOST_CHECK ( got == expected );
+		std::stringstream books, errors;
+		resumed.printCurrentOrderBook ( books );
+		resumed.printErrorSummary ( errors );
+		BOOST_CHECK_EQUAL ( books.str(), original_books.str() );
+		BOOST_CHECK_EQUAL ( errors.str(), original_errors.str() );
+	}
+	// and nothing that's only part of a snapshot, or more, or something else altogether
+	std::string whole ( snapshots.back().second );
+	size_t sizes[] = { 0, 4, 8, 16, whole.size() / 2, whole.size() - 1 };
+	for ( size_t i = 0; i < sizeof ( sizes ) / sizeof ( sizes[0] ); i++ )
+	{
+		FeedHandler feed;
+		uint64_t position ( 0 );
+		BOOST_CHECK ( !feed.loadSnapshot ( whole.data(), sizes[i], position ) );
+	}
+	std::string longer ( whole + '\0' ), other ( whole );
+	other[0] = 'X';
+	FeedHandler longer_feed, other_feed;
+	uint64_t position ( 0 );
+	BOOST_CHECK ( !longer_feed.loadSnapshot ( longer.data(), longer.size(), position ) );
+	BOOST_CHECK ( !other_feed.loadSnapshot ( other.data(), other.size(), position ) );
+}
+
+/* A book saves the same whatever its levels are kept in, so it can be loaded into any other one */
+BOOST_AUTO_TEST_CASE ( bookSnapshotTest )
+{
+	ErrorSummary errors, ladder_errors, map_errors;
+	LadderOrderBook book ( errors );
+	FillRecorder recorder;
+	book.setFillListener ( &recorder );
+	executeRandomOrders ( book, recorder );
+	std::string saved ( saveBook ( book ) );
+	LadderOrderBook ladder_book ( ladder_errors );
+	OrderBook map_book ( map_errors );
+	SnapshotReader ladder_in ( saved.data(), saved.size() ), map_in ( saved.data(), saved.size() );
+	BOOST_REQUIRE ( ladder_book.load ( ladder_in ) );
+	BOOST_REQUIRE ( map_book.load ( map_in ) );
+	BOOST_CHECK ( !ladder_in.remaining() && !map_in.remaining() );
+	BOOST_CHECK_EQUAL ( printBook ( ladder_book ), printBook ( book ) );
+	BOOST_CHECK_EQUAL ( printBook ( map_book ), printBook ( book ) );
+	BOOST_CHECK ( saveBook ( map_book ) == saved );
+	checkTotals ( map_book.buys() );
+	checkTotals ( map_book.sells() );
+	checkTotals ( ladder_book.buys() );
+	checkTotals ( ladder_book.sells() );
+	BOOST_CHECK_EQUAL ( map_book.topOfBookSum(), book.topOfBookSum() );
+	// the queues come back in the same order, so the same orders trade against the same ones
+	FillRecorder map_fills;
+	map_book.setFillListener ( &map_fills );
+	size_t before ( recorder.fills.size() );
+	for ( uint32_t id = 100000; id < 100050; id++ )
+	{
+		OrderSide::Side side ( id % 2 ? OrderSide::BUY : OrderSide::SELL );
+		book.execute ( id, side, 30, 0, OrderType::MARKET );
+		map_book.execute ( id, side, 30, 0, OrderType::MARKET );
+	}
+	BOOST_REQUIRE_EQUAL ( map_fills.fills.size(), recorder.fills.size() - before );
+	BOOST_REQUIRE ( map_fills.fills.size() > 0 );
+	for ( size_t i = 0; i < map_fills.fills.size(); i++ )
+	{
+		BOOST_CHECK_EQUAL ( map_fills.fills[i].resting_id, recorder.fills[ before + i ].resting_id );
+		BOOST_CHECK_EQUAL ( map_fills.fills[i].volume, recorder.fills[ before + i ].volume );
+	}
+	// an order that's in there twice makes no sense, and leaves us with an empty book
+	BOOST_REQUIRE ( book.buys().begin()->second->size() > 1 );
+	std::string twice ( saved );
+	size_t first_order ( 4 * 3 + 1 + 2 + 4 * 4 + 1 + 4 + 8 + 4 + 8 + 4 + 4 );
+	memcpy ( &twice[ first_order + 12 ], &twice[ first_order ], 4 );
+	ErrorSummary twice_errors;
+	OrderBook twice_book ( twice_errors );
+	SnapshotReader twice_in ( twice.data(), twice.size() );
+	BOOST_CHECK ( !twice_book.load ( twice_in ) );
+	BOOST_CHECK ( !twice_in.good() );
+	BOOST_CHECK ( twice_book.buys().empty() && twice_book.sells().empty() );
+	BOOST_CHECK_EQUAL ( twice_book.buys().orders(), ( uint64_t ) 0 );
+}
 
+/*
+ * The trades we expect after a cross are read off the book as it is when they come in: what's left of the crossing
+ * order only takes part of the last order it gets to, an order that's gone isn't expected anymore, an order that was
+ * only queued after we started expecting trades never crossed, and a volume that was modified since counts as it is now.
+ */
+BOOST_AUTO_TEST_CASE ( expectedTradesTest )
+{
+	std::stringstream ss;
+	StreamSink sink ( ss );
+	OutputBuffer out ( sink );
+	ErrorSummary errors;
+	OrderBook book ( errors );
+	const char * before[] = { "A,1,S,5,1000", "A,2,S,3,1000", "A,3,S,4,1002", "A,6,S,3,1004", "A,4,B,8,1005" };
+	for ( size_t i = 0; i < sizeof ( before ) / sizeof ( before[0] ); i++ )
+		applyToBook ( book, errors, parse ( before[i] ), out );
+	BOOST_REQUIRE ( book.isCrossed() );
+	// all of order 1, and 3 to go
+	applyToBook ( book, errors, parse ( "T,5,1000" ), out );
+	BOOST_CHECK_EQUAL ( errors.trades_with_no_corresponding_order, ( uint32_t ) 0 );
+	// order 2 was next, and order 5 came in after we started
+	applyToBook ( book, errors, parse ( "A,5,S,2,1000" ), out );
+	applyToBook ( book, errors, parse ( "X,2,S,3,1000" ), out );
+	applyToBook ( book, errors, parse ( "T,2,1000" ), out );
+	BOOST_CHECK_EQUAL ( errors.trades_with_no_corresponding_order, ( uint32_t ) 1 );
+	// order 3 with the volume it has now, not the 4 it had when we crossed
+	applyToBook ( book, errors, parse ( "M,3,S,2,1002" ), out );
+	applyToBook ( book, errors, parse ( "T,2,1002" ), out );
+	BOOST_CHECK_EQUAL ( errors.trades_with_no_corresponding_order, ( uint32_t ) 1 );
+	// the 1 that's left of order 4 only takes part of order 6
+	applyToBook ( book, errors, parse ( "T,1,1004" ), out );
+	BOOST_CHECK_EQUAL ( errors.trades_with_no_corresponding_order, ( uint32_t ) 1 );
+	// and that's all of it
+	applyToBook ( book, errors, parse ( "T,1,1004" ), out );
+	BOOST_CHECK_EQUAL ( errors.trades_with_no_corresponding_order, ( uint32_t ) 2 );
+}
 
+/* A book whose next sequence id is this one, with nothing in it */
+static void startBookAt ( OrderBook & book, uint32_t sequence_id )
+{
+	ErrorSummary errors;
+	OrderBook empty ( errors );
+	std::string saved ( saveBook ( empty ) );
+	// the sequence id comes first
+	for ( size_t i = 0; i < 4; i++ )
+		saved[i] = static_cast < char > ( sequence_id >> ( 8 * i ) );
+	SnapshotReader in ( saved.data(), saved.size() );
+	BOOST_REQUIRE ( book.load ( in ) );
+}
 
+/* An order only keeps 31 bits of its sequence id, we still know which ones were queued first once they wrap around */
+BOOST_AUTO_TEST_CASE ( sequenceWrapTest )
+{
+	BOOST_CHECK ( Order::queuedBefore ( 0x7FFFFFFF, 0 ) );
+	BOOST_CHECK ( !Order::queuedBefore ( 0, 0x7FFFFFFF ) );
+	BOOST_CHECK ( Order::queuedBefore ( 1, 2 ) );
+	BOOST_CHECK ( !Order::queuedBefore ( 2, 2 ) );
+	std::stringstream ss;
+	StreamSink sink ( ss );
+	OutputBuffer out ( sink );
+	{
+		// the buy is the last one in, even though its sequence id is 0, and both sells were there before we traded
+		ErrorSummary errors;
+		OrderBook book ( errors );
+		startBookAt ( book, 0x7FFFFFFF );
+		const char * lines[] = { "A,1,S,1,1000", "A,2,B,3,1010", "A,3,S,1,1005", "T,1,1000", "T,1,1005" };
+		for ( size_t i = 0; i < sizeof ( lines ) / sizeof ( lines[0] ); i++ )
+			applyToBook ( book, errors, parse ( lines[i] ), out );
+		BOOST_CHECK_EQUAL ( errors.trades_with_no_corresponding_order, ( uint32_t ) 0 );
+	}
+	{
+		// we started expecting trades just before the wrap, so the sell at 1009 came in after that
+		ErrorSummary errors;
+		OrderBook book ( errors );
+		startBookAt ( book, 0x7FFFFFFC );
+		const char * lines[] = { "A,1,S,1,1000", "A,2,B,3,1010", "A,3,S,1,1005", "T,1,1000", "A,4,S,1,1008", "A,5,S,1,1009", "T,1,1005" };
+		for ( size_t i = 0; i < sizeof ( lines ) / sizeof ( lines[0] ); i++ )
+			applyToBook ( book, errors, parse ( lines[i] ), out );
+		BOOST_CHECK_EQUAL ( errors.trades_with_no_corresponding_order, ( uint32_t ) 0 );
+		applyToBook ( book, errors, parse ( "T,1,1009" ), out );
+		BOOST_CHECK_EQUAL ( errors.trades_with_no_corresponding_order, ( uint32_t ) 1 );
+	}
+}
+
+static uint64_t replayJournal ( std::string const & filename, FeedHandler & feed )
+{
+	MappedFile journal ( filename );
+	BOOST_REQUIRE ( journal.good() );
+	return Journal::replay ( journal.data(), journal.size(), feed );
+}
+
+/*
+ * Whatever we appended, and committed, comes back as the same books and errors - the corrupted messages included -
+ * however many times we open the journal again, and whatever a crash left at its end.
+ */
+BOOST_AUTO_TEST_CASE ( journalTest )
+{
+	static const char * symbols[] = { "", ",AAPL", ",IBM", ",MSFT", ",GOOG" };
+	std::vector < Message > generated ( generatedFeed ( 2000, symbols ) );
+	std::vector < Message > messages;
+	for ( size_t i = 0; i < generated.size(); i++ )
+	{
+		messages.push_back ( generated[i] );
+		if ( i % 97 == 0 )
+			messages.push_back ( parse ( "garbage" ) );
+	}
+	char filename[] = "/tmp/journalTestXXXXXX";
+	int fd ( mkstemp ( filename ) );
+	BOOST_REQUIRE ( fd >= 0 );
+	close ( fd );
+	FeedHandler original;
+	std::stringstream ignored;
+	size_t half ( messages.size() / 2 );
+	{
+		// small groups, and we wait for every one of them to be committed before we start on the next, so there's
+		// more than one commit however fast the writer thread gets to them
+		static const size_t group_bytes ( 1024 );
+		static const size_t group_records ( ( group_bytes + Journal::record_size - 1 ) / Journal::record_size );
+		Journal journal ( filename, GroupCommit ( group_bytes, 0 ) );
+		BOOST_REQUIRE ( journal.good() );
+		BOOST_CHECK_EQUAL ( journal.recovered(), ( uint64_t ) 0 );
+		size_t groups ( 0 );
+		for ( size_t i = 0; i < half; i++ )
+		{
+			journal.append ( messages[i] );
+			original.processMessage ( messages[i], ignored );
+			if ( ( i + 1 ) % group_records == 0 )
+			{
+				while ( journal.committed() < ( i + 1 ) * Journal::record_size )
+					std::this_thread::yield();
+				groups++;
+			}
+		}
+		BOOST_REQUIRE ( groups > 1 );
+		journal.close();
+		AsyncWriterStats const & stats ( journal.stats() );
+		BOOST_CHECK_EQUAL ( stats.bytes_written, half * Journal::record_size );
+		BOOST_CHECK_EQUAL ( journal.committed(), stats.bytes_written );
+		BOOST_CHECK ( stats.syncs >= groups );
+		BOOST_CHECK_EQUAL ( stats.failed_syncs, ( uint64_t ) 0 );
+	}
+	FeedHandler first_half;
+	BOOST_CHECK_EQUAL ( replayJournal ( filename, first_half ), ( uint64_t ) half );
+	checkSameFeed ( first_half, original );
+	// a record we only got half way through
+	FILE * file ( fopen ( filename, "ab" ) );
+	BOOST_REQUIRE ( file );
+	fwrite ( "torn", 1, 4, file );
+	fclose ( file );
+	{
+		Journal journal ( filename );
+		BOOST_REQUIRE ( journal.good() );
+		BOOST_CHECK_EQUAL ( journal.recovered(), ( uint64_t ) half );
+		for ( size_t i = half; i < messages.size(); i++ )
+		{
+			journal.append ( messages[i] );
+			original.processMessage ( messages[i], ignored );
+		}
+	}
+	FeedHandler whole;
+	BOOST_CHECK_EQUAL ( replayJournal ( filename, whole ), ( uint64_t ) messages.size() );
+	checkSameFeed ( whole, original );
+	// starting half way, on top of what we had
+	MappedFile journal ( filename );
+	BOOST_REQUIRE_EQUAL ( journal.size(), Journal::header_size + messages.size() * Journal::record_size );
+	BOOST_CHECK_EQUAL ( Journal::replay ( journal.data(), journal.size(), first_half, half ), ( uint64_t ) messages.size() );
+	checkSameFeed ( first_half, original );
+	// a round trip keeps every field, the symbol too
+	for ( size_t i = 0; i < messages.size(); i++ )
+	{
+		Message decoded;
+		Journal::decode ( journal.data() + Journal::header_size + i * Journal::record_size, decoded );
+		BOOST_CHECK_EQUAL ( decoded.type, messages[i].type );
+		BOOST_CHECK_EQUAL ( decoded.symbol, messages[i].symbol );
+		BOOST_CHECK_EQUAL ( decoded.order_id, messages[i].order_id );
+	}
+	// something that isn't a journal is left alone
+	file = fopen ( filename, "wb" );
+	BOOST_REQUIRE ( file );
+	fwrite ( "not a journal", 1, 13, file );
+	fclose ( file );
+	{
+		Journal other ( filename );
+		BOOST_CHECK ( !other.good() );
+		other.append ( messages[0] );
+	}
+	MappedFile other ( filename );
+	BOOST_CHECK_EQUAL ( other.size(), ( size_t ) 13 );
+	FeedHandler nothing;
+	BOOST_CHECK_EQUAL ( Journal::replay ( other.data(), other.size(), nothing ), ( uint64_t ) 0 );
+	unlink ( filename );
+}
+
+/* Takes its time over every message, and remembers what it got */
+struct SlowProcessor
+{
+	SlowProcessor ( std::chrono::microseconds per_message ) : took ( per_message ) {}
+	void process ( Message const & message )
+	{
+		std::this_thread::sleep_for ( took );
+		types.push_back ( message.type );
+	}
+	std::chrono::microseconds took;
+	std::vector < MessageType::Type > types;
+};
+
+BOOST_AUTO_TEST_CASE ( latencyHistogramTest )
+{
+	LatencyHistogram histogram;
+	BOOST_CHECK_EQUAL ( histogram.percentile ( 50 ), ( uint64_t ) 0 );
+	for ( uint64_t ns = 1; ns <= 100000; ns++ )
+		histogram.record ( ns );
+	BOOST_CHECK_EQUAL ( histogram.count(), ( uint64_t ) 100000 );
+	BOOST_CHECK_EQUAL ( histogram.max(), ( uint64_t ) 100000 );
+	BOOST_CHECK_CLOSE ( histogram.mean(), 50000.5, 0.001 );
+	BOOST_CHECK_EQUAL ( histogram.percentile ( 100 ), ( uint64_t ) 100000 );
+	// never under, and at most a 16th over
+	double percentiles[] = { 0.001, 0.01, 1, 50, 90, 99, 99.9 };
+	for ( size_t i = 0; i < sizeof ( percentiles ) / sizeof ( percentiles[0] ); i++ )
+	{
+		uint64_t exact ( static_cast < uint64_t > ( percentiles[i] * 1000 + 0.5 ) );
+		uint64_t got ( histogram.percentile ( percentiles[i] ) );
+		BOOST_CHECK ( got >= exact );
+		BOOST_CHECK ( got <= exact + exact / 16 );
+	}
+	// small ones are exact
+	LatencyHistogram small;
+	small.record ( 3 );
+	small.record ( 7 );
+	BOOST_CHECK_EQUAL ( small.percentile ( 50 ), ( uint64_t ) 3 );
+	BOOST_CHECK_EQUAL ( small.percentile ( 99 ), ( uint64_t ) 7 );
+	LatencyHistogram huge;
+	huge.record ( std::numeric_limits < uint64_t >::max() );
+	BOOST_CHECK_EQUAL ( huge.percentile ( 50 ), std::numeric_limits < uint64_t >::max() );
+}
+
+BOOST_AUTO_TEST_CASE ( replayTest )
+{
+	uint64_t capture_ns ( 0 );
+	Message message;
+	BOOST_CHECK ( ReplayDriver::parse ( std::string ( "1697012345000001234,A,100000,S,1,1075,IBM" ), capture_ns, message ) );
+	BOOST_CHECK_EQUAL ( capture_ns, ( uint64_t ) 1697012345000001234ull );
+	BOOST_CHECK_EQUAL ( message.type, MessageType::ADD );
+	BOOST_CHECK_EQUAL ( message.order_id, ( uint32_t ) 100000 );
+	BOOST_CHECK ( message.symbol != 0 );
+	BOOST_CHECK ( !ReplayDriver::parse ( std::string ( "X,100000,S,1,1075" ), capture_ns, message ) );
+	BOOST_CHECK_EQUAL ( message.type, MessageType::REMOVE );
+	BOOST_CHECK_EQUAL ( capture_ns, ( uint64_t ) 1697012345000001234ull );
+	BOOST_CHECK ( !ReplayDriver::parse ( std::string ( "12345" ), capture_ns, message ) );
+	BOOST_CHECK_EQUAL ( message.type, MessageType::CORRUPTED );
+	const char * lines[] = { "0,A,1,B,5,100", "2000000,A,2,S,5,101", "4000000,M,1,B,4,100", "6000000,X,2,S,5,101", "8000000,T,1,100", "8000000,garbage" };
+	const size_t count ( sizeof ( lines ) / sizeof ( lines[0] ) );
+	// as captured the last one is due 8ms after the first, ten times as fast 0.8ms, and as fast as we can whenever
+	double speeds[] = { 1, 10, 0 };
+	for ( size_t s = 0; s < sizeof ( speeds ) / sizeof ( speeds[0] ); s++ )
+	{
+		ReplayDriver driver ( speeds[s] );
+		SlowProcessor processor ( std::chrono::microseconds ( 0 ) );
+		for ( size_t i = 0; i < count; i++ )
+		{
+			bool timed ( ReplayDriver::parse ( std::string ( lines[i] ), capture_ns, message ) );
+			driver.replay ( capture_ns, timed, message, processor );
+		}
+		BOOST_REQUIRE_EQUAL ( processor.types.size(), count );
+		BOOST_CHECK_EQUAL ( processor.types[2], MessageType::MODIFY );
+		if ( speeds[s] )
+			BOOST_CHECK ( driver.elapsed() >= std::chrono::microseconds ( static_cast < uint64_t > ( 8000 / speeds[s] ) ) );
+		else
+			BOOST_CHECK_EQUAL ( driver.late(), ( uint64_t ) 0 );
+		BOOST_CHECK_EQUAL ( driver.latencies ( MessageType::ADD ).count(), ( uint64_t ) 2 );
+		BOOST_CHECK_EQUAL ( driver.latencies ( MessageType::TRADE ).count(), ( uint64_t ) 1 );
+		// WEIRD and CORRUPTED end up together
+		BOOST_CHECK_EQUAL ( driver.latencies ( MessageType::WEIRD ).count(), ( uint64_t ) 1 );
+		std::stringstream report;
+		report << driver;
+		BOOST_CHECK ( report.str().find ( "[ REPLAY] M: 1 messages" ) != std::string::npos );
+	}
+	// all due at once, and 1ms each: the last one had to wait for the four before it
+	ReplayDriver driver ( 1 );
+	SlowProcessor processor ( std::chrono::microseconds ( 1000 ) );
+	for ( uint32_t i = 0; i < 5; i++ )
+	{
+		message.type = MessageType::ADD;
+		driver.replay ( 1000, i == 0, message, processor );
+	}
+	LatencyHistogram const & added ( driver.latencies ( MessageType::ADD ) );
+	BOOST_CHECK_EQUAL ( added.count(), ( uint64_t ) 5 );
+	BOOST_CHECK ( added.max() >= 5000000 );
+	BOOST_CHECK ( driver.late() >= 4 );
+}